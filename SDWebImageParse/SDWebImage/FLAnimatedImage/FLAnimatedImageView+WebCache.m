@@ -14,6 +14,7 @@
 #import "UIView+WebCache.h"
 #import "NSData+ImageContentType.h"
 #import "UIImageView+WebCache.h"
+#import "SDWebImageCoderHelper.h"
 
 @implementation UIImage (FLAnimatedImage)
 
@@ -78,7 +79,13 @@
                                }
                            } else if ([NSData sd_imageFormatForImageData:imageData] == SDImageFormatGIF) {
                                // Firstly set the static poster image to avoid flashing
-                               UIImage *posterImage = image.images ? image.images.firstObject : image;
+                               UIImage *posterImage;
+                               if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+                                   // do not build the repeated frames, the image itself is the first frame
+                                   posterImage = [[UIImage alloc] initWithCGImage:image.CGImage scale:image.scale orientation:image.imageOrientation];
+                               } else {
+                                   posterImage = image.images ? image.images.firstObject : image;
+                               }
                                weakSelf.image = posterImage;
                                weakSelf.animatedImage = nil;
                                // Secondly create FLAnimatedImage in global queue because it's time consuming, then set it back
@@ -17,13 +17,19 @@ typedef NS_ENUM(NSInteger, SDImageFormat) {
     SDImageFormatGIF,
     SDImageFormatTIFF,
     SDImageFormatWebP,
-    SDImageFormatHEIC
+    SDImageFormatHEIC,
+    SDImageFormatAVIF,
+    SDImageFormatBMP,
+    SDImageFormatICO
 };
 
 @interface NSData (ImageContentType)
 
 /**
  *  Return image format
+ *  The header is matched against a static signature table with raw byte compares, nothing is allocated.
+ *  APNG and animated WebP are reported as `SDImageFormatPNG` and `SDImageFormatWebP`.
+ *  wwt 只读取前64个字节做签名比较，不分配任何对象
  *
  *  @param data the input image data
  *
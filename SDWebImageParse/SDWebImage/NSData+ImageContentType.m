@@ -19,6 +19,100 @@
 // AVFileTypeHEIC is defined in AVFoundation via iOS 11, we use this without import AVFoundation
 #define kSDUTTypeHEIC ((__bridge CFStringRef)@"public.heic")
 
+// AVIF is supported by Image/IO via iOS 16
+#define kSDUTTypeAVIF ((__bridge CFStringRef)@"public.avif")
+
+// The longest header we need to look at, `ftyp` box with a few compatible brands
+#define kSDImageHeaderLength 64
+
+static inline uint32_t SDImageReadUInt32BE(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint32_t SDImageReadUInt32LE(const uint8_t *p) {
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+// Validators take the matched header and return the format, or `SDImageFormatUndefined` to keep searching
+typedef SDImageFormat (*SDImageSignatureValidator)(const uint8_t *bytes, size_t length, SDImageFormat format);
+
+// RIFF....WEBP followed by a `VP8 `, `VP8L` or `VP8X` (animated, alpha) chunk
+static SDImageFormat SDImageValidateWebP(const uint8_t *bytes, size_t length, SDImageFormat format) {
+    if (length < 16 || memcmp(bytes + 8, "WEBP", 4) != 0) return SDImageFormatUndefined;
+    if (memcmp(bytes + 12, "VP8 ", 4) == 0 || memcmp(bytes + 12, "VP8L", 4) == 0 || memcmp(bytes + 12, "VP8X", 4) == 0) {
+        return format;
+    }
+    return SDImageFormatUndefined;
+}
+
+// ISO base media `ftyp` box: the major brand, or the compatible brands for `mif1`/`msf1`
+static SDImageFormat SDImageFormatForBrand(const uint8_t *brand) {
+    static const char *heicBrands[] = {"heic", "heix", "hevc", "hevx", "heim", "heis", "hevm", "hevs"};
+    if (memcmp(brand, "avif", 4) == 0 || memcmp(brand, "avis", 4) == 0) return SDImageFormatAVIF;
+    for (size_t i = 0; i < sizeof(heicBrands) / sizeof(heicBrands[0]); i++) {
+        if (memcmp(brand, heicBrands[i], 4) == 0) return SDImageFormatHEIC;
+    }
+    return SDImageFormatUndefined;
+}
+
+static SDImageFormat SDImageValidateFileType(const uint8_t *bytes, size_t length, SDImageFormat format) {
+    if (length < 12) return SDImageFormatUndefined;
+    SDImageFormat major = SDImageFormatForBrand(bytes + 8);
+    if (major != SDImageFormatUndefined) return major;
+    if (memcmp(bytes + 8, "mif1", 4) != 0 && memcmp(bytes + 8, "msf1", 4) != 0) return SDImageFormatUndefined;
+    // size, type, major brand, minor version, then compatible brands until the end of box
+    size_t end = MIN((size_t)SDImageReadUInt32BE(bytes), length);
+    SDImageFormat compatible = SDImageFormatUndefined;
+    for (size_t offset = 16; offset + 4 <= end; offset += 4) {
+        SDImageFormat brand = SDImageFormatForBrand(bytes + offset);
+        if (brand == SDImageFormatAVIF) return brand;
+        if (brand != SDImageFormatUndefined) compatible = brand;
+    }
+    return compatible;
+}
+
+// BM, then the DIB header size at offset 14 must be one of the known versions
+static SDImageFormat SDImageValidateBMP(const uint8_t *bytes, size_t length, SDImageFormat format) {
+    if (length < 18) return SDImageFormatUndefined;
+    switch (SDImageReadUInt32LE(bytes + 14)) {
+        case 12: case 16: case 40: case 52: case 56: case 64: case 108: case 124:
+            return format;
+        default:
+            return SDImageFormatUndefined;
+    }
+}
+
+// 00 00 01 00 and a non-zero image count
+static SDImageFormat SDImageValidateICO(const uint8_t *bytes, size_t length, SDImageFormat format) {
+    if (length < 6 || (bytes[4] == 0 && bytes[5] == 0)) return SDImageFormatUndefined;
+    return format;
+}
+
+typedef struct {
+    SDImageFormat format;
+    size_t offset;
+    size_t length;
+    const char *magic;
+    SDImageSignatureValidator validator;
+} SDImageSignature;
+
+// File signatures table: http://www.garykessler.net/library/file_sigs.html
+// YYKit keeps the same table in `YYImageDetectType` (YYImageCoder.m), the two libraries can't share code.
+// Keep them in sync, the FormatDetection benchmark in SDWebImageBenchmark.m and YYImageBenchmark check the same headers.
+// wwt 按常见程度排序，前缀匹配后再由validator做进一步检查
+static const SDImageSignature kSDImageSignatures[] = {
+    {SDImageFormatJPEG, 0, 3, "\xFF\xD8\xFF", NULL},
+    {SDImageFormatPNG,  0, 8, "\x89PNG\r\n\x1A\n", NULL},
+    {SDImageFormatGIF,  0, 6, "GIF89a", NULL},
+    {SDImageFormatGIF,  0, 6, "GIF87a", NULL},
+    {SDImageFormatWebP, 0, 4, "RIFF", SDImageValidateWebP},
+    {SDImageFormatUndefined, 4, 4, "ftyp", SDImageValidateFileType}, // HEIC, AVIF
+    {SDImageFormatTIFF, 0, 4, "II*\0", NULL},
+    {SDImageFormatTIFF, 0, 4, "MM\0*", NULL},
+    {SDImageFormatBMP,  0, 2, "BM", SDImageValidateBMP},
+    {SDImageFormatICO,  0, 4, "\0\0\1\0", SDImageValidateICO},
+};
+
 @implementation NSData (ImageContentType)
 
 + (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data {
@@ -26,41 +120,21 @@
         return SDImageFormatUndefined;
     }
     
-    // File signatures table: http://www.garykessler.net/library/file_sigs.html
-    uint8_t c;
-    [data getBytes:&c length:1];
-    switch (c) {
-        case 0xFF:
-            return SDImageFormatJPEG;
-        case 0x89:
-            return SDImageFormatPNG;
-        case 0x47:
-            return SDImageFormatGIF;
-        case 0x49:
-        case 0x4D:
-            return SDImageFormatTIFF;
-        case 0x52: {
-            if (data.length >= 12) {
-                //RIFF....WEBP
-                NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(0, 12)] encoding:NSASCIIStringEncoding];
-                if ([testString hasPrefix:@"RIFF"] && [testString hasSuffix:@"WEBP"]) {
-                    return SDImageFormatWebP;
-                }
-            }
-            break;
+    // Copy the header to the stack, `data.bytes` may flatten a non-contiguous data
+    uint8_t bytes[kSDImageHeaderLength];
+    size_t length = MIN(data.length, kSDImageHeaderLength);
+    [data getBytes:bytes length:length];
+    
+    for (size_t i = 0; i < sizeof(kSDImageSignatures) / sizeof(kSDImageSignatures[0]); i++) {
+        const SDImageSignature *signature = &kSDImageSignatures[i];
+        if (length < signature->offset + signature->length) continue;
+        if (memcmp(bytes + signature->offset, signature->magic, signature->length) != 0) continue;
+        SDImageFormat format = signature->format;
+        if (signature->validator) {
+            format = signature->validator(bytes, length, format);
         }
-        case 0x00: {
-            if (data.length >= 12) {
-                //....ftypheic ....ftypheix ....ftyphevc ....ftyphevx
-                NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(4, 8)] encoding:NSASCIIStringEncoding];
-                if ([testString isEqualToString:@"ftypheic"]
-                    || [testString isEqualToString:@"ftypheix"]
-                    || [testString isEqualToString:@"ftyphevc"]
-                    || [testString isEqualToString:@"ftyphevx"]) {
-                    return SDImageFormatHEIC;
-                }
-            }
-            break;
+        if (format != SDImageFormatUndefined) {
+            return format;
         }
     }
     return SDImageFormatUndefined;
@@ -87,6 +161,15 @@
         case SDImageFormatHEIC:
             UTType = kSDUTTypeHEIC;
             break;
+        case SDImageFormatAVIF:
+            UTType = kSDUTTypeAVIF;
+            break;
+        case SDImageFormatBMP:
+            UTType = kUTTypeBMP;
+            break;
+        case SDImageFormatICO:
+            UTType = kUTTypeICO;
+            break;
         default:
             // default is kUTTypePNG
             UTType = kUTTypePNG;
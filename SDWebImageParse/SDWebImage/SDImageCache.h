@@ -65,8 +65,9 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 @property (nonatomic, nonnull, readonly) SDImageCacheConfig *config;
 
 /**
- * wwt 内存中的图片缓存的最大成本，成本函数是内存中保存的像素数
- * The maximum "total cost" of the in-memory image cache. The cost function is the number of pixels held in memory.
+ * wwt 内存中的图片缓存的最大成本，成本函数是内存中保存的字节数，超出时淘汰最久未使用的图片
+ * The maximum "total cost" of the in-memory image cache. The cost function is the number of bytes held in memory (all frames for animated images, the compressed data and first frame for images decoded on demand).
+ * The least recently used images are evicted when the cost is over the limit. Defaults to 0, which means no limit.
  */
 @property (assign, nonatomic) NSUInteger maxMemoryCost;
 
@@ -76,6 +77,13 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
  */
 @property (assign, nonatomic) NSUInteger maxMemoryCountLimit;
 
+/**
+ * wwt 被淘汰后仍保留弱引用的图片的最大数目
+ * The maximum number of evicted images which are still tracked by weak references, so the images retained by other instance such as imageViews can be synced back without loading from disk.
+ * The least recently evicted ones are forgotten first. Defaults to 1000, 0 means no weak cache.
+ */
+@property (assign, nonatomic) NSUInteger maxMemoryWeakCountLimit;
+
 #pragma mark - Singleton and initialization
 
 /**
@@ -112,6 +120,7 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
  * 添加一个只读的缓存路径以搜索SDImageCache预缓存的图像，对于使用预缓存的app是有用的
  * Add a read-only cache path to search for images pre-cached by SDImageCache
  * Useful if you want to bundle pre-loaded images with your app
+ * The files in path are indexed when searched the first time, so the path should not be modified after added
  *
  * @param path The path to use for this read-only cache path
  */
@@ -207,6 +216,7 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 
 /**
  * Operation that queries the cache asynchronously and call the completion when done.
+ * The disk queries run concurrently with each other, but still after the store and remove operations called before.
  *
  * @param key       The unique key used to store the wanted image
  * @param options   A mask to specify options to use for this cache query
@@ -273,7 +283,9 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 - (void)clearDiskOnCompletion:(nullable SDWebImageNoParamsBlock)completion;
 
 /**
+ * wwt 异步删除硬盘中过期的图片，文件的大小和时间从硬盘缓存的清单读取，不遍历缓存目录
  * Async remove all expired cached image from disk. Non-blocking method - returns immediately.
+ * The size and dates of the files are read from the disk cache manifest (an index kept in the cache directory), the directory is not enumerated.
  * @param completionBlock A block that should be executed after cache expiration completes (optional)
  */
 - (void)deleteOldFilesWithCompletionBlock:(nullable SDWebImageNoParamsBlock)completionBlock;
@@ -281,7 +293,17 @@ typedef void(^SDWebImageCalculateSizeBlock)(NSUInteger fileCount, NSUInteger tot
 #pragma mark - Cache Info
 
 /**
- * Get the size used by the disk cache
+ * Get the cost (bytes) used by the memory cache
+ */
+- (NSUInteger)getMemoryCost;
+
+/**
+ * Get the number of images in the memory cache (not including the weak cache)
+ */
+- (NSUInteger)getMemoryCount;
+
+/**
+ * Get the size used by the disk cache (the total file size recorded in the disk cache manifest)
  */
 - (NSUInteger)getSize;
 
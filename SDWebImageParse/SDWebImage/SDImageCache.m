@@ -8,124 +8,1028 @@
 
 #import "SDImageCache.h"
 #import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+#import <sys/mman.h>
 #import "NSImage+WebCache.h"
 #import "SDWebImageCodersManager.h"
+#import "SDWebImageCoderHelper.h"
 
 #define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
 #define UNLOCK(lock) dispatch_semaphore_signal(lock);
 
+// wwt 图片在内存中占用的字节数，动图按帧计算
 FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
+    CGImageRef imageRef = image.CGImage;
+    NSUInteger bytesPerPixel = imageRef ? MAX(CGImageGetBitsPerPixel(imageRef) / 8, 1) : 4;
 #if SD_MAC
-    return image.size.height * image.size.width;
+    return image.size.height * image.size.width * bytesPerPixel;
 #elif SD_UIKIT || SD_WATCH
-    return image.size.height * image.size.width * image.scale * image.scale;
+    NSUInteger cost = image.size.height * image.size.width * image.scale * image.scale * bytesPerPixel;
+#if SD_UIKIT
+    // wwt 按需解码的动图只缓存压缩数据和第一帧
+    if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        SDWebImageAnimatedImage *animatedImage = (SDWebImageAnimatedImage *)image;
+        if (animatedImage.animatedImageData) {
+            // the compressed data plus the first frame
+            cost += animatedImage.animatedImageData.length;
+        } else {
+            cost *= animatedImage.animatedImageFrameCount;
+        }
+        return cost;
+    }
+#endif
+    if (image.images.count > 0) {
+        // the repeated frames are the same instance
+        cost *= [NSSet setWithArray:image.images].count;
+    }
+    return cost;
 #endif
 }
 
-// A memory cache which auto purge the cache on memory warning and support weak cache.
-@interface SDMemoryCache <KeyType, ObjectType> : NSCache <KeyType, ObjectType>
+// A node of the LRU lists in `SDMemoryCache`. The node holds the object strongly when it's in the cache, and weakly after it's evicted.
+@interface SDMemoryCacheNode : NSObject {
+    @package
+    __unsafe_unretained SDMemoryCacheNode *_prev; // retained by the dictionary
+    __unsafe_unretained SDMemoryCacheNode *_next; // retained by the dictionary
+    id _key;
+    id _value; // nil if the node is in the weak list
+    __weak id _weakValue;
+    NSUInteger _cost;
+}
+@end
 
+@implementation SDMemoryCacheNode
 @end
 
-// Private
-@interface SDMemoryCache <KeyType, ObjectType> ()
+// A doubly linked list of nodes, the head is the most recently used one
+typedef struct {
+    __unsafe_unretained SDMemoryCacheNode *head;
+    __unsafe_unretained SDMemoryCacheNode *tail;
+    NSUInteger count;
+} SDMemoryCacheList;
+
+static void SDMemoryCacheListInsertAtHead(SDMemoryCacheList *list, SDMemoryCacheNode *node) {
+    node->_prev = nil;
+    node->_next = list->head;
+    if (list->head) {
+        list->head->_prev = node;
+    } else {
+        list->tail = node;
+    }
+    list->head = node;
+    list->count++;
+}
+
+static void SDMemoryCacheListRemove(SDMemoryCacheList *list, SDMemoryCacheNode *node) {
+    if (node->_prev) {
+        node->_prev->_next = node->_next;
+    } else {
+        list->head = node->_next;
+    }
+    if (node->_next) {
+        node->_next->_prev = node->_prev;
+    } else {
+        list->tail = node->_prev;
+    }
+    node->_prev = nil;
+    node->_next = nil;
+    list->count--;
+}
 
-@property (nonatomic, strong, nonnull) NSMapTable<KeyType, ObjectType> *weakCache; // strong-weak cache
-@property (nonatomic, strong, nonnull) dispatch_semaphore_t weakCacheLock; // a lock to keep the access to `weakCache` thread-safe
+// wwt LRU内存缓存：按成本(字节数)和数量淘汰最久未使用的对象，被淘汰的对象转为弱引用，弱引用的数量也有限制
+// A memory cache with explicit LRU eviction by total cost (bytes) and count. It's used in place of `NSCache`, whose eviction is not deterministic.
+// The evicted objects (including the ones removed on memory warning) are kept weakly. The image instance can be retained by other instance such as imageViews and alive,
+// at this case, we can sync weak cache back and do not need to load from disk cache. The weak entries are limited by `weakCountLimit` in LRU order too.
+// This class is thread-safe.
+@interface SDMemoryCache <KeyType, ObjectType> : NSObject
+
+@property (nonatomic, copy, nullable) NSString *name;
+@property (nonatomic, assign) NSUInteger totalCostLimit; // 0 means no limit
+@property (nonatomic, assign) NSUInteger countLimit; // 0 means no limit
+@property (nonatomic, assign) NSUInteger weakCountLimit; // the maximum number of evicted objects kept weakly, 0 means no weak cache
+@property (nonatomic, assign, readonly) NSUInteger totalCost;
+@property (nonatomic, assign, readonly) NSUInteger totalCount;
+
+- (nullable ObjectType)objectForKey:(nonnull KeyType)key;
+- (void)setObject:(nullable ObjectType)obj forKey:(nonnull KeyType)key;
+- (void)setObject:(nullable ObjectType)obj forKey:(nonnull KeyType)key cost:(NSUInteger)g;
+- (void)removeObjectForKey:(nonnull KeyType)key;
+- (void)removeAllObjects;
 
 @end
 
-@implementation SDMemoryCache
-
-// Current this seems no use on macOS (macOS use virtual memory and do not clear cache when memory warning). So we only override on iOS/tvOS platform.
-// But in the future there may be more options and features for this subclass.
-#if SD_UIKIT
+@implementation SDMemoryCache {
+    NSMutableDictionary<id, SDMemoryCacheNode *> *_nodes;
+    SDMemoryCacheList _strongList;
+    SDMemoryCacheList _weakList;
+    NSUInteger _totalCost;
+    dispatch_semaphore_t _lock;
+}
 
 - (void)dealloc {
+#if SD_UIKIT
     [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+#endif
 }
 
 - (instancetype)init {
     self = [super init];
     if (self) {
-        // Use a strong-weak maptable storing the secondary cache. Follow the doc that NSCache does not copy keys
-        // This is useful when the memory warning, the cache was purged. However, the image instance can be retained by other instance such as imageViews and alive.
-        // At this case, we can sync weak cache back and do not need to load from disk cache
-        self.weakCache = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory valueOptions:NSPointerFunctionsWeakMemory capacity:0];
-        self.weakCacheLock = dispatch_semaphore_create(1);
+        _nodes = [NSMutableDictionary dictionary];
+        _lock = dispatch_semaphore_create(1);
+        _weakCountLimit = 1000;
+        // Current this seems no use on macOS (macOS use virtual memory and do not clear cache when memory warning). So we only observe on iOS/tvOS platform.
+#if SD_UIKIT
         [[NSNotificationCenter defaultCenter] addObserver:self
                                                  selector:@selector(didReceiveMemoryWarning:)
                                                      name:UIApplicationDidReceiveMemoryWarningNotification
                                                    object:nil];
+#endif
     }
     return self;
 }
 
 - (void)didReceiveMemoryWarning:(NSNotification *)notification {
     // Only remove cache, but keep weak cache
-    [super removeAllObjects];
+    NSMutableArray *evictedValues = [NSMutableArray array];
+    LOCK(_lock);
+    while (_strongList.tail) {
+        [evictedValues addObject:_strongList.tail->_value];
+        [self _evictNode:_strongList.tail];
+    }
+    [self _trimWeakList];
+    UNLOCK(_lock);
+    // release the objects out of lock
+    [evictedValues removeAllObjects];
+}
+
+- (NSUInteger)totalCost {
+    LOCK(_lock);
+    NSUInteger totalCost = _totalCost;
+    UNLOCK(_lock);
+    return totalCost;
+}
+
+- (NSUInteger)totalCount {
+    LOCK(_lock);
+    NSUInteger totalCount = _strongList.count;
+    UNLOCK(_lock);
+    return totalCount;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit {
+    LOCK(_lock);
+    _totalCostLimit = totalCostLimit;
+    NSArray *evictedValues = [self _trimStrongList];
+    UNLOCK(_lock);
+    evictedValues = nil;
+}
+
+- (void)setCountLimit:(NSUInteger)countLimit {
+    LOCK(_lock);
+    _countLimit = countLimit;
+    NSArray *evictedValues = [self _trimStrongList];
+    UNLOCK(_lock);
+    evictedValues = nil;
+}
+
+- (void)setWeakCountLimit:(NSUInteger)weakCountLimit {
+    LOCK(_lock);
+    _weakCountLimit = weakCountLimit;
+    [self _trimWeakList];
+    UNLOCK(_lock);
+}
+
+- (void)setObject:(id)obj forKey:(id)key {
+    [self setObject:obj forKey:key cost:0];
 }
 
-// `setObject:forKey:` just call this with 0 cost. Override this is enough
 - (void)setObject:(id)obj forKey:(id)key cost:(NSUInteger)g {
-    [super setObject:obj forKey:key cost:g];
-    if (key && obj) {
-        // Store weak cache
-        LOCK(self.weakCacheLock);
-        [self.weakCache setObject:obj forKey:key];
-        UNLOCK(self.weakCacheLock);
+    if (!key) {
+        return;
     }
+    if (!obj) {
+        [self removeObjectForKey:key];
+        return;
+    }
+    LOCK(_lock);
+    SDMemoryCacheNode *node = _nodes[key];
+    id oldValue = node ? node->_value : nil;
+    if (node) {
+        [self _detachNode:node];
+    } else {
+        node = [SDMemoryCacheNode new];
+        node->_key = key;
+        _nodes[key] = node;
+    }
+    node->_value = obj;
+    node->_weakValue = nil;
+    node->_cost = g;
+    _totalCost += g;
+    SDMemoryCacheListInsertAtHead(&_strongList, node);
+    NSArray *evictedValues = [self _trimStrongList];
+    UNLOCK(_lock);
+    // release the objects out of lock
+    oldValue = nil;
+    evictedValues = nil;
 }
 
 - (id)objectForKey:(id)key {
-    id obj = [super objectForKey:key];
-    if (key && !obj) {
-        // Check weak cache
-        LOCK(self.weakCacheLock);
-        obj = [self.weakCache objectForKey:key];
-        UNLOCK(self.weakCacheLock);
-        if (obj) {
-            // Sync cache
-            NSUInteger cost = 0;
-            if ([obj isKindOfClass:[UIImage class]]) {
-                cost = SDCacheCostForImage(obj);
-            }
-            [super setObject:obj forKey:key cost:cost];
-        }
+    if (!key) {
+        return nil;
+    }
+    LOCK(_lock);
+    SDMemoryCacheNode *node = _nodes[key];
+    if (!node) {
+        UNLOCK(_lock);
+        return nil;
+    }
+    id obj = node->_value;
+    if (obj) {
+        SDMemoryCacheListRemove(&_strongList, node);
+        SDMemoryCacheListInsertAtHead(&_strongList, node);
+        UNLOCK(_lock);
+        return obj;
     }
+    
+    // Check weak cache
+    obj = node->_weakValue;
+    SDMemoryCacheListRemove(&_weakList, node);
+    if (!obj) {
+        [_nodes removeObjectForKey:key];
+        UNLOCK(_lock);
+        return nil;
+    }
+    // Sync cache
+    NSUInteger cost = 0;
+    if ([obj isKindOfClass:[UIImage class]]) {
+        cost = SDCacheCostForImage(obj);
+    }
+    node->_value = obj;
+    node->_weakValue = nil;
+    node->_cost = cost;
+    _totalCost += cost;
+    SDMemoryCacheListInsertAtHead(&_strongList, node);
+    NSArray *evictedValues = [self _trimStrongList];
+    UNLOCK(_lock);
+    evictedValues = nil;
     return obj;
 }
 
 - (void)removeObjectForKey:(id)key {
-    [super removeObjectForKey:key];
-    if (key) {
-        // Remove weak cache
-        LOCK(self.weakCacheLock);
-        [self.weakCache removeObjectForKey:key];
-        UNLOCK(self.weakCacheLock);
+    if (!key) {
+        return;
+    }
+    LOCK(_lock);
+    SDMemoryCacheNode *node = _nodes[key];
+    id value = node ? node->_value : nil;
+    if (node) {
+        [self _detachNode:node];
+        [_nodes removeObjectForKey:key];
     }
+    UNLOCK(_lock);
+    value = nil;
 }
 
 - (void)removeAllObjects {
-    [super removeAllObjects];
     // Manually remove should also remove weak cache
-    LOCK(self.weakCacheLock);
-    [self.weakCache removeAllObjects];
-    UNLOCK(self.weakCacheLock);
+    LOCK(_lock);
+    NSMutableDictionary *nodes = _nodes;
+    _nodes = [NSMutableDictionary dictionary];
+    _strongList = (SDMemoryCacheList){nil, nil, 0};
+    _weakList = (SDMemoryCacheList){nil, nil, 0};
+    _totalCost = 0;
+    UNLOCK(_lock);
+    // release the objects out of lock
+    nodes = nil;
 }
 
-#endif
+#pragma mark - Private (call with lock)
+
+// Remove the node from the list it belongs to, the node is still in dictionary
+- (void)_detachNode:(SDMemoryCacheNode *)node {
+    if (node->_value) {
+        SDMemoryCacheListRemove(&_strongList, node);
+        _totalCost -= node->_cost;
+    } else {
+        SDMemoryCacheListRemove(&_weakList, node);
+    }
+}
+
+// Move the node from strong list to weak list, the caller should release the value out of lock
+- (void)_evictNode:(SDMemoryCacheNode *)node {
+    // the node (and its key) is released by the dictionary, keep it until the node is unlinked
+    SDMemoryCacheNode *strongNode = node;
+    SDMemoryCacheListRemove(&_strongList, strongNode);
+    _totalCost -= strongNode->_cost;
+    if (_weakCountLimit > 0) {
+        strongNode->_weakValue = strongNode->_value;
+        strongNode->_value = nil;
+        strongNode->_cost = 0;
+        SDMemoryCacheListInsertAtHead(&_weakList, strongNode);
+    } else {
+        strongNode->_value = nil;
+        [_nodes removeObjectForKey:strongNode->_key];
+    }
+}
+
+// Evict the least recently used objects until the cost and count are under limit, return the evicted objects
+- (NSArray *)_trimStrongList {
+    NSMutableArray *evictedValues = nil;
+    while (_strongList.tail && ((_totalCostLimit > 0 && _totalCost > _totalCostLimit) || (_countLimit > 0 && _strongList.count > _countLimit))) {
+        if (!evictedValues) {
+            evictedValues = [NSMutableArray array];
+        }
+        [evictedValues addObject:_strongList.tail->_value];
+        [self _evictNode:_strongList.tail];
+    }
+    if (evictedValues) {
+        [self _trimWeakList];
+    }
+    return evictedValues;
+}
+
+// Remove the released weak entries, then the least recently used ones until the count is under limit
+- (void)_trimWeakList {
+    if (_weakList.count <= _weakCountLimit) {
+        return;
+    }
+    SDMemoryCacheNode *node = _weakList.tail;
+    while (node && _weakList.count > _weakCountLimit) {
+        SDMemoryCacheNode *prev = node->_prev;
+        if (!node->_weakValue) {
+            // the node (and its key) is released by the dictionary, keep it until the node is unlinked
+            SDMemoryCacheNode *strongNode = node;
+            [_nodes removeObjectForKey:strongNode->_key];
+            SDMemoryCacheListRemove(&_weakList, strongNode);
+        }
+        node = prev;
+    }
+    while (_weakList.tail && _weakList.count > _weakCountLimit) {
+        SDMemoryCacheNode *strongNode = _weakList.tail;
+        [_nodes removeObjectForKey:strongNode->_key];
+        SDMemoryCacheListRemove(&_weakList, strongNode);
+    }
+}
+
+@end
+
+#pragma mark - Disk Cache Manifest
+
+static NSString *const kSDDiskCacheManifestFileName = @".sdmanifest";
+static const char kSDDiskCacheManifestHeader[] = "SDManifest 2\n";
+static const NSUInteger kSDDiskCacheManifestBufferSize = 4096; // pending records are written when the buffer is full
+static const NSTimeInterval kSDDiskCacheManifestAccessResolution = 60; // access time is recorded at most once per minute
+
+// An entry of the disk cache manifest, times are seconds since 1970.
+@interface SDDiskCacheManifestEntry : NSObject <NSCopying>
+
+@property (nonatomic, copy, nonnull) NSString *fileName;
+@property (nonatomic, assign) NSUInteger size;
+@property (nonatomic, assign) NSTimeInterval modificationTime;
+@property (nonatomic, assign) NSTimeInterval accessTime;
+@property (nonatomic, assign) uint64_t token; // a new random value for each write of the file
+
+@end
+
+@implementation SDDiskCacheManifestEntry
+
+- (id)copyWithZone:(NSZone *)zone {
+    SDDiskCacheManifestEntry *entry = [[[self class] allocWithZone:zone] init];
+    entry.fileName = self.fileName;
+    entry.size = self.size;
+    entry.modificationTime = self.modificationTime;
+    entry.accessTime = self.accessTime;
+    entry.token = self.token;
+    return entry;
+}
+
+@end
+
+// wwt 硬盘缓存的清单：记录每个文件的大小、修改时间和访问时间，清理和统计的时候不需要遍历目录
+// A persistent index of the disk cache files, stored as an append-only log (a hidden file in the cache directory).
+// Each line of the log is a record:
+//   "S <size> <mtime> <atime> <token> <file name>"   a file is stored
+//   "A <atime> <file name>"                          a file is accessed
+//   "R <file name>"                                  a file is removed
+// The log is replayed when loaded and compacted to "S" records when it grows too long.
+// If the log is missing or invalid (e.g. the cache was written by an older version), it is rebuilt from the directory once.
+// Once loaded, the manifest is authoritative: a lookup never stats the directory, so a miss costs nothing. Files put into
+// the directory by others (not through the cache) are not seen until the manifest is rebuilt.
+// This class is thread-safe.
+@interface SDDiskCacheManifest : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger totalSize;
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+- (nonnull instancetype)initWithDirectory:(nonnull NSString *)directory;
+
+// Load the log, or rebuild it from the directory. It is called automatically when the manifest is used the first time.
+- (void)load;
+
+- (void)setFileName:(nonnull NSString *)fileName size:(NSUInteger)size;
+- (void)accessFileName:(nonnull NSString *)fileName;
+- (void)removeFileName:(nonnull NSString *)fileName;
+- (BOOL)containsFileName:(nonnull NSString *)fileName;
+// The token of the last write of the file, 0 if the file is not in the manifest
+- (uint64_t)tokenForFileName:(nonnull NSString *)fileName;
+// Call this after the cache directory is removed
+- (void)removeAllEntries;
+
+// A snapshot of all entries
+- (nonnull NSArray<SDDiskCacheManifestEntry *> *)allEntries;
+
+// Write the pending records, and compact the log if needed
+- (void)flush;
+
+@end
+
+// A token for a write of a file, never 0
+static uint64_t SDDiskCacheManifestNewToken(void) {
+    uint64_t token = 0;
+    while (token == 0) {
+        arc4random_buf(&token, sizeof(token));
+    }
+    return token;
+}
+
+// Write all bytes, retry on partial write and interrupt
+static BOOL SDWriteAll(int fd, const void *bytes, size_t length) {
+    const char *p = bytes;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+        p += written;
+        length -= written;
+    }
+    return YES;
+}
+
+@implementation SDDiskCacheManifest {
+    NSString *_directory;
+    NSString *_path;
+    NSMutableDictionary<NSString *, SDDiskCacheManifestEntry *> *_entries;
+    NSMutableData *_buffer; // records not written to the log yet
+    NSUInteger _recordCount; // records in the log (written or pending)
+    NSUInteger _totalSize;
+    int _fd;
+    BOOL _loaded;
+    dispatch_semaphore_t _lock;
+}
+
+- (nonnull instancetype)initWithDirectory:(nonnull NSString *)directory {
+    if ((self = [super init])) {
+        _directory = [directory copy];
+        _path = [directory stringByAppendingPathComponent:kSDDiskCacheManifestFileName];
+        _entries = [NSMutableDictionary new];
+        _buffer = [NSMutableData new];
+        _fd = -1;
+        _lock = dispatch_semaphore_create(1);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self _flushBuffer];
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+#pragma mark Public
+
+- (void)load {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    UNLOCK(_lock);
+}
+
+- (NSUInteger)totalSize {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    NSUInteger totalSize = _totalSize;
+    UNLOCK(_lock);
+    return totalSize;
+}
+
+- (NSUInteger)count {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    NSUInteger count = _entries.count;
+    UNLOCK(_lock);
+    return count;
+}
+
+- (void)setFileName:(nonnull NSString *)fileName size:(NSUInteger)size {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    SDDiskCacheManifestEntry *entry = [self _setFileName:fileName size:size modificationTime:now accessTime:now];
+    [self _appendRecord:[self _recordForEntry:entry] flush:YES];
+    UNLOCK(_lock);
+}
+
+- (void)accessFileName:(nonnull NSString *)fileName {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    SDDiskCacheManifestEntry *entry = _entries[fileName];
+    if (entry && now - entry.accessTime >= kSDDiskCacheManifestAccessResolution) {
+        entry.accessTime = now;
+        // access records are only hints, they are buffered to avoid a write for every read
+        [self _appendRecord:[NSString stringWithFormat:@"A %.0f %@\n", now, fileName] flush:NO];
+    }
+    UNLOCK(_lock);
+}
+
+- (void)removeFileName:(nonnull NSString *)fileName {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    if (_entries[fileName]) {
+        [self _removeFileName:fileName];
+        [self _appendRecord:[NSString stringWithFormat:@"R %@\n", fileName] flush:YES];
+    }
+    UNLOCK(_lock);
+}
+
+- (BOOL)containsFileName:(nonnull NSString *)fileName {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    BOOL contains = _entries[fileName] != nil;
+    UNLOCK(_lock);
+    return contains;
+}
+
+- (uint64_t)tokenForFileName:(nonnull NSString *)fileName {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    uint64_t token = _entries[fileName].token;
+    UNLOCK(_lock);
+    return token;
+}
+
+- (void)removeAllEntries {
+    LOCK(_lock);
+    _loaded = YES;
+    [_entries removeAllObjects];
+    _totalSize = 0;
+    _recordCount = 0;
+    _buffer.length = 0;
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    unlink(_path.fileSystemRepresentation);
+    UNLOCK(_lock);
+}
+
+- (nonnull NSArray<SDDiskCacheManifestEntry *> *)allEntries {
+    LOCK(_lock);
+    [self _loadIfNeeded];
+    NSMutableArray<SDDiskCacheManifestEntry *> *entries = [NSMutableArray arrayWithCapacity:_entries.count];
+    for (SDDiskCacheManifestEntry *entry in _entries.objectEnumerator) {
+        [entries addObject:[entry copy]];
+    }
+    UNLOCK(_lock);
+    return entries;
+}
+
+- (void)flush {
+    LOCK(_lock);
+    if (_loaded) {
+        if (_recordCount > _entries.count * 2 + 1024) {
+            [self _compact];
+        } else {
+            [self _flushBuffer];
+        }
+    }
+    UNLOCK(_lock);
+}
+
+#pragma mark Private (call with lock)
+
+- (void)_loadIfNeeded {
+    if (_loaded) {
+        return;
+    }
+    _loaded = YES;
+    NSData *data = [NSData dataWithContentsOfFile:_path options:NSDataReadingMappedIfSafe error:nil];
+    BOOL truncated = NO;
+    if (![self _replayLog:data truncated:&truncated]) {
+        // no manifest yet (or an invalid one), build it from the files once
+        [_entries removeAllObjects];
+        _totalSize = 0;
+        [self _rebuildFromDirectory];
+        [self _compact];
+    } else if (truncated || _recordCount > _entries.count * 2 + 1024) {
+        // drop the partial record written when the app was killed, or the outdated records
+        [self _compact];
+    }
+}
+
+- (BOOL)_replayLog:(NSData *)data truncated:(BOOL *)truncated {
+    size_t headerLength = strlen(kSDDiskCacheManifestHeader);
+    if (data.length < headerLength || memcmp(data.bytes, kSDDiskCacheManifestHeader, headerLength) != 0) {
+        return NO;
+    }
+    const char *p = (const char *)data.bytes + headerLength;
+    const char *end = (const char *)data.bytes + data.length;
+    _recordCount = 0;
+    while (p < end) {
+        const char *lineEnd = memchr(p, '\n', end - p);
+        if (!lineEnd) {
+            *truncated = YES;
+            break;
+        }
+        [self _replayRecord:p length:lineEnd - p];
+        _recordCount++;
+        p = lineEnd + 1;
+    }
+    return YES;
+}
+
+- (void)_replayRecord:(const char *)record length:(size_t)length {
+    char line[1024];
+    if (length < 3 || length >= sizeof(line) || record[1] != ' ') {
+        return;
+    }
+    memcpy(line, record, length);
+    line[length] = '\0';
+    char *p = line + 2;
+    switch (line[0]) {
+        case 'S': {
+            unsigned long long size = strtoull(p, &p, 10);
+            double modificationTime = strtod(p, &p);
+            double accessTime = strtod(p, &p);
+            unsigned long long token = strtoull(p, &p, 10);
+            NSString *fileName = (*p == ' ') ? [NSString stringWithUTF8String:p + 1] : nil;
+            if (fileName.length > 0) {
+                [self _setFileName:fileName size:(NSUInteger)size modificationTime:modificationTime accessTime:accessTime].token = token;
+            }
+        } break;
+        case 'A': {
+            double accessTime = strtod(p, &p);
+            NSString *fileName = (*p == ' ') ? [NSString stringWithUTF8String:p + 1] : nil;
+            if (fileName.length > 0) {
+                _entries[fileName].accessTime = accessTime;
+            }
+        } break;
+        case 'R': {
+            NSString *fileName = [NSString stringWithUTF8String:p];
+            if (fileName.length > 0) {
+                [self _removeFileName:fileName];
+            }
+        } break;
+        default: break;
+    }
+}
+
+- (void)_rebuildFromDirectory {
+    NSURL *directoryURL = [NSURL fileURLWithPath:_directory isDirectory:YES];
+    NSArray<NSString *> *resourceKeys = @[NSURLIsDirectoryKey, NSURLContentModificationDateKey, NSURLContentAccessDateKey, NSURLFileSizeKey];
+    NSDirectoryEnumerator *fileEnumerator = [[NSFileManager new] enumeratorAtURL:directoryURL
+                                                      includingPropertiesForKeys:resourceKeys
+                                                                         options:NSDirectoryEnumerationSkipsHiddenFiles | NSDirectoryEnumerationSkipsSubdirectoryDescendants
+                                                                    errorHandler:NULL];
+    for (NSURL *fileURL in fileEnumerator) {
+        NSDictionary<NSString *, id> *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:nil];
+        if (!resourceValues || [resourceValues[NSURLIsDirectoryKey] boolValue]) {
+            continue;
+        }
+        NSDate *modificationDate = resourceValues[NSURLContentModificationDateKey];
+        NSDate *accessDate = resourceValues[NSURLContentAccessDateKey] ?: modificationDate;
+        NSNumber *fileSize = resourceValues[NSURLFileSizeKey];
+        [self _setFileName:fileURL.lastPathComponent size:fileSize.unsignedIntegerValue modificationTime:modificationDate.timeIntervalSince1970 accessTime:accessDate.timeIntervalSince1970];
+    }
+}
+
+- (SDDiskCacheManifestEntry *)_setFileName:(NSString *)fileName size:(NSUInteger)size modificationTime:(NSTimeInterval)modificationTime accessTime:(NSTimeInterval)accessTime {
+    SDDiskCacheManifestEntry *entry = _entries[fileName];
+    if (entry) {
+        _totalSize -= entry.size;
+    } else {
+        entry = [SDDiskCacheManifestEntry new];
+        entry.fileName = fileName;
+        _entries[fileName] = entry;
+    }
+    entry.size = size;
+    entry.modificationTime = modificationTime;
+    entry.accessTime = accessTime;
+    entry.token = SDDiskCacheManifestNewToken();
+    _totalSize += size;
+    return entry;
+}
+
+- (void)_removeFileName:(NSString *)fileName {
+    SDDiskCacheManifestEntry *entry = _entries[fileName];
+    if (entry) {
+        _totalSize -= entry.size;
+        [_entries removeObjectForKey:fileName];
+    }
+}
+
+- (NSString *)_recordForEntry:(SDDiskCacheManifestEntry *)entry {
+    return [NSString stringWithFormat:@"S %lu %.0f %.0f %llu %@\n", (unsigned long)entry.size, entry.modificationTime, entry.accessTime, entry.token, entry.fileName];
+}
+
+- (void)_appendRecord:(NSString *)record flush:(BOOL)flush {
+    [_buffer appendData:[record dataUsingEncoding:NSUTF8StringEncoding]];
+    _recordCount++;
+    if (flush || _buffer.length >= kSDDiskCacheManifestBufferSize) {
+        [self _flushBuffer];
+    }
+}
+
+- (void)_flushBuffer {
+    if (_buffer.length == 0) {
+        return;
+    }
+    if (_fd < 0) {
+        _fd = open(_path.fileSystemRepresentation, O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (_fd < 0) {
+            // the cache directory is not created yet, the records are written with the next one
+            return;
+        }
+        struct stat st;
+        if (fstat(_fd, &st) == 0 && st.st_size == 0) {
+            SDWriteAll(_fd, kSDDiskCacheManifestHeader, strlen(kSDDiskCacheManifestHeader));
+        }
+    }
+    if (!SDWriteAll(_fd, _buffer.bytes, _buffer.length)) {
+        // the log may end with a partial record, rewrite it
+        [self _compact];
+        return;
+    }
+    _buffer.length = 0;
+}
+
+// Rewrite the log with one "S" record for each entry
+- (void)_compact {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _buffer.length = 0;
+    _recordCount = _entries.count;
+    NSMutableData *data = [NSMutableData dataWithBytes:kSDDiskCacheManifestHeader length:strlen(kSDDiskCacheManifestHeader)];
+    for (SDDiskCacheManifestEntry *entry in _entries.objectEnumerator) {
+        [data appendData:[[self _recordForEntry:entry] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    BOOL isDirectory = NO;
+    if ([[NSFileManager new] fileExistsAtPath:_directory isDirectory:&isDirectory] && isDirectory) {
+        [data writeToFile:_path atomically:YES];
+    }
+}
+
+@end
+
+#pragma mark - Read-only Cache Index
+
+// wwt 只读缓存路径的索引：文件名 -> 路径，第一次查找时列出目录，之后查找不需要访问文件系统
+// An index of the files in read-only cache paths (file name -> the first path containing it).
+// The read-only paths are not modified, so each path is listed once lazily when searched the first time, instead of probing the file system for every key.
+// This class is thread-safe.
+@interface SDDiskCacheReadOnlyIndex : NSObject
+
+- (void)addPath:(nonnull NSString *)path;
+// Return the full path of the file in the first path containing it (in the order paths are added), or nil
+- (nullable NSString *)filePathForFileName:(nonnull NSString *)fileName;
+// The order of the path containing the file, NSNotFound if not found
+- (NSUInteger)pathIndexForFileName:(nonnull NSString *)fileName;
+
+@end
+
+@implementation SDDiskCacheReadOnlyIndex {
+    NSMutableArray<NSString *> *_paths;
+    NSUInteger _indexedPathCount; // the paths before this are listed
+    NSMutableDictionary<NSString *, NSNumber *> *_locations; // file name -> path index
+    dispatch_semaphore_t _lock;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _paths = [NSMutableArray new];
+        _locations = [NSMutableDictionary new];
+        _lock = dispatch_semaphore_create(1);
+    }
+    return self;
+}
+
+- (void)addPath:(nonnull NSString *)path {
+    LOCK(_lock);
+    if (![_paths containsObject:path]) {
+        [_paths addObject:path];
+    }
+    UNLOCK(_lock);
+}
+
+- (nullable NSString *)filePathForFileName:(nonnull NSString *)fileName {
+    LOCK(_lock);
+    [self _indexIfNeeded];
+    NSNumber *location = _locations[fileName];
+    NSString *filePath = location ? [_paths[location.unsignedIntegerValue] stringByAppendingPathComponent:fileName] : nil;
+    UNLOCK(_lock);
+    return filePath;
+}
+
+- (NSUInteger)pathIndexForFileName:(nonnull NSString *)fileName {
+    LOCK(_lock);
+    [self _indexIfNeeded];
+    NSNumber *location = _locations[fileName];
+    UNLOCK(_lock);
+    return location ? location.unsignedIntegerValue : NSNotFound;
+}
+
+// call with lock
+- (void)_indexIfNeeded {
+    NSFileManager *fileManager = [NSFileManager new];
+    while (_indexedPathCount < _paths.count) {
+        NSUInteger pathIndex = _indexedPathCount++;
+        NSArray<NSString *> *fileNames = [fileManager contentsOfDirectoryAtPath:_paths[pathIndex] error:nil];
+        for (NSString *fileName in fileNames) {
+            // the former path takes precedence
+            if (!_locations[fileName]) {
+                _locations[fileName] = @(pathIndex);
+            }
+        }
+    }
+}
 
 @end
 
+#pragma mark - Decoded Bitmap Files
+
+// wwt 解码位图文件：一页大小的文件头加上按64字节对齐行的像素，读取时映射文件直接生成CGImage
+// A decoded bitmap file is a header padded to a page, followed by the pixels (32 bits, host byte order, 64-byte aligned rows),
+// so the pixels of a mapped file are page-aligned and can back a `CGImage` without copying or decoding.
+// The header keeps the manifest token of the compressed file it is decoded from, a bitmap of replaced data is never used.
+// The files live in a hidden subdirectory of the disk cache, which is skipped by the manifest of the compressed files.
+static NSString *const kSDDecodedBitmapDirectoryName = @".bitmaps";
+static NSString *const kSDDecodedBitmapPathExtension = @"bitmap";
+static const uint32_t kSDDecodedBitmapMagic = 0x4D424453; // "SDBM"
+static const uint32_t kSDDecodedBitmapVersion = 2;
+static const size_t kSDDecodedBitmapMaxBytes = 4 * 1024 * 1024; // larger images are not stored, the tier is for the list thumbnails
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerRow;
+    uint32_t bitmapInfo;
+    uint32_t dataOffset; // offset of the pixels, a multiple of the page size
+    uint32_t orientation;
+    float scale;
+    uint64_t dataToken; // the token of the compressed file in manifest
+} SDDecodedBitmapHeader;
+
+// The bitmap of a compressed file, with or without extension
+static inline NSString *SDDecodedBitmapFileName(NSString *fileName) {
+    return [fileName.stringByDeletingPathExtension stringByAppendingPathExtension:kSDDecodedBitmapPathExtension];
+}
+
+#if SD_UIKIT || SD_WATCH
+// Draw the pixels of image into a new mapped file at path and fill the header, which is not written yet
+static BOOL SDDecodedBitmapDrawFile(UIImage *image, NSString *path, SDDecodedBitmapHeader *header) {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        return NO;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    if (width == 0 || height == 0) {
+        return NO;
+    }
+    size_t bytesPerRow = (width * 4 + 63) & ~(size_t)63;
+    size_t length = bytesPerRow * height;
+    if (length > kSDDecodedBitmapMaxBytes) {
+        return NO;
+    }
+    size_t dataOffset = (size_t)getpagesize();
+    size_t fileSize = dataOffset + length;
+    
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NO;
+    }
+    if (ftruncate(fd, (off_t)fileSize) != 0) {
+        close(fd);
+        return NO;
+    }
+    void *bytes = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) {
+        return NO;
+    }
+    
+    BOOL hasAlpha = SDCGImageRefContainsAlpha(imageRef);
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | (hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst);
+    CGContextRef context = CGBitmapContextCreate((uint8_t *)bytes + dataOffset, width, height, 8, bytesPerRow, SDCGColorSpaceGetDeviceRGB(), bitmapInfo);
+    BOOL success = NO;
+    if (context) {
+        CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+        CGContextRelease(context);
+        *header = (SDDecodedBitmapHeader){
+            .magic = kSDDecodedBitmapMagic,
+            .version = kSDDecodedBitmapVersion,
+            .width = (uint32_t)width,
+            .height = (uint32_t)height,
+            .bytesPerRow = (uint32_t)bytesPerRow,
+            .bitmapInfo = bitmapInfo,
+            .dataOffset = (uint32_t)dataOffset,
+            .orientation = (uint32_t)image.imageOrientation,
+            .scale = (float)image.scale,
+        };
+        success = YES;
+    }
+    munmap(bytes, fileSize);
+    return success;
+}
+
+// Write the header of a drawn file, a file with partial pixels or without the token is never valid
+static BOOL SDDecodedBitmapWriteHeader(NSString *path, const SDDecodedBitmapHeader *header) {
+    int fd = open(path.fileSystemRepresentation, O_WRONLY);
+    if (fd < 0) {
+        return NO;
+    }
+    BOOL success = pwrite(fd, header, sizeof(*header), 0) == (ssize_t)sizeof(*header);
+    close(fd);
+    return success;
+}
+
+// The token in the header of a bitmap file, 0 if it is not a valid bitmap file
+static uint64_t SDDecodedBitmapFileDataToken(NSString *path) {
+    SDDecodedBitmapHeader header;
+    int fd = open(path.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = pread(fd, &header, sizeof(header), 0);
+    close(fd);
+    if (length != (ssize_t)sizeof(header) || header.magic != kSDDecodedBitmapMagic || header.version != kSDDecodedBitmapVersion) {
+        return 0;
+    }
+    return header.dataToken;
+}
+
+static void SDDecodedBitmapReleaseData(void *info, const void *data, size_t size) {
+    if (info) {
+        CFRelease(info);
+    }
+}
+
+// The image keeps the (mapped) data until the `CGImage` is released.
+// Return nil if the bitmap is not decoded from the compressed file with the token.
+static UIImage *SDDecodedBitmapImageFromData(NSData *data, uint64_t dataToken) {
+    SDDecodedBitmapHeader header;
+    if (data.length < sizeof(header)) {
+        return nil;
+    }
+    memcpy(&header, data.bytes, sizeof(header));
+    if (header.magic != kSDDecodedBitmapMagic || header.version != kSDDecodedBitmapVersion || header.dataToken == 0 || header.dataToken != dataToken) {
+        return nil;
+    }
+    if (header.width == 0 || header.height == 0 || header.bytesPerRow < (uint64_t)header.width * 4 || header.scale <= 0 || header.orientation > UIImageOrientationRightMirrored) {
+        return nil;
+    }
+    size_t length = (size_t)header.bytesPerRow * header.height;
+    if (header.dataOffset < sizeof(header) || header.dataOffset > data.length || data.length - header.dataOffset < length) {
+        return nil;
+    }
+    
+    CFTypeRef info = CFBridgingRetain(data);
+    CGDataProviderRef provider = CGDataProviderCreateWithData((void *)info, (const uint8_t *)data.bytes + header.dataOffset, length, SDDecodedBitmapReleaseData);
+    if (!provider) {
+        CFRelease(info);
+        return nil;
+    }
+    CGImageRef imageRef = CGImageCreate(header.width, header.height, 8, 32, header.bytesPerRow, SDCGColorSpaceGetDeviceRGB(), header.bitmapInfo, provider, NULL, NO, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    if (!imageRef) {
+        return nil;
+    }
+    UIImage *image = [[UIImage alloc] initWithCGImage:imageRef scale:header.scale orientation:(UIImageOrientation)header.orientation];
+    CGImageRelease(imageRef);
+    return image;
+}
+#endif
+
 @interface SDImageCache ()
 
 #pragma mark - Properties
 @property (strong, nonatomic, nonnull) SDMemoryCache *memCache;
 @property (strong, nonatomic, nonnull) NSString *diskCachePath;
-@property (strong, nonatomic, nullable) NSMutableArray<NSString *> *customPaths;
-@property (strong, nonatomic, nullable) dispatch_queue_t ioQueue;
+@property (strong, nonatomic, nonnull) SDDiskCacheReadOnlyIndex *readOnlyIndex;
+@property (strong, nonatomic, nullable) dispatch_queue_t ioQueue; // concurrent, the disk reads run concurrently and the writes are barriers
 @property (strong, nonatomic, nonnull) NSFileManager *fileManager;
+@property (strong, nonatomic, nonnull) SDDiskCacheManifest *manifest;
+@property (strong, nonatomic, nonnull) NSString *bitmapCachePath;
+@property (strong, nonatomic, nonnull) SDDiskCacheManifest *bitmapManifest; // loaded when the decoded bitmaps are used the first time
 
 @end
 
@@ -157,8 +1061,11 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     if ((self = [super init])) {
         NSString *fullNamespace = [@"com.hackemist.SDWebImageCache." stringByAppendingString:ns];
         
-        // Create IO serial queue
-        _ioQueue = dispatch_queue_create("com.hackemist.SDWebImageCache", DISPATCH_QUEUE_SERIAL);
+        // wwt IO队列是并行队列，读操作并行执行，写操作使用barrier
+        // Create IO concurrent queue. The disk queries run concurrently, and the writes use barrier so they are still in order with the reads
+        _ioQueue = dispatch_queue_create("com.hackemist.SDWebImageCache", DISPATCH_QUEUE_CONCURRENT);
+        
+        _readOnlyIndex = [SDDiskCacheReadOnlyIndex new];
         
         _config = [[SDImageCacheConfig alloc] init];
         
@@ -174,10 +1081,20 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
             _diskCachePath = path;
         }
 
-        dispatch_sync(_ioQueue, ^{
+        dispatch_barrier_sync(_ioQueue, ^{
             _fileManager = [NSFileManager new];
         });
 
+        // Load the disk cache manifest in background
+        SDDiskCacheManifest *manifest = [[SDDiskCacheManifest alloc] initWithDirectory:_diskCachePath];
+        _manifest = manifest;
+        dispatch_barrier_async(_ioQueue, ^{
+            [manifest load];
+        });
+        
+        _bitmapCachePath = [_diskCachePath stringByAppendingPathComponent:kSDDecodedBitmapDirectoryName];
+        _bitmapManifest = [[SDDiskCacheManifest alloc] initWithDirectory:_bitmapCachePath];
+
 #if SD_UIKIT
         // Subscribe to app events
         [[NSNotificationCenter defaultCenter] addObserver:self
@@ -202,13 +1119,7 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 #pragma mark - Cache paths
 // wwt 添加只读缓存的路径
 - (void)addReadOnlyCachePath:(nonnull NSString *)path {
-    if (!self.customPaths) {
-        self.customPaths = [NSMutableArray new];
-    }
-
-    if (![self.customPaths containsObject:path]) {
-        [self.customPaths addObject:path];
-    }
+    [self.readOnlyIndex addPath:path];
 }
 
 // wwt 根据关键字生成缓存图片地址
@@ -278,7 +1189,7 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     }
     
     if (toDisk) {
-        dispatch_async(self.ioQueue, ^{
+        dispatch_barrier_async(self.ioQueue, ^{
             @autoreleasepool {
                 NSData *data = imageData;
                 if (!data && image) {
@@ -293,12 +1204,14 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
                 }
                 [self _storeImageDataToDisk:data forKey:key];
             }
-            
-            if (completionBlock) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    completionBlock();
-                });
-            }
+            // the bitmap is drawn out of this barrier, the completion is called once it is written
+            [self _storeDecodedBitmapImage:image forKey:key dataToken:[self _compressedFileTokenForKey:key] completion:^{
+                if (completionBlock) {
+                    dispatch_async(dispatch_get_main_queue(), ^{
+                        completionBlock();
+                    });
+                }
+            }];
         });
     } else {
         if (completionBlock) {
@@ -311,7 +1224,7 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     if (!imageData || !key) {
         return;
     }
-    dispatch_sync(self.ioQueue, ^{
+    dispatch_barrier_sync(self.ioQueue, ^{
         [self _storeImageDataToDisk:imageData forKey:key];
     });
 }
@@ -332,7 +1245,11 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     // transform to NSUrl
     NSURL *fileURL = [NSURL fileURLWithPath:cachePathForKey];
     
-    [imageData writeToURL:fileURL options:self.config.diskCacheWritingOptions error:nil];
+    if ([imageData writeToURL:fileURL options:self.config.diskCacheWritingOptions error:nil]) {
+        [self.manifest setFileName:fileURL.lastPathComponent size:imageData.length];
+    }
+    // the decoded bitmap of the old data is stale
+    [self _removeDecodedBitmapForFileName:fileURL.lastPathComponent];
     
     // disable iCloud backup
     if (self.config.shouldDisableiCloud) {
@@ -370,15 +1287,9 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     if (!key) {
         return NO;
     }
-    BOOL exists = [self.fileManager fileExistsAtPath:[self defaultCachePathForKey:key]];
-    
     // fallback because of https://github.com/rs/SDWebImage/pull/976 that added the extension to the disk file name
-    // checking the key with and without the extension
-    if (!exists) {
-        exists = [self.fileManager fileExistsAtPath:[self defaultCachePathForKey:key].stringByDeletingPathExtension];
-    }
-    
-    return exists;
+    // checking the key with and without the extension, the manifest knows the files in default path without stat
+    return [self _hasCompressedFileForFileName:[self cachedFileNameForKey:key]];
 }
 
 // wwt 内存中是否已经缓存了
@@ -408,36 +1319,42 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     return image;
 }
 
-// wwt 根据key从硬盘获取图像数据，如果没有从预加载的路径获取图片数据
+// wwt 根据key从硬盘获取图像数据，如果没有从预加载的路径获取图片数据。通过清单和只读路径的索引查找文件，不逐个路径试探
 - (nullable NSData *)diskImageDataBySearchingAllPathsForKey:(nullable NSString *)key {
-    NSString *defaultPath = [self defaultCachePathForKey:key];
-    NSData *data = [NSData dataWithContentsOfFile:defaultPath options:self.config.diskCacheReadingOptions error:nil];
-    if (data) {
-        return data;
-    }
-
     // fallback because of https://github.com/rs/SDWebImage/pull/976 that added the extension to the disk file name
     // checking the key with and without the extension
-    data = [NSData dataWithContentsOfFile:defaultPath.stringByDeletingPathExtension options:self.config.diskCacheReadingOptions error:nil];
-    if (data) {
-        return data;
-    }
-
-    NSArray<NSString *> *customPaths = [self.customPaths copy];
-    for (NSString *path in customPaths) {
-        NSString *filePath = [self cachePathForKey:key inPath:path];
-        NSData *imageData = [NSData dataWithContentsOfFile:filePath options:self.config.diskCacheReadingOptions error:nil];
-        if (imageData) {
-            return imageData;
+    NSString *fileName = [self cachedFileNameForKey:key];
+    NSString *fileNameWithoutExtension = fileName.stringByDeletingPathExtension;
+    NSArray<NSString *> *fileNames = [fileName isEqualToString:fileNameWithoutExtension] ? @[fileName] : @[fileName, fileNameWithoutExtension];
+    
+    // The manifest knows the files in default path, only read the file which exists, a miss costs no stat
+    for (NSString *name in fileNames) {
+        if (![self.manifest containsFileName:name]) {
+            continue;
         }
-
-        // fallback because of https://github.com/rs/SDWebImage/pull/976 that added the extension to the disk file name
-        // checking the key with and without the extension
-        imageData = [NSData dataWithContentsOfFile:filePath.stringByDeletingPathExtension options:self.config.diskCacheReadingOptions error:nil];
-        if (imageData) {
-            return imageData;
+        NSData *data = [NSData dataWithContentsOfFile:[self.diskCachePath stringByAppendingPathComponent:name] options:self.config.diskCacheReadingOptions error:nil];
+        if (data) {
+            [self.manifest accessFileName:name];
+            return data;
+        }
+        // the file is removed by others, such as the system purging the caches directory
+        [self.manifest removeFileName:name];
+    }
+    
+    // The read-only paths are searched in order, and the file with extension first in the same path
+    NSString *matchedFileName = nil;
+    NSUInteger matchedPathIndex = NSNotFound;
+    for (NSString *name in fileNames) {
+        NSUInteger pathIndex = [self.readOnlyIndex pathIndexForFileName:name];
+        if (pathIndex < matchedPathIndex) {
+            matchedPathIndex = pathIndex;
+            matchedFileName = name;
         }
     }
+    if (matchedFileName) {
+        NSString *filePath = [self.readOnlyIndex filePathForFileName:matchedFileName];
+        return [NSData dataWithContentsOfFile:filePath options:self.config.diskCacheReadingOptions error:nil];
+    }
 
     return nil;
 }
@@ -497,13 +1414,24 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
         }
         
         @autoreleasepool {
-            NSData *diskData = [self diskImageDataBySearchingAllPathsForKey:key];
+            // wwt 内存缓存没有命中时先使用解码位图，调用者需要数据时才读取压缩数据
+            UIImage *bitmapImage = image ? nil : [self _decodedBitmapImageForKey:key];
+            // the token is read before the data, a bitmap drawn from data replaced since then is dropped
+            uint64_t dataToken = (image || bitmapImage || !self.config.shouldCacheDecodedBitmaps) ? 0 : [self _compressedFileTokenForKey:key];
+            NSData *diskData = (bitmapImage && !(options & SDImageCacheQueryDataWhenInMemory)) ? nil : [self diskImageDataBySearchingAllPathsForKey:key];
             UIImage *diskImage;
             SDImageCacheType cacheType = SDImageCacheTypeDisk;
             if (image) {
                 // the image is from in-memory cache
                 diskImage = image;
                 cacheType = SDImageCacheTypeMemory;
+            } else if (bitmapImage) {
+                // the decoded bitmap is mapped, no decoding
+                diskImage = bitmapImage;
+                if (self.config.shouldCacheImagesInMemory) {
+                    NSUInteger cost = SDCacheCostForImage(diskImage);
+                    [self.memCache setObject:diskImage forKey:key cost:cost];
+                }
             } else if (diskData) {
                 // decode image data only if in-memory cache missed
                 diskImage = [self diskImageForKey:key data:diskData];
@@ -511,6 +1439,10 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
                     NSUInteger cost = SDCacheCostForImage(diskImage);
                     [self.memCache setObject:diskImage forKey:key cost:cost];
                 }
+                if (diskImage && dataToken != 0) {
+                    // the next cold query maps the bitmap instead of decoding
+                    [self _storeDecodedBitmapImage:diskImage forKey:key dataToken:dataToken completion:nil];
+                }
             }
             
             if (doneBlock) {
@@ -534,6 +1466,182 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     return operation;
 }
 
+#pragma mark - Decoded Bitmap Ops
+
+// Make sure to call form io queue by caller
+// wwt 压缩数据是否在默认路径，带扩展名和不带扩展名的文件都检查
+- (BOOL)_hasCompressedFileForFileName:(nonnull NSString *)fileName {
+    return [self.manifest containsFileName:fileName] || [self.manifest containsFileName:fileName.stringByDeletingPathExtension];
+}
+
+// Make sure to call form io queue by caller
+// wwt 默认路径中压缩数据的token，没有时返回0
+- (uint64_t)_compressedFileTokenForKey:(nonnull NSString *)key {
+    NSString *fileName = [self cachedFileNameForKey:key];
+    return [self.manifest tokenForFileName:fileName] ?: [self.manifest tokenForFileName:fileName.stringByDeletingPathExtension];
+}
+
+// Make sure to call form io queue by caller
+// wwt 映射解码位图文件生成图片，不需要解码。只使用从当前压缩数据解码的位图
+- (nullable UIImage *)_decodedBitmapImageForKey:(nonnull NSString *)key {
+#if SD_UIKIT || SD_WATCH
+    if (!self.config.shouldCacheDecodedBitmaps) {
+        return nil;
+    }
+    NSString *fileName = [self cachedFileNameForKey:key];
+    NSString *bitmapFileName = SDDecodedBitmapFileName(fileName);
+    if (![self.bitmapManifest containsFileName:bitmapFileName]) {
+        return nil;
+    }
+    uint64_t dataToken = [self _compressedFileTokenForKey:key];
+    if (dataToken == 0) {
+        return nil;
+    }
+    NSString *bitmapPath = [self.bitmapCachePath stringByAppendingPathComponent:bitmapFileName];
+    NSData *data = [NSData dataWithContentsOfFile:bitmapPath options:NSDataReadingMappedAlways error:nil];
+    UIImage *image = SDDecodedBitmapImageFromData(data, dataToken);
+    if (image) {
+        [self.bitmapManifest accessFileName:bitmapFileName];
+    } else {
+        // the file is removed by others, it is not a valid bitmap, or it is decoded from replaced data.
+        // The queries run concurrently, so it is removed in a barrier
+        dispatch_barrier_async(self.ioQueue, ^{
+            [self _removeStaleDecodedBitmapForKey:key];
+        });
+    }
+    return image;
+#else
+    return nil;
+#endif
+}
+
+// Make sure to call form io queue by caller, with barrier
+// wwt 删除无效的解码位图，查询之后可能已经写入了新的位图，删除前再检查一次
+- (void)_removeStaleDecodedBitmapForKey:(nonnull NSString *)key {
+#if SD_UIKIT || SD_WATCH
+    NSString *bitmapFileName = SDDecodedBitmapFileName([self cachedFileNameForKey:key]);
+    if (![self.bitmapManifest containsFileName:bitmapFileName]) {
+        return;
+    }
+    NSString *bitmapPath = [self.bitmapCachePath stringByAppendingPathComponent:bitmapFileName];
+    uint64_t dataToken = [self _compressedFileTokenForKey:key];
+    if (dataToken != 0 && SDDecodedBitmapFileDataToken(bitmapPath) == dataToken) {
+        // a valid bitmap is stored since the query
+        return;
+    }
+    [self.fileManager removeItemAtPath:bitmapPath error:nil];
+    [self.bitmapManifest removeFileName:bitmapFileName];
+#endif
+}
+
+// Can be called from any queue
+// wwt 写入解码位图：在并发的io队列中绘制到隐藏的临时文件，绘制不阻塞其他读写；然后在barrier中确认压缩数据没有被替换，写入文件头并重命名，已经被映射的旧文件不受影响
+// The bitmap is drawn into a hidden temporary file on the concurrent io queue, so drawing does not block the other reads and writes.
+// Then in a barrier, if the compressed file still has `dataToken` (the token read no later than its data), the header is written with the token and the file is renamed.
+// The completion is called after that, or immediately if the bitmap is not stored.
+- (void)_storeDecodedBitmapImage:(nullable UIImage *)image forKey:(nonnull NSString *)key dataToken:(uint64_t)dataToken completion:(nullable dispatch_block_t)completion {
+#if SD_UIKIT || SD_WATCH
+    BOOL shouldStore = self.config.shouldCacheDecodedBitmaps && dataToken != 0 && image.CGImage != NULL;
+#if SD_UIKIT
+    // check before `images`, which builds the repeated frames of an animated image
+    if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        shouldStore = NO;
+    }
+#endif
+    if (!shouldStore || image.images.count > 0) {
+        if (completion) {
+            completion();
+        }
+        return;
+    }
+    dispatch_async(self.ioQueue, ^{
+        BOOL drawn = NO;
+        SDDecodedBitmapHeader header = {0};
+        // the temporary file is hidden, so it is skipped when the manifest is rebuilt
+        NSString *tempPath = [self.bitmapCachePath stringByAppendingPathComponent:[@"." stringByAppendingString:[NSUUID UUID].UUIDString]];
+        @autoreleasepool {
+            if (![self.fileManager fileExistsAtPath:self.bitmapCachePath]) {
+                [self.fileManager createDirectoryAtPath:self.bitmapCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+            }
+            drawn = SDDecodedBitmapDrawFile(image, tempPath, &header);
+        }
+        dispatch_barrier_async(self.ioQueue, ^{
+            if (drawn) {
+                SDDecodedBitmapHeader tokenHeader = header;
+                tokenHeader.dataToken = dataToken;
+                [self _commitDecodedBitmapAtPath:tempPath header:tokenHeader forKey:key];
+            } else {
+                unlink(tempPath.fileSystemRepresentation);
+            }
+            if (completion) {
+                completion();
+            }
+        });
+    });
+#else
+    if (completion) {
+        completion();
+    }
+#endif
+}
+
+#if SD_UIKIT || SD_WATCH
+// Make sure to call form io queue by caller, with barrier
+// wwt 压缩数据没有被替换时，写入文件头并重命名为位图文件
+- (void)_commitDecodedBitmapAtPath:(nonnull NSString *)tempPath header:(SDDecodedBitmapHeader)header forKey:(nonnull NSString *)key {
+    NSString *bitmapFileName = SDDecodedBitmapFileName([self cachedFileNameForKey:key]);
+    NSString *bitmapPath = [self.bitmapCachePath stringByAppendingPathComponent:bitmapFileName];
+    struct stat st;
+    if ([self _compressedFileTokenForKey:key] != header.dataToken
+        || !SDDecodedBitmapWriteHeader(tempPath, &header)
+        || rename(tempPath.fileSystemRepresentation, bitmapPath.fileSystemRepresentation) != 0
+        || stat(bitmapPath.fileSystemRepresentation, &st) != 0) {
+        unlink(tempPath.fileSystemRepresentation);
+        return;
+    }
+    [self.bitmapManifest setFileName:bitmapFileName size:(NSUInteger)st.st_size];
+    
+    // disable iCloud backup
+    if (self.config.shouldDisableiCloud) {
+        [[NSURL fileURLWithPath:bitmapPath] setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
+    }
+    
+    [self _trimDecodedBitmapsIfNeeded];
+}
+#endif
+
+// Make sure to call form io queue by caller, with barrier
+- (void)_removeDecodedBitmapForFileName:(nonnull NSString *)fileName {
+    NSString *bitmapFileName = SDDecodedBitmapFileName(fileName);
+    if ([self.bitmapManifest containsFileName:bitmapFileName]) {
+        [self.fileManager removeItemAtPath:[self.bitmapCachePath stringByAppendingPathComponent:bitmapFileName] error:nil];
+        [self.bitmapManifest removeFileName:bitmapFileName];
+    }
+}
+
+// Make sure to call form io queue by caller, with barrier
+// wwt 解码位图超过最大大小时，按访问时间删除最久没有使用的位图，直到一半大小
+- (void)_trimDecodedBitmapsIfNeeded {
+    NSUInteger maxBitmapCacheSize = self.config.maxBitmapCacheSize;
+    if (maxBitmapCacheSize == 0 || self.bitmapManifest.totalSize <= maxBitmapCacheSize) {
+        return;
+    }
+    NSMutableArray<SDDiskCacheManifestEntry *> *entries = [[self.bitmapManifest allEntries] mutableCopy];
+    [entries sortUsingComparator:^NSComparisonResult(SDDiskCacheManifestEntry *entry1, SDDiskCacheManifestEntry *entry2) {
+        return entry1.accessTime < entry2.accessTime ? NSOrderedAscending : (entry1.accessTime > entry2.accessTime ? NSOrderedDescending : NSOrderedSame);
+    }];
+    const NSUInteger desiredSize = maxBitmapCacheSize / 2;
+    NSUInteger currentSize = self.bitmapManifest.totalSize;
+    for (SDDiskCacheManifestEntry *entry in entries) {
+        [self.fileManager removeItemAtPath:[self.bitmapCachePath stringByAppendingPathComponent:entry.fileName] error:nil];
+        [self.bitmapManifest removeFileName:entry.fileName];
+        currentSize -= entry.size;
+        if (currentSize < desiredSize) {
+            break;
+        }
+    }
+}
+
 #pragma mark - Remove Ops
 
 - (void)removeImageForKey:(nullable NSString *)key withCompletion:(nullable SDWebImageNoParamsBlock)completion {
@@ -550,8 +1658,11 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     }
 
     if (fromDisk) {
-        dispatch_async(self.ioQueue, ^{
-            [self.fileManager removeItemAtPath:[self defaultCachePathForKey:key] error:nil];
+        dispatch_barrier_async(self.ioQueue, ^{
+            NSString *path = [self defaultCachePathForKey:key];
+            [self.fileManager removeItemAtPath:path error:nil];
+            [self.manifest removeFileName:path.lastPathComponent];
+            [self _removeDecodedBitmapForFileName:path.lastPathComponent];
             
             if (completion) {
                 dispatch_async(dispatch_get_main_queue(), ^{
@@ -583,6 +1694,14 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     self.memCache.countLimit = maxCountLimit;
 }
 
+- (NSUInteger)maxMemoryWeakCountLimit {
+    return self.memCache.weakCountLimit;
+}
+
+- (void)setMaxMemoryWeakCountLimit:(NSUInteger)maxMemoryWeakCountLimit {
+    self.memCache.weakCountLimit = maxMemoryWeakCountLimit;
+}
+
 #pragma mark - Cache clean Ops
 // wwt 清除内存缓存
 - (void)clearMemory {
@@ -591,12 +1710,14 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 
 // wwt 清除硬盘缓存
 - (void)clearDiskOnCompletion:(nullable SDWebImageNoParamsBlock)completion {
-    dispatch_async(self.ioQueue, ^{
+    dispatch_barrier_async(self.ioQueue, ^{
         [self.fileManager removeItemAtPath:self.diskCachePath error:nil];
         [self.fileManager createDirectoryAtPath:self.diskCachePath
                 withIntermediateDirectories:YES
                                  attributes:nil
                                       error:NULL];
+        [self.manifest removeAllEntries];
+        [self.bitmapManifest removeAllEntries];
 
         if (completion) {
             dispatch_async(dispatch_get_main_queue(), ^{
@@ -612,49 +1733,26 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 
 // wwt 在程序将要结束的时候删除过期的硬盘缓存和当缓存的图片多于最大缓存大小的时候按照时间顺序删除硬盘缓存到指定大小
 - (void)deleteOldFilesWithCompletionBlock:(nullable SDWebImageNoParamsBlock)completionBlock {
-    dispatch_async(self.ioQueue, ^{
-        NSURL *diskCacheURL = [NSURL fileURLWithPath:self.diskCachePath isDirectory:YES];
-        NSArray<NSString *> *resourceKeys = @[NSURLIsDirectoryKey, NSURLContentModificationDateKey, NSURLTotalFileAllocatedSizeKey];
-
-        // This enumerator prefetches useful properties for our cache files.
-        NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtURL:diskCacheURL
-                                                   includingPropertiesForKeys:resourceKeys
-                                                                      options:NSDirectoryEnumerationSkipsHiddenFiles
-                                                                 errorHandler:NULL];
-
-        NSDate *expirationDate = [NSDate dateWithTimeIntervalSinceNow:-self.config.maxCacheAge];
-        NSMutableDictionary<NSURL *, NSDictionary<NSString *, id> *> *cacheFiles = [NSMutableDictionary dictionary];
+    dispatch_barrier_async(self.ioQueue, ^{
+        // The manifest keeps the size and dates of each file, so the cache directory is not enumerated.
+        NSArray<SDDiskCacheManifestEntry *> *entries = [self.manifest allEntries];
+        BOOL useAccessDate = (self.config.diskCacheExpireType == SDImageCacheConfigExpireTypeAccessDate);
+        NSTimeInterval expirationTime = [NSDate date].timeIntervalSince1970 - self.config.maxCacheAge;
+        NSMutableArray<SDDiskCacheManifestEntry *> *cacheEntries = [NSMutableArray arrayWithCapacity:entries.count];
         NSUInteger currentCacheSize = 0;
 
-        // Enumerate all of the files in the cache directory.  This loop has two purposes:
+        // Enumerate all of the entries in the manifest.  This loop has two purposes:
         //
         //  1. Removing files that are older than the expiration date.
-        //  2. Storing file attributes for the size-based cleanup pass.
-        NSMutableArray<NSURL *> *urlsToDelete = [[NSMutableArray alloc] init];
-        for (NSURL *fileURL in fileEnumerator) {
-            NSError *error;
-            NSDictionary<NSString *, id> *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:&error];
-
-            // Skip directories and errors.
-            if (error || !resourceValues || [resourceValues[NSURLIsDirectoryKey] boolValue]) {
-                continue;
-            }
-
-            // Remove files that are older than the expiration date;
-            NSDate *modificationDate = resourceValues[NSURLContentModificationDateKey];
-            if ([[modificationDate laterDate:expirationDate] isEqualToDate:expirationDate]) {
-                [urlsToDelete addObject:fileURL];
+        //  2. Storing entries for the size-based cleanup pass.
+        for (SDDiskCacheManifestEntry *entry in entries) {
+            NSTimeInterval time = useAccessDate ? entry.accessTime : entry.modificationTime;
+            if (time <= expirationTime) {
+                [self _removeFileWithManifestEntry:entry];
                 continue;
             }
-
-            // Store a reference to this file and account for its total size.
-            NSNumber *totalAllocatedSize = resourceValues[NSURLTotalFileAllocatedSizeKey];
-            currentCacheSize += totalAllocatedSize.unsignedIntegerValue;
-            cacheFiles[fileURL] = resourceValues;
-        }
-        
-        for (NSURL *fileURL in urlsToDelete) {
-            [self.fileManager removeItemAtURL:fileURL error:nil];
+            currentCacheSize += entry.size;
+            [cacheEntries addObject:entry];
         }
 
         // If our remaining disk cache exceeds a configured maximum size, perform a second
@@ -663,25 +1761,25 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
             // Target half of our maximum cache size for this cleanup pass.
             const NSUInteger desiredCacheSize = self.config.maxCacheSize / 2;
 
-            // Sort the remaining cache files by their last modification time (oldest first).
-            NSArray<NSURL *> *sortedFiles = [cacheFiles keysSortedByValueWithOptions:NSSortConcurrent
-                                                                     usingComparator:^NSComparisonResult(id obj1, id obj2) {
-                                                                         return [obj1[NSURLContentModificationDateKey] compare:obj2[NSURLContentModificationDateKey]];
-                                                                     }];
+            // Sort the remaining cache files by their date (oldest first).
+            [cacheEntries sortWithOptions:NSSortConcurrent usingComparator:^NSComparisonResult(SDDiskCacheManifestEntry *entry1, SDDiskCacheManifestEntry *entry2) {
+                NSTimeInterval time1 = useAccessDate ? entry1.accessTime : entry1.modificationTime;
+                NSTimeInterval time2 = useAccessDate ? entry2.accessTime : entry2.modificationTime;
+                return time1 < time2 ? NSOrderedAscending : (time1 > time2 ? NSOrderedDescending : NSOrderedSame);
+            }];
 
             // Delete files until we fall below our desired cache size.
-            for (NSURL *fileURL in sortedFiles) {
-                if ([self.fileManager removeItemAtURL:fileURL error:nil]) {
-                    NSDictionary<NSString *, id> *resourceValues = cacheFiles[fileURL];
-                    NSNumber *totalAllocatedSize = resourceValues[NSURLTotalFileAllocatedSizeKey];
-                    currentCacheSize -= totalAllocatedSize.unsignedIntegerValue;
-
-                    if (currentCacheSize < desiredCacheSize) {
-                        break;
-                    }
+            for (SDDiskCacheManifestEntry *entry in cacheEntries) {
+                [self _removeFileWithManifestEntry:entry];
+                currentCacheSize -= entry.size;
+                if (currentCacheSize < desiredCacheSize) {
+                    break;
                 }
             }
         }
+        [self.manifest flush];
+        [self _trimDecodedBitmapsIfNeeded];
+        [self.bitmapManifest flush];
         if (completionBlock) {
             dispatch_async(dispatch_get_main_queue(), ^{
                 completionBlock();
@@ -690,6 +1788,15 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
     });
 }
 
+// Make sure to call form io queue by caller
+// A file missing in the directory (removed by others) is also removed from the manifest
+- (void)_removeFileWithManifestEntry:(nonnull SDDiskCacheManifestEntry *)entry {
+    NSString *filePath = [self.diskCachePath stringByAppendingPathComponent:entry.fileName];
+    [self.fileManager removeItemAtPath:filePath error:nil];
+    [self.manifest removeFileName:entry.fileName];
+    [self _removeDecodedBitmapForFileName:entry.fileName];
+}
+
 // wwt 程序进入后台的时候删除过期图片
 #if SD_UIKIT
 - (void)backgroundDeleteOldFiles {
@@ -714,16 +1821,21 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 #endif
 
 #pragma mark - Cache Info
-// wwt 获取已经在硬盘缓存的图像大小
+// wwt 返回内存缓存的字节数
+- (NSUInteger)getMemoryCost {
+    return self.memCache.totalCost;
+}
+
+// wwt 返回内存缓存的图片数目
+- (NSUInteger)getMemoryCount {
+    return self.memCache.totalCount;
+}
+
+// wwt 获取已经在硬盘缓存的图像大小（从清单读取，不遍历目录）
 - (NSUInteger)getSize {
     __block NSUInteger size = 0;
     dispatch_sync(self.ioQueue, ^{
-        NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtPath:self.diskCachePath];
-        for (NSString *fileName in fileEnumerator) {
-            NSString *filePath = [self.diskCachePath stringByAppendingPathComponent:fileName];
-            NSDictionary<NSString *, id> *attrs = [self.fileManager attributesOfItemAtPath:filePath error:nil];
-            size += [attrs fileSize];
-        }
+        size = self.manifest.totalSize;
     });
     return size;
 }
@@ -731,30 +1843,15 @@ FOUNDATION_STATIC_INLINE NSUInteger SDCacheCostForImage(UIImage *image) {
 - (NSUInteger)getDiskCount {
     __block NSUInteger count = 0;
     dispatch_sync(self.ioQueue, ^{
-        NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtPath:self.diskCachePath];
-        count = fileEnumerator.allObjects.count;
+        count = self.manifest.count;
     });
     return count;
 }
 // wwt 计算硬盘缓存图像数据的大小和数目
 - (void)calculateSizeWithCompletionBlock:(nullable SDWebImageCalculateSizeBlock)completionBlock {
-    NSURL *diskCacheURL = [NSURL fileURLWithPath:self.diskCachePath isDirectory:YES];
-
     dispatch_async(self.ioQueue, ^{
-        NSUInteger fileCount = 0;
-        NSUInteger totalSize = 0;
-
-        NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtURL:diskCacheURL
-                                                   includingPropertiesForKeys:@[NSFileSize]
-                                                                      options:NSDirectoryEnumerationSkipsHiddenFiles
-                                                                 errorHandler:NULL];
-
-        for (NSURL *fileURL in fileEnumerator) {
-            NSNumber *fileSize;
-            [fileURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL];
-            totalSize += fileSize.unsignedIntegerValue;
-            fileCount += 1;
-        }
+        NSUInteger fileCount = self.manifest.count;
+        NSUInteger totalSize = self.manifest.totalSize;
 
         if (completionBlock) {
             dispatch_async(dispatch_get_main_queue(), ^{
@@ -9,6 +9,20 @@
 #import <Foundation/Foundation.h>
 #import "SDWebImageCompat.h"
 
+// wwt 硬盘缓存过期和按大小清理时使用的时间
+typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
+    /**
+     * wwt 最后访问时间，从硬盘读取图片时更新
+     * When the image is accessed it will update this value
+     */
+    SDImageCacheConfigExpireTypeAccessDate,
+    /**
+     * wwt 修改时间，写入硬盘时更新（默认）
+     * The image was stored to the disk cache (Default)
+     */
+    SDImageCacheConfigExpireTypeModificationDate
+};
+
 @interface SDImageCacheConfig : NSObject
 
 /**
@@ -56,4 +70,27 @@
  */
 @property (assign, nonatomic) NSUInteger maxCacheSize;
 
+/**
+ * wwt 清理硬盘缓存时使用的时间，默认是修改时间。过期的图片会被删除，超过最大大小时先删除最早的图片
+ * The attribute which the clear cache will be checked against when clearing the disk cache.
+ * Default is Modified Date. Expired images are removed, then the oldest images are removed first when the cache exceeds `maxCacheSize`.
+ */
+@property (assign, nonatomic) SDImageCacheConfigExpireType diskCacheExpireType;
+
+/**
+ * wwt 在硬盘额外缓存解码后的位图，冷启动时直接映射文件生成图片，不需要再解码，默认NO
+ * Store the decoded bitmaps of the disk cached images in page-aligned files, so a cold disk query maps the file and renders it without decoding.
+ * The bitmaps are much larger than the compressed data, and the animated images and the bitmaps larger than 4MB are not stored.
+ * When an image is served from the bitmaps, the query does not read the image data unless `SDImageCacheQueryDataWhenInMemory` is set.
+ * Defaults to NO.
+ */
+@property (assign, nonatomic) BOOL shouldCacheDecodedBitmaps;
+
+/**
+ * wwt 解码位图缓存的最大大小，以字节为单位，超过时先删除最久没有访问的位图，默认128MB，0表示不限制
+ * The maximum size of the decoded bitmaps, in bytes. The least recently accessed bitmaps are removed first when it is exceeded.
+ * Defaults to 128MB, 0 means no limit.
+ */
+@property (assign, nonatomic) NSUInteger maxBitmapCacheSize;
+
 @end
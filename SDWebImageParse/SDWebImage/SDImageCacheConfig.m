@@ -9,6 +9,7 @@
 #import "SDImageCacheConfig.h"
 
 static const NSInteger kDefaultCacheMaxCacheAge = 60 * 60 * 24 * 7; // 1 week
+static const NSUInteger kDefaultMaxBitmapCacheSize = 128 * 1024 * 1024; // 128MB
 
 @implementation SDImageCacheConfig
 
@@ -21,6 +22,9 @@ static const NSInteger kDefaultCacheMaxCacheAge = 60 * 60 * 24 * 7; // 1 week
         _diskCacheWritingOptions = NSDataWritingAtomic;
         _maxCacheAge = kDefaultCacheMaxCacheAge;
         _maxCacheSize = 0;
+        _diskCacheExpireType = SDImageCacheConfigExpireTypeModificationDate;
+        _shouldCacheDecodedBitmaps = NO;
+        _maxBitmapCacheSize = kDefaultMaxBitmapCacheSize;
     }
     return self;
 }
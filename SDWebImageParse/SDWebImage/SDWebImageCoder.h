@@ -17,6 +17,14 @@
  */
 FOUNDATION_EXPORT NSString * _Nonnull const SDWebImageCoderScaleDownLargeImagesKey;
 
+/**
+ wwt 缩小大图时的目标像素尺寸，图片会等比缩放到这个尺寸以内，不会放大，不设置时使用编码器默认的最大解码大小
+ 
+ The pixel size to fit large images into when scaling down during decompressing, used with `SDWebImageCoderScaleDownLargeImagesKey`. (NSValue of CGSize)
+ The aspect ratio is kept and images are never scaled up. If not provided, the coder uses its own maximum decoded size.
+ */
+FOUNDATION_EXPORT NSString * _Nonnull const SDWebImageCoderScaleDownTargetPixelSizeKey;
+
 /**
  wwt 返回一个CGColorSpaceCreateDeviceRGB创建的共享设备颜色空间
  
@@ -76,7 +84,7 @@ CG_EXTERN BOOL SDCGImageRefContainsAlpha(_Nullable CGImageRef imageRef);
 
  @param image The original image to be decompressed
  @param data The pointer to original image data. The pointer itself is nonnull but image data can be null. This data will set to cache if needed. If you do not need to modify data at the sametime, ignore this param.
- @param optionsDict A dictionary containing any decompressing options. Pass {SDWebImageCoderScaleDownLargeImagesKey: @(YES)} to scale down large images
+ @param optionsDict A dictionary containing any decompressing options. Pass {SDWebImageCoderScaleDownLargeImagesKey: @(YES)} to scale down large images, and `SDWebImageCoderScaleDownTargetPixelSizeKey` to choose the size
  @return The decompressed image
  */
 - (nullable UIImage *)decompressedImageWithImage:(nullable UIImage *)image
@@ -9,6 +9,7 @@
 #import "SDWebImageCoder.h"
 
 NSString * const SDWebImageCoderScaleDownLargeImagesKey = @"scaleDownLargeImages";
+NSString * const SDWebImageCoderScaleDownTargetPixelSizeKey = @"scaleDownTargetPixelSize";
 
 CGColorSpaceRef SDCGColorSpaceGetDeviceRGB(void) {
     static CGColorSpaceRef colorSpace;
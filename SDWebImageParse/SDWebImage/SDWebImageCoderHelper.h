@@ -10,14 +10,156 @@
 #import "SDWebImageCompat.h"
 #import "SDWebImageFrame.h"
 
+#if SD_UIKIT
+/**
+ wwt 按需解码动图帧的数据源，只持有压缩数据
+ A source which decodes the frames of an animated image on demand from the compressed data, such as a `CGImageSource` or a `WebPDemuxer`.
+ The methods may be called from any thread, the provider should keep itself thread-safe.
+ */
+@protocol SDWebImageAnimatedImageProvider <NSObject>
+
+@required
+/**
+ The compressed image data.
+ */
+@property (nonatomic, copy, readonly, nonnull) NSData *animatedImageData;
+
+/**
+ The frame count.
+ */
+@property (nonatomic, assign, readonly) NSUInteger animatedImageFrameCount;
+
+/**
+ The loop count, 0 means infinite looping.
+ */
+@property (nonatomic, assign, readonly) NSUInteger animatedImageLoopCount;
+
+/**
+ Return the duration of the frame at index, in seconds.
+ */
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index;
+
+/**
+ Return the decoded (bitmap) frame at index, the scale of returned image is ignored.
+ */
+- (nullable UIImage *)animatedImageFrameAtIndex:(NSUInteger)index;
+
+@end
+
+/**
+ wwt 可变帧时长的动图：保存帧数组和每帧的时长，不按照最大公约数重复帧。帧在播放时按需解码，由播放者的帧缓存保存有限数量的已解码帧
+ A variable-duration animated image: a frames array plus a duration table, frames are not repeated by the GCD of durations.
+ The frames are decoded on demand when played; the image keeps no decoded frames, each player keeps a bounded number of them in its own `SDWebImageAnimatedImageFrameBuffer` (the following frames are decoded in background).
+ The image itself (`CGImage`, `size`) is the first frame. It is played with its own frame durations by `-[UIImageView sd_setAnimatedImage:]`, which is used by `sd_setImageWithURL:` and never reads `images`.
+ For the other UIKit consumers (UIButton, highlighted image, MKAnnotationView, setting `UIImageView.image` directly), `images` and `duration` return the frames repeated by the GCD of durations, the array is built on first access and kept by the image, avoid it for large images.
+ The frames come from a frames array, or from a `SDWebImageAnimatedImageProvider` which keeps the compressed data only (used by the GIF and WebP coders).
+ */
+@interface SDWebImageAnimatedImage : UIImage
+
+/**
+ Create an animated image with frames array.
+
+ @param frames The frames array. If no frames or frames is empty, return nil
+ @return The animated image
+ */
+- (nullable instancetype)initWithFrames:(nonnull NSArray<SDWebImageFrame *> *)frames;
+
+/**
+ Create an animated image which decodes its frames from the provider on demand. The first frame is decoded immediately, and the loop count is set to `sd_imageLoopCount`.
+ wwt 使用压缩数据创建动图，只有第一帧立即解码
+
+ @param provider The frame provider. If it has no frames or the first frame can not be decoded, return nil
+ @param scale The image scale
+ @return The animated image
+ */
+- (nullable instancetype)initWithProvider:(nonnull id<SDWebImageAnimatedImageProvider>)provider scale:(CGFloat)scale;
+
+/**
+ The frame provider, nil if the image is created with frames array.
+ */
+@property (nonatomic, strong, readonly, nullable) id<SDWebImageAnimatedImageProvider> animatedImageProvider;
+
+/**
+ The compressed image data of provider, nil if the image is created with frames array.
+ */
+@property (nonatomic, copy, readonly, nullable) NSData *animatedImageData;
+
+/**
+ The frames (not decoded).
+ @note If the image is created with provider, all the frames are decoded every time when this is called, avoid it.
+ */
+@property (nonatomic, copy, readonly, nonnull) NSArray<SDWebImageFrame *> *animatedImageFrames;
+
+/**
+ The frame count.
+ */
+@property (nonatomic, assign, readonly) NSUInteger animatedImageFrameCount;
+
+/**
+ Return the duration of the frame at index, in seconds.
+ */
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index;
+
+/**
+ Decode and return the frame at index, the decoded frame is not kept by the image. This method is thread-safe.
+ wwt 解码一帧，图片本身不缓存已解码的帧（图片可能被内存缓存和多个视图共享），播放时使用SDWebImageAnimatedImageFrameBuffer
+ 
+ @param index The frame index (zero-based)
+ @return The decoded frame
+ */
+- (nullable UIImage *)decodedFrameAtIndex:(NSUInteger)index;
+
+@end
+
+/**
+ wwt 播放动图时的已解码帧缓存。每个播放者有自己的缓存和预解码窗口，多个视图播放同一个动图时互不影响，停止播放时只释放自己的帧
+ The buffer of decoded frames used to play a `SDWebImageAnimatedImage`. The image is shared by the memory cache and by every image view showing it, so the decoded frames and the look-ahead window belong to the player instead: several views can play the same image at different positions, and stopping one of them releases its own frames only.
+ */
+@interface SDWebImageAnimatedImageFrameBuffer : NSObject
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/**
+ Create a frame buffer for an animated image.
+ */
+- (nonnull instancetype)initWithAnimatedImage:(nonnull SDWebImageAnimatedImage *)animatedImage NS_DESIGNATED_INITIALIZER;
+
+/**
+ The animated image.
+ */
+@property (nonatomic, strong, readonly, nonnull) SDWebImageAnimatedImage *animatedImage;
+
+/**
+ The maximum count of decoded frames kept in buffer. Default is 0, which means the count is calculated from the frame size (about 20MB, at least 2 frames).
+ */
+@property (nonatomic, assign) NSUInteger maxBufferCount;
+
+/**
+ Return the decoded frame at index, and start decoding the following frames into the buffer in background. This method is thread-safe.
+
+ @param index The frame index (zero-based)
+ @param decodeIfNeeded If NO and the frame is not decoded yet, return nil instead of decoding it on current thread
+ @return The decoded frame
+ */
+- (nullable UIImage *)frameAtIndex:(NSUInteger)index decodeIfNeeded:(BOOL)decodeIfNeeded;
+
+/**
+ Remove all the decoded frames in buffer, for example when the image stops playing. The frames are decoded again when requested.
+ */
+- (void)clear;
+
+@end
+#endif
+
 @interface SDWebImageCoderHelper : NSObject
 
 /**
  wwt 根据帧数组返回一个动画图像
- 对于UIKit 会使用这个补丁创建一个动画图像。因为UIImage提供的+[UIImage animatedImageWithImages:duration:]方法只能用每个图像持续时间的平均值。所以当帧持续时间不同的时候就不好使了。因此这里重复帧指定的时间进行工作
+ 对于UIKit 返回一个SDWebImageAnimatedImage，保存每一帧的时长，不再按照时长的最大公约数重复帧（watchOS仍然重复帧）
  对于AppKit NSImage只支持GIF格式的图片。这个放回会试着将帧编码为GIF格式，然后创建一个用于渲染的动画NSImage对象。需要注意的是如果帧包含完整的Alpha通道，动画图像可能会丢失一些细节，因为GIF格式的图像只支持1位的alpha通道
  Return an animated image with frames array.
- For UIKit, this will apply the patch and then create animated UIImage. The patch is because that `+[UIImage animatedImageWithImages:duration:]` just use the average of duration for each image. So it will not work if different frame has different duration. Therefore we repeat the specify frame for specify times to let it work.
+ For UIKit, this will create a `SDWebImageAnimatedImage`, which keeps the duration of each frame. `+[UIImage animatedImageWithImages:duration:]` just use the average of duration for each image, the frames had to be repeated by the GCD of durations, which can explode into hundreds of entries for mixed durations.
+ For watchOS, this will apply the patch and then create animated UIImage: we repeat the specify frame for specify times to let it work.
  For AppKit, NSImage does not support animates other than GIF. This will try to encode the frames to GIF format and then create an animated NSImage for rendering. Attention the animated image may loss some detail if the input frames contain full alpha channel because GIF only supports 1 bit alpha channel. (For 1 pixel, either transparent or not)
 
  @param frames The frames array. If no frames or frames is empty, return nil
@@ -27,7 +169,7 @@
 
 /**
  Return frames array from an animated image.
- For UIKit, this will unapply the patch for the description above and then create frames array. This will also work for normal animated UIImage.
+ For UIKit, this will return the frames of `SDWebImageAnimatedImage`, or unapply the patch for the description above and then create frames array. This will also work for normal animated UIImage.
  For AppKit, NSImage does not support animates other than GIF. This will try to decode the GIF imageRep and then create frames array.
 
  @param animatedImage A animated image. If it's not animated, return nil
@@ -12,6 +12,369 @@
 #import "NSImage+WebCache.h"
 #import <ImageIO/ImageIO.h>
 #import "SDAnimatedImageRep.h"
+#import "SDWebImageCoder.h"
+#import "UIImage+MultiFormat.h"
+
+#if SD_UIKIT || SD_WATCH
+static NSUInteger gcdArray(size_t const count, NSUInteger const * const values);
+#endif
+
+#if SD_UIKIT
+
+#define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
+#define UNLOCK(lock) dispatch_semaphore_signal(lock);
+
+// wwt 自动计算缓存帧数时，已解码帧占用的最大内存
+static const NSUInteger kSDAnimatedImageBufferBytes = 20 * 1024 * 1024;
+
+// wwt 将一帧解码成位图，失败时返回原图
+static UIImage * SDAnimatedImageDecodedFrame(UIImage *image) {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        return image;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    if (width == 0 || height == 0) {
+        return image;
+    }
+    // BGRA8888 (premultiplied) or BGRX8888, same as the format used by Core Animation
+    BOOL hasAlpha = SDCGImageRefContainsAlpha(imageRef);
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host;
+    bitmapInfo |= hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst;
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, SDCGColorSpaceGetDeviceRGB(), bitmapInfo);
+    if (!context) {
+        return image;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+    CGImageRef decodedImageRef = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!decodedImageRef) {
+        return image;
+    }
+    UIImage *decodedImage = [[UIImage alloc] initWithCGImage:decodedImageRef scale:image.scale orientation:image.imageOrientation];
+    CGImageRelease(decodedImageRef);
+    return decodedImage;
+}
+
+@implementation SDWebImageAnimatedImage {
+    NSArray<SDWebImageFrame *> *_frames;
+    NSTimeInterval *_durations;
+    NSUInteger _frameCount;
+    NSArray<UIImage *> *_repeatedImages; // built on first access of `images`
+    dispatch_semaphore_t _repeatedImagesLock;
+}
+
+- (instancetype)initWithFrames:(NSArray<SDWebImageFrame *> *)frames {
+    UIImage *firstImage = frames.firstObject.image;
+    if (!firstImage.CGImage) {
+        return nil;
+    }
+    // the static image is the first frame
+    self = [super initWithCGImage:firstImage.CGImage scale:firstImage.scale orientation:firstImage.imageOrientation];
+    if (self) {
+        _frames = [frames copy];
+        if (![self _setupWithFrameCount:frames.count]) {
+            return nil;
+        }
+        for (NSUInteger i = 0; i < _frameCount; i++) {
+            NSTimeInterval duration = frames[i].duration;
+            _durations[i] = duration > 0 ? duration : 0.1;
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithProvider:(id<SDWebImageAnimatedImageProvider>)provider scale:(CGFloat)scale {
+    NSUInteger frameCount = provider.animatedImageFrameCount;
+    if (frameCount == 0) {
+        return nil;
+    }
+    UIImage *firstFrame = [provider animatedImageFrameAtIndex:0];
+    if (!firstFrame.CGImage) {
+        return nil;
+    }
+    if (scale <= 0) {
+        scale = 1;
+    }
+    self = [super initWithCGImage:firstFrame.CGImage scale:scale orientation:UIImageOrientationUp];
+    if (self) {
+        _animatedImageProvider = provider;
+        if (![self _setupWithFrameCount:frameCount]) {
+            return nil;
+        }
+        for (NSUInteger i = 0; i < _frameCount; i++) {
+            NSTimeInterval duration = [provider animatedImageDurationAtIndex:i];
+            _durations[i] = duration > 0 ? duration : 0.1;
+        }
+        self.sd_imageLoopCount = provider.animatedImageLoopCount;
+    }
+    return self;
+}
+
+- (BOOL)_setupWithFrameCount:(NSUInteger)frameCount {
+    _frameCount = frameCount;
+    _repeatedImagesLock = dispatch_semaphore_create(1);
+    _durations = malloc(sizeof(NSTimeInterval) * _frameCount);
+    if (!_durations) {
+        return NO;
+    }
+    return YES;
+}
+
+- (void)dealloc {
+    if (_durations) {
+        free(_durations);
+    }
+}
+
+- (NSData *)animatedImageData {
+    return self.animatedImageProvider.animatedImageData;
+}
+
+- (NSArray<SDWebImageFrame *> *)animatedImageFrames {
+    if (_frames) {
+        return _frames;
+    }
+    NSMutableArray<SDWebImageFrame *> *frames = [NSMutableArray arrayWithCapacity:_frameCount];
+    for (NSUInteger i = 0; i < _frameCount; i++) {
+        @autoreleasepool {
+            UIImage *image = [self decodedFrameAtIndex:i];
+            [frames addObject:[SDWebImageFrame frameWithImage:image duration:_durations[i]]];
+        }
+    }
+    return [frames copy];
+}
+
+- (NSUInteger)animatedImageFrameCount {
+    return _frameCount;
+}
+
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index {
+    if (index >= _frameCount) {
+        return 0;
+    }
+    return _durations[index];
+}
+
+// wwt 兼容直接读取images的UIKit控件（UIButton、高亮图片、MKAnnotationView、直接设置imageView.image），第一次访问时按时长的最大公约数重复帧生成帧数组
+// For the UIKit consumers which play `images` themselves (UIButton, highlighted image, MKAnnotationView, `imageView.image =`), the frames are repeated by the GCD of durations like `+[UIImage animatedImageWithImages:duration:]`. The array is built on first access and kept by the image.
+- (NSArray<UIImage *> *)images {
+    if (_frameCount <= 1) {
+        return nil;
+    }
+    LOCK(_repeatedImagesLock);
+    NSArray<UIImage *> *repeatedImages = _repeatedImages;
+    if (!repeatedImages) {
+        NSUInteger *durations = malloc(sizeof(NSUInteger) * _frameCount);
+        if (durations) {
+            for (NSUInteger i = 0; i < _frameCount; i++) {
+                durations[i] = _durations[i] * 1000;
+            }
+            NSUInteger const gcd = gcdArray(_frameCount, durations);
+            NSMutableArray<UIImage *> *images = [NSMutableArray arrayWithCapacity:_frameCount];
+            for (NSUInteger i = 0; i < _frameCount; i++) {
+                @autoreleasepool {
+                    // the frames array keeps the frames already, only the provider frames are decoded
+                    UIImage *image = _frames ? _frames[i].image : [self decodedFrameAtIndex:i];
+                    NSUInteger repeatCount = gcd ? MAX(durations[i] / gcd, 1) : 1;
+                    for (NSUInteger j = 0; j < repeatCount; j++) {
+                        [images addObject:image];
+                    }
+                }
+            }
+            free(durations);
+            repeatedImages = [images copy];
+            _repeatedImages = repeatedImages;
+        }
+    }
+    UNLOCK(_repeatedImagesLock);
+    return repeatedImages;
+}
+
+- (NSTimeInterval)duration {
+    if (_frameCount <= 1) {
+        return 0;
+    }
+    NSTimeInterval duration = 0;
+    for (NSUInteger i = 0; i < _frameCount; i++) {
+        duration += _durations[i];
+    }
+    return duration;
+}
+
+// Decode the frame from frames array or provider, the provider locks itself
+- (UIImage *)decodedFrameAtIndex:(NSUInteger)index {
+    if (index >= _frameCount) {
+        return nil;
+    }
+    if (_frames) {
+        return SDAnimatedImageDecodedFrame(_frames[index].image);
+    }
+    if (index == 0) {
+        // the static image is the decoded first frame
+        return [[UIImage alloc] initWithCGImage:self.CGImage scale:self.scale orientation:UIImageOrientationUp];
+    }
+    UIImage *frame = [self.animatedImageProvider animatedImageFrameAtIndex:index];
+    // use the first frame for broken frames, or the frame will be decoded again and again
+    CGImageRef imageRef = frame.CGImage ?: self.CGImage;
+    return [[UIImage alloc] initWithCGImage:imageRef scale:self.scale orientation:UIImageOrientationUp];
+}
+
+@end
+
+@implementation SDWebImageAnimatedImageFrameBuffer {
+    NSUInteger _frameCount;
+    NSMutableDictionary<NSNumber *, UIImage *> *_buffer; // decoded frames
+    NSUInteger _requestedIndex; // the buffer keeps the frames from the last requested one
+    BOOL _prefetching;
+    dispatch_semaphore_t _lock;
+    dispatch_queue_t _decodeQueue;
+}
+
+- (instancetype)initWithAnimatedImage:(SDWebImageAnimatedImage *)animatedImage {
+    self = [super init];
+    if (self) {
+        _animatedImage = animatedImage;
+        _frameCount = animatedImage.animatedImageFrameCount;
+        _buffer = [NSMutableDictionary dictionary];
+        _lock = dispatch_semaphore_create(1);
+        _decodeQueue = dispatch_queue_create("com.hackemist.SDWebImageAnimatedImageFrameBuffer", DISPATCH_QUEUE_SERIAL);
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(didReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+}
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification {
+    // keep the frame on screen only
+    LOCK(_lock);
+    UIImage *frame = _buffer[@(_requestedIndex)];
+    [_buffer removeAllObjects];
+    if (frame) {
+        _buffer[@(_requestedIndex)] = frame;
+    }
+    UNLOCK(_lock);
+}
+
+- (UIImage *)frameAtIndex:(NSUInteger)index decodeIfNeeded:(BOOL)decodeIfNeeded {
+    if (index >= _frameCount) {
+        return nil;
+    }
+    LOCK(_lock);
+    _requestedIndex = index;
+    [self _trimBuffer];
+    UIImage *frame = _buffer[@(index)];
+    UNLOCK(_lock);
+    
+    if (!frame && decodeIfNeeded) {
+        frame = [self.animatedImage decodedFrameAtIndex:index];
+        LOCK(_lock);
+        if ([self _isIndexInBuffer:index]) {
+            _buffer[@(index)] = frame;
+        }
+        UNLOCK(_lock);
+    }
+    [self _startPrefetching];
+    return frame;
+}
+
+- (void)clear {
+    LOCK(_lock);
+    [_buffer removeAllObjects];
+    UNLOCK(_lock);
+}
+
+#pragma mark - Buffer (call with lock)
+
+- (NSUInteger)_bufferCount {
+    NSUInteger maxBufferCount = self.maxBufferCount;
+    if (maxBufferCount > 0) {
+        return MIN(maxBufferCount, _frameCount);
+    }
+    CGImageRef imageRef = self.animatedImage.CGImage;
+    NSUInteger frameBytes = CGImageGetWidth(imageRef) * CGImageGetHeight(imageRef) * 4;
+    NSUInteger count = frameBytes > 0 ? kSDAnimatedImageBufferBytes / frameBytes : _frameCount;
+    // at least the current and the next frame
+    return MIN(MAX(count, 2), _frameCount);
+}
+
+// The buffer keeps the frames in [requested index, requested index + buffer count), wrapping around
+- (BOOL)_isIndexInBuffer:(NSUInteger)index {
+    return (index + _frameCount - _requestedIndex) % _frameCount < [self _bufferCount];
+}
+
+- (void)_trimBuffer {
+    if (_buffer.count < [self _bufferCount]) {
+        return;
+    }
+    for (NSNumber *key in _buffer.allKeys) {
+        if (![self _isIndexInBuffer:key.unsignedIntegerValue]) {
+            [_buffer removeObjectForKey:key];
+        }
+    }
+}
+
+#pragma mark - Prefetch
+
+- (void)_startPrefetching {
+    LOCK(_lock);
+    if (_prefetching || _frameCount <= 1) {
+        UNLOCK(_lock);
+        return;
+    }
+    _prefetching = YES;
+    UNLOCK(_lock);
+    
+    __weak __typeof(self) wself = self;
+    dispatch_async(_decodeQueue, ^{
+        __strong __typeof(wself) sself = wself;
+        [sself _decodeBufferFrames];
+    });
+}
+
+// Decode the missing frames in buffer one by one, until the buffer is full
+- (void)_decodeBufferFrames {
+    while (YES) {
+        @autoreleasepool {
+            NSUInteger missingIndex = NSNotFound;
+            LOCK(_lock);
+            NSUInteger bufferCount = [self _bufferCount];
+            for (NSUInteger i = 0; i < bufferCount; i++) {
+                NSUInteger index = (_requestedIndex + i) % _frameCount;
+                if (!_buffer[@(index)]) {
+                    missingIndex = index;
+                    break;
+                }
+            }
+            if (missingIndex == NSNotFound) {
+                _prefetching = NO;
+                UNLOCK(_lock);
+                return;
+            }
+            UNLOCK(_lock);
+            
+            UIImage *frame = [self.animatedImage decodedFrameAtIndex:missingIndex];
+            
+            LOCK(_lock);
+            // the window may move when decoding
+            if ([self _isIndexInBuffer:missingIndex]) {
+                _buffer[@(missingIndex)] = frame;
+            }
+            UNLOCK(_lock);
+        }
+    }
+}
+
+@end
+
+#endif
 
 @implementation SDWebImageCoderHelper
 
@@ -23,7 +386,11 @@
     
     UIImage *animatedImage;
     
-#if SD_UIKIT || SD_WATCH
+#if SD_UIKIT
+    // keep the duration table instead of repeating frames by the GCD of durations
+    animatedImage = [[SDWebImageAnimatedImage alloc] initWithFrames:frames];
+    
+#elif SD_WATCH
     NSUInteger durations[frameCount];
     for (size_t i = 0; i < frameCount; i++) {
         durations[i] = frames[i].duration * 1000;
@@ -92,6 +459,11 @@
     NSUInteger frameCount = 0;
     
 #if SD_UIKIT || SD_WATCH
+#if SD_UIKIT
+    if ([animatedImage isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        return ((SDWebImageAnimatedImage *)animatedImage).animatedImageFrames;
+    }
+#endif
     NSArray<UIImage *> *animatedImages = animatedImage.images;
     frameCount = animatedImages.count;
     if (frameCount == 0) {
@@ -8,6 +8,7 @@
 
 #import "SDWebImageCompat.h"
 #import "UIImage+MultiFormat.h"
+#import "SDWebImageCoderHelper.h"
 
 // wwt 只支持arc
 #if !__has_feature(objc_arc)
@@ -27,6 +28,30 @@ inline UIImage *SDScaledImageForKey(NSString * _Nullable key, UIImage * _Nullabl
 #if SD_MAC
     return image;
 #elif SD_UIKIT || SD_WATCH
+#if SD_UIKIT
+    if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        id<SDWebImageAnimatedImageProvider> provider = ((SDWebImageAnimatedImage *)image).animatedImageProvider;
+        if (provider) {
+            // do not decode the frames, just create with the scale of the first frame
+            CGFloat scale = SDScaledImageForKey(key, [[UIImage alloc] initWithCGImage:image.CGImage]).scale;
+            if (scale == image.scale) {
+                return image;
+            }
+            return [[SDWebImageAnimatedImage alloc] initWithProvider:provider scale:scale];
+        }
+        NSArray<SDWebImageFrame *> *frames = ((SDWebImageAnimatedImage *)image).animatedImageFrames;
+        NSMutableArray<SDWebImageFrame *> *scaledFrames = [NSMutableArray arrayWithCapacity:frames.count];
+        for (SDWebImageFrame *frame in frames) {
+            [scaledFrames addObject:[SDWebImageFrame frameWithImage:SDScaledImageForKey(key, frame.image) duration:frame.duration]];
+        }
+        
+        UIImage *animatedImage = [[SDWebImageAnimatedImage alloc] initWithFrames:scaledFrames];
+        if (animatedImage) {
+            animatedImage.sd_imageLoopCount = image.sd_imageLoopCount;
+        }
+        return animatedImage;
+    }
+#endif
     if ((image.images).count > 0) {
         NSMutableArray<UIImage *> *scaledImages = [NSMutableArray array];
 
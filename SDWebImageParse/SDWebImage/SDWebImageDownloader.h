@@ -60,6 +60,13 @@ typedef NS_OPTIONS(NSUInteger, SDWebImageDownloaderOptions) {
      * Scale down the image
      */
     SDWebImageDownloaderScaleDownLargeImages = 1 << 8,
+    
+    /**
+     * wwt 只下载数据不解码，完成回调中image为nil，用于预加载到硬盘缓存
+     * Do not decode the downloaded data, the completion block is called with nil image and the image data.
+     * Useful to warm the disk cache (see `SDWebImagePrefetcherWarmDiskOnly`). If another request without this flag joins the same download, the image is decoded.
+     */
+    SDWebImageDownloaderSkipDecoding = 1 << 9,
 };
 
 // wwt 图片下载执行顺序
@@ -127,6 +134,13 @@ typedef SDHTTPHeadersDictionary * _Nullable (^SDWebImageDownloaderHeadersFilterB
  */
 @property (assign, nonatomic) BOOL shouldDecompressImages;
 
+/**
+ * wwt 设置SDWebImageDownloaderScaleDownLargeImages时缩小的目标像素尺寸，默认CGSizeZero使用解码器默认的最大大小
+ * The pixel size large images are scaled down to fit when `SDWebImageDownloaderScaleDownLargeImages` is set.
+ * The image is decoded directly at this size from the downloaded data. Defaults to CGSizeZero, which uses the coder's maximum decoded size.
+ */
+@property (assign, nonatomic) CGSize scaleDownTargetPixelSize;
+
 /**
  * wwt 最大并发下载
  *  The maximum number of concurrent downloads
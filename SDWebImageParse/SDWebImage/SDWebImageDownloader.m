@@ -244,7 +244,7 @@
                                                  completed:(nullable SDWebImageDownloaderCompletedBlock)completedBlock {
     __weak SDWebImageDownloader *wself = self;
 
-    return [self addProgressCallback:progressBlock completedBlock:completedBlock forURL:url createCallback:^SDWebImageDownloaderOperation *{
+    SDWebImageDownloadToken *token = [self addProgressCallback:progressBlock completedBlock:completedBlock skipDecoding:(options & SDWebImageDownloaderSkipDecoding) != 0 forURL:url createCallback:^SDWebImageDownloaderOperation *{
         __strong __typeof (wself) sself = wself;
         // wwt 配置超时时间
         NSTimeInterval timeoutInterval = sself.downloadTimeout;
@@ -277,6 +277,9 @@
         // wwt 初始化下载队列
         SDWebImageDownloaderOperation *operation = [[sself.operationClass alloc] initWithRequest:request inSession:sself.session options:options];
         operation.shouldDecompressImages = sself.shouldDecompressImages;
+        if ([operation isKindOfClass:[SDWebImageDownloaderOperation class]]) {
+            operation.scaleDownTargetPixelSize = sself.scaleDownTargetPixelSize;
+        }
         
         // wwt 如果设置了证书传递给下载op，或者如果设置了账号密码，根据账号密码生成证书（但是并没有传递给op🤔️）
         if (sself.urlCredential) {
@@ -303,6 +306,7 @@
 
         return operation;
     }];
+    return token;
 }
 
 // wwt 根据token取消下载操作
@@ -325,6 +329,7 @@
 // wwt 设置进度和完成回调block，生成httpHeader
 - (nullable SDWebImageDownloadToken *)addProgressCallback:(SDWebImageDownloaderProgressBlock)progressBlock
                                            completedBlock:(SDWebImageDownloaderCompletedBlock)completedBlock
+                                             skipDecoding:(BOOL)skipDecoding
                                                    forURL:(nullable NSURL *)url
                                            createCallback:(SDWebImageDownloaderOperation *(^)(void))createCallback {
     // wwt URL会作为回调字典的key，所有不能为空
@@ -356,8 +361,13 @@
     }
     UNLOCK(self.operationsLock);
     
-    // wwt 添加进度和完成block
-    id downloadOperationCancelToken = [operation addHandlersForProgress:progressBlock completed:completedBlock];
+    // wwt 添加进度和完成block，订阅者是否需要解码随回调一起保存，下载完成时根据所有订阅者决定
+    id downloadOperationCancelToken;
+    if ([operation isKindOfClass:[SDWebImageDownloaderOperation class]]) {
+        downloadOperationCancelToken = [operation addHandlersForProgress:progressBlock completed:completedBlock skipDecoding:skipDecoding];
+    } else {
+        downloadOperationCancelToken = [operation addHandlersForProgress:progressBlock completed:completedBlock];
+    }
     
     // wwt 生成sdWebImageToken并返回
     SDWebImageDownloadToken *token = [SDWebImageDownloadToken new];
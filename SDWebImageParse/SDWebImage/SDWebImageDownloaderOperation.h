@@ -60,6 +60,19 @@ FOUNDATION_EXPORT NSString * _Nonnull const SDWebImageDownloadFinishNotification
 
 @property (assign, nonatomic) BOOL shouldDecompressImages;
 
+/**
+ * wwt 是否跳过解码，只回调图像数据。所有需要完成回调的订阅者都只需要数据时才跳过
+ * Whether to call the completion blocks with the image data only, without decoding the image.
+ * It is YES only if every current subscriber with a completed block was added with `skipDecoding`, and it is decided under the lock of the callbacks when the download completes, so a subscriber which needs the image always gets one.
+ */
+@property (assign, readonly) BOOL shouldSkipDecoding;
+
+/**
+ * wwt 缩小大图的目标像素尺寸
+ * The pixel size to fit large images into when `SDWebImageDownloaderScaleDownLargeImages` is set. Defaults to CGSizeZero.
+ */
+@property (assign, nonatomic) CGSize scaleDownTargetPixelSize;
+
 /**
  *  Was used to determine whether the URL connection should consult the credential storage for authenticating the connection.
  *  @deprecated Not used for a couple of versions
@@ -118,6 +131,18 @@ FOUNDATION_EXPORT NSString * _Nonnull const SDWebImageDownloadFinishNotification
 - (nullable id)addHandlersForProgress:(nullable SDWebImageDownloaderProgressBlock)progressBlock
                             completed:(nullable SDWebImageDownloaderCompletedBlock)completedBlock;
 
+/**
+ *  Adds handlers for progress and completion, like `addHandlersForProgress:completed:`.
+ *  wwt 订阅者是否只需要图像数据，对应`SDWebImageDownloaderSkipDecoding`
+ *
+ *  @param skipDecoding   whether this subscriber needs the image data only, see `SDWebImageDownloaderSkipDecoding`
+ *
+ *  @return the token to use to cancel this set of handlers
+ */
+- (nullable id)addHandlersForProgress:(nullable SDWebImageDownloaderProgressBlock)progressBlock
+                            completed:(nullable SDWebImageDownloaderCompletedBlock)completedBlock
+                         skipDecoding:(BOOL)skipDecoding;
+
 /**
  *  Cancels a set of callbacks. Once all callbacks are canceled, the operation is cancelled.
  *
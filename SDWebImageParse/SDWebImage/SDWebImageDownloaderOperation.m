@@ -10,6 +10,7 @@
 #import "SDWebImageManager.h"
 #import "NSImage+WebCache.h"
 #import "SDWebImageCodersManager.h"
+#import "UIImage+MultiFormat.h"
 
 #define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
 #define UNLOCK(lock) dispatch_semaphore_signal(lock);
@@ -23,10 +24,116 @@ NSString *const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinis
 static NSString *const kProgressCallbackKey = @"progress";
 // wwt 下载完成回调block在字典中的key
 static NSString *const kCompletedCallbackKey = @"completed";
+// wwt 是否只需要图像数据在字典中的key
+static NSString *const kSkipDecodingCallbackKey = @"skipDecoding";
 
 // wwt 定义SD字典类型 装逼用的，不过也直观
 typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 
+// wwt 逐步解码的节流：距离上次解码至少新收到这么多字节，并且间隔这么长时间
+static const NSUInteger kProgressiveDecodeMinimumBytes = 16 * 1024;
+static const CFTimeInterval kProgressiveDecodeMinimumInterval = 0.1;
+
+// wwt 实际存放字节的内存，被缓冲区和它生成的所有快照共同持有，最后一个释放时free
+@interface SDWebImageDownloaderDataStorage : NSObject
+
+@property (assign, nonatomic, readonly, nonnull) uint8_t *bytes;
+@property (assign, nonatomic, readonly) NSUInteger capacity;
+
+@end
+
+@implementation SDWebImageDownloaderDataStorage
+
+- (nullable instancetype)initWithCapacity:(NSUInteger)capacity {
+    if ((self = [super init])) {
+        _bytes = malloc(MAX(capacity, 1));
+        if (!_bytes) {
+            return nil;
+        }
+        _capacity = capacity;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_bytes);
+}
+
+@end
+
+/**
+ * wwt 只追加的下载缓冲区，快照直接引用已写入的前缀，不拷贝数据
+ * An append-only buffer for the downloaded bytes.
+ * Snapshots reference the bytes written so far without copying, appending never touches them.
+ * When the buffer grows, the bytes move to a new storage and old snapshots keep the old one alive.
+ */
+@interface SDWebImageDownloaderDataBuffer : NSObject
+
+@property (assign, nonatomic, readonly) NSUInteger length;
+
+- (nonnull instancetype)initWithCapacity:(NSUInteger)capacity;
+// wwt 内存分配失败时返回NO，缓冲区不变
+// Return NO if the storage can not be allocated, the buffer is not changed then
+- (BOOL)appendData:(nonnull NSData *)data;
+- (nonnull NSData *)snapshot;
+// wwt 下载完成后使用，有多余容量时拷贝一份，避免缓存的数据持有多余的内存
+- (nonnull NSData *)compactSnapshot;
+
+@end
+
+@implementation SDWebImageDownloaderDataBuffer {
+    SDWebImageDownloaderDataStorage *_storage;
+}
+
+- (nonnull instancetype)initWithCapacity:(NSUInteger)capacity {
+    if ((self = [super init])) {
+        _storage = [[SDWebImageDownloaderDataStorage alloc] initWithCapacity:capacity];
+    }
+    return self;
+}
+
+- (BOOL)appendData:(nonnull NSData *)data {
+    NSUInteger length = _length + data.length;
+    if (!_storage || length > _storage.capacity) {
+        // wwt 按倍数增长，整个下载的拷贝总量是O(n)
+        SDWebImageDownloaderDataStorage *storage = [[SDWebImageDownloaderDataStorage alloc] initWithCapacity:MAX(length, MAX(_storage.capacity * 2, kProgressiveDecodeMinimumBytes))];
+        if (!storage) {
+            return NO;
+        }
+        if (_length > 0) {
+            memcpy(storage.bytes, _storage.bytes, _length);
+        }
+        _storage = storage;
+    }
+    // The data from NSURLSession may not be contiguous, copy each region without flattening it
+    uint8_t *bytes = _storage.bytes;
+    [data enumerateByteRangesUsingBlock:^(const void *regionBytes, NSRange byteRange, BOOL *stop) {
+        memcpy(bytes + self->_length + byteRange.location, regionBytes, byteRange.length);
+    }];
+    _length = length;
+    return YES;
+}
+
+- (nonnull NSData *)snapshot {
+    if (_length == 0) {
+        return [NSData data];
+    }
+    SDWebImageDownloaderDataStorage *storage = _storage;
+    return [[NSData alloc] initWithBytesNoCopy:storage.bytes length:_length deallocator:^(void *bytes, NSUInteger length) {
+        // the snapshot holds the storage until it is released
+        [storage self];
+    }];
+}
+
+- (nonnull NSData *)compactSnapshot {
+    if (_length == _storage.capacity) {
+        return [self snapshot];
+    }
+    return [NSData dataWithBytes:_storage.bytes length:_length];
+}
+
+@end
+
 @interface SDWebImageDownloaderOperation ()
 
 // wwt 回调block数组
@@ -37,7 +144,9 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 @property (assign, nonatomic, getter = isFinished) BOOL finished;
 
 // wwt 图片数据
-@property (strong, nonatomic, nullable) NSMutableData *imageData;
+@property (strong, nonatomic, nullable) SDWebImageDownloaderDataBuffer *imageData;
+// wwt 保存数据失败时的错误，任务取消后用它回调
+@property (strong, nonatomic, nullable) NSError *imageDataError; // the task is cancelled when set, and completes with this error
 
 // wwt NSURLCache中的缓存的数据
 @property (copy, nonatomic, nullable) NSData *cachedData; // for `SDWebImageDownloaderIgnoreCachedResponse`
@@ -69,6 +178,13 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 // wwt 实现图片编码、解码解压缩的对象，该对象需要实现SDWebImageProgressiveCoder协议
 @property (strong, nonatomic, nullable) id<SDWebImageProgressiveCoder> progressiveCoder;
 
+// wwt 等待逐步解码的最新数据，每个operation最多只有一个等待中的解码，新数据直接替换旧数据
+@property (strong, nonatomic, nullable) NSData *progressiveData;
+@property (strong, nonatomic, nonnull) dispatch_semaphore_t progressiveLock; // a lock to keep the access to `progressiveData` thread-safe
+// wwt 上次安排逐步解码时的数据长度和时间，只在代理队列访问
+@property (assign, nonatomic) NSUInteger progressiveDecodedLength;
+@property (assign, nonatomic) CFAbsoluteTime progressiveDecodedTime;
+
 @end
 
 @implementation SDWebImageDownloaderOperation
@@ -101,6 +217,7 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
         _unownedSession = session;
         // wwt 创建旗语锁
         _callbacksLock = dispatch_semaphore_create(1);
+        _progressiveLock = dispatch_semaphore_create(1);
         // wwt 创建解码队列
         _coderQueue = dispatch_queue_create("com.hackemist.SDWebImageDownloaderOperationCoderQueue", DISPATCH_QUEUE_SERIAL);
     }
@@ -110,9 +227,16 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 // wwt 设置过程和完成block，返回回调block字典作为token
 - (nullable id)addHandlersForProgress:(nullable SDWebImageDownloaderProgressBlock)progressBlock
                             completed:(nullable SDWebImageDownloaderCompletedBlock)completedBlock {
+    return [self addHandlersForProgress:progressBlock completed:completedBlock skipDecoding:NO];
+}
+
+- (nullable id)addHandlersForProgress:(nullable SDWebImageDownloaderProgressBlock)progressBlock
+                            completed:(nullable SDWebImageDownloaderCompletedBlock)completedBlock
+                         skipDecoding:(BOOL)skipDecoding {
     SDCallbacksDictionary *callbacks = [NSMutableDictionary new];
     if (progressBlock) callbacks[kProgressCallbackKey] = [progressBlock copy];
     if (completedBlock) callbacks[kCompletedCallbackKey] = [completedBlock copy];
+    callbacks[kSkipDecodingCallbackKey] = @(skipDecoding);
     
     // wwt 添加回调block时是线程安全的
     LOCK(self.callbacksLock);
@@ -135,6 +259,20 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
     return [callbacks copy]; // strip mutability here
 }
 
+// wwt 所有需要完成回调的订阅者都只需要数据时才跳过解码
+- (BOOL)shouldSkipDecoding {
+    BOOL skipDecoding = YES;
+    LOCK(self.callbacksLock);
+    for (SDCallbacksDictionary *callbacks in self.callbackBlocks) {
+        if (callbacks[kCompletedCallbackKey] && ![callbacks[kSkipDecodingCallbackKey] boolValue]) {
+            skipDecoding = NO;
+            break;
+        }
+    }
+    UNLOCK(self.callbacksLock);
+    return skipDecoding;
+}
+
 // wwt 根据token取消
 - (BOOL)cancel:(nullable id)token {
     // wwt 标记是否应该移除
@@ -388,56 +526,68 @@ didReceiveResponse:(NSURLResponse *)response
 // wwt 接收到数据
 - (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
     
-    // wwt 存储收到的data
+    if (self.imageDataError) {
+        return;
+    }
+    // wwt 存储收到的data，内存不足时取消任务并以错误结束，不返回不完整的数据
     if (!self.imageData) {
-        self.imageData = [[NSMutableData alloc] initWithCapacity:self.expectedSize];
+        self.imageData = [[SDWebImageDownloaderDataBuffer alloc] initWithCapacity:MAX(self.expectedSize, 0)];
+    }
+    if (![self.imageData appendData:data]) {
+        // The task completes with the cancelled error, which is replaced by this one
+        self.imageDataError = [NSError errorWithDomain:SDWebImageErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey : @"Failed to allocate memory for the image data"}];
+        [dataTask cancel];
+        return;
     }
-    [self.imageData appendData:data];
     
     // wwt 如果是逐步下载模式
     if ((self.options & SDWebImageDownloaderProgressiveDownload) && self.expectedSize > 0) {
-        // wwt 获取一份imageData的copy
-        // Get the image data
-        __block NSData *imageData = [self.imageData copy];
         // wwt imageData的大小
         // Get the total bytes downloaded
-        const NSInteger totalSize = imageData.length;
+        const NSUInteger totalSize = self.imageData.length;
         // wwt 判断是否已经下载完成
         // Get the finish status
-        BOOL finished = (totalSize >= self.expectedSize);
+        BOOL finished = ((NSInteger)totalSize >= self.expectedSize);
         
-        // wwt 如果没有解码器初始化解码器
-        if (!self.progressiveCoder) {
-            // We need to create a new instance for progressive decoding to avoid conflicts
-            for (id<SDWebImageCoder>coder in [SDWebImageCodersManager sharedInstance].coders) {
-                if ([coder conformsToProtocol:@protocol(SDWebImageProgressiveCoder)] &&
-                    [((id<SDWebImageProgressiveCoder>)coder) canIncrementallyDecodeFromData:imageData]) {
-                    self.progressiveCoder = [[[coder class] alloc] init];
-                    break;
+        // wwt 节流，新数据足够多并且距离上次足够久才解码，最后一块一定解码
+        // Throttle by the bytes and the time since the last decode, the last chunk is always decoded
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        if (finished || (totalSize - self.progressiveDecodedLength >= kProgressiveDecodeMinimumBytes &&
+                         now - self.progressiveDecodedTime >= kProgressiveDecodeMinimumInterval)) {
+            self.progressiveDecodedLength = totalSize;
+            self.progressiveDecodedTime = now;
+            
+            // wwt 快照共享缓冲区，不拷贝数据
+            // Get the image data
+            NSData *imageData = [self.imageData snapshot];
+            
+            // wwt 如果没有解码器初始化解码器
+            if (!self.progressiveCoder) {
+                // We need to create a new instance for progressive decoding to avoid conflicts
+                for (id<SDWebImageCoder>coder in [SDWebImageCodersManager sharedInstance].coders) {
+                    if ([coder conformsToProtocol:@protocol(SDWebImageProgressiveCoder)] &&
+                        [((id<SDWebImageProgressiveCoder>)coder) canIncrementallyDecodeFromData:imageData]) {
+                        self.progressiveCoder = [[[coder class] alloc] init];
+                        break;
+                    }
                 }
             }
-        }
-        
-        // wwt 在解码队列中逐步解码图片
-        // progressive decode the image in coder queue
-        dispatch_async(self.coderQueue, ^{
-            UIImage *image = [self.progressiveCoder incrementallyDecodedImageWithData:imageData finished:finished];
-            if (image) {
-                // wwt 获取缓存关键字
-                NSString *key = [[SDWebImageManager sharedManager] cacheKeyForURL:self.request.URL];
-                // wwt 根据关键字缩放图片
-                image = [self scaledImageForKey:key image:image];
-                // wwt 如果需要解压缩图片，对图片进行解压缩
-                if (self.shouldDecompressImages) {
-                    image = [[SDWebImageCodersManager sharedInstance] decompressedImageWithImage:image data:&imageData options:@{SDWebImageCoderScaleDownLargeImagesKey: @(NO)}];
-                }
-                
-                // wwt 不保存逐步解码的图片即使已经完成了
-                // We do not keep the progressive decoding image even when `finished`=YES. Because they are for view rendering but not take full function from downloader options. And some coders implementation may not keep consistent between progressive decoding and normal decoding.
-                // wwt 执行完成block，用来逐步更新试图
-                [self callCompletionBlocksWithImage:image imageData:nil error:nil finished:NO];
+            
+            // wwt 最新数据优先，已经有等待中的解码时只替换它的数据
+            // Latest wins: if a decode is already waiting, it picks up this data when it runs
+            LOCK(self.progressiveLock);
+            BOOL scheduled = self.progressiveData != nil;
+            self.progressiveData = imageData;
+            UNLOCK(self.progressiveLock);
+            
+            // wwt 在解码队列中逐步解码图片
+            // progressive decode the image in coder queue
+            if (!scheduled) {
+                dispatch_async(self.coderQueue, ^{
+                    [self progressiveDecodeLatestData];
+                });
             }
-        });
+        }
     }
     
     // wwt 回调进度block
@@ -446,6 +596,35 @@ didReceiveResponse:(NSURLResponse *)response
     }
 }
 
+// wwt 在解码队列中解码最新的数据
+- (void)progressiveDecodeLatestData {
+    LOCK(self.progressiveLock);
+    NSData *imageData = self.progressiveData;
+    self.progressiveData = nil;
+    UNLOCK(self.progressiveLock);
+    if (!imageData) {
+        return;
+    }
+    
+    BOOL finished = ((NSInteger)imageData.length >= self.expectedSize);
+    UIImage *image = [self.progressiveCoder incrementallyDecodedImageWithData:imageData finished:finished];
+    if (image) {
+        // wwt 获取缓存关键字
+        NSString *key = [[SDWebImageManager sharedManager] cacheKeyForURL:self.request.URL];
+        // wwt 根据关键字缩放图片
+        image = [self scaledImageForKey:key image:image];
+        // wwt 如果需要解压缩图片，对图片进行解压缩
+        if (self.shouldDecompressImages) {
+            image = [[SDWebImageCodersManager sharedInstance] decompressedImageWithImage:image data:&imageData options:@{SDWebImageCoderScaleDownLargeImagesKey: @(NO)}];
+        }
+        
+        // wwt 不保存逐步解码的图片即使已经完成了
+        // We do not keep the progressive decoding image even when `finished`=YES. Because they are for view rendering but not take full function from downloader options. And some coders implementation may not keep consistent between progressive decoding and normal decoding.
+        // wwt 执行完成block，用来逐步更新试图
+        [self callCompletionBlocksWithImage:image imageData:nil error:nil finished:NO];
+    }
+}
+
 // wwt 是否使用NSURL缓存
 - (void)URLSession:(NSURLSession *)session
           dataTask:(NSURLSessionDataTask *)dataTask
@@ -479,6 +658,10 @@ didReceiveResponse:(NSURLResponse *)response
         });
     }
     
+    if (self.imageDataError) {
+        error = self.imageDataError;
+    }
+    
     // wwt 进行完成回调
     // make sure to call `[self done]` to mark operation as finished
     if (error) {
@@ -489,7 +672,7 @@ didReceiveResponse:(NSURLResponse *)response
             /**
              *  If you specified to use `NSURLCache`, then the response you get here is what you need.
              */
-            __block NSData *imageData = [self.imageData copy];
+            __block NSData *imageData = [self.imageData compactSnapshot];
             if (imageData) {
                 /**
                  * wwt 处理从NSURLCache中获取数据的情况
@@ -500,6 +683,10 @@ didReceiveResponse:(NSURLResponse *)response
                     // call completion block with nil
                     [self callCompletionBlocksWithImage:nil imageData:nil error:nil finished:YES];
                     [self done];
+                } else if (self.shouldSkipDecoding) {
+                    // wwt 只需要图像数据，不解码
+                    [self callCompletionBlocksWithImage:nil imageData:imageData error:nil finished:YES];
+                    [self done];
                 } else {
                     // wwt 对图像数据解码
                     // decode the image in coder queue
@@ -512,7 +699,7 @@ didReceiveResponse:(NSURLResponse *)response
                         
                         // wwt 不支持webP和动态图的解压缩
                         // Do not force decoding animated GIFs and WebPs
-                        if (image.images) {
+                        if (image.sd_isAnimated) {
                             shouldDecode = NO;
                         } else {
 #ifdef SD_WEBP
@@ -527,7 +714,13 @@ didReceiveResponse:(NSURLResponse *)response
                         if (shouldDecode) {
                             if (self.shouldDecompressImages) {
                                 BOOL shouldScaleDown = self.options & SDWebImageDownloaderScaleDownLargeImages;
-                                image = [[SDWebImageCodersManager sharedInstance] decompressedImageWithImage:image data:&imageData options:@{SDWebImageCoderScaleDownLargeImagesKey: @(shouldScaleDown)}];
+                                NSMutableDictionary *decompressOptions = [NSMutableDictionary dictionaryWithObject:@(shouldScaleDown) forKey:SDWebImageCoderScaleDownLargeImagesKey];
+#if SD_UIKIT || SD_WATCH
+                                if (shouldScaleDown && self.scaleDownTargetPixelSize.width > 0 && self.scaleDownTargetPixelSize.height > 0) {
+                                    decompressOptions[SDWebImageCoderScaleDownTargetPixelSizeKey] = [NSValue valueWithCGSize:self.scaleDownTargetPixelSize];
+                                }
+#endif
+                                image = [[SDWebImageCodersManager sharedInstance] decompressedImageWithImage:image data:&imageData options:decompressOptions];
                             }
                         }
                         
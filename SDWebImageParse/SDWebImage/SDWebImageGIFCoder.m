@@ -14,6 +14,78 @@
 #import "SDWebImageCoderHelper.h"
 #import "SDAnimatedImageRep.h"
 
+#if SD_UIKIT
+
+#define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
+#define UNLOCK(lock) dispatch_semaphore_signal(lock);
+
+// wwt 持有GIF压缩数据和CGImageSource，按需解码帧
+@interface SDWebImageGIFFrameProvider : NSObject <SDWebImageAnimatedImageProvider>
+
+- (instancetype)initWithData:(NSData *)data source:(CGImageSourceRef)source durations:(NSArray<NSNumber *> *)durations loopCount:(NSUInteger)loopCount;
+
+@end
+
+@implementation SDWebImageGIFFrameProvider {
+    CGImageSourceRef _source;
+    NSArray<NSNumber *> *_durations;
+    dispatch_semaphore_t _lock;
+}
+
+@synthesize animatedImageData = _animatedImageData;
+@synthesize animatedImageLoopCount = _animatedImageLoopCount;
+
+- (instancetype)initWithData:(NSData *)data source:(CGImageSourceRef)source durations:(NSArray<NSNumber *> *)durations loopCount:(NSUInteger)loopCount {
+    self = [super init];
+    if (self) {
+        _animatedImageData = [data copy];
+        _source = (CGImageSourceRef)CFRetain(source);
+        _durations = [durations copy];
+        _animatedImageLoopCount = loopCount;
+        _lock = dispatch_semaphore_create(1);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_source) {
+        CFRelease(_source);
+        _source = NULL;
+    }
+}
+
+- (NSUInteger)animatedImageFrameCount {
+    return _durations.count;
+}
+
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index {
+    if (index >= _durations.count) {
+        return 0;
+    }
+    return _durations[index].doubleValue;
+}
+
+- (UIImage *)animatedImageFrameAtIndex:(NSUInteger)index {
+    if (index >= _durations.count) {
+        return nil;
+    }
+    // decode when creating the image, instead of when rendering on main queue
+    NSDictionary *options = @{(__bridge NSString *)kCGImageSourceShouldCacheImmediately : @YES};
+    LOCK(_lock);
+    CGImageRef imageRef = CGImageSourceCreateImageAtIndex(_source, index, (__bridge CFDictionaryRef)options);
+    UNLOCK(_lock);
+    if (!imageRef) {
+        return nil;
+    }
+    UIImage *image = [[UIImage alloc] initWithCGImage:imageRef];
+    CGImageRelease(imageRef);
+    return image;
+}
+
+@end
+
+#endif
+
 @implementation SDWebImageGIFCoder
 
 + (instancetype)sharedCoder {
@@ -55,6 +127,26 @@
     if (count <= 1) {
         animatedImage = [[UIImage alloc] initWithData:data];
     } else {
+        NSUInteger loopCount = 1;
+        NSDictionary *imageProperties = (__bridge_transfer NSDictionary *)CGImageSourceCopyProperties(source, nil);
+        NSDictionary *gifProperties = [imageProperties valueForKey:(__bridge_transfer NSString *)kCGImagePropertyGIFDictionary];
+        if (gifProperties) {
+            NSNumber *gifLoopCount = [gifProperties valueForKey:(__bridge_transfer NSString *)kCGImagePropertyGIFLoopCount];
+            if (gifLoopCount != nil) {
+                loopCount = gifLoopCount.unsignedIntegerValue;
+            }
+        }
+        
+#if SD_UIKIT
+        // wwt 只保留压缩数据，帧在播放时按需解码
+        // Keep the compressed data only, the frames are decoded on demand when played
+        NSMutableArray<NSNumber *> *durations = [NSMutableArray arrayWithCapacity:count];
+        for (size_t i = 0; i < count; i++) {
+            [durations addObject:@([self sd_frameDurationAtIndex:i source:source])];
+        }
+        SDWebImageGIFFrameProvider *provider = [[SDWebImageGIFFrameProvider alloc] initWithData:data source:source durations:durations loopCount:loopCount];
+        animatedImage = [[SDWebImageAnimatedImage alloc] initWithProvider:provider scale:1];
+#else
         NSMutableArray<SDWebImageFrame *> *frames = [NSMutableArray array];
         
         for (size_t i = 0; i < count; i++) {
@@ -71,18 +163,9 @@
             [frames addObject:frame];
         }
         
-        NSUInteger loopCount = 1;
-        NSDictionary *imageProperties = (__bridge_transfer NSDictionary *)CGImageSourceCopyProperties(source, nil);
-        NSDictionary *gifProperties = [imageProperties valueForKey:(__bridge_transfer NSString *)kCGImagePropertyGIFDictionary];
-        if (gifProperties) {
-            NSNumber *gifLoopCount = [gifProperties valueForKey:(__bridge_transfer NSString *)kCGImagePropertyGIFLoopCount];
-            if (gifLoopCount != nil) {
-                loopCount = gifLoopCount.unsignedIntegerValue;
-            }
-        }
-        
         animatedImage = [SDWebImageCoderHelper animatedImageWithFrames:frames];
         animatedImage.sd_imageLoopCount = loopCount;
+#endif
     }
     
     CFRelease(source);
@@ -147,6 +230,16 @@
         return nil;
     }
     
+#if SD_UIKIT
+    // the image decoded by this coder keeps the original data, do not encode the frames again
+    if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        NSData *animatedImageData = ((SDWebImageAnimatedImage *)image).animatedImageData;
+        if ([NSData sd_imageFormatForImageData:animatedImageData] == SDImageFormatGIF) {
+            return animatedImageData;
+        }
+    }
+#endif
+    
     NSMutableData *imageData = [NSMutableData data];
     CFStringRef imageUTType = [NSData sd_UTTypeFromSDImageFormat:SDImageFormatGIF];
     NSArray<SDWebImageFrame *> *frames = [SDWebImageCoderHelper framesFromAnimatedImage:image];
@@ -11,6 +11,7 @@
 #import "NSImage+WebCache.h"
 #import <ImageIO/ImageIO.h>
 #import "NSData+ImageContentType.h"
+#import "UIImage+MultiFormat.h"
 
 #if SD_UIKIT || SD_WATCH
 // wwt 每个像素含有的字节
@@ -45,6 +46,126 @@ static const CGFloat kTileTotalPixels = kSourceImageTileSizeMB * kPixelsPerMB;
 
 // wwt 图块交界的地方重叠的像素
 static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to overlap the seems where tiles meet.
+
+// wwt 内存池中空闲位图内存的上限
+static const size_t kBitmapPoolCostLimit = 16 * 1024 * 1024;
+
+#define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
+#define UNLOCK(lock) dispatch_semaphore_signal(lock);
+
+// wwt 按大小分级，每个2的幂之间分4级，相近大小的图片可以复用同一块内存
+// The size class of a buffer, 4 classes per power of two, so buffers of close sizes are shared
+static size_t SDBitmapBufferSizeClass(size_t length) {
+    if (length <= 4096) return 4096;
+    size_t power = 4096;
+    while (power * 2 < length) power *= 2;
+    size_t step = power / 4;
+    return (length + step - 1) / step * step;
+}
+
+/**
+ wwt 解压图片使用的位图内存池，图片释放后内存回到池中，下次解压相近大小的图片时直接复用，减少内存分配和缺页
+ A pool of the bitmap buffers used by decompressing. When a decompressed image is released, its buffer goes back
+ to the pool and is used by the next image of a close size, instead of new pages. Idle buffers are limited to
+ `kBitmapPoolCostLimit` bytes, and freed on memory warning and when entering background.
+ */
+@interface SDWebImageBitmapPool : NSObject
+
++ (nonnull instancetype)sharedPool;
+// the buffer has at least `length` bytes, its contents are undefined
+- (nullable void *)bufferWithLength:(size_t)length;
+- (void)recycleBuffer:(nonnull void *)buffer length:(size_t)length;
+- (void)removeAllBuffers;
+
+@end
+
+@implementation SDWebImageBitmapPool {
+    NSMutableDictionary<NSNumber *, NSMutableArray<NSValue *> *> *_buffers; // size class -> idle buffers
+    size_t _totalCost;
+    dispatch_semaphore_t _lock;
+}
+
++ (nonnull instancetype)sharedPool {
+    static SDWebImageBitmapPool *pool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pool = [SDWebImageBitmapPool new];
+    });
+    return pool;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _buffers = [NSMutableDictionary dictionary];
+        _lock = dispatch_semaphore_create(1);
+#if SD_UIKIT
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(removeAllBuffers) name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(removeAllBuffers) name:UIApplicationDidEnterBackgroundNotification object:nil];
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self removeAllBuffers];
+}
+
+- (nullable void *)bufferWithLength:(size_t)length {
+    size_t capacity = SDBitmapBufferSizeClass(length);
+    void *buffer = NULL;
+    LOCK(_lock);
+    NSMutableArray<NSValue *> *buffers = _buffers[@(capacity)];
+    if (buffers.count > 0) {
+        buffer = buffers.lastObject.pointerValue;
+        [buffers removeLastObject];
+        _totalCost -= capacity;
+    }
+    UNLOCK(_lock);
+    if (!buffer) {
+        buffer = malloc(capacity);
+    }
+    return buffer;
+}
+
+- (void)recycleBuffer:(nonnull void *)buffer length:(size_t)length {
+    size_t capacity = SDBitmapBufferSizeClass(length);
+    LOCK(_lock);
+    if (_totalCost + capacity <= kBitmapPoolCostLimit) {
+        NSMutableArray<NSValue *> *buffers = _buffers[@(capacity)];
+        if (!buffers) {
+            buffers = [NSMutableArray array];
+            _buffers[@(capacity)] = buffers;
+        }
+        [buffers addObject:[NSValue valueWithPointer:buffer]];
+        _totalCost += capacity;
+        buffer = NULL;
+    }
+    UNLOCK(_lock);
+    if (buffer) {
+        free(buffer);
+    }
+}
+
+- (void)removeAllBuffers {
+    LOCK(_lock);
+    NSDictionary<NSNumber *, NSMutableArray<NSValue *> *> *buffers = _buffers;
+    _buffers = [NSMutableDictionary dictionary];
+    _totalCost = 0;
+    UNLOCK(_lock);
+    for (NSArray<NSValue *> *list in buffers.allValues) {
+        for (NSValue *value in list) {
+            free(value.pointerValue);
+        }
+    }
+}
+
+@end
+
+// wwt 图片释放时把位图内存还给内存池
+static void SDBitmapPoolReleaseData(void *info, const void *data, size_t size) {
+    [[SDWebImageBitmapPool sharedPool] recycleBuffer:(void *)data length:size];
+}
 #endif
 
 @implementation SDWebImageImageIOCoder {
@@ -221,10 +342,21 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
             shouldScaleDown = [scaleDownLargeImagesOption boolValue];
         }
     }
+    CGSize targetPixelSize = CGSizeZero;
+    if ([optionsDict[SDWebImageCoderScaleDownTargetPixelSizeKey] isKindOfClass:[NSValue class]]) {
+        targetPixelSize = [(NSValue *)optionsDict[SDWebImageCoderScaleDownTargetPixelSizeKey] CGSizeValue];
+    }
     if (!shouldScaleDown) {
         return [self sd_decompressedImageWithImage:image];
     } else {
-        UIImage *scaledDownImage = [self sd_decompressedAndScaledDownImageWithImage:image];
+        UIImage *scaledDownImage = nil;
+        // wwt 有原始数据时直接从数据解码出缩小的图片，完整尺寸的位图不会被生成
+        if (*data && [[self class] shouldDecodeImage:image] && [[self class] shouldScaleDownImage:image targetPixelSize:targetPixelSize]) {
+            scaledDownImage = [self sd_decodedAndScaledDownImageWithData:*data image:image targetPixelSize:targetPixelSize];
+        }
+        if (!scaledDownImage) {
+            scaledDownImage = [self sd_decompressedAndScaledDownImageWithImage:image targetPixelSize:targetPixelSize];
+        }
         if (scaledDownImage && !CGSizeEqualToSize(scaledDownImage.size, image.size)) {
             // if the image is scaled down, need to modify the data pointer as well
             SDImageFormat format = [NSData sd_imageFormatForImageData:*data];
@@ -261,35 +393,97 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
         // kCGImageAlphaNone is not supported in CGBitmapContextCreate.
         // Since the original image here has no alpha info, use kCGImageAlphaNoneSkipLast
         // to create bitmap graphics contexts without alpha info.
-        CGContextRef context = CGBitmapContextCreate(NULL,
+        // wwt 位图内存从内存池中获取，图片释放后还给内存池
+        size_t bytesPerRow = (width * kBytesPerPixel + 63) / 64 * 64;
+        size_t length = bytesPerRow * height;
+        SDWebImageBitmapPool *pool = [SDWebImageBitmapPool sharedPool];
+        void *buffer = [pool bufferWithLength:length];
+        if (!buffer) {
+            return image;
+        }
+        CGBitmapInfo bitmapInfo = kCGBitmapByteOrderDefault|kCGImageAlphaNoneSkipLast;
+        CGContextRef context = CGBitmapContextCreate(buffer,
                                                      width,
                                                      height,
                                                      kBitsPerComponent,
-                                                     0,
+                                                     bytesPerRow,
                                                      colorspaceRef,
-                                                     kCGBitmapByteOrderDefault|kCGImageAlphaNoneSkipLast);
+                                                     bitmapInfo);
         if (context == NULL) {
+            [pool recycleBuffer:buffer length:length];
             return image;
         }
         
         // Draw the image into the context and retrieve the new bitmap image without alpha
         CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
-        CGImageRef imageRefWithoutAlpha = CGBitmapContextCreateImage(context);
-        UIImage *imageWithoutAlpha = [[UIImage alloc] initWithCGImage:imageRefWithoutAlpha scale:image.scale orientation:image.imageOrientation];
         CGContextRelease(context);
+        // The image uses the buffer without copying, the provider returns it to the pool
+        CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, buffer, length, SDBitmapPoolReleaseData);
+        if (!provider) {
+            [pool recycleBuffer:buffer length:length];
+            return image;
+        }
+        CGImageRef imageRefWithoutAlpha = CGImageCreate(width, height, kBitsPerComponent, kBitsPerComponent * kBytesPerPixel, bytesPerRow, colorspaceRef, bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+        CGDataProviderRelease(provider);
+        if (!imageRefWithoutAlpha) {
+            return image;
+        }
+        UIImage *imageWithoutAlpha = [[UIImage alloc] initWithCGImage:imageRefWithoutAlpha scale:image.scale orientation:image.imageOrientation];
         CGImageRelease(imageRefWithoutAlpha);
         
         return imageWithoutAlpha;
     }
 }
 
+// wwt 从原始数据解码缩小的图片，ImageIO按条带解码并缩放（JPEG直接在DCT阶段缩小），内存峰值约为目标位图加一个条带
+- (nullable UIImage *)sd_decodedAndScaledDownImageWithData:(nonnull NSData *)data image:(nonnull UIImage *)image targetPixelSize:(CGSize)targetPixelSize {
+    @autoreleasepool {
+        CGImageRef sourceImageRef = image.CGImage;
+        CGSize destResolution = [[self class] scaledDownPixelSizeForImageRef:sourceImageRef targetPixelSize:targetPixelSize];
+        
+        CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, (__bridge CFDictionaryRef)@{(__bridge NSString *)kCGImageSourceShouldCache : @NO});
+        if (!source) {
+            return nil;
+        }
+        
+        // The data must be the one the image was created from, otherwise let the tiled path draw the image itself
+        size_t width = 0, height = 0;
+        CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+        if (properties) {
+            CFTypeRef val = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+            if (val) CFNumberGetValue(val, kCFNumberLongType, &width);
+            val = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+            if (val) CFNumberGetValue(val, kCFNumberLongType, &height);
+            CFRelease(properties);
+        }
+        if (width != CGImageGetWidth(sourceImageRef) || height != CGImageGetHeight(sourceImageRef)) {
+            CFRelease(source);
+            return nil;
+        }
+        
+        // Orientation is kept on the UIImage, same as `decodedImageWithData:`
+        NSDictionary *options = @{(__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+                                  (__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize : @(MAX(destResolution.width, destResolution.height)),
+                                  (__bridge NSString *)kCGImageSourceCreateThumbnailWithTransform : @NO,
+                                  (__bridge NSString *)kCGImageSourceShouldCacheImmediately : @YES};
+        CGImageRef destImageRef = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+        CFRelease(source);
+        if (destImageRef == NULL) {
+            return nil;
+        }
+        UIImage *destImage = [[UIImage alloc] initWithCGImage:destImageRef scale:image.scale orientation:image.imageOrientation];
+        CGImageRelease(destImageRef);
+        return destImage;
+    }
+}
+
 // wwt 解压需要缩小的图片
-- (nullable UIImage *)sd_decompressedAndScaledDownImageWithImage:(nullable UIImage *)image {
+- (nullable UIImage *)sd_decompressedAndScaledDownImageWithImage:(nullable UIImage *)image targetPixelSize:(CGSize)targetPixelSize {
     if (![[self class] shouldDecodeImage:image]) {
         return image;
     }
     
-    if (![[self class] shouldScaleDownImage:image]) {
+    if (![[self class] shouldScaleDownImage:image targetPixelSize:targetPixelSize]) {
         return [self sd_decompressedImageWithImage:image];
     }
     
@@ -303,14 +497,11 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
         CGSize sourceResolution = CGSizeZero;
         sourceResolution.width = CGImageGetWidth(sourceImageRef);
         sourceResolution.height = CGImageGetHeight(sourceImageRef);
-        float sourceTotalPixels = sourceResolution.width * sourceResolution.height;
         // Determine the scale ratio to apply to the input image
         // that results in an output image of the defined size.
         // see kDestImageSizeMB, and how it relates to destTotalPixels.
-        float imageScale = kDestTotalPixels / sourceTotalPixels;
-        CGSize destResolution = CGSizeZero;
-        destResolution.width = (int)(sourceResolution.width*imageScale);
-        destResolution.height = (int)(sourceResolution.height*imageScale);
+        CGSize destResolution = [[self class] scaledDownPixelSizeForImageRef:sourceImageRef targetPixelSize:targetPixelSize];
+        float imageScale = destResolution.width / sourceResolution.width;
         
         // current color space
         CGColorSpaceRef colorspaceRef = [[self class] colorSpaceForImageRef:sourceImageRef];
@@ -411,6 +602,9 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
         case SDImageFormatHEIC:
             // Check HEIC encoding compatibility
             return [[self class] canEncodeToHEICFormat];
+        case SDImageFormatAVIF:
+            // Image/IO can not write AVIF
+            return NO;
         default:
             return YES;
     }
@@ -470,7 +664,7 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
     }
     
     // do not decode animated images
-    if (image.images != nil) {
+    if (image.sd_isAnimated) {
         return NO;
     }
     
@@ -566,22 +760,35 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
 
 // wwt 判断图片是否需要缩放
 #if SD_UIKIT || SD_WATCH
-+ (BOOL)shouldScaleDownImage:(nonnull UIImage *)image {
-    BOOL shouldScaleDown = YES;
-    
++ (BOOL)shouldScaleDownImage:(nonnull UIImage *)image targetPixelSize:(CGSize)targetPixelSize {
     CGImageRef sourceImageRef = image.CGImage;
+    CGSize destResolution = [self scaledDownPixelSizeForImageRef:sourceImageRef targetPixelSize:targetPixelSize];
+    return destResolution.width < CGImageGetWidth(sourceImageRef) || destResolution.height < CGImageGetHeight(sourceImageRef);
+}
+
+// wwt 缩小后的像素尺寸，等比缩放到目标尺寸以内，没有目标尺寸时总像素不超过kDestTotalPixels，不会放大
++ (CGSize)scaledDownPixelSizeForImageRef:(CGImageRef)imageRef targetPixelSize:(CGSize)targetPixelSize {
     CGSize sourceResolution = CGSizeZero;
-    sourceResolution.width = CGImageGetWidth(sourceImageRef);
-    sourceResolution.height = CGImageGetHeight(sourceImageRef);
-    float sourceTotalPixels = sourceResolution.width * sourceResolution.height;
-    float imageScale = kDestTotalPixels / sourceTotalPixels;
-    if (imageScale < 1) {
-        shouldScaleDown = YES;
+    sourceResolution.width = CGImageGetWidth(imageRef);
+    sourceResolution.height = CGImageGetHeight(imageRef);
+    if (sourceResolution.width == 0 || sourceResolution.height == 0) {
+        return sourceResolution;
+    }
+    float imageScale;
+    if (targetPixelSize.width > 0 && targetPixelSize.height > 0) {
+        imageScale = MIN(targetPixelSize.width / sourceResolution.width, targetPixelSize.height / sourceResolution.height);
     } else {
-        shouldScaleDown = NO;
+        // the limit is in pixels, so the scale of each side is its square root
+        float sourceTotalPixels = sourceResolution.width * sourceResolution.height;
+        imageScale = sqrtf(kDestTotalPixels / sourceTotalPixels);
     }
-    
-    return shouldScaleDown;
+    if (imageScale >= 1) {
+        return sourceResolution;
+    }
+    CGSize destResolution = CGSizeZero;
+    destResolution.width = MAX(1, (int)(sourceResolution.width * imageScale));
+    destResolution.height = MAX(1, (int)(sourceResolution.height * imageScale));
+    return destResolution;
 }
 
 // wwt 返回图片的颜色空间，如果是不支持的颜色空间返回设备的RGB颜色空间
@@ -8,6 +8,7 @@
 
 #import "SDWebImageManager.h"
 #import "NSImage+WebCache.h"
+#import "UIImage+MultiFormat.h"
 #import <objc/message.h>
 
 @interface SDWebImageCombinedOperation : NSObject <SDWebImageOperation>
@@ -280,7 +281,7 @@
                     }
                     
                     // wwt 如果图片下载成功了，而且不是动图或者设置了可以转换动图，而且设置了图像转换代理，则让代理执行转换操作，并将转换后的图像写入缓存，并执行完成block
-                    else if (downloadedImage && (!downloadedImage.images || (options & SDWebImageTransformAnimatedImage)) && [self.delegate respondsToSelector:@selector(imageManager:transformDownloadedImage:withURL:)]) {
+                    else if (downloadedImage && (!downloadedImage.sd_isAnimated || (options & SDWebImageTransformAnimatedImage)) && [self.delegate respondsToSelector:@selector(imageManager:transformDownloadedImage:withURL:)]) {
                         dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
                             UIImage *transformedImage = [self.delegate imageManager:self transformDownloadedImage:downloadedImage withURL:url];
 
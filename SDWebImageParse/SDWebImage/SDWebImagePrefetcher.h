@@ -38,6 +38,33 @@
 typedef void(^SDWebImagePrefetcherProgressBlock)(NSUInteger noOfFinishedUrls, NSUInteger noOfTotalUrls);
 typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls, NSUInteger noOfSkippedUrls);
 
+typedef NS_OPTIONS(NSUInteger, SDWebImagePrefetcherOptions) {
+    /**
+     * wwt 只把图像数据下载到硬盘缓存，不解码，也不放入内存缓存
+     * Only download the image data into the disk cache, the images are not decoded and not stored in memory cache.
+     * The URLs already in disk cache are skipped without reading.
+     */
+    SDWebImagePrefetcherWarmDiskOnly = 1 << 0
+};
+
+/**
+ * wwt 一批预加载的token，可以取消这一批预加载
+ * A batch of prefetching URLs, returned by `prefetchURLs:prefetcherOptions:progress:completed:`. Use it to cancel the batch only.
+ */
+@interface SDWebImagePrefetchToken : NSObject <SDWebImageOperation>
+
+/**
+ * The URLs of the batch.
+ */
+@property (copy, nonatomic, readonly, nonnull) NSArray<NSURL *> *urls;
+
+/**
+ * Cancel the running and the queued URLs of the batch. The completion block is not called after cancelled.
+ */
+- (void)cancel;
+
+@end
+
 /**
  * Prefetch some URLs in the cache for future use. Images are downloaded in low priority.
  */
@@ -53,6 +80,13 @@ typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls,
  */
 @property (nonatomic, assign) NSUInteger maxConcurrentDownloads;
 
+/**
+ * wwt 每批同时处理的URL数目（查询缓存、下载、解码），比最大并发下载数大，保证下载队列一直有任务
+ * Maximum number of URLs in flight (querying cache, downloading or decoding) for each batch. A new URL is started as soon as one finishes.
+ * It should be larger than `maxConcurrentDownloads` so the downloader always has queued requests. Defaults to 8.
+ */
+@property (nonatomic, assign) NSUInteger maxConcurrentPrefetches;
+
 /**
  * SDWebImageOptions for prefetcher. Defaults to SDWebImageLowPriority.
  */
@@ -77,7 +111,7 @@ typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls,
 
 /**
  * Assign list of URLs to let SDWebImagePrefetcher to queue the prefetching,
- * currently one image is downloaded at a time,
+ * up to `maxConcurrentPrefetches` URLs are in flight at a time,
  * and skips images for failed downloads and proceed to the next image in the list.
  * Any previously-running prefetch operations are canceled.
  *
@@ -87,7 +121,7 @@ typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls,
 
 /**
  * Assign list of URLs to let SDWebImagePrefetcher to queue the prefetching,
- * currently one image is downloaded at a time,
+ * up to `maxConcurrentPrefetches` URLs are in flight at a time,
  * and skips images for failed downloads and proceed to the next image in the list.
  * Any previously-running prefetch operations are canceled.
  *
@@ -104,7 +138,23 @@ typedef void(^SDWebImagePrefetcherCompletionBlock)(NSUInteger noOfFinishedUrls,
            completed:(nullable SDWebImagePrefetcherCompletionBlock)completionBlock;
 
 /**
- * Remove and cancel queued list
+ * Prefetch a batch of URLs without canceling the other batches.
+ * The duplicated URLs, the URLs in memory cache, and for `SDWebImagePrefetcherWarmDiskOnly` the URLs in disk cache are finished without loading.
+ * The same URL in flight in other batches or image views shares the download.
+ *
+ * @param urls              list of URLs to prefetch
+ * @param prefetcherOptions options of this batch
+ * @param progressBlock     block to be called on `prefetcherQueue` when progress updates, see `prefetchURLs:progress:completed:`
+ * @param completionBlock   block to be called on `prefetcherQueue` when the batch is completed, see `prefetchURLs:progress:completed:`
+ * @return the token to cancel the batch, nil if urls is empty
+ */
+- (nullable SDWebImagePrefetchToken *)prefetchURLs:(nullable NSArray<NSURL *> *)urls
+                                 prefetcherOptions:(SDWebImagePrefetcherOptions)prefetcherOptions
+                                          progress:(nullable SDWebImagePrefetcherProgressBlock)progressBlock
+                                         completed:(nullable SDWebImagePrefetcherCompletionBlock)completionBlock;
+
+/**
+ * Remove and cancel queued list (all the batches)
  */
 - (void)cancelPrefetching;
 
@@ -8,16 +8,68 @@
 
 #import "SDWebImagePrefetcher.h"
 
+#define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
+#define UNLOCK(lock) dispatch_semaphore_signal(lock);
+
+@interface SDWebImagePrefetchToken ()
+
+@property (weak, nonatomic, nullable) SDWebImagePrefetcher *prefetcher;
+@property (copy, nonatomic, readwrite, nonnull) NSArray<NSURL *> *urls;
+@property (assign, nonatomic) SDWebImagePrefetcherOptions prefetcherOptions;
+@property (copy, nonatomic, nullable) SDWebImagePrefetcherProgressBlock progressBlock;
+@property (copy, nonatomic, nullable) SDWebImagePrefetcherCompletionBlock completionBlock;
+@property (assign, atomic, getter=isCancelled) BOOL cancelled;
+// the following are accessed with lock
+@property (assign, nonatomic) NSUInteger nextIndex; // the next URL to start
+@property (assign, nonatomic) NSUInteger runningCount;
+@property (assign, nonatomic) NSUInteger finishedCount;
+@property (assign, nonatomic) NSUInteger skippedCount;
+@property (assign, nonatomic, getter=isLaunching) BOOL launching; // a thread is starting the URLs
+@property (strong, nonatomic, nonnull) NSMutableSet<NSURL *> *startedURLs; // to finish the duplicated URLs without loading
+@property (strong, nonatomic, nonnull) NSMutableDictionary<NSNumber *, id> *operations; // URL index -> operation, NSNull before the operation is returned
+@property (strong, nonatomic, nonnull) dispatch_semaphore_t lock;
+
+@end
+
+@implementation SDWebImagePrefetchToken
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _startedURLs = [NSMutableSet new];
+        _operations = [NSMutableDictionary new];
+        _lock = dispatch_semaphore_create(1);
+    }
+    return self;
+}
+
+- (void)cancel {
+    LOCK(self.lock);
+    if (self.cancelled) {
+        UNLOCK(self.lock);
+        return;
+    }
+    self.cancelled = YES;
+    NSArray *operations = self.operations.allValues;
+    [self.operations removeAllObjects];
+    UNLOCK(self.lock);
+    
+    for (id operation in operations) {
+        if ([operation conformsToProtocol:@protocol(SDWebImageOperation)]) {
+            [operation cancel];
+        }
+    }
+    [self.prefetcher removeToken:self];
+}
+
+@end
+
 @interface SDWebImagePrefetcher ()
 
 @property (strong, nonatomic, nonnull) SDWebImageManager *manager;
-@property (strong, atomic, nullable) NSArray<NSURL *> *prefetchURLs; // may be accessed from different queue
-@property (assign, nonatomic) NSUInteger requestedCount;
-@property (assign, nonatomic) NSUInteger skippedCount;
-@property (assign, nonatomic) NSUInteger finishedCount;
-@property (assign, nonatomic) NSTimeInterval startedTime;
-@property (copy, nonatomic, nullable) SDWebImagePrefetcherCompletionBlock completionBlock;
-@property (copy, nonatomic, nullable) SDWebImagePrefetcherProgressBlock progressBlock;
+@property (strong, nonatomic, nonnull) NSMutableSet<SDWebImagePrefetchToken *> *runningTokens;
+@property (strong, nonatomic, nonnull) dispatch_semaphore_t runningTokensLock; // a lock to keep the access to `runningTokens` thread-safe
+
+- (void)removeToken:(nonnull SDWebImagePrefetchToken *)token;
 
 @end
 
@@ -39,8 +91,11 @@
 - (nonnull instancetype)initWithImageManager:(SDWebImageManager *)manager {
     if ((self = [super init])) {
         _manager = manager;
+        _runningTokens = [NSMutableSet new];
+        _runningTokensLock = dispatch_semaphore_create(1);
         _options = SDWebImageLowPriority;
         _prefetcherQueue = dispatch_get_main_queue();
+        _maxConcurrentPrefetches = 8;
         self.maxConcurrentDownloads = 3;
     }
     return self;
@@ -54,91 +109,215 @@
     return self.manager.imageDownloader.maxConcurrentDownloads;
 }
 
-- (void)startPrefetchingAtIndex:(NSUInteger)index {
-    NSURL *currentURL;
-    @synchronized(self) {
-        if (index >= self.prefetchURLs.count) return;
-        currentURL = self.prefetchURLs[index];
-        self.requestedCount++;
+#pragma mark - Prefetch
+
+- (void)prefetchURLs:(nullable NSArray<NSURL *> *)urls {
+    [self prefetchURLs:urls progress:nil completed:nil];
+}
+
+- (void)prefetchURLs:(nullable NSArray<NSURL *> *)urls
+            progress:(nullable SDWebImagePrefetcherProgressBlock)progressBlock
+           completed:(nullable SDWebImagePrefetcherCompletionBlock)completionBlock {
+    [self cancelPrefetching]; // Prevent duplicate prefetch request
+    [self prefetchURLs:urls prefetcherOptions:0 progress:progressBlock completed:completionBlock];
+}
+
+- (nullable SDWebImagePrefetchToken *)prefetchURLs:(nullable NSArray<NSURL *> *)urls
+                                 prefetcherOptions:(SDWebImagePrefetcherOptions)prefetcherOptions
+                                          progress:(nullable SDWebImagePrefetcherProgressBlock)progressBlock
+                                         completed:(nullable SDWebImagePrefetcherCompletionBlock)completionBlock {
+    if (urls.count == 0) {
+        if (completionBlock) {
+            completionBlock(0, 0);
+        }
+        return nil;
+    }
+    
+    SDWebImagePrefetchToken *token = [SDWebImagePrefetchToken new];
+    token.prefetcher = self;
+    token.urls = urls;
+    token.prefetcherOptions = prefetcherOptions;
+    token.progressBlock = progressBlock;
+    token.completionBlock = completionBlock;
+    LOCK(self.runningTokensLock);
+    [self.runningTokens addObject:token];
+    UNLOCK(self.runningTokensLock);
+    
+    // Starts prefetching from the very first image on the list with the max allowed concurrency
+    [self startPrefetchingWithToken:token];
+    return token;
+}
+
+// wwt 滑动窗口：一个URL完成后马上开始下一个，同时进行的URL数不超过maxConcurrentPrefetches
+// Start the URLs until the window is full. Only one thread starts the URLs at a time, the others just leave after updating the counters, so this never recurses
+- (void)startPrefetchingWithToken:(SDWebImagePrefetchToken *)token {
+    NSUInteger maxConcurrentPrefetches = MAX(self.maxConcurrentPrefetches, 1);
+    LOCK(token.lock);
+    if (token.isLaunching) {
+        UNLOCK(token.lock);
+        return;
+    }
+    token.launching = YES;
+    while (!token.isCancelled && token.runningCount < maxConcurrentPrefetches && token.nextIndex < token.urls.count) {
+        NSUInteger index = token.nextIndex;
+        token.nextIndex++;
+        token.runningCount++;
+        token.operations[@(index)] = [NSNull null];
+        UNLOCK(token.lock);
+        [self prefetchURLAtIndex:index token:token];
+        LOCK(token.lock);
     }
-    [self.manager loadImageWithURL:currentURL options:self.options progress:nil completed:^(UIImage *image, NSData *data, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
-        if (!finished) return;
-        self.finishedCount++;
+    token.launching = NO;
+    UNLOCK(token.lock);
+}
 
-        if (self.progressBlock) {
-            self.progressBlock(self.finishedCount,(self.prefetchURLs).count);
+- (void)prefetchURLAtIndex:(NSUInteger)index token:(SDWebImagePrefetchToken *)token {
+    NSURL *url = token.urls[index];
+    if (![url isKindOfClass:[NSURL class]]) {
+        [self finishURLAtIndex:index token:token succeeded:NO];
+        return;
+    }
+    LOCK(token.lock);
+    BOOL duplicated = [token.startedURLs containsObject:url];
+    [token.startedURLs addObject:url];
+    UNLOCK(token.lock);
+    if (duplicated) {
+        [self finishURLAtIndex:index token:token succeeded:YES];
+        return;
+    }
+    
+    // check the cache out of caller's queue
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+        if (token.isCancelled) {
+            return;
+        }
+        SDImageCache *imageCache = self.manager.imageCache;
+        NSString *key = [self.manager cacheKeyForURL:url];
+        id<SDWebImageOperation> operation;
+        
+        if (token.prefetcherOptions & SDWebImagePrefetcherWarmDiskOnly) {
+            if ([imageCache diskImageDataExistsWithKey:key]) {
+                [self finishURLAtIndex:index token:token succeeded:YES];
+                return;
+            }
+            operation = [self.manager.imageDownloader downloadImageWithURL:url options:[self downloaderOptions] progress:nil completed:^(UIImage * _Nullable image, NSData * _Nullable data, NSError * _Nullable error, BOOL finished) {
+                if (!finished) {
+                    return;
+                }
+                BOOL succeeded = (data && !error);
+                if (succeeded) {
+                    [imageCache storeImageDataToDisk:data forKey:key];
+                }
+                [self finishURLAtIndex:index token:token succeeded:succeeded];
+            }];
+        } else {
+            if ([imageCache imageFromMemoryCacheForKey:key]) {
+                [self finishURLAtIndex:index token:token succeeded:YES];
+                return;
+            }
+            operation = [self.manager loadImageWithURL:url options:self.options progress:nil completed:^(UIImage *image, NSData *data, NSError *error, SDImageCacheType cacheType, BOOL finished, NSURL *imageURL) {
+                if (!finished) {
+                    return;
+                }
+                [self finishURLAtIndex:index token:token succeeded:(image != nil)];
+            }];
+        }
+        
+        LOCK(token.lock);
+        BOOL shouldCancel = token.isCancelled;
+        if (!shouldCancel && token.operations[@(index)] && operation) {
+            // not finished yet
+            token.operations[@(index)] = operation;
         }
-        if (!image) {
-            // Add last failed
-            self.skippedCount++;
+        UNLOCK(token.lock);
+        if (shouldCancel) {
+            [operation cancel];
+        }
+    });
+}
+
+- (void)finishURLAtIndex:(NSUInteger)index token:(SDWebImagePrefetchToken *)token succeeded:(BOOL)succeeded {
+    LOCK(token.lock);
+    if (token.isCancelled) {
+        UNLOCK(token.lock);
+        return;
+    }
+    [token.operations removeObjectForKey:@(index)];
+    token.runningCount--;
+    token.finishedCount++;
+    if (!succeeded) {
+        // Add last failed
+        token.skippedCount++;
+    }
+    NSUInteger finishedCount = token.finishedCount;
+    NSUInteger skippedCount = token.skippedCount;
+    NSUInteger totalCount = token.urls.count;
+    UNLOCK(token.lock);
+    
+    BOOL batchFinished = (finishedCount == totalCount);
+    NSURL *url = token.urls[index];
+    dispatch_async(self.prefetcherQueue, ^{
+        if (token.isCancelled) {
+            return;
+        }
+        if (token.progressBlock) {
+            token.progressBlock(finishedCount, totalCount);
         }
         if ([self.delegate respondsToSelector:@selector(imagePrefetcher:didPrefetchURL:finishedCount:totalCount:)]) {
             [self.delegate imagePrefetcher:self
-                            didPrefetchURL:currentURL
-                             finishedCount:self.finishedCount
-                                totalCount:self.prefetchURLs.count
+                            didPrefetchURL:url
+                             finishedCount:finishedCount
+                                totalCount:totalCount
              ];
         }
-        if (self.prefetchURLs.count > self.requestedCount) {
-            dispatch_async(self.prefetcherQueue, ^{
-                // we need dispatch to avoid function recursion call. This can prevent stack overflow even for huge urls list
-                [self startPrefetchingAtIndex:self.requestedCount];
-            });
-        } else if (self.finishedCount == self.requestedCount) {
-            [self reportStatus];
-            if (self.completionBlock) {
-                self.completionBlock(self.finishedCount, self.skippedCount);
-                self.completionBlock = nil;
+        if (batchFinished) {
+            if ([self.delegate respondsToSelector:@selector(imagePrefetcher:didFinishWithTotalCount:skippedCount:)]) {
+                [self.delegate imagePrefetcher:self
+                       didFinishWithTotalCount:(totalCount - skippedCount)
+                                  skippedCount:skippedCount
+                 ];
             }
-            self.progressBlock = nil;
+            if (token.completionBlock) {
+                token.completionBlock(finishedCount, skippedCount);
+            }
+            [self removeToken:token];
         }
-    }];
-}
-
-- (void)reportStatus {
-    NSUInteger total = (self.prefetchURLs).count;
-    if ([self.delegate respondsToSelector:@selector(imagePrefetcher:didFinishWithTotalCount:skippedCount:)]) {
-        [self.delegate imagePrefetcher:self
-               didFinishWithTotalCount:(total - self.skippedCount)
-                          skippedCount:self.skippedCount
-         ];
+    });
+    
+    if (!batchFinished) {
+        [self startPrefetchingWithToken:token];
     }
 }
 
-- (void)prefetchURLs:(nullable NSArray<NSURL *> *)urls {
-    [self prefetchURLs:urls progress:nil completed:nil];
+// The downloader options used by `SDWebImagePrefetcherWarmDiskOnly`, the same as what `SDWebImageManager` does for `options`
+- (SDWebImageDownloaderOptions)downloaderOptions {
+    SDWebImageOptions options = self.options;
+    SDWebImageDownloaderOptions downloaderOptions = SDWebImageDownloaderSkipDecoding;
+    if (options & SDWebImageLowPriority) downloaderOptions |= SDWebImageDownloaderLowPriority;
+    if (options & SDWebImageHighPriority) downloaderOptions |= SDWebImageDownloaderHighPriority;
+    if (options & SDWebImageContinueInBackground) downloaderOptions |= SDWebImageDownloaderContinueInBackground;
+    if (options & SDWebImageHandleCookies) downloaderOptions |= SDWebImageDownloaderHandleCookies;
+    if (options & SDWebImageAllowInvalidSSLCertificates) downloaderOptions |= SDWebImageDownloaderAllowInvalidSSLCertificates;
+    return downloaderOptions;
 }
 
-- (void)prefetchURLs:(nullable NSArray<NSURL *> *)urls
-            progress:(nullable SDWebImagePrefetcherProgressBlock)progressBlock
-           completed:(nullable SDWebImagePrefetcherCompletionBlock)completionBlock {
-    [self cancelPrefetching]; // Prevent duplicate prefetch request
-    self.startedTime = CFAbsoluteTimeGetCurrent();
-    self.prefetchURLs = urls;
-    self.completionBlock = completionBlock;
-    self.progressBlock = progressBlock;
+#pragma mark - Cancel
 
-    if (urls.count == 0) {
-        if (completionBlock) {
-            completionBlock(0,0);
-        }
-    } else {
-        // Starts prefetching from the very first image on the list with the max allowed concurrency
-        NSUInteger listCount = self.prefetchURLs.count;
-        for (NSUInteger i = 0; i < self.maxConcurrentDownloads && self.requestedCount < listCount; i++) {
-            [self startPrefetchingAtIndex:i];
-        }
-    }
+- (void)removeToken:(nonnull SDWebImagePrefetchToken *)token {
+    LOCK(self.runningTokensLock);
+    [self.runningTokens removeObject:token];
+    UNLOCK(self.runningTokensLock);
 }
 
 - (void)cancelPrefetching {
-    @synchronized(self) {
-        self.prefetchURLs = nil;
-        self.skippedCount = 0;
-        self.requestedCount = 0;
-        self.finishedCount = 0;
+    LOCK(self.runningTokensLock);
+    NSArray<SDWebImagePrefetchToken *> *tokens = self.runningTokens.allObjects;
+    [self.runningTokens removeAllObjects];
+    UNLOCK(self.runningTokensLock);
+    
+    for (SDWebImagePrefetchToken *token in tokens) {
+        [token cancel];
     }
-    [self.manager cancelAll];
 }
 
 @end
@@ -24,6 +24,144 @@
 #import "webp/mux.h"
 #endif
 
+@interface SDWebImageWebPCoder ()
+
+- (nullable UIImage *)sd_drawnWebpImageWithCanvas:(CGContextRef)canvas iterator:(WebPIterator)iter;
+
+@end
+
+#if SD_UIKIT
+
+#define LOCK(lock) dispatch_semaphore_wait(lock, DISPATCH_TIME_FOREVER);
+#define UNLOCK(lock) dispatch_semaphore_signal(lock);
+
+// wwt 持有WebP压缩数据和WebPDemuxer，按需解码帧
+// The frames are drawn on the canvas one by one like the coder does, so decoding frames in order is cheap, and going backward restarts from the first frame
+@interface SDWebImageWebPFrameProvider : NSObject <SDWebImageAnimatedImageProvider>
+
+- (nullable instancetype)initWithData:(NSData *)data;
+
+@end
+
+@implementation SDWebImageWebPFrameProvider {
+    WebPDemuxer *_demuxer;
+    CGContextRef _canvas;
+    NSUInteger _canvasIndex; // the last frame drawn on canvas, NSNotFound for none
+    NSArray<NSNumber *> *_durations;
+    dispatch_semaphore_t _lock;
+}
+
+@synthesize animatedImageData = _animatedImageData;
+@synthesize animatedImageLoopCount = _animatedImageLoopCount;
+
+- (instancetype)initWithData:(NSData *)data {
+    self = [super init];
+    if (self) {
+        // the demuxer does not copy the bytes, keep the data
+        _animatedImageData = [data copy];
+        WebPData webpData;
+        WebPDataInit(&webpData);
+        webpData.bytes = _animatedImageData.bytes;
+        webpData.size = _animatedImageData.length;
+        _demuxer = WebPDemux(&webpData);
+        if (!_demuxer) {
+            return nil;
+        }
+        
+        uint32_t flags = WebPDemuxGetI(_demuxer, WEBP_FF_FORMAT_FLAGS);
+        int canvasWidth = WebPDemuxGetI(_demuxer, WEBP_FF_CANVAS_WIDTH);
+        int canvasHeight = WebPDemuxGetI(_demuxer, WEBP_FF_CANVAS_HEIGHT);
+        CGBitmapInfo bitmapInfo;
+        if (!(flags & ALPHA_FLAG)) {
+            bitmapInfo = kCGBitmapByteOrder32Big | kCGImageAlphaNoneSkipLast;
+        } else {
+            bitmapInfo = kCGBitmapByteOrder32Big | kCGImageAlphaPremultipliedLast;
+        }
+        _canvas = CGBitmapContextCreate(NULL, canvasWidth, canvasHeight, 8, 0, SDCGColorSpaceGetDeviceRGB(), bitmapInfo);
+        if (!_canvas) {
+            return nil;
+        }
+        
+        NSMutableArray<NSNumber *> *durations = [NSMutableArray array];
+        WebPIterator iter;
+        if (WebPDemuxGetFrame(_demuxer, 1, &iter)) {
+            do {
+                int duration = iter.duration;
+                if (duration <= 10) {
+                    // same as the coder, see `decodedImageWithData:`
+                    duration = 100;
+                }
+                [durations addObject:@(duration / 1000.f)];
+            } while (WebPDemuxNextFrame(&iter));
+        }
+        WebPDemuxReleaseIterator(&iter);
+        
+        _durations = [durations copy];
+        _animatedImageLoopCount = WebPDemuxGetI(_demuxer, WEBP_FF_LOOP_COUNT);
+        _canvasIndex = NSNotFound;
+        _lock = dispatch_semaphore_create(1);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_demuxer) {
+        WebPDemuxDelete(_demuxer);
+        _demuxer = NULL;
+    }
+    if (_canvas) {
+        CGContextRelease(_canvas);
+        _canvas = NULL;
+    }
+}
+
+- (NSUInteger)animatedImageFrameCount {
+    return _durations.count;
+}
+
+- (NSTimeInterval)animatedImageDurationAtIndex:(NSUInteger)index {
+    if (index >= _durations.count) {
+        return 0;
+    }
+    return _durations[index].doubleValue;
+}
+
+- (UIImage *)animatedImageFrameAtIndex:(NSUInteger)index {
+    if (index >= _durations.count) {
+        return nil;
+    }
+    
+    UIImage *image;
+    LOCK(_lock);
+    NSUInteger startIndex;
+    if (_canvasIndex == NSNotFound || index <= _canvasIndex) {
+        // restart from the first frame
+        CGContextClearRect(_canvas, CGRectMake(0, 0, CGBitmapContextGetWidth(_canvas), CGBitmapContextGetHeight(_canvas)));
+        _canvasIndex = NSNotFound;
+        startIndex = 0;
+    } else {
+        startIndex = _canvasIndex + 1;
+    }
+    WebPIterator iter;
+    // frame number of iterator starts from 1
+    if (WebPDemuxGetFrame(_demuxer, (int)startIndex + 1, &iter)) {
+        do {
+            @autoreleasepool {
+                image = [[SDWebImageWebPCoder sharedCoder] sd_drawnWebpImageWithCanvas:_canvas iterator:iter];
+            }
+            _canvasIndex = iter.frame_num - 1;
+        } while (_canvasIndex < index && WebPDemuxNextFrame(&iter));
+    }
+    WebPDemuxReleaseIterator(&iter);
+    UNLOCK(_lock);
+    
+    return image;
+}
+
+@end
+
+#endif
+
 @implementation SDWebImageWebPCoder {
     WebPIDecoder *_idec;
 }
@@ -71,7 +209,6 @@
     }
     
     uint32_t flags = WebPDemuxGetI(demuxer, WEBP_FF_FORMAT_FLAGS);
-    int loopCount = WebPDemuxGetI(demuxer, WEBP_FF_LOOP_COUNT);
     int canvasWidth = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_WIDTH);
     int canvasHeight = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_HEIGHT);
     CGBitmapInfo bitmapInfo;
@@ -108,7 +245,19 @@
         return staticImage;
     }
     
+#if SD_UIKIT
+    // wwt 只保留压缩数据，帧在播放时按需解码
+    // Keep the compressed data only, the frames are decoded on demand when played
+    WebPDemuxDelete(demuxer);
+    CGContextRelease(canvas);
+    SDWebImageWebPFrameProvider *provider = [[SDWebImageWebPFrameProvider alloc] initWithData:data];
+    if (!provider) {
+        return nil;
+    }
+    return [[SDWebImageAnimatedImage alloc] initWithProvider:provider scale:1];
+#else
     // for animated webp image
+    int loopCount = WebPDemuxGetI(demuxer, WEBP_FF_LOOP_COUNT);
     WebPIterator iter;
     if (!WebPDemuxGetFrame(demuxer, 1, &iter)) {
         WebPDemuxReleaseIterator(&iter);
@@ -146,6 +295,7 @@
     animatedImage.sd_imageLoopCount = loopCount;
     
     return animatedImage;
+#endif
 }
 
 - (UIImage *)incrementallyDecodedImageWithData:(NSData *)data finished:(BOOL)finished {
@@ -329,6 +479,16 @@
     
     NSData *data;
     
+#if SD_UIKIT
+    // the image decoded by this coder keeps the original data, do not encode the frames again
+    if ([image isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        NSData *animatedImageData = ((SDWebImageAnimatedImage *)image).animatedImageData;
+        if ([NSData sd_imageFormatForImageData:animatedImageData] == SDImageFormatWebP) {
+            return animatedImageData;
+        }
+    }
+#endif
+    
     NSArray<SDWebImageFrame *> *frames = [SDWebImageCoderHelper framesFromAnimatedImage:image];
     if (frames.count == 0) {
         // for static single webp image
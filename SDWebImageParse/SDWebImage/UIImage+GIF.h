@@ -13,12 +13,12 @@
 
 /**
  *  Creates an animated UIImage from an NSData.
- *  For static GIF, will create an UIImage with `images` array set to nil. For animated GIF, will create an UIImage with valid `images` array.
+ *  For static GIF, will create an UIImage with `images` array set to nil. For animated GIF, will create an UIImage with valid `images` array (on iOS/tvOS, a `SDWebImageAnimatedImage` which keeps each frame's own duration instead).
  */
 + (UIImage *)sd_animatedGIFWithData:(NSData *)data;
 
 /**
- *  Checks if an UIImage instance is a GIF. Will use the `images` array.
+ *  Checks if an UIImage instance is a GIF. Will use `sd_isAnimated`.
  */
 - (BOOL)isGIF;
 
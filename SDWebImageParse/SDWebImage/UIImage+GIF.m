@@ -10,6 +10,7 @@
 #import "UIImage+GIF.h"
 #import "SDWebImageGIFCoder.h"
 #import "NSImage+WebCache.h"
+#import "UIImage+MultiFormat.h"
 
 @implementation UIImage (GIF)
 
@@ -21,7 +22,7 @@
 }
 
 - (BOOL)isGIF {
-    return (self.images != nil);
+    return self.sd_isAnimated;
 }
 
 @end
@@ -23,6 +23,14 @@
  */
 @property (nonatomic, assign) NSUInteger sd_imageLoopCount;
 
+/**
+ * Whether the image has more than one frame.
+ * UIKit: `images` is not nil, or the image is a `SDWebImageAnimatedImage` created by `SDWebImageCoderHelper`, which does not use `images` to keep its frames.
+ * AppKit: the GIF imageRep has more than one frame.
+ * wwt 是否为动图，UIKit下的SDWebImageAnimatedImage没有images，需要使用该属性判断
+ */
+@property (nonatomic, assign, readonly) BOOL sd_isAnimated;
+
 + (nullable UIImage *)sd_imageWithData:(nullable NSData *)data;
 - (nullable NSData *)sd_imageData;
 - (nullable NSData *)sd_imageDataAsFormat:(SDImageFormat)imageFormat;
@@ -10,6 +10,7 @@
 
 #import "objc/runtime.h"
 #import "SDWebImageCodersManager.h"
+#import "SDWebImageCoderHelper.h"
 
 @implementation UIImage (MultiFormat)
 
@@ -36,6 +37,16 @@
     }
 }
 
+- (BOOL)sd_isAnimated {
+    for (NSImageRep *rep in self.representations) {
+        if ([rep isKindOfClass:[NSBitmapImageRep class]]) {
+            NSBitmapImageRep *bitmapRep = (NSBitmapImageRep *)rep;
+            return [[bitmapRep valueForProperty:NSImageFrameCount] unsignedIntegerValue] > 1;
+        }
+    }
+    return NO;
+}
+
 #else
 
 - (NSUInteger)sd_imageLoopCount {
@@ -51,6 +62,15 @@
     NSNumber *value = @(sd_imageLoopCount);
     objc_setAssociatedObject(self, @selector(sd_imageLoopCount), value, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
 }
+
+- (BOOL)sd_isAnimated {
+#if SD_UIKIT
+    if ([self isKindOfClass:[SDWebImageAnimatedImage class]]) {
+        return YES;
+    }
+#endif
+    return self.images != nil;
+}
 #endif
 
 + (nullable UIImage *)sd_imageWithData:(nullable NSData *)data {
@@ -181,6 +181,18 @@
 
 #if SD_UIKIT
 
+#pragma mark - Animated image
+
+/**
+ * Set the image, and play it if it's a `SDWebImageAnimatedImage`, each frame is displayed with its own duration and the loop count is `sd_imageLoopCount`.
+ * The frames are decoded on demand, the playback stops when another image is set, and pauses when the view is not in a window.
+ * `sd_setImageWithURL:` uses this method to set the image.
+ * wwt 设置图片，如果是SDWebImageAnimatedImage则按每帧自己的时长播放
+ *
+ * @param image The image, or nil to clear it
+ */
+- (void)sd_setAnimatedImage:(nullable UIImage *)image;
+
 #pragma mark - Animation of multiple images
 
 /**
@@ -13,6 +13,156 @@
 #import "objc/runtime.h"
 #import "UIView+WebCacheOperation.h"
 #import "UIView+WebCache.h"
+#import "UIImage+MultiFormat.h"
+#import "SDWebImageCoderHelper.h"
+
+#if SD_UIKIT
+
+@class SDAnimatedImagePlayer;
+
+// wwt 添加到图片视图上的隐藏视图，图片视图移入/移出窗口时暂停或恢复播放
+// A hidden subview of the image view, its `didMoveToWindow` is called when the image view (or any superview) moves in or out of a window.
+// It is released with the image view, and stops the player then, because a paused display link never steps to find the image view is gone
+@interface SDAnimatedImagePlayerWindowObserver : UIView
+
+@property (nonatomic, weak) SDAnimatedImagePlayer *player;
+
+@end
+
+// wwt 按每帧的时长播放SDWebImageAnimatedImage，已解码的帧保存在播放者自己的帧缓存中
+// The display link retains the player, the player is stopped once the image view is released or its image is replaced
+@interface SDAnimatedImagePlayer : NSObject
+
+@property (nonatomic, weak) UIImageView *imageView;
+@property (nonatomic, strong) SDWebImageAnimatedImage *animatedImage;
+@property (nonatomic, strong) SDWebImageAnimatedImageFrameBuffer *frameBuffer;
+@property (nonatomic, weak) SDAnimatedImagePlayerWindowObserver *windowObserver; // owned by the image view
+@property (nonatomic, strong) CADisplayLink *displayLink;
+@property (nonatomic, strong) UIImage *currentFrame; // the image set on image view by player
+@property (nonatomic, assign) NSUInteger currentIndex;
+@property (nonatomic, assign) NSUInteger currentLoop;
+@property (nonatomic, assign) NSTimeInterval currentTime; // time elapsed of current frame
+@property (nonatomic, assign) CFTimeInterval lastTimestamp; // timestamp of last step, 0 after start or resume
+
+- (instancetype)initWithImageView:(UIImageView *)imageView animatedImage:(SDWebImageAnimatedImage *)animatedImage;
+- (void)start;
+- (void)stop;
+- (void)windowDidChange;
+
+@end
+
+@implementation SDAnimatedImagePlayerWindowObserver
+
+- (void)didMoveToWindow {
+    [super didMoveToWindow];
+    [self.player windowDidChange];
+}
+
+- (void)dealloc {
+    [_player stop];
+}
+
+@end
+
+@implementation SDAnimatedImagePlayer
+
+- (instancetype)initWithImageView:(UIImageView *)imageView animatedImage:(SDWebImageAnimatedImage *)animatedImage {
+    self = [super init];
+    if (self) {
+        _imageView = imageView;
+        _animatedImage = animatedImage;
+        _frameBuffer = [[SDWebImageAnimatedImageFrameBuffer alloc] initWithAnimatedImage:animatedImage];
+        // the image view plays `images` of the animated image itself, so it shows the static first frame instead
+        _currentFrame = [[UIImage alloc] initWithCGImage:animatedImage.CGImage scale:animatedImage.scale orientation:animatedImage.imageOrientation];
+    }
+    return self;
+}
+
+- (void)start {
+    if (self.displayLink) {
+        return;
+    }
+    // start decoding the following frames
+    [self.frameBuffer frameAtIndex:0 decodeIfNeeded:NO];
+    self.displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(step:)];
+    [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    
+    SDAnimatedImagePlayerWindowObserver *windowObserver = [[SDAnimatedImagePlayerWindowObserver alloc] initWithFrame:CGRectZero];
+    windowObserver.hidden = YES;
+    windowObserver.userInteractionEnabled = NO;
+    windowObserver.player = self;
+    self.windowObserver = windowObserver;
+    [self.imageView addSubview:windowObserver];
+    [self windowDidChange];
+}
+
+- (void)stop {
+    [self.displayLink invalidate];
+    self.displayLink = nil;
+    self.windowObserver.player = nil;
+    [self.windowObserver removeFromSuperview];
+    self.windowObserver = nil;
+    // the frames belong to this player, the image shared by memory cache and other views is not touched
+    [self.frameBuffer clear];
+}
+
+// do not step when the image view is not in a window, and do not count the time off screen
+- (void)windowDidChange {
+    BOOL paused = !self.imageView.window;
+    if (self.displayLink.paused != paused) {
+        self.displayLink.paused = paused;
+        self.lastTimestamp = 0;
+    }
+}
+
+- (void)step:(CADisplayLink *)displayLink {
+    UIImageView *imageView = self.imageView;
+    if (!imageView || imageView.image != self.currentFrame) {
+        [self stop];
+        return;
+    }
+    if (!imageView.window) {
+        [self windowDidChange];
+        return;
+    }
+    
+    // advance by the time elapsed since last step, the display link may skip frames or run at a variable rate
+    CFTimeInterval timestamp = displayLink.timestamp;
+    NSTimeInterval elapsed = self.lastTimestamp > 0 ? MAX(timestamp - self.lastTimestamp, 0) : 0;
+    self.lastTimestamp = timestamp;
+    
+    SDWebImageAnimatedImage *animatedImage = self.animatedImage;
+    NSTimeInterval duration = [animatedImage animatedImageDurationAtIndex:self.currentIndex];
+    self.currentTime += elapsed;
+    if (self.currentTime < duration) {
+        return;
+    }
+    
+    NSUInteger nextIndex = (self.currentIndex + 1) % animatedImage.animatedImageFrameCount;
+    UIImage *nextFrame = [self.frameBuffer frameAtIndex:nextIndex decodeIfNeeded:NO];
+    if (!nextFrame) {
+        // the next frame is still decoding, keep current frame
+        return;
+    }
+    if (nextIndex == 0) {
+        self.currentLoop++;
+        NSUInteger loopCount = animatedImage.sd_imageLoopCount;
+        if (loopCount > 0 && self.currentLoop >= loopCount) {
+            [self stop];
+            return;
+        }
+    }
+    
+    // do not catch up the frames skipped, just like UIImageView animation
+    self.currentTime = MIN(self.currentTime - duration, [animatedImage animatedImageDurationAtIndex:nextIndex]);
+    self.currentIndex = nextIndex;
+    self.currentFrame = nextFrame;
+    imageView.image = nextFrame;
+}
+
+@end
+
+#endif
 
 @implementation UIImageView (WebCache)
 
@@ -67,6 +217,26 @@
 
 #if SD_UIKIT
 
+#pragma mark - Animated image
+
+static char animatedImagePlayerKey;
+
+- (void)sd_setAnimatedImage:(nullable UIImage *)image {
+    SDAnimatedImagePlayer *player = objc_getAssociatedObject(self, &animatedImagePlayerKey);
+    [player stop];
+    objc_setAssociatedObject(self, &animatedImagePlayerKey, nil, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    
+    if (![image isKindOfClass:[SDWebImageAnimatedImage class]] || ((SDWebImageAnimatedImage *)image).animatedImageFrameCount <= 1) {
+        self.image = image;
+        return;
+    }
+    SDWebImageAnimatedImage *animatedImage = (SDWebImageAnimatedImage *)image;
+    player = [[SDAnimatedImagePlayer alloc] initWithImageView:self animatedImage:animatedImage];
+    self.image = player.currentFrame;
+    objc_setAssociatedObject(self, &animatedImagePlayerKey, player, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    [player start];
+}
+
 #pragma mark - Animation of multiple images
 
 - (void)sd_setAnimationImagesWithURLs:(nonnull NSArray<NSURL *> *)arrayOfURLs {
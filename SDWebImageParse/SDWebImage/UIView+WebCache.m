@@ -12,6 +12,7 @@
 
 #import "objc/runtime.h"
 #import "UIView+WebCacheOperation.h"
+#import "UIImageView+WebCache.h"
 
 NSString * const SDWebImageInternalSetImageGroupKey = @"internalSetImageGroup";
 NSString * const SDWebImageExternalCustomManagerKey = @"externalCustomManager";
@@ -196,7 +197,11 @@ static char TAG_ACTIVITY_SHOW;
     else if ([view isKindOfClass:[UIImageView class]]) {
         UIImageView *imageView = (UIImageView *)view;
         finalSetImageBlock = ^(UIImage *setImage, NSData *setImageData) {
+#if SD_UIKIT
+            [imageView sd_setAnimatedImage:setImage];
+#else
             imageView.image = setImage;
+#endif
         };
     }
 #endif
@@ -0,0 +1,48 @@
+//
+//  SDWebImageBenchmark.h
+//  SDWebImageParse
+//
+//  Copyright © 2018年 dreamdreamdream. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * wwt 启动参数中的性能测试名称，例如 -SDWebImageBenchmark DiskCleanup
+ * The launch argument that names the benchmark to run, e.g. `-SDWebImageBenchmark DiskCleanup`
+ */
+FOUNDATION_EXPORT NSString * const SDWebImageBenchmarkArgument;
+
+typedef void(^SDWebImageBenchmarkCompletionBlock)(BOOL passed, NSString * _Nonnull report);
+
+/**
+ * wwt 图片加载各个环节的性能测试，UI测试通过启动参数运行，结果显示在界面上
+ * Benchmarks of the cache, decode and download paths. The UI tests launch the app
+ * with `SDWebImageBenchmarkArgument` and wait for the result label, which starts with
+ * "PASS" or "FAIL" followed by the measured numbers.
+ *
+ * A benchmark named `Foo` is the method `- (void)benchmarkFoo` of this class. It runs
+ * on a background queue with an empty work directory and fails by `expect` checks.
+ */
+@interface SDWebImageBenchmark : NSObject
+
+/**
+ * wwt 启动参数中的性能测试名称，正常启动时为nil
+ * The benchmark named in the launch arguments, nil if the app is launched normally
+ */
++ (nullable NSString *)benchmarkNameFromLaunchArguments;
+
+/**
+ * wwt 在后台运行性能测试，完成后在主线程回调
+ * Runs the benchmark in background, the completion block is called on the main queue
+ *
+ * @param name       The benchmark name
+ * @param completion A block called with whether all the checks passed and the report
+ */
++ (void)runBenchmarkNamed:(nonnull NSString *)name completion:(nonnull SDWebImageBenchmarkCompletionBlock)completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
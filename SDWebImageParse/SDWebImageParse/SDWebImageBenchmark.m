@@ -0,0 +1,1687 @@
+//
+//  SDWebImageBenchmark.m
+//  SDWebImageParse
+//
+//  Copyright © 2018年 dreamdreamdream. All rights reserved.
+//
+
+#import "SDWebImageBenchmark.h"
+#import <QuartzCore/QuartzCore.h>
+#import <ImageIO/ImageIO.h>
+#import <MobileCoreServices/MobileCoreServices.h>
+#import <mach/mach.h>
+#import <sys/socket.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/resource.h>
+#import "SDImageCache.h"
+#import "NSData+ImageContentType.h"
+#import "SDWebImageCodersManager.h"
+#import "SDWebImageDownloader.h"
+#import "SDWebImageManager.h"
+#import "SDWebImagePrefetcher.h"
+#import "SDWebImageCoderHelper.h"
+#import "SDWebImageFrame.h"
+#import "SDWebImageGIFCoder.h"
+#import "SDWebImageImageIOCoder.h"
+#import "UIImageView+WebCache.h"
+
+NSString * const SDWebImageBenchmarkArgument = @"SDWebImageBenchmark";
+
+static inline CFTimeInterval SDBenchmarkNow(void) {
+    return CACurrentMediaTime();
+}
+
+static inline double SDBenchmarkMB(uint64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// wwt 进程占用的物理内存(phys_footprint)，与Xcode内存仪表显示的一致
+// The physical footprint of the process, the number shown by the Xcode memory gauge
+static uint64_t SDBenchmarkFootprint(void) {
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.phys_footprint;
+}
+
+// wwt 排序后取百分位数
+static double SDBenchmarkPercentile(NSArray<NSNumber *> *samples, double percentile) {
+    if (samples.count == 0) {
+        return 0;
+    }
+    NSArray<NSNumber *> *sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+    NSUInteger index = MIN((NSUInteger)(percentile * sorted.count), sorted.count - 1);
+    return sorted[index].doubleValue;
+}
+
+// wwt 同步等待异步操作完成，完成回调通常在主线程，所以不能在主线程调用
+// Waits until the block calls `done`. Completion blocks are usually called on the main queue, so never call it on main
+static void SDBenchmarkWait(void (^block)(dispatch_block_t done)) {
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    block(^{
+        dispatch_semaphore_signal(semaphore);
+    });
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+/**
+ * wwt 后台定时采样内存占用，记录相对开始时的峰值
+ * Samples the footprint every 2ms in background and keeps the peak above the footprint at start
+ */
+@interface SDBenchmarkMemorySampler : NSObject
+
+- (void)start;
+// the peak footprint growth since start, in bytes
+- (uint64_t)stop;
+
+@end
+
+@implementation SDBenchmarkMemorySampler {
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    uint64_t _baseline;
+    uint64_t _peak;
+}
+
+- (void)start {
+    _queue = dispatch_queue_create("com.hackemist.SDWebImageBenchmark.memory", DISPATCH_QUEUE_SERIAL);
+    _baseline = SDBenchmarkFootprint();
+    _peak = _baseline;
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_NOW, 2 * NSEC_PER_MSEC, NSEC_PER_MSEC);
+    __unsafe_unretained SDBenchmarkMemorySampler *sampler = self; // the timer is cancelled in stop
+    dispatch_source_set_event_handler(_timer, ^{
+        sampler->_peak = MAX(sampler->_peak, SDBenchmarkFootprint());
+    });
+    dispatch_resume(_timer);
+}
+
+- (uint64_t)stop {
+    dispatch_source_cancel(_timer);
+    __block uint64_t peak = 0;
+    dispatch_sync(_queue, ^{
+        _peak = MAX(_peak, SDBenchmarkFootprint());
+        peak = _peak;
+    });
+    _timer = nil;
+    return peak > _baseline ? peak - _baseline : 0;
+}
+
+@end
+
+/**
+ * wwt 本地HTTP测试服务器，每个请求延迟一段时间后返回同样的图片数据
+ * A local HTTP server on 127.0.0.1. Every request is answered after `latency` with the same image data,
+ * one connection per request.
+ */
+@interface SDBenchmarkHTTPServer : NSObject
+
+@property (assign, nonatomic, readonly) uint16_t port;
+// the number of requests answered
+@property (assign, atomic, readonly) NSUInteger requestCount;
+// wwt 同时处理中的请求数的最大值，置0重新统计
+// the most requests in flight at once, set it to 0 to start over
+@property (assign, atomic) NSUInteger peakRequestCount;
+// wwt 分块发送响应体，模拟慢速网络，默认0一次发送
+// the response body is written `chunkSize` bytes every `chunkInterval`, 0 writes it at once
+@property (assign, nonatomic) NSUInteger chunkSize;
+@property (assign, nonatomic) NSTimeInterval chunkInterval;
+
+- (nullable instancetype)initWithResponseData:(nonnull NSData *)data latency:(NSTimeInterval)latency;
+- (nonnull NSURL *)URLForPath:(nonnull NSString *)path;
+- (void)stop;
+
+@end
+
+@interface SDBenchmarkHTTPServer ()
+
+@property (assign, atomic, readwrite) NSUInteger requestCount;
+
+@end
+
+@implementation SDBenchmarkHTTPServer {
+    NSData *_responseData;
+    NSUInteger _activeRequestCount;
+    NSTimeInterval _latency;
+    int _socket;
+    dispatch_source_t _acceptSource;
+    dispatch_queue_t _connectionQueue;
+}
+
+- (nullable instancetype)initWithResponseData:(nonnull NSData *)data latency:(NSTimeInterval)latency {
+    if ((self = [super init])) {
+        _responseData = [data copy];
+        _latency = latency;
+        _socket = socket(AF_INET, SOCK_STREAM, 0);
+        if (_socket < 0) {
+            return nil;
+        }
+        int reuse = 1;
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in address = {0};
+        address.sin_len = sizeof(address);
+        address.sin_family = AF_INET;
+        address.sin_port = 0; // any free port
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(_socket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+            listen(_socket, 128) != 0 ||
+            getsockname(_socket, (struct sockaddr *)&address, &length) != 0) {
+            close(_socket);
+            return nil;
+        }
+        _port = ntohs(address.sin_port);
+        fcntl(_socket, F_SETFL, O_NONBLOCK);
+
+        _connectionQueue = dispatch_queue_create("com.hackemist.SDWebImageBenchmark.http", DISPATCH_QUEUE_CONCURRENT);
+        _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _socket, 0, _connectionQueue);
+        __weak typeof(self) wself = self;
+        int listenSocket = _socket;
+        dispatch_source_set_event_handler(_acceptSource, ^{
+            int client;
+            while ((client = accept(listenSocket, NULL, NULL)) >= 0) {
+                [wself handleConnection:client];
+            }
+        });
+        dispatch_source_set_cancel_handler(_acceptSource, ^{
+            close(listenSocket);
+        });
+        dispatch_resume(_acceptSource);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (nonnull NSURL *)URLForPath:(nonnull NSString *)path {
+    return [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u%@", self.port, path]];
+}
+
+- (void)stop {
+    if (_acceptSource) {
+        dispatch_source_cancel(_acceptSource);
+        _acceptSource = nil;
+    }
+}
+
+- (void)handleConnection:(int)client {
+    int noSigPipe = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+    dispatch_async(_connectionQueue, ^{
+        // read the request head, the body of a GET is empty
+        NSMutableData *request = [NSMutableData data];
+        char buffer[4096];
+        while (request.length < 64 * 1024) {
+            ssize_t count = read(client, buffer, sizeof(buffer));
+            if (count <= 0) {
+                break;
+            }
+            [request appendBytes:buffer length:count];
+            if (memmem(request.bytes, request.length, "\r\n\r\n", 4)) {
+                break;
+            }
+        }
+        @synchronized (self) {
+            self.requestCount++;
+            _activeRequestCount++;
+            if (_activeRequestCount > self.peakRequestCount) {
+                self.peakRequestCount = _activeRequestCount;
+            }
+        }
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_latency * NSEC_PER_SEC)), _connectionQueue, ^{
+            NSString *head = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)_responseData.length];
+            NSMutableData *response = [[head dataUsingEncoding:NSASCIIStringEncoding] mutableCopy];
+            [response appendData:_responseData];
+            const uint8_t *bytes = response.bytes;
+            size_t remaining = response.length;
+            size_t chunkRemaining = self.chunkSize > 0 ? response.length - _responseData.length + self.chunkSize : remaining;
+            while (remaining > 0) {
+                ssize_t written = write(client, bytes, MIN(remaining, chunkRemaining));
+                if (written <= 0) {
+                    break;
+                }
+                bytes += written;
+                remaining -= written;
+                chunkRemaining -= written;
+                if (chunkRemaining == 0) {
+                    usleep((useconds_t)(self.chunkInterval * USEC_PER_SEC));
+                    chunkRemaining = self.chunkSize;
+                }
+            }
+            // before closing, so the next request of a full window is not counted with this one
+            @synchronized (self) {
+                _activeRequestCount--;
+            }
+            close(client);
+        });
+    });
+}
+
+@end
+
+@interface SDWebImageBenchmark ()
+
+@property (strong, nonatomic, nonnull) NSMutableString *report;
+@property (assign, nonatomic) BOOL passed;
+// wwt 每个测试独立的工作目录，测试结束后删除
+@property (copy, nonatomic, nonnull) NSString *workPath;
+
+- (void)log:(nonnull NSString *)format, ... NS_FORMAT_FUNCTION(1,2);
+- (void)expect:(BOOL)condition format:(nonnull NSString *)format, ... NS_FORMAT_FUNCTION(2,3);
+
+@end
+
+@implementation SDWebImageBenchmark
+
++ (nullable NSString *)benchmarkNameFromLaunchArguments {
+    // `-SDWebImageBenchmark Name` is in the argument domain of the user defaults
+    NSString *name = [[NSUserDefaults standardUserDefaults] stringForKey:SDWebImageBenchmarkArgument];
+    return name.length > 0 ? name : nil;
+}
+
++ (void)runBenchmarkNamed:(nonnull NSString *)name completion:(nonnull SDWebImageBenchmarkCompletionBlock)completion {
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+        SDWebImageBenchmark *benchmark = [self new];
+        benchmark.report = [NSMutableString string];
+        benchmark.passed = YES;
+        benchmark.workPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:@"SDWebImageBenchmark"] stringByAppendingPathComponent:name];
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtPath:benchmark.workPath error:nil];
+        [fileManager createDirectoryAtPath:benchmark.workPath withIntermediateDirectories:YES attributes:nil error:nil];
+
+        SEL selector = NSSelectorFromString([@"benchmark" stringByAppendingString:name]);
+        if ([benchmark respondsToSelector:selector]) {
+            IMP imp = [benchmark methodForSelector:selector];
+            ((void (*)(id, SEL))imp)(benchmark, selector);
+        } else {
+            [benchmark expect:NO format:@"unknown benchmark %@", name];
+        }
+
+        [fileManager removeItemAtPath:benchmark.workPath error:nil];
+        NSLog(@"SDWebImageBenchmark %@ %@\n%@", name, benchmark.passed ? @"PASS" : @"FAIL", benchmark.report);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(benchmark.passed, [benchmark.report copy]);
+        });
+    });
+}
+
+#pragma mark - Report
+
+- (void)log:(nonnull NSString *)format, ... {
+    va_list args;
+    va_start(args, format);
+    NSString *line = [[NSString alloc] initWithFormat:format arguments:args];
+    va_end(args);
+    [self.report appendFormat:@"%@\n", line];
+}
+
+// wwt 检查失败时测试结果为FAIL，并记录失败原因
+- (void)expect:(BOOL)condition format:(nonnull NSString *)format, ... {
+    if (condition) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    NSString *reason = [[NSString alloc] initWithFormat:format arguments:args];
+    va_end(args);
+    self.passed = NO;
+    [self.report appendFormat:@"FAIL: %@\n", reason];
+}
+
+#pragma mark - Disk cache cleanup
+
+// wwt 旧的清理方式：遍历缓存目录并读取每个文件的属性，作为对照
+// The directory walk the disk cleanup did before the manifest, as the baseline
+static NSUInteger SDBenchmarkWalkDirectory(NSString *path) {
+    NSURL *directoryURL = [NSURL fileURLWithPath:path isDirectory:YES];
+    NSArray<NSString *> *resourceKeys = @[NSURLIsDirectoryKey, NSURLContentModificationDateKey, NSURLTotalFileAllocatedSizeKey];
+    NSDirectoryEnumerator *fileEnumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
+                                                                 includingPropertiesForKeys:resourceKeys
+                                                                                    options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                               errorHandler:NULL];
+    NSMutableDictionary<NSURL *, NSDictionary<NSString *, id> *> *cacheFiles = [NSMutableDictionary dictionary];
+    for (NSURL *fileURL in fileEnumerator) {
+        NSDictionary<NSString *, id> *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:NULL];
+        if ([resourceValues[NSURLIsDirectoryKey] boolValue]) {
+            continue;
+        }
+        cacheFiles[fileURL] = resourceValues;
+    }
+    return cacheFiles.count;
+}
+
+// wwt 清理耗时与缓存文件数目的关系：清单索引 vs 遍历目录
+// Cleanup time against the entry count. A cleanup with nothing to remove reads the manifest only and
+// keeps every entry; a trimming cleanup has to leave the manifest in sync with the files that are left.
+// The times against the directory walk it replaced are reported, they do not fail the run.
+- (void)benchmarkDiskCleanup {
+    static const NSUInteger kFileSize = 1024;
+    NSArray<NSNumber *> *entryCounts = @[@1000, @3000, @10000];
+    NSMutableData *fileData = [NSMutableData dataWithLength:kFileSize];
+    arc4random_buf(fileData.mutableBytes, kFileSize);
+
+    double firstCleanupPerEntry = 0;
+    for (NSUInteger round = 0; round < entryCounts.count; round++) {
+        NSUInteger count = entryCounts[round].unsignedIntegerValue;
+        NSString *directory = [self.workPath stringByAppendingPathComponent:entryCounts[round].stringValue];
+        SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"cleanup" diskCacheDirectory:directory];
+        cache.config.maxCacheAge = NSIntegerMax / 2;
+        cache.config.maxCacheSize = 0;
+        for (NSUInteger i = 0; i < count; i++) {
+            NSString *key = [NSString stringWithFormat:@"https://example.com/images/%lu.jpg", (unsigned long)i];
+            [cache storeImageDataToDisk:fileData forKey:key];
+        }
+        NSString *cachePath = [[cache defaultCachePathForKey:@"key"] stringByDeletingLastPathComponent];
+
+        CFTimeInterval start = SDBenchmarkNow();
+        NSUInteger walkedCount = SDBenchmarkWalkDirectory(cachePath);
+        CFTimeInterval walkTime = SDBenchmarkNow() - start;
+
+        start = SDBenchmarkNow();
+        SDBenchmarkWait(^(dispatch_block_t done) {
+            [cache deleteOldFilesWithCompletionBlock:done];
+        });
+        CFTimeInterval cleanupTime = SDBenchmarkNow() - start;
+        NSUInteger cleanedCount = [cache getDiskCount];
+
+        // A relaunch replays the manifest instead of walking the directory
+        NSUInteger reopenedCount = 0;
+        CFTimeInterval reopenTime = 0;
+        @autoreleasepool {
+            start = SDBenchmarkNow();
+            SDImageCache *reopenedCache = [[SDImageCache alloc] initWithNamespace:@"cleanup" diskCacheDirectory:directory];
+            reopenedCount = [reopenedCache getDiskCount];
+            reopenTime = SDBenchmarkNow() - start;
+        }
+
+        // Trim to half of the stored bytes, the cleanup targets half of maxCacheSize
+        cache.config.maxCacheSize = count * kFileSize / 2;
+        start = SDBenchmarkNow();
+        SDBenchmarkWait(^(dispatch_block_t done) {
+            [cache deleteOldFilesWithCompletionBlock:done];
+        });
+        CFTimeInterval trimTime = SDBenchmarkNow() - start;
+        NSUInteger trimmedSize = [cache getSize];
+        NSUInteger trimmedCount = [cache getDiskCount];
+        NSUInteger filesLeft = SDBenchmarkWalkDirectory(cachePath);
+
+        [self log:@"entries=%lu walk=%.1fms cleanup=%.1fms reopen=%.1fms trim=%.1fms left=%lu",
+         (unsigned long)count, walkTime * 1000, cleanupTime * 1000, reopenTime * 1000, trimTime * 1000, (unsigned long)trimmedCount];
+
+        [self expect:walkedCount == count format:@"%lu files stored, %lu on disk", (unsigned long)count, (unsigned long)walkedCount];
+        [self expect:cleanedCount == count format:@"cleanup with nothing expired left %lu of %lu entries", (unsigned long)cleanedCount, (unsigned long)count];
+        [self expect:reopenedCount == count format:@"reopened cache has %lu entries, expected %lu", (unsigned long)reopenedCount, (unsigned long)count];
+        [self expect:trimmedSize < cache.config.maxCacheSize / 2 format:@"trimmed to %lu bytes, limit %lu", (unsigned long)trimmedSize, (unsigned long)cache.config.maxCacheSize / 2];
+        [self expect:trimmedCount == filesLeft format:@"manifest has %lu entries, %lu files left", (unsigned long)trimmedCount, (unsigned long)filesLeft];
+
+        double cleanupPerEntry = cleanupTime / count;
+        if (round == 0) {
+            firstCleanupPerEntry = cleanupPerEntry;
+        }
+        if (round == entryCounts.count - 1) {
+            [self log:@"cleanup/walk=%.2f cleanup per entry %.2fus, %.2fx the first run", walkTime > 0 ? cleanupTime / walkTime : 0, cleanupPerEntry * 1e6, firstCleanupPerEntry > 0 ? cleanupPerEntry / firstCleanupPerEntry : 0];
+        }
+    }
+}
+
+#pragma mark - Adversarial GIF durations
+
+// wwt 生成每帧内容不同的GIF，帧时长依次使用durations中的值
+// A GIF with distinct frames, the frame durations cycle through `durations`
+static NSData *SDBenchmarkGIFData(NSUInteger frameCount, size_t size, NSArray<NSNumber *> *durations) {
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, kUTTypeGIF, frameCount, NULL);
+    if (!destination) {
+        return nil;
+    }
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        @autoreleasepool {
+            CGContextRef context = CGBitmapContextCreate(NULL, size, size, 8, 0, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaNoneSkipLast);
+            CGContextSetRGBFillColor(context, (i % 7) / 7.0, (i % 5) / 5.0, (i % 3) / 3.0, 1);
+            CGContextFillRect(context, CGRectMake(0, 0, size, size));
+            CGContextSetRGBFillColor(context, 1, 1, 1, 1);
+            CGContextFillEllipseInRect(context, CGRectMake((i * 13) % (size / 2), (i * 29) % (size / 2), size / 2, size / 2));
+            CGImageRef imageRef = CGBitmapContextCreateImage(context);
+            NSDictionary *properties = @{(__bridge NSString *)kCGImagePropertyGIFDictionary : @{(__bridge NSString *)kCGImagePropertyGIFDelayTime : durations[i % durations.count]}};
+            CGImageDestinationAddImage(destination, imageRef, (__bridge CFDictionaryRef)properties);
+            CGImageRelease(imageRef);
+            CGContextRelease(context);
+        }
+    }
+    CGColorSpaceRelease(colorSpace);
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    return finalized ? data : nil;
+}
+
+// wwt GIF的每一帧，图片没有解码，显示时才解码
+// The frames of the GIF, the images are not decoded until drawn
+static NSArray<SDWebImageFrame *> *SDBenchmarkGIFFrames(NSData *data, NSArray<NSNumber *> *durations) {
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source) {
+        return nil;
+    }
+    size_t count = CGImageSourceGetCount(source);
+    NSMutableArray<SDWebImageFrame *> *frames = [NSMutableArray arrayWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, i, NULL);
+        if (!imageRef) {
+            continue;
+        }
+        UIImage *image = [[UIImage alloc] initWithCGImage:imageRef];
+        CGImageRelease(imageRef);
+        [frames addObject:[SDWebImageFrame frameWithImage:image duration:durations[i % durations.count].doubleValue]];
+    }
+    CFRelease(source);
+    return frames;
+}
+
+// wwt 旧的实现：按时长的最大公约数重复帧，作为对照
+// What animatedImageWithFrames: did before the duration table: repeat each frame by the GCD of the durations
+static UIImage *SDBenchmarkRepeatedFramesImage(NSArray<SDWebImageFrame *> *frames, NSUInteger *repeatedCount) {
+    NSUInteger gcd = 0;
+    NSUInteger totalDuration = 0;
+    for (SDWebImageFrame *frame in frames) {
+        NSUInteger a = frame.duration * 1000, b = gcd;
+        while (b) {
+            NSUInteger t = a % b;
+            a = b;
+            b = t;
+        }
+        gcd = a;
+        totalDuration += (NSUInteger)(frame.duration * 1000);
+    }
+    NSMutableArray<UIImage *> *animatedImages = [NSMutableArray array];
+    for (SDWebImageFrame *frame in frames) {
+        NSUInteger repeatCount = gcd ? (NSUInteger)(frame.duration * 1000) / gcd : 1;
+        for (NSUInteger i = 0; i < repeatCount; i++) {
+            [animatedImages addObject:frame.image];
+        }
+    }
+    *repeatedCount = animatedImages.count;
+    return [UIImage animatedImageWithImages:animatedImages duration:totalDuration / 1000.0];
+}
+
+// wwt 在窗口中显示动图一段时间，返回内存峰值的增长
+// Shows the image in the key window for a while, returns the peak footprint growth
+static uint64_t SDBenchmarkDisplayPeakMemory(UIImage *image, BOOL animatedImagePlayer, NSTimeInterval duration) {
+    __block UIImageView *imageView;
+    SDBenchmarkMemorySampler *sampler = [SDBenchmarkMemorySampler new];
+    [sampler start];
+    dispatch_sync(dispatch_get_main_queue(), ^{
+        imageView = [[UIImageView alloc] initWithFrame:CGRectMake(0, 0, 200, 200)];
+        [[UIApplication sharedApplication].keyWindow addSubview:imageView];
+        if (animatedImagePlayer) {
+            [imageView sd_setAnimatedImage:image];
+        } else {
+            imageView.image = image;
+        }
+    });
+    [NSThread sleepForTimeInterval:duration];
+    uint64_t peak = [sampler stop];
+    dispatch_sync(dispatch_get_main_queue(), ^{
+        [imageView sd_setAnimatedImage:nil];
+        [imageView removeFromSuperview];
+        imageView = nil;
+    });
+    return peak;
+}
+
+// wwt 帧时长差异很大(20ms/1s)的GIF：创建耗时和显示时的内存
+// Setup time and memory of a GIF mixing 20ms and 1s frames, whose duration GCD used to repeat
+// each slow frame 50 times. The duration table keeps one entry per frame where the repeated frames
+// hold 51 entries per pair, and playback through UIImageView+WebCache stays within the decoded frame
+// buffer budget (20MB). The setup times are reported, they do not fail the run.
+- (void)benchmarkAdversarialGIF {
+    static const NSUInteger kFrameCount = 60;
+    static const size_t kFrameSize = 400;
+    NSArray<NSNumber *> *durations = @[@0.02, @1.0];
+    NSData *gifData = SDBenchmarkGIFData(kFrameCount, kFrameSize, durations);
+    [self expect:gifData != nil format:@"failed to encode the GIF"];
+    if (!gifData) {
+        return;
+    }
+    NSTimeInterval expectedDuration = kFrameCount / 2 * (0.02 + 1.0);
+    uint64_t decodedBytes = (uint64_t)kFrameCount * kFrameSize * kFrameSize * 4;
+
+    // The duration table, on frames of its own so no decoded bitmap is shared with the baseline
+    NSArray<SDWebImageFrame *> *frames = SDBenchmarkGIFFrames(gifData, durations);
+    CFTimeInterval start = SDBenchmarkNow();
+    UIImage *image = [SDWebImageCoderHelper animatedImageWithFrames:frames];
+    CFTimeInterval setupTime = SDBenchmarkNow() - start;
+    frames = nil;
+    SDWebImageAnimatedImage *animatedImage = [image isKindOfClass:[SDWebImageAnimatedImage class]] ? (SDWebImageAnimatedImage *)image : nil;
+    NSTimeInterval totalDuration = 0;
+    for (NSUInteger i = 0; i < animatedImage.animatedImageFrameCount; i++) {
+        totalDuration += [animatedImage animatedImageDurationAtIndex:i];
+    }
+    uint64_t displayPeak = SDBenchmarkDisplayPeakMemory(animatedImage, YES, 2);
+
+    // The repeated frames
+    NSArray<SDWebImageFrame *> *baselineFrames = SDBenchmarkGIFFrames(gifData, durations);
+    NSUInteger repeatedCount = 0;
+    start = SDBenchmarkNow();
+    UIImage *repeatedImage = SDBenchmarkRepeatedFramesImage(baselineFrames, &repeatedCount);
+    CFTimeInterval repeatedSetupTime = SDBenchmarkNow() - start;
+    baselineFrames = nil;
+    uint64_t repeatedDisplayPeak = SDBenchmarkDisplayPeakMemory(repeatedImage, NO, 2);
+
+    // The GIF coder builds the same duration table from the data
+    UIImage *decodedImage = [[SDWebImageGIFCoder sharedCoder] decodedImageWithData:gifData];
+    SDWebImageAnimatedImage *decodedAnimatedImage = [decodedImage isKindOfClass:[SDWebImageAnimatedImage class]] ? (SDWebImageAnimatedImage *)decodedImage : nil;
+
+    // UIButton and the other UIKit consumers read `images`, which repeats the frames like before
+    NSUInteger legacyCount = animatedImage.images.count;
+    NSTimeInterval legacyDuration = animatedImage.duration;
+
+    [self log:@"frames=%lu decoded=%.1fMB", (unsigned long)kFrameCount, SDBenchmarkMB(decodedBytes)];
+    [self log:@"duration table: entries=%lu setup=%.2fms display peak=%.1fMB",
+     (unsigned long)animatedImage.animatedImageFrameCount, setupTime * 1000, SDBenchmarkMB(displayPeak)];
+    [self log:@"repeated frames: entries=%lu setup=%.2fms display peak=%.1fMB",
+     (unsigned long)repeatedCount, repeatedSetupTime * 1000, SDBenchmarkMB(repeatedDisplayPeak)];
+    [self log:@"setup/repeated=%.2f", repeatedSetupTime > 0 ? setupTime / repeatedSetupTime : 0];
+
+    [self expect:animatedImage.animatedImageFrameCount == kFrameCount format:@"%lu entries for %lu frames", (unsigned long)animatedImage.animatedImageFrameCount, (unsigned long)kFrameCount];
+    [self expect:fabs(totalDuration - expectedDuration) < 0.01 format:@"total duration %.2fs, expected %.2fs", totalDuration, expectedDuration];
+    [self expect:decodedAnimatedImage.animatedImageFrameCount == kFrameCount format:@"GIF coder returned %lu frames", (unsigned long)decodedAnimatedImage.animatedImageFrameCount];
+    [self expect:legacyCount == repeatedCount format:@"images has %lu entries, expected %lu", (unsigned long)legacyCount, (unsigned long)repeatedCount];
+    [self expect:fabs(legacyDuration - expectedDuration) < 0.01 format:@"duration %.2fs, expected %.2fs", legacyDuration, expectedDuration];
+    // One 20ms entry plus 50 for the 1s frame, for each pair of frames
+    NSUInteger expectedRepeatedCount = kFrameCount / 2 * (1 + 50);
+    [self expect:repeatedCount == expectedRepeatedCount format:@"repeated frames have %lu entries, expected %lu", (unsigned long)repeatedCount, (unsigned long)expectedRepeatedCount];
+    // The frame buffer budget plus the frame on screen and allocator slack
+    uint64_t displayLimit = 20 * 1024 * 1024 + 2 * kFrameSize * kFrameSize * 4 + 8 * 1024 * 1024;
+    [self expect:displayPeak < displayLimit format:@"display peak %.1fMB over %.1fMB", SDBenchmarkMB(displayPeak), SDBenchmarkMB(displayLimit)];
+}
+
+#pragma mark - On-demand frame decoding
+
+// wwt 强制解码图片，返回解码后的位图
+// Draws the image into a bitmap, which is what decoding a frame up front costs
+static CGImageRef SDBenchmarkCreateDecodedImage(CGImageRef imageRef) CF_RETURNS_RETAINED {
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedFirst);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return NULL;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+    CGImageRef decodedImageRef = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    return decodedImageRef;
+}
+
+// wwt 按需解码 vs 一次性解码所有帧：首帧耗时和内存峰值
+// Time-to-first-frame and peak memory of a 120-frame GIF. The coder decodes the first frame only and
+// the player decodes the rest into its bounded buffer, where decoding every frame up front holds all
+// 120 bitmaps. The memory cache is charged the compressed data plus the first frame. The times are
+// reported, they do not fail the run.
+- (void)benchmarkOnDemandFrames {
+    static const NSUInteger kFrameCount = 120;
+    static const size_t kFrameSize = 400;
+    NSData *gifData = SDBenchmarkGIFData(kFrameCount, kFrameSize, @[@0.05]);
+    [self expect:gifData != nil format:@"failed to encode the GIF"];
+    if (!gifData) {
+        return;
+    }
+    uint64_t frameBytes = kFrameSize * kFrameSize * 4;
+
+    // On demand: the coder returns once the first frame is decoded
+    SDBenchmarkMemorySampler *sampler = [SDBenchmarkMemorySampler new];
+    [sampler start];
+    CFTimeInterval start = SDBenchmarkNow();
+    UIImage *image = [[SDWebImageGIFCoder sharedCoder] decodedImageWithData:gifData];
+    CFTimeInterval firstFrameTime = SDBenchmarkNow() - start;
+    uint64_t decodePeak = [sampler stop];
+    SDWebImageAnimatedImage *animatedImage = [image isKindOfClass:[SDWebImageAnimatedImage class]] ? (SDWebImageAnimatedImage *)image : nil;
+    uint64_t displayPeak = SDBenchmarkDisplayPeakMemory(animatedImage, YES, 2);
+
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"frames" diskCacheDirectory:self.workPath];
+    SDBenchmarkWait(^(dispatch_block_t done) {
+        [cache storeImage:animatedImage forKey:@"animated" toDisk:NO completion:done];
+    });
+    NSUInteger memoryCost = [cache getMemoryCost];
+
+    // Up front: every frame is decoded before the image is returned
+    NSMutableArray *decodedFrames = [NSMutableArray arrayWithCapacity:kFrameCount];
+    sampler = [SDBenchmarkMemorySampler new];
+    [sampler start];
+    start = SDBenchmarkNow();
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)gifData, NULL);
+    size_t count = source ? CGImageSourceGetCount(source) : 0;
+    for (size_t i = 0; i < count; i++) {
+        @autoreleasepool {
+            CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, i, NULL);
+            CGImageRef decodedImageRef = imageRef ? SDBenchmarkCreateDecodedImage(imageRef) : NULL;
+            if (decodedImageRef) {
+                [decodedFrames addObject:(__bridge_transfer id)decodedImageRef];
+            }
+            if (imageRef) {
+                CGImageRelease(imageRef);
+            }
+        }
+    }
+    if (source) {
+        CFRelease(source);
+    }
+    CFTimeInterval allFramesTime = SDBenchmarkNow() - start;
+    uint64_t allFramesPeak = [sampler stop];
+    NSUInteger decodedCount = decodedFrames.count;
+    decodedFrames = nil;
+
+    [self log:@"frames=%lu data=%.1fMB decoded=%.1fMB", (unsigned long)kFrameCount, SDBenchmarkMB(gifData.length), SDBenchmarkMB(kFrameCount * frameBytes)];
+    [self log:@"on demand: first frame=%.1fms decode peak=%.1fMB display peak=%.1fMB memory cost=%.1fMB",
+     firstFrameTime * 1000, SDBenchmarkMB(decodePeak), SDBenchmarkMB(displayPeak), SDBenchmarkMB(memoryCost)];
+    [self log:@"up front: first frame=%.1fms decode peak=%.1fMB", allFramesTime * 1000, SDBenchmarkMB(allFramesPeak)];
+    [self log:@"first frame/all frames=%.2f", allFramesTime > 0 ? firstFrameTime / allFramesTime : 0];
+
+    [self expect:animatedImage.animatedImageFrameCount == kFrameCount format:@"GIF coder returned %lu frames", (unsigned long)animatedImage.animatedImageFrameCount];
+    [self expect:animatedImage.animatedImageData != nil format:@"the image does not keep the compressed data"];
+    [self expect:decodedCount == kFrameCount format:@"decoded %lu frames up front", (unsigned long)decodedCount];
+    [self expect:decodePeak * 4 < allFramesPeak format:@"decode peak %.1fMB, all frames %.1fMB", SDBenchmarkMB(decodePeak), SDBenchmarkMB(allFramesPeak)];
+    // The frame buffer budget plus the frame on screen and allocator slack
+    uint64_t displayLimit = 20 * 1024 * 1024 + 2 * frameBytes + 8 * 1024 * 1024;
+    [self expect:displayPeak < displayLimit format:@"display peak %.1fMB over %.1fMB", SDBenchmarkMB(displayPeak), SDBenchmarkMB(displayLimit)];
+    [self expect:memoryCost <= gifData.length + frameBytes format:@"memory cost %lu, expected the data plus one frame", (unsigned long)memoryCost];
+}
+
+#pragma mark - Memory cache feed scroll
+
+// wwt 生成解码后的图片，模拟从磁盘加载并解码
+// A decoded image, standing for one loaded from disk and decoded
+static UIImage *SDBenchmarkBitmapImage(size_t size, NSUInteger seed) {
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, size, size, 8, size * 4, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaNoneSkipLast);
+    CGColorSpaceRelease(colorSpace);
+    CGContextSetRGBFillColor(context, (seed % 7) / 7.0, (seed % 11) / 11.0, (seed % 13) / 13.0, 1);
+    CGContextFillRect(context, CGRectMake(0, 0, size, size));
+    CGImageRef imageRef = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    UIImage *image = [[UIImage alloc] initWithCGImage:imageRef scale:1 orientation:UIImageOrientationUp];
+    CGImageRelease(imageRef);
+    return image;
+}
+
+// wwt 模拟滚动：向前滚动，每100项回滚30项，每次查询可见的6项
+// The feed positions of a scroll replay: forward, scrolling back 30 items every 100 items
+static NSArray<NSNumber *> *SDBenchmarkScrollPositions(NSUInteger itemCount, NSUInteger visibleCount) {
+    NSMutableArray<NSNumber *> *positions = [NSMutableArray array];
+    for (NSUInteger position = 0; position + visibleCount <= itemCount; position++) {
+        [positions addObject:@(position)];
+        if (position > 0 && position % 100 == 0) {
+            for (NSUInteger back = 1; back <= 30; back++) {
+                [positions addObject:@(position - back)];
+            }
+            for (NSUInteger forward = 29; forward > 0; forward--) {
+                [positions addObject:@(position - forward)];
+            }
+        }
+    }
+    return positions;
+}
+
+// wwt 内存缓存的命中率和占用字节：按字节计算成本的LRU
+// Replays a feed scroll against the memory cache and reports the hit rate and resident bytes.
+// The cache is a deterministic LRU over bytes, so it has to match a plain LRU model step by step,
+// except for the hits revived from the weak cache while the cells still show them. NSCache, the
+// previous backing store, is replayed for comparison.
+- (void)benchmarkFeedScroll {
+    static const NSUInteger kItemCount = 2000;
+    static const NSUInteger kVisibleCount = 6;
+    static const NSUInteger kCostLimit = 8 * 1024 * 1024;
+    NSArray<NSNumber *> *positions = SDBenchmarkScrollPositions(kItemCount, kVisibleCount);
+    // 100px to 300px square, 40KB to 360KB decoded
+    size_t (^imageSize)(NSUInteger) = ^size_t(NSUInteger item) {
+        return 100 + (item * 37) % 201;
+    };
+
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"feed" diskCacheDirectory:self.workPath];
+    cache.maxMemoryCost = kCostLimit;
+    NSCache *baselineCache = [NSCache new];
+    baselineCache.totalCostLimit = kCostLimit;
+
+    // The LRU model: keys from the least to the most recently used
+    NSMutableOrderedSet<NSNumber *> *modelKeys = [NSMutableOrderedSet orderedSet];
+    NSUInteger modelCost = 0;
+    NSUInteger modelHits = 0, hits = 0, baselineHits = 0, lookups = 0;
+    NSUInteger peakResident = 0;
+    BOOL overLimit = NO;
+    NSArray<UIImage *> *visibleImages = nil; // the images shown by the cells
+    CFTimeInterval lookupTime = 0;
+
+    for (NSNumber *position in positions) {
+        @autoreleasepool {
+            NSMutableArray<UIImage *> *images = [NSMutableArray arrayWithCapacity:kVisibleCount];
+            for (NSUInteger item = position.unsignedIntegerValue; item < position.unsignedIntegerValue + kVisibleCount; item++) {
+                NSNumber *itemKey = @(item);
+                NSString *key = [NSString stringWithFormat:@"https://example.com/feed/%lu.jpg", (unsigned long)item];
+                NSUInteger cost = imageSize(item) * imageSize(item) * 4;
+                lookups++;
+
+                if ([modelKeys containsObject:itemKey]) {
+                    modelHits++;
+                    [modelKeys removeObject:itemKey];
+                } else {
+                    modelCost += cost;
+                }
+                [modelKeys addObject:itemKey];
+                while (modelCost > kCostLimit) {
+                    NSNumber *evicted = modelKeys.firstObject;
+                    modelCost -= imageSize(evicted.unsignedIntegerValue) * imageSize(evicted.unsignedIntegerValue) * 4;
+                    [modelKeys removeObjectAtIndex:0];
+                }
+
+                CFTimeInterval start = SDBenchmarkNow();
+                UIImage *image = [cache imageFromMemoryCacheForKey:key];
+                lookupTime += SDBenchmarkNow() - start;
+                if (image) {
+                    hits++;
+                } else {
+                    image = SDBenchmarkBitmapImage(imageSize(item), item);
+                    [cache storeImage:image forKey:key toDisk:NO completion:nil];
+                }
+                [images addObject:image];
+
+                if ([baselineCache objectForKey:key]) {
+                    baselineHits++;
+                } else {
+                    [baselineCache setObject:image forKey:key cost:cost];
+                }
+            }
+            visibleImages = images;
+            NSUInteger resident = [cache getMemoryCost];
+            peakResident = MAX(peakResident, resident);
+            overLimit = overLimit || resident > kCostLimit;
+        }
+    }
+    NSUInteger resident = [cache getMemoryCost];
+
+    // A memory warning empties the cache, the images still on screen come back from the weak cache
+    dispatch_sync(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    });
+    NSUInteger residentAfterWarning = [cache getMemoryCost];
+    NSUInteger visibleHits = 0;
+    NSUInteger lastPosition = positions.lastObject.unsignedIntegerValue;
+    for (NSUInteger item = lastPosition; item < lastPosition + kVisibleCount; item++) {
+        NSString *key = [NSString stringWithFormat:@"https://example.com/feed/%lu.jpg", (unsigned long)item];
+        if ([cache imageFromMemoryCacheForKey:key]) {
+            visibleHits++;
+        }
+    }
+    visibleImages = nil;
+
+    [self log:@"lookups=%lu limit=%.1fMB", (unsigned long)lookups, SDBenchmarkMB(kCostLimit)];
+    [self log:@"LRU: hit rate=%.1f%% (model %.1f%%) resident=%.2fMB (model %.2fMB) peak=%.2fMB lookup=%.2fus",
+     100.0 * hits / lookups, 100.0 * modelHits / lookups, SDBenchmarkMB(resident), SDBenchmarkMB(modelCost), SDBenchmarkMB(peakResident), lookupTime / lookups * 1e6];
+    [self log:@"NSCache: hit rate=%.1f%%", 100.0 * baselineHits / lookups];
+    [self log:@"memory warning: resident=%.2fMB visible hits=%lu/%lu", SDBenchmarkMB(residentAfterWarning), (unsigned long)visibleHits, (unsigned long)kVisibleCount];
+
+    [self expect:!overLimit && peakResident <= kCostLimit format:@"resident %.2fMB over the limit", SDBenchmarkMB(peakResident)];
+    [self expect:resident == modelCost format:@"resident %lu bytes, the LRU model has %lu", (unsigned long)resident, (unsigned long)modelCost];
+    [self expect:hits >= modelHits format:@"%lu hits, the LRU model has %lu", (unsigned long)hits, (unsigned long)modelHits];
+    [self expect:visibleHits == kVisibleCount format:@"%lu of the visible images lost on memory warning", (unsigned long)(kVisibleCount - visibleHits)];
+
+    // The cost is the bytes of every unique frame
+    SDImageCache *costCache = [[SDImageCache alloc] initWithNamespace:@"cost" diskCacheDirectory:self.workPath];
+    UIImage *frame1 = SDBenchmarkBitmapImage(100, 1), *frame2 = SDBenchmarkBitmapImage(100, 2), *frame3 = SDBenchmarkBitmapImage(100, 3);
+    NSMutableArray<UIImage *> *repeatedFrames = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 10; i++) {
+        [repeatedFrames addObjectsFromArray:@[frame1, frame2, frame3]];
+    }
+    NSArray<SDWebImageFrame *> *frames = @[[SDWebImageFrame frameWithImage:frame1 duration:0.1], [SDWebImageFrame frameWithImage:frame2 duration:0.1], [SDWebImageFrame frameWithImage:frame3 duration:0.1]];
+    [costCache storeImage:frame1 forKey:@"still" toDisk:NO completion:nil];
+    NSUInteger stillCost = [costCache getMemoryCost];
+    [costCache storeImage:[UIImage animatedImageWithImages:repeatedFrames duration:3] forKey:@"repeated" toDisk:NO completion:nil];
+    NSUInteger repeatedCost = [costCache getMemoryCost] - stillCost;
+    [costCache storeImage:[SDWebImageCoderHelper animatedImageWithFrames:frames] forKey:@"frames" toDisk:NO completion:nil];
+    NSUInteger framesCost = [costCache getMemoryCost] - stillCost - repeatedCost;
+    [self expect:stillCost == 100 * 100 * 4 format:@"still image cost %lu", (unsigned long)stillCost];
+    [self expect:repeatedCost == 3 * 100 * 100 * 4 format:@"repeated frames cost %lu, 3 unique frames", (unsigned long)repeatedCost];
+    [self expect:framesCost == 3 * 100 * 100 * 4 format:@"animated image cost %lu, 3 frames", (unsigned long)framesCost];
+
+    // The weak references are bounded: keep every image alive, only the latest evicted ones come back
+    static const NSUInteger kWeakLimit = 100;
+    SDImageCache *weakCache = [[SDImageCache alloc] initWithNamespace:@"weak" diskCacheDirectory:self.workPath];
+    weakCache.maxMemoryCost = 1024 * 1024;
+    weakCache.maxMemoryWeakCountLimit = kWeakLimit;
+    NSMutableArray<UIImage *> *retainedImages = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 300; i++) {
+        @autoreleasepool {
+            UIImage *image = SDBenchmarkBitmapImage(100, i);
+            [retainedImages addObject:image];
+            [weakCache storeImage:image forKey:@(i).stringValue toDisk:NO completion:nil];
+        }
+    }
+    NSUInteger strongCount = [weakCache getMemoryCount];
+    NSUInteger weakHits = 0;
+    for (NSUInteger i = 0; i < 300; i++) {
+        @autoreleasepool {
+            if ([weakCache imageFromMemoryCacheForKey:@(i).stringValue]) {
+                weakHits++;
+            }
+        }
+    }
+    [self log:@"weak cache: retained=300 strong=%lu hits=%lu", (unsigned long)strongCount, (unsigned long)weakHits];
+    [self expect:weakHits <= strongCount + kWeakLimit format:@"%lu hits with %lu strong and %lu weak entries", (unsigned long)weakHits, (unsigned long)strongCount, (unsigned long)kWeakLimit];
+    [self expect:weakHits > strongCount format:@"no hit from the weak cache"];
+}
+
+#pragma mark - Read-only path lookup
+
+// wwt 生成指定尺寸的PNG数据
+static NSData *SDBenchmarkPNGData(size_t size) {
+    UIImage *image = SDBenchmarkBitmapImage(size, size);
+    return [[SDWebImageCodersManager sharedInstance] encodedDataWithImage:image format:SDImageFormatPNG];
+}
+
+// wwt 旧的查找方式：依次试探默认路径和每个只读路径，每个路径试探带扩展名和不带扩展名的文件
+// The lookup before the indexes: probe the default path and then each read-only path, with and without the extension
+static UIImage *SDBenchmarkProbeImage(SDImageCache *cache, NSArray<NSString *> *paths, NSString *key) {
+    NSData *data = nil;
+    for (NSString *path in paths) {
+        NSString *filePath = [cache cachePathForKey:key inPath:path];
+        data = [NSData dataWithContentsOfFile:filePath options:cache.config.diskCacheReadingOptions error:nil];
+        if (!data) {
+            data = [NSData dataWithContentsOfFile:filePath.stringByDeletingPathExtension options:cache.config.diskCacheReadingOptions error:nil];
+        }
+        if (data) {
+            break;
+        }
+    }
+    return data ? [[SDWebImageCodersManager sharedInstance] decodedImageWithData:data] : nil;
+}
+
+// wwt 3个只读路径共5万个文件时的查找延迟
+// Lookup latency with 3 read-only paths holding 50k files. The default path is resolved by the manifest
+// and the read-only paths by an index listed once, so a key in the last path, or in no path at all, costs
+// no more probes than a key in the default path. The queries run on the concurrent IO queue, where they have to
+// find the same keys as one by one. The latencies against probing are reported, they do not fail the run.
+- (void)benchmarkReadOnlyPathLookup {
+    static const NSUInteger kFilesPerPath = 16667;
+    static const NSUInteger kLookupCount = 1000;
+    NSData *imageData = SDBenchmarkPNGData(1);
+    NSData *largerImageData = SDBenchmarkPNGData(2);
+
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"lookup" diskCacheDirectory:self.workPath];
+    cache.config.shouldCacheImagesInMemory = NO;
+    cache.config.shouldDecompressImages = NO;
+    NSString *defaultPath = [[cache defaultCachePathForKey:@"key"] stringByDeletingLastPathComponent];
+    NSMutableArray<NSString *> *readOnlyPaths = [NSMutableArray array];
+    NSFileManager *fileManager = [NSFileManager new];
+    NSString *(^keyForItem)(NSString *, NSUInteger) = ^NSString *(NSString *kind, NSUInteger item) {
+        return [NSString stringWithFormat:@"https://example.com/%@/%lu.png", kind, (unsigned long)item];
+    };
+    for (NSUInteger pathIndex = 0; pathIndex < 3; pathIndex++) {
+        NSString *path = [self.workPath stringByAppendingPathComponent:[NSString stringWithFormat:@"bundle%lu", (unsigned long)pathIndex]];
+        [fileManager createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:nil];
+        for (NSUInteger i = 0; i < kFilesPerPath; i++) {
+            NSString *key = keyForItem([NSString stringWithFormat:@"bundle%lu", (unsigned long)pathIndex], i);
+            [fileManager createFileAtPath:[cache cachePathForKey:key inPath:path] contents:imageData attributes:nil];
+        }
+        [readOnlyPaths addObject:path];
+    }
+    // The same key in the first two paths, the first path wins
+    NSString *sharedKey = keyForItem(@"shared", 0);
+    [fileManager createFileAtPath:[cache cachePathForKey:sharedKey inPath:readOnlyPaths[0]] contents:largerImageData attributes:nil];
+    [fileManager createFileAtPath:[cache cachePathForKey:sharedKey inPath:readOnlyPaths[1]] contents:imageData attributes:nil];
+    for (NSUInteger i = 0; i < kLookupCount; i++) {
+        [cache storeImageDataToDisk:imageData forKey:keyForItem(@"default", i)];
+    }
+    for (NSString *path in readOnlyPaths) {
+        [cache addReadOnlyCachePath:path];
+    }
+    NSMutableArray<NSString *> *probePaths = [NSMutableArray arrayWithObject:defaultPath];
+    [probePaths addObjectsFromArray:readOnlyPaths];
+
+    UIImage * (^query)(NSString *) = ^UIImage *(NSString *key) {
+        __block UIImage *image = nil;
+        [cache queryCacheOperationForKey:key options:SDImageCacheQueryDiskSync done:^(UIImage *diskImage, NSData *data, SDImageCacheType cacheType) {
+            image = diskImage;
+        }];
+        return image;
+    };
+
+    // The first query lists the read-only paths
+    CFTimeInterval start = SDBenchmarkNow();
+    UIImage *sharedImage = query(sharedKey);
+    CFTimeInterval indexTime = SDBenchmarkNow() - start;
+
+    NSArray<NSString *> *kinds = @[@"default", @"bundle2", @"missing"];
+    NSMutableArray<NSString *> *allKeys = [NSMutableArray array];
+    CFTimeInterval serialTime = 0;
+    NSUInteger serialFound = 0;
+    for (NSString *kind in kinds) {
+        NSMutableArray<NSNumber *> *latencies = [NSMutableArray arrayWithCapacity:kLookupCount];
+        NSMutableArray<NSNumber *> *probeLatencies = [NSMutableArray arrayWithCapacity:kLookupCount];
+        NSUInteger found = 0, probeFound = 0;
+        for (NSUInteger i = 0; i < kLookupCount; i++) {
+            @autoreleasepool {
+                NSString *key = keyForItem(kind, (i * 7919) % kLookupCount);
+                [allKeys addObject:key];
+                start = SDBenchmarkNow();
+                if (query(key)) {
+                    found++;
+                }
+                CFTimeInterval latency = SDBenchmarkNow() - start;
+                serialTime += latency;
+                [latencies addObject:@(latency)];
+
+                start = SDBenchmarkNow();
+                if (SDBenchmarkProbeImage(cache, probePaths, key)) {
+                    probeFound++;
+                }
+                [probeLatencies addObject:@(SDBenchmarkNow() - start)];
+            }
+        }
+        double median = SDBenchmarkPercentile(latencies, 0.5), probeMedian = SDBenchmarkPercentile(probeLatencies, 0.5);
+        [self log:@"%@: p50=%.1fus p99=%.1fus found=%lu | probing p50=%.1fus p99=%.1fus", kind,
+         median * 1e6, SDBenchmarkPercentile(latencies, 0.99) * 1e6, (unsigned long)found,
+         probeMedian * 1e6, SDBenchmarkPercentile(probeLatencies, 0.99) * 1e6];
+        [self log:@"%@: p50/probing=%.2f", kind, probeMedian > 0 ? median / probeMedian : 0];
+        NSUInteger expectedFound = [kind isEqualToString:@"missing"] ? 0 : kLookupCount;
+        [self expect:found == expectedFound && probeFound == expectedFound format:@"%@: found %lu, probing found %lu, expected %lu", kind, (unsigned long)found, (unsigned long)probeFound, (unsigned long)expectedFound];
+        serialFound += found;
+    }
+
+    // The same queries at once, the IO queue runs them concurrently
+    dispatch_group_t group = dispatch_group_create();
+    __block NSUInteger concurrentFound = 0;
+    start = SDBenchmarkNow();
+    for (NSString *key in allKeys) {
+        dispatch_group_enter(group);
+        [cache queryCacheOperationForKey:key done:^(UIImage *image, NSData *data, SDImageCacheType cacheType) {
+            if (image) {
+                @synchronized (group) {
+                    concurrentFound++;
+                }
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    CFTimeInterval concurrentTime = SDBenchmarkNow() - start;
+
+    [self log:@"files=%lu index=%.1fms queries=%lu serial=%.1fms async=%.1fms async/serial=%.2f",
+     (unsigned long)(3 * kFilesPerPath), indexTime * 1000, (unsigned long)allKeys.count, serialTime * 1000, concurrentTime * 1000,
+     serialTime > 0 ? concurrentTime / serialTime : 0];
+    [self expect:sharedImage.size.width * sharedImage.scale == 2 format:@"the key in two read-only paths is not read from the first path"];
+    [self expect:concurrentFound == serialFound format:@"async queries found %lu, one by one found %lu", (unsigned long)concurrentFound, (unsigned long)serialFound];
+}
+
+#pragma mark - Prefetching
+
+// wwt 使用独立的缓存和下载器创建预加载器，同时下载数与窗口大小相同
+// A prefetcher with its own cache and downloader, downloading up to `window` URLs at a time
+- (SDWebImagePrefetcher *)prefetcherWithNamespace:(NSString *)ns window:(NSUInteger)window {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.HTTPMaximumConnectionsPerHost = window;
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithSessionConfiguration:configuration];
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:ns diskCacheDirectory:self.workPath];
+    SDWebImageManager *manager = [[SDWebImageManager alloc] initWithCache:cache downloader:downloader];
+    SDWebImagePrefetcher *prefetcher = [[SDWebImagePrefetcher alloc] initWithImageManager:manager];
+    prefetcher.maxConcurrentDownloads = window;
+    prefetcher.maxConcurrentPrefetches = window;
+    return prefetcher;
+}
+
+// wwt 预加载一批URL并等待完成，返回完成和跳过的数目
+- (void)prefetchURLs:(NSArray<NSURL *> *)urls
+          prefetcher:(SDWebImagePrefetcher *)prefetcher
+             options:(SDWebImagePrefetcherOptions)options
+       finishedCount:(NSUInteger *)finishedCount
+        skippedCount:(NSUInteger *)skippedCount {
+    __block NSUInteger finished = 0, skipped = 0;
+    SDBenchmarkWait(^(dispatch_block_t done) {
+        [prefetcher prefetchURLs:urls prefetcherOptions:options progress:nil completed:^(NSUInteger noOfFinishedUrls, NSUInteger noOfSkippedUrls) {
+            finished = noOfFinishedUrls;
+            skipped = noOfSkippedUrls;
+            done();
+        }];
+    });
+    if (finishedCount) {
+        *finishedCount = finished;
+    }
+    if (skippedCount) {
+        *skippedCount = skipped;
+    }
+}
+
+// wwt 本地HTTP服务器上预加载N个URL的耗时
+// Time to prefetch N URLs from a local HTTP server answering after 20ms, so a prefetcher loading one
+// URL at a time is latency-bound. The sliding window keeps 8 URLs in flight, which the server sees as the
+// most requests it holds at once; the times are reported, they do not fail the run. Duplicates and memory
+// cache hits must not reach the server, warm-disk-only batches skip what is on disk, and cancelling a
+// batch token stops that batch only.
+- (void)benchmarkPrefetch {
+    static const NSUInteger kURLCount = 200;
+    NSData *imageData = SDBenchmarkPNGData(64);
+    SDBenchmarkHTTPServer *server = [[SDBenchmarkHTTPServer alloc] initWithResponseData:imageData latency:0.02];
+    [self expect:server != nil format:@"failed to start the HTTP server"];
+    if (!server) {
+        return;
+    }
+    NSArray<NSURL *> * (^urlsForBatch)(NSString *, NSUInteger) = ^NSArray<NSURL *> *(NSString *batch, NSUInteger count) {
+        NSMutableArray<NSURL *> *urls = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            [urls addObject:[server URLForPath:[NSString stringWithFormat:@"/%@/%lu.png", batch, (unsigned long)i]]];
+        }
+        return urls;
+    };
+
+    // Prefetch time against the window
+    NSMutableDictionary<NSNumber *, NSNumber *> *times = [NSMutableDictionary dictionary];
+    for (NSNumber *window in @[@1, @3, @8]) {
+        SDWebImagePrefetcher *prefetcher = [self prefetcherWithNamespace:[NSString stringWithFormat:@"window%@", window] window:window.unsignedIntegerValue];
+        NSArray<NSURL *> *urls = urlsForBatch([NSString stringWithFormat:@"window%@", window], kURLCount);
+        NSUInteger requestCount = server.requestCount;
+        server.peakRequestCount = 0;
+        NSUInteger finished = 0;
+        CFTimeInterval start = SDBenchmarkNow();
+        [self prefetchURLs:urls prefetcher:prefetcher options:0 finishedCount:&finished skippedCount:NULL];
+        CFTimeInterval time = SDBenchmarkNow() - start;
+        times[window] = @(time);
+        NSUInteger requests = server.requestCount - requestCount;
+        NSUInteger peakRequests = server.peakRequestCount;
+        [self log:@"window=%@ urls=%lu time=%.0fms (%.1f urls/s) requests=%lu in flight=%lu", window, (unsigned long)kURLCount, time * 1000, kURLCount / time, (unsigned long)requests, (unsigned long)peakRequests];
+        [self expect:finished == kURLCount && requests == kURLCount format:@"window %@: finished %lu with %lu requests", window, (unsigned long)finished, (unsigned long)requests];
+        [self expect:peakRequests == window.unsignedIntegerValue format:@"window %@: %lu requests in flight at most", window, (unsigned long)peakRequests];
+    }
+    double serialTime = times[@1].doubleValue, windowTime = times[@8].doubleValue;
+    [self log:@"window 8/one at a time=%.2f window 8/window 3=%.2f", serialTime > 0 ? windowTime / serialTime : 0, times[@3].doubleValue > 0 ? windowTime / times[@3].doubleValue : 0];
+
+    // Duplicates and memory cache hits
+    SDWebImagePrefetcher *prefetcher = [self prefetcherWithNamespace:@"dedup" window:8];
+    NSArray<NSURL *> *cachedURLs = urlsForBatch(@"dedup", 50);
+    [self prefetchURLs:cachedURLs prefetcher:prefetcher options:0 finishedCount:NULL skippedCount:NULL];
+    NSMutableArray<NSURL *> *urls = [NSMutableArray arrayWithArray:cachedURLs];
+    NSArray<NSURL *> *newURLs = urlsForBatch(@"dedup-new", 50);
+    [urls addObjectsFromArray:newURLs];
+    [urls addObjectsFromArray:newURLs];
+    NSUInteger requestCount = server.requestCount;
+    NSUInteger finished = 0;
+    [self prefetchURLs:urls prefetcher:prefetcher options:0 finishedCount:&finished skippedCount:NULL];
+    NSUInteger dedupRequests = server.requestCount - requestCount;
+    [self log:@"dedup: urls=%lu cached=50 unique new=50 requests=%lu", (unsigned long)urls.count, (unsigned long)dedupRequests];
+    [self expect:finished == urls.count format:@"dedup: finished %lu of %lu", (unsigned long)finished, (unsigned long)urls.count];
+    [self expect:dedupRequests == newURLs.count format:@"dedup: %lu requests for %lu new URLs", (unsigned long)dedupRequests, (unsigned long)newURLs.count];
+
+    // Warm the disk only
+    prefetcher = [self prefetcherWithNamespace:@"warm" window:8];
+    NSArray<NSURL *> *warmURLs = urlsForBatch(@"warm", 100);
+    [self prefetchURLs:warmURLs prefetcher:prefetcher options:SDWebImagePrefetcherWarmDiskOnly finishedCount:NULL skippedCount:NULL];
+    SDImageCache *warmCache = prefetcher.manager.imageCache;
+    NSUInteger onDisk = 0;
+    for (NSURL *url in warmURLs) {
+        if ([warmCache diskImageDataExistsWithKey:[prefetcher.manager cacheKeyForURL:url]]) {
+            onDisk++;
+        }
+    }
+    NSUInteger inMemory = [warmCache getMemoryCount];
+    requestCount = server.requestCount;
+    CFTimeInterval start = SDBenchmarkNow();
+    [self prefetchURLs:warmURLs prefetcher:prefetcher options:SDWebImagePrefetcherWarmDiskOnly finishedCount:&finished skippedCount:NULL];
+    CFTimeInterval warmAgainTime = SDBenchmarkNow() - start;
+    NSUInteger warmAgainRequests = server.requestCount - requestCount;
+    [self log:@"warm disk: on disk=%lu in memory=%lu again=%.1fms requests=%lu", (unsigned long)onDisk, (unsigned long)inMemory, warmAgainTime * 1000, (unsigned long)warmAgainRequests];
+    [self expect:onDisk == warmURLs.count format:@"warm disk: %lu of %lu on disk", (unsigned long)onDisk, (unsigned long)warmURLs.count];
+    [self expect:inMemory == 0 format:@"warm disk: %lu images decoded into memory", (unsigned long)inMemory];
+    [self expect:warmAgainRequests == 0 && finished == warmURLs.count format:@"warm disk again: %lu requests", (unsigned long)warmAgainRequests];
+
+    // Cancel one batch, the other one completes
+    SDBenchmarkHTTPServer *slowServer = [[SDBenchmarkHTTPServer alloc] initWithResponseData:imageData latency:0.2];
+    prefetcher = [self prefetcherWithNamespace:@"cancel" window:4];
+    NSMutableArray<NSURL *> *cancelledURLs = [NSMutableArray array];
+    NSMutableArray<NSURL *> *keptURLs = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 40; i++) {
+        [cancelledURLs addObject:[slowServer URLForPath:[NSString stringWithFormat:@"/cancelled/%lu.png", (unsigned long)i]]];
+        [keptURLs addObject:[slowServer URLForPath:[NSString stringWithFormat:@"/kept/%lu.png", (unsigned long)i]]];
+    }
+    __block BOOL cancelledCompleted = NO;
+    __block SDWebImagePrefetchToken *token = nil;
+    dispatch_sync(dispatch_get_main_queue(), ^{
+        token = [prefetcher prefetchURLs:cancelledURLs prefetcherOptions:0 progress:nil completed:^(NSUInteger noOfFinishedUrls, NSUInteger noOfSkippedUrls) {
+            cancelledCompleted = YES;
+        }];
+    });
+    [NSThread sleepForTimeInterval:0.3];
+    [token cancel];
+    NSUInteger keptFinished = 0;
+    [self prefetchURLs:keptURLs prefetcher:prefetcher options:0 finishedCount:&keptFinished skippedCount:NULL];
+    [NSThread sleepForTimeInterval:0.5];
+    NSUInteger slowRequests = slowServer.requestCount;
+    [self log:@"cancel: requests=%lu of %lu, kept batch finished=%lu", (unsigned long)slowRequests, (unsigned long)(cancelledURLs.count + keptURLs.count), (unsigned long)keptFinished];
+    [self expect:!cancelledCompleted format:@"cancel: the cancelled batch completed"];
+    [self expect:keptFinished == keptURLs.count format:@"cancel: the other batch finished %lu of %lu", (unsigned long)keptFinished, (unsigned long)keptURLs.count];
+    [self expect:slowRequests < cancelledURLs.count + keptURLs.count format:@"cancel: all %lu URLs requested", (unsigned long)slowRequests];
+    [slowServer stop];
+    [server stop];
+}
+
+#pragma mark - Format detection
+
+typedef struct {
+    const char *bytes;
+    size_t length;
+    SDImageFormat format;
+} SDBenchmarkFormatCorpusEntry;
+
+#define SD_CORPUS_ENTRY(bytes, format) {bytes, sizeof(bytes) - 1, format}
+
+// wwt 与YYKitDemo中YYImageBenchmark.m的YYImageTypeCorpus使用相同的文件头，两边的签名表需要保持一致
+// The same headers as YYImageTypeCorpus in YYKitDemo's YYImageBenchmark.m, the two signature tables must agree
+static const SDBenchmarkFormatCorpusEntry SDBenchmarkFormatCorpus[] = {
+    SD_CORPUS_ENTRY("\xFF\xD8\xFF\xE0\0\x10" "JFIF\0\1\1\0\0\1\0\1", SDImageFormatJPEG),
+    SD_CORPUS_ENTRY("\xFF\xD8\xFF\xDB\0\x43\0\x08\x06\x06\x07\x06\x05\x08\x07\x07", SDImageFormatJPEG),
+    SD_CORPUS_ENTRY("\xFF\xD8\0\0\0\0\0\0\0\0\0\0\0\0\0\0", SDImageFormatUndefined), // bare FF D8
+    SD_CORPUS_ENTRY("\x89PNG\r\n\x1A\n\0\0\0\x0D" "IHDR\0\0\0\x10", SDImageFormatPNG),
+    SD_CORPUS_ENTRY("\x89PNG\r\n\x1A\0\0\0\0\x0D" "IHDR\0\0\0\x10", SDImageFormatUndefined), // broken signature
+    SD_CORPUS_ENTRY("GIF89a\x10\0\x10\0\x80\0\0\0\0\0", SDImageFormatGIF),
+    SD_CORPUS_ENTRY("GIF87a\x10\0\x10\0\x80\0\0\0\0\0", SDImageFormatGIF),
+    SD_CORPUS_ENTRY("GIF88a\x10\0\x10\0\x80\0\0\0\0\0", SDImageFormatUndefined),
+    SD_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8 \x18\0\0\0", SDImageFormatWebP),
+    SD_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8L\x18\0\0\0", SDImageFormatWebP),
+    SD_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8X\x0A\0\0\0", SDImageFormatWebP), // animated, alpha
+    SD_CORPUS_ENTRY("RIFF\x24\0\0\0" "WAVEfmt \x10\0\0\0", SDImageFormatUndefined),
+    SD_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPABCD\x10\0\0\0", SDImageFormatUndefined),
+    SD_CORPUS_ENTRY("\0\0\0\x18" "ftypheic\0\0\0\0" "mif1heic", SDImageFormatHEIC),
+    SD_CORPUS_ENTRY("\0\0\0\x18" "ftypheix\0\0\0\0" "mif1heix", SDImageFormatHEIC),
+    SD_CORPUS_ENTRY("\0\0\0\x18" "ftypmif1\0\0\0\0" "mif1heic", SDImageFormatHEIC),
+    SD_CORPUS_ENTRY("\0\0\0\x1C" "ftypavif\0\0\0\0" "avifmif1miaf", SDImageFormatAVIF),
+    SD_CORPUS_ENTRY("\0\0\0\x1C" "ftypmif1\0\0\0\0" "mif1heicavif", SDImageFormatAVIF),
+    SD_CORPUS_ENTRY("\0\0\0\x18" "ftypmp42\0\0\0\0" "mp42isom", SDImageFormatUndefined), // video
+    SD_CORPUS_ENTRY("\0\0\0\x10" "ftypmif1\0\0\0\0" "heic", SDImageFormatUndefined), // brand after the end of box
+    SD_CORPUS_ENTRY("II*\0\x08\0\0\0\x0E\0\0\x01\x03\0\x01\0", SDImageFormatTIFF),
+    SD_CORPUS_ENTRY("MM\0*\0\0\0\x08\0\x0E\x01\0\0\x03\0\0", SDImageFormatTIFF),
+    SD_CORPUS_ENTRY("II\0*\x08\0\0\0\x0E\0\0\x01\x03\0\x01\0", SDImageFormatUndefined),
+    SD_CORPUS_ENTRY("BM\x46\0\0\0\0\0\0\0\x36\0\0\0\x28\0\0\0", SDImageFormatBMP),
+    SD_CORPUS_ENTRY("BM\x46\0\0\0\0\0\0\0\x36\0\0\0\x07\0\0\0", SDImageFormatUndefined), // unknown DIB header
+    SD_CORPUS_ENTRY("\0\0\1\0\1\0\x10\x10\0\0\1\0\x20\0\0\0", SDImageFormatICO),
+    SD_CORPUS_ENTRY("\0\0\1\0\0\0\x10\x10\0\0\1\0\x20\0\0\0", SDImageFormatUndefined), // no image
+    SD_CORPUS_ENTRY("<html><head><title>404</title>", SDImageFormatUndefined),
+};
+
+// wwt 文件头语料库的识别结果和识别耗时
+// Checks sd_imageFormatForImageData: against the header corpus shared with YYKit, and against data
+// encoded by Image/IO, then times the detection.
+- (void)benchmarkFormatDetection {
+    size_t corpusCount = sizeof(SDBenchmarkFormatCorpus) / sizeof(SDBenchmarkFormatCorpus[0]);
+    NSMutableArray<NSData *> *samples = [NSMutableArray array];
+    NSUInteger corpusFailed = 0;
+    for (size_t i = 0; i < corpusCount; i++) {
+        const SDBenchmarkFormatCorpusEntry *entry = &SDBenchmarkFormatCorpus[i];
+        NSData *data = [NSData dataWithBytes:entry->bytes length:entry->length];
+        SDImageFormat format = [NSData sd_imageFormatForImageData:data];
+        if (format != entry->format) {
+            corpusFailed++;
+            [self expect:NO format:@"corpus header %zu detected as %ld, expected %ld", i, (long)format, (long)entry->format];
+        }
+        [samples addObject:data];
+    }
+
+    // The data encoded by Image/IO
+    UIImage *image = SDBenchmarkBitmapImage(16, 16);
+    NSDictionary<NSNumber *, NSString *> *encodedTypes = @{@(SDImageFormatJPEG) : (__bridge NSString *)kUTTypeJPEG,
+                                                           @(SDImageFormatPNG) : (__bridge NSString *)kUTTypePNG,
+                                                           @(SDImageFormatGIF) : (__bridge NSString *)kUTTypeGIF,
+                                                           @(SDImageFormatTIFF) : (__bridge NSString *)kUTTypeTIFF,
+                                                           @(SDImageFormatBMP) : (__bridge NSString *)kUTTypeBMP,
+                                                           @(SDImageFormatICO) : (__bridge NSString *)kUTTypeICO};
+    NSUInteger encodedCount = 0;
+    for (NSNumber *expectedFormat in encodedTypes) {
+        NSMutableData *data = [NSMutableData data];
+        CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, (__bridge CFStringRef)encodedTypes[expectedFormat], 1, NULL);
+        if (!destination) {
+            continue; // not supported to encode on this OS
+        }
+        CGImageDestinationAddImage(destination, image.CGImage, NULL);
+        BOOL finalized = CGImageDestinationFinalize(destination);
+        CFRelease(destination);
+        if (!finalized) {
+            continue;
+        }
+        encodedCount++;
+        SDImageFormat format = [NSData sd_imageFormatForImageData:data];
+        [self expect:format == expectedFormat.integerValue format:@"%@ data detected as %ld", encodedTypes[expectedFormat], (long)format];
+        [samples addObject:data];
+    }
+
+    static const NSUInteger kRounds = 10000;
+    CFTimeInterval start = SDBenchmarkNow();
+    for (NSUInteger round = 0; round < kRounds; round++) {
+        for (NSData *data in samples) {
+            [NSData sd_imageFormatForImageData:data];
+        }
+    }
+    CFTimeInterval time = SDBenchmarkNow() - start;
+    NSUInteger detections = kRounds * samples.count;
+    [self log:@"corpus=%zu wrong=%lu encoded=%lu detection=%.0fns", corpusCount, (unsigned long)corpusFailed, (unsigned long)encodedCount, time / detections * 1e9];
+}
+
+#pragma mark - Large JPEG scale down
+
+typedef struct {
+    size_t width;
+    size_t height;
+} SDBenchmarkPatternInfo;
+
+// wwt 按需生成像素：红色沿x方向渐变，绿色沿y方向渐变，蓝色是64像素的棋盘格
+// RGB pixels generated when Image/IO asks for them, so the source bitmap is never allocated:
+// red grows along x, green along y, and blue is a 64 pixel checkerboard that gives the encoder some detail
+static size_t SDBenchmarkPatternGetBytes(void *info, void *buffer, off_t position, size_t count) {
+    const SDBenchmarkPatternInfo *pattern = info;
+    uint8_t *bytes = buffer;
+    for (size_t i = 0; i < count; i++) {
+        size_t offset = (size_t)position + i;
+        size_t pixel = offset / 3;
+        size_t x = pixel % pattern->width, y = pixel / pattern->width;
+        switch (offset % 3) {
+            case 0: bytes[i] = x * 255 / (pattern->width - 1); break;
+            case 1: bytes[i] = y * 255 / (pattern->height - 1); break;
+            default: bytes[i] = ((x / 64 + y / 64) & 1) ? 200 : 50; break;
+        }
+    }
+    return count;
+}
+
+static NSData *SDBenchmarkLargeJPEGData(size_t width, size_t height, BOOL progressive) {
+    SDBenchmarkPatternInfo info = {width, height};
+    CGDataProviderDirectCallbacks callbacks = {0, NULL, NULL, SDBenchmarkPatternGetBytes, NULL};
+    CGDataProviderRef provider = CGDataProviderCreateDirect(&info, width * height * 3, &callbacks);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef imageRef = CGImageCreate(width, height, 8, 24, width * 3, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaNone, provider, NULL, NO, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, kUTTypeJPEG, 1, NULL);
+    NSDictionary *properties = @{(__bridge NSString *)kCGImageDestinationLossyCompressionQuality : @0.8,
+                                 (__bridge NSString *)kCGImagePropertyJFIFDictionary : @{(__bridge NSString *)kCGImagePropertyJFIFIsProgressive : @(progressive)}};
+    CGImageDestinationAddImage(destination, imageRef, (__bridge CFDictionaryRef)properties);
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    CGImageRelease(imageRef);
+    return finalized ? data : nil;
+}
+
+// wwt 读取图片中心像素的红色和绿色分量
+// The red and green of the pixel at the center of the image
+static void SDBenchmarkCenterPixel(CGImageRef imageRef, uint8_t *red, uint8_t *green) {
+    uint8_t pixel[4] = {0};
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(pixel, 1, 1, 8, 4, colorSpace, kCGBitmapByteOrderDefault | kCGImageAlphaNoneSkipLast);
+    CGColorSpaceRelease(colorSpace);
+    size_t width = CGImageGetWidth(imageRef), height = CGImageGetHeight(imageRef);
+    CGContextDrawImage(context, CGRectMake(-(CGFloat)(width / 2), -(CGFloat)(height / 2), width, height), imageRef);
+    CGContextRelease(context);
+    *red = pixel[0];
+    *green = pixel[1];
+}
+
+// wwt 缩小解码一次，返回输出图片，并记录耗时和内存峰值；fromData为NO时不传原始数据，走分块绘制的旧路径
+// Scales the JPEG down once through the Image/IO coder. Without the data, the coder falls back to tiling over the image.
+- (UIImage *)scaleDownJPEGData:(NSData *)jpegData
+               targetPixelSize:(CGSize)targetPixelSize
+                      fromData:(BOOL)fromData
+                          time:(CFTimeInterval *)time
+                          peak:(uint64_t *)peak {
+    UIImage *scaledImage = nil;
+    @autoreleasepool {
+        // initWithData: only reads the header, the pixels are decoded by the coder
+        UIImage *image = [[UIImage alloc] initWithData:jpegData];
+        NSMutableDictionary<NSString *, NSObject *> *options = [NSMutableDictionary dictionaryWithObject:@YES forKey:SDWebImageCoderScaleDownLargeImagesKey];
+        if (targetPixelSize.width > 0 && targetPixelSize.height > 0) {
+            options[SDWebImageCoderScaleDownTargetPixelSizeKey] = [NSValue valueWithCGSize:targetPixelSize];
+        }
+        NSData *data = fromData ? jpegData : nil;
+        SDBenchmarkMemorySampler *sampler = [SDBenchmarkMemorySampler new];
+        [sampler start];
+        CFTimeInterval start = SDBenchmarkNow();
+        scaledImage = [[SDWebImageImageIOCoder sharedCoder] decompressedImageWithImage:image data:&data options:options];
+        *time = SDBenchmarkNow() - start;
+        *peak = [sampler stop];
+    }
+    return scaledImage;
+}
+
+// wwt 100MP的JPEG直接从数据缩小解码的内存峰值和吞吐量，与没有数据时的分块路径对比
+// Scales a 100 MP JPEG down from its data and reports the peak footprint and the throughput in source megapixels
+// per second. A 25 MP JPEG is also scaled through the tiled fallback, which has to decode the full image first and
+// so has to peak higher; the times of the two paths are reported, they do not fail the run.
+- (void)benchmarkLargeJPEGScaleDown {
+    static const size_t kLargeSide = 10000, kMediumSide = 5000;
+    static const size_t kTargetSide = 2048;
+    static const size_t kBytesPerPixel = 4;
+    CGSize targetPixelSize = CGSizeMake(kTargetSide, kTargetSide);
+
+    NSData *largeData = SDBenchmarkLargeJPEGData(kLargeSide, kLargeSide, NO);
+    NSData *mediumData = SDBenchmarkLargeJPEGData(kMediumSide, kMediumSide, NO);
+    if (!largeData || !mediumData) {
+        [self expect:NO format:@"could not encode the source JPEGs"];
+        return;
+    }
+    double largeMP = kLargeSide * kLargeSide / 1e6, mediumMP = kMediumSide * kMediumSide / 1e6;
+    uint64_t fullBitmapBytes = kLargeSide * kLargeSide * kBytesPerPixel;
+    [self log:@"source=%.0fMP data=%.1fMB full bitmap=%.1fMB", largeMP, SDBenchmarkMB(largeData.length), SDBenchmarkMB(fullBitmapBytes)];
+
+    // The output bitmap plus one stripe of the source, the rest is Image/IO buffers, the re-encoded data and allocator slack
+    uint64_t stripeBytes = kLargeSide * kBytesPerPixel * 16;
+    uint64_t slackBytes = 32 * 1024 * 1024;
+
+    CFTimeInterval targetTime = 0;
+    uint64_t targetPeak = 0;
+    UIImage *targetImage = [self scaleDownJPEGData:largeData targetPixelSize:targetPixelSize fromData:YES time:&targetTime peak:&targetPeak];
+    size_t targetWidth = CGImageGetWidth(targetImage.CGImage), targetHeight = CGImageGetHeight(targetImage.CGImage);
+    uint64_t targetLimit = targetWidth * targetHeight * kBytesPerPixel + stripeBytes + slackBytes;
+    [self log:@"target %zu: output=%zux%zu time=%.0fms %.0fMP/s peak=%.1fMB", kTargetSide, targetWidth, targetHeight, targetTime * 1000, largeMP / targetTime, SDBenchmarkMB(targetPeak)];
+    [self expect:targetWidth == kTargetSide && targetHeight == kTargetSide format:@"target output is %zux%zu", targetWidth, targetHeight];
+    [self expect:targetPeak < targetLimit format:@"target peak %.1fMB over %.1fMB", SDBenchmarkMB(targetPeak), SDBenchmarkMB(targetLimit)];
+    uint8_t red = 0, green = 0;
+    if (targetImage.CGImage) {
+        SDBenchmarkCenterPixel(targetImage.CGImage, &red, &green);
+    }
+    [self expect:abs(red - 127) <= 16 && abs(green - 127) <= 16 format:@"center pixel is (%d, %d), expected about (127, 127)", red, green];
+    targetImage = nil;
+
+    // Without a target the output is limited to kDestImageSizeMB of the coder
+    CFTimeInterval defaultTime = 0;
+    uint64_t defaultPeak = 0;
+    UIImage *defaultImage = [self scaleDownJPEGData:largeData targetPixelSize:CGSizeZero fromData:YES time:&defaultTime peak:&defaultPeak];
+    size_t defaultWidth = CGImageGetWidth(defaultImage.CGImage), defaultHeight = CGImageGetHeight(defaultImage.CGImage);
+    uint64_t defaultBytes = defaultWidth * defaultHeight * kBytesPerPixel;
+    uint64_t defaultLimit = defaultBytes + stripeBytes + slackBytes;
+    [self log:@"default: output=%zux%zu time=%.0fms %.0fMP/s peak=%.1fMB", defaultWidth, defaultHeight, defaultTime * 1000, largeMP / defaultTime, SDBenchmarkMB(defaultPeak)];
+    [self expect:defaultWidth > 0 && defaultWidth < kLargeSide && defaultBytes <= 60 * 1024 * 1024 format:@"default output is %zux%zu", defaultWidth, defaultHeight];
+    [self expect:defaultPeak < defaultLimit format:@"default peak %.1fMB over %.1fMB", SDBenchmarkMB(defaultPeak), SDBenchmarkMB(defaultLimit)];
+    defaultImage = nil;
+
+    // The tiled fallback decodes the full source, so it is compared on a smaller image
+    CFTimeInterval dataTime = 0, tiledTime = 0;
+    uint64_t dataPeak = 0, tiledPeak = 0;
+    UIImage *dataImage = [self scaleDownJPEGData:mediumData targetPixelSize:targetPixelSize fromData:YES time:&dataTime peak:&dataPeak];
+    UIImage *tiledImage = [self scaleDownJPEGData:mediumData targetPixelSize:targetPixelSize fromData:NO time:&tiledTime peak:&tiledPeak];
+    [self log:@"%.0fMP from data: time=%.0fms %.0fMP/s peak=%.1fMB", mediumMP, dataTime * 1000, mediumMP / dataTime, SDBenchmarkMB(dataPeak)];
+    [self log:@"%.0fMP tiled: time=%.0fms %.0fMP/s peak=%.1fMB", mediumMP, tiledTime * 1000, mediumMP / tiledTime, SDBenchmarkMB(tiledPeak)];
+    [self log:@"data/tiled time=%.2f", tiledTime > 0 ? dataTime / tiledTime : 0];
+    [self expect:CGSizeEqualToSize(dataImage.size, tiledImage.size) format:@"data output %@, tiled output %@", NSStringFromCGSize(dataImage.size), NSStringFromCGSize(tiledImage.size)];
+    [self expect:dataPeak < tiledPeak format:@"data peak %.1fMB, tiled peak %.1fMB", SDBenchmarkMB(dataPeak), SDBenchmarkMB(tiledPeak)];
+}
+
+#pragma mark - Progressive download
+
+// wwt 进程使用的CPU时间（用户态加内核态）
+// The CPU time used by the process, user and system
+static CFTimeInterval SDBenchmarkCPUTime(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// wwt 下载一张图片并等待完成，记录进度回调次数、逐步解码出的图片数、CPU时间、内存峰值和耗时
+// Downloads one image and waits for it. Counts the progress callbacks and the partial images, and measures
+// the CPU time, the peak footprint and the wall time of the download.
+- (UIImage *)downloadURL:(NSURL *)url
+              downloader:(SDWebImageDownloader *)downloader
+                 options:(SDWebImageDownloaderOptions)options
+                    data:(NSData **)imageData
+           progressCount:(NSUInteger *)progressCount
+            partialCount:(NSUInteger *)partialCount
+                 cpuTime:(CFTimeInterval *)cpuTime
+                    peak:(uint64_t *)peak
+                    time:(CFTimeInterval *)time {
+    __block UIImage *finalImage = nil;
+    __block NSData *finalData = nil;
+    __block NSUInteger progresses = 0, partials = 0;
+    SDBenchmarkMemorySampler *sampler = [SDBenchmarkMemorySampler new];
+    [sampler start];
+    CFTimeInterval cpuStart = SDBenchmarkCPUTime();
+    CFTimeInterval start = SDBenchmarkNow();
+    SDBenchmarkWait(^(dispatch_block_t done) {
+        [downloader downloadImageWithURL:url options:options progress:^(NSInteger receivedSize, NSInteger expectedSize, NSURL *targetURL) {
+            progresses++; // on the session delegate queue, before the completion
+        } completed:^(UIImage *image, NSData *data, NSError *error, BOOL finished) {
+            if (!finished) {
+                partials++;
+                return;
+            }
+            finalImage = image;
+            finalData = data;
+            done();
+        }];
+    });
+    *time = SDBenchmarkNow() - start;
+    *cpuTime = SDBenchmarkCPUTime() - cpuStart;
+    *peak = [sampler stop];
+    *imageData = finalData;
+    *progressCount = progresses;
+    *partialCount = partials;
+    return finalImage;
+}
+
+// wwt 慢速网络下逐步下载一张大图的CPU时间和内存峰值，与不逐步解码的下载对比
+// Downloads a 12 MP progressive JPEG from a local server that sends it in 200 chunks over about a second,
+// with and without `SDWebImageDownloaderProgressiveDownload`, and reports the CPU time and peak footprint of
+// each download. The progressive decodes are throttled to 16KB and 0.1s instead of one per chunk, so there are no
+// more partial images than 16KB steps of the data; the CPU times are reported, they do not fail the run.
+- (void)benchmarkProgressiveDownload {
+    static const size_t kWidth = 4000, kHeight = 3000;
+    static const NSUInteger kChunkCount = 200;
+    static const NSTimeInterval kChunkInterval = 0.005;
+    NSData *jpegData = SDBenchmarkLargeJPEGData(kWidth, kHeight, YES);
+    if (!jpegData) {
+        [self expect:NO format:@"could not encode the progressive JPEG"];
+        return;
+    }
+    SDBenchmarkHTTPServer *server = [[SDBenchmarkHTTPServer alloc] initWithResponseData:jpegData latency:0];
+    [self expect:server != nil format:@"failed to start the HTTP server"];
+    if (!server) {
+        return;
+    }
+    server.chunkSize = (jpegData.length + kChunkCount - 1) / kChunkCount;
+    server.chunkInterval = kChunkInterval;
+    uint64_t bitmapBytes = kWidth * kHeight * 4;
+    [self log:@"image=%zux%zu data=%.1fMB bitmap=%.1fMB chunk=%luB every %.0fms", kWidth, kHeight, SDBenchmarkMB(jpegData.length), SDBenchmarkMB(bitmapBytes), (unsigned long)server.chunkSize, kChunkInterval * 1000];
+
+    // The CPU time of one full decode, what every chunk would cost without throttling
+    CFTimeInterval decodeStart = SDBenchmarkCPUTime();
+    @autoreleasepool {
+        NSData *data = jpegData;
+        UIImage *image = [[SDWebImageCodersManager sharedInstance] decodedImageWithData:data];
+        image = [[SDWebImageCodersManager sharedInstance] decompressedImageWithImage:image data:&data options:@{SDWebImageCoderScaleDownLargeImagesKey : @NO}];
+    }
+    CFTimeInterval decodeCPU = SDBenchmarkCPUTime() - decodeStart;
+
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithSessionConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    NSData *plainData = nil, *progressiveData = nil;
+    NSUInteger plainProgresses = 0, plainPartials = 0, progressiveProgresses = 0, progressivePartials = 0;
+    CFTimeInterval plainCPU = 0, plainTime = 0, progressiveCPU = 0, progressiveTime = 0;
+    uint64_t plainPeak = 0, progressivePeak = 0;
+    UIImage *plainImage = [self downloadURL:[server URLForPath:@"/plain.jpg"] downloader:downloader options:0 data:&plainData
+                              progressCount:&plainProgresses partialCount:&plainPartials cpuTime:&plainCPU peak:&plainPeak time:&plainTime];
+    plainImage = nil;
+    plainData = nil;
+    UIImage *progressiveImage = [self downloadURL:[server URLForPath:@"/progressive.jpg"] downloader:downloader options:SDWebImageDownloaderProgressiveDownload data:&progressiveData
+                                    progressCount:&progressiveProgresses partialCount:&progressivePartials cpuTime:&progressiveCPU peak:&progressivePeak time:&progressiveTime];
+    [server stop];
+
+    [self log:@"full decode cpu=%.0fms", decodeCPU * 1000];
+    [self log:@"plain: time=%.0fms cpu=%.0fms peak=%.1fMB chunks=%lu", plainTime * 1000, plainCPU * 1000, SDBenchmarkMB(plainPeak), (unsigned long)plainProgresses];
+    [self log:@"progressive: time=%.0fms cpu=%.0fms peak=%.1fMB chunks=%lu partial images=%lu", progressiveTime * 1000, progressiveCPU * 1000, SDBenchmarkMB(progressivePeak), (unsigned long)progressiveProgresses, (unsigned long)progressivePartials];
+    [self log:@"progressive cpu over plain=%.1f full decodes", decodeCPU > 0 ? (progressiveCPU - plainCPU) / decodeCPU : 0];
+
+    [self expect:plainPartials == 0 format:@"plain download returned %lu partial images", (unsigned long)plainPartials];
+    [self expect:progressiveData.length == jpegData.length format:@"downloaded %lu bytes of %lu", (unsigned long)progressiveData.length, (unsigned long)jpegData.length];
+    CGSize pixelSize = CGSizeMake(CGImageGetWidth(progressiveImage.CGImage), CGImageGetHeight(progressiveImage.CGImage));
+    [self expect:CGSizeEqualToSize(pixelSize, CGSizeMake(kWidth, kHeight)) format:@"final image is %@", NSStringFromCGSize(pixelSize)];
+    // Without enough chunks the throttling is not exercised
+    [self expect:progressiveProgresses >= kChunkCount / 4 format:@"only %lu chunks were received", (unsigned long)progressiveProgresses];
+    [self expect:progressivePartials > 0 format:@"no partial image was decoded"];
+    // One decode per chunk at most, and one per 16KB of new data plus the finished one
+    NSUInteger partialLimit = MIN(progressiveProgresses, jpegData.length / (16 * 1024) + 1);
+    [self expect:progressivePartials <= partialLimit format:@"%lu partial images for %lu chunks of %luB, expected at most %lu", (unsigned long)progressivePartials, (unsigned long)progressiveProgresses, (unsigned long)jpegData.length, (unsigned long)partialLimit];
+    // The decodes run one at a time, each holds a snapshot of the data and a few bitmaps
+    uint64_t peakLimit = plainPeak + 3 * bitmapBytes + 16 * 1024 * 1024;
+    [self expect:progressivePeak < peakLimit format:@"progressive peak %.1fMB over %.1fMB", SDBenchmarkMB(progressivePeak), SDBenchmarkMB(peakLimit)];
+}
+
+
+#pragma mark - Decoded bitmaps
+
+// wwt 查询一次，返回图片和是否读取了压缩数据
+// Queries the key on the calling thread, `data` is nil when the image is served from the decoded bitmap
+static UIImage *SDBenchmarkQueryDisk(SDImageCache *cache, NSString *key, NSData **data) {
+    __block UIImage *image = nil;
+    __block NSData *imageData = nil;
+    [cache queryCacheOperationForKey:key options:SDImageCacheQueryDiskSync done:^(UIImage *diskImage, NSData *diskData, SDImageCacheType cacheType) {
+        image = diskImage;
+        imageData = diskData;
+    }];
+    if (data) {
+        *data = imageData;
+    }
+    return image;
+}
+
+// wwt 冷启动查询：映射解码位图 vs 解码压缩数据，以及数据被替换后不会使用旧的位图
+// Cold queries of 300 thumbnails from the decoded bitmaps against decoding the PNG data. A bitmap query reads
+// no compressed data and maps the file, so holding the images costs no anonymous memory. The bitmaps keep the
+// token of the data they are decoded from: after the data is replaced, concurrently with the queries which store
+// bitmaps, every query still returns the latest image.
+- (void)benchmarkDecodedBitmaps {
+    static const NSUInteger kImageCount = 300;
+    static const size_t kImageSize = 200;
+    static const NSUInteger kReplacedCount = 50;
+    NSString *(^keyForItem)(NSUInteger) = ^NSString *(NSUInteger item) {
+        return [NSString stringWithFormat:@"https://example.com/thumbnails/%lu.png", (unsigned long)item];
+    };
+    // the expected red of the image of a seed, see SDBenchmarkBitmapImage
+    int (^redForSeed)(NSUInteger) = ^int(NSUInteger seed) {
+        return (int)lround((seed % 7) / 7.0 * 255);
+    };
+    SDImageCache *(^newCache)(BOOL) = ^SDImageCache *(BOOL bitmaps) {
+        SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"bitmaps" diskCacheDirectory:self.workPath];
+        cache.config.shouldCacheImagesInMemory = NO;
+        cache.config.shouldCacheDecodedBitmaps = bitmaps;
+        return cache;
+    };
+
+    // Store the images, the completion is called once the bitmap is written
+    SDImageCache *cache = newCache(YES);
+    for (NSUInteger i = 0; i < kImageCount; i++) {
+        @autoreleasepool {
+            UIImage *image = SDBenchmarkBitmapImage(kImageSize, i);
+            NSData *data = [[SDWebImageCodersManager sharedInstance] encodedDataWithImage:image format:SDImageFormatPNG];
+            SDBenchmarkWait(^(dispatch_block_t done) {
+                [cache storeImage:image imageData:data forKey:keyForItem(i) toDisk:YES completion:done];
+            });
+        }
+    }
+    NSString *bitmapPath = [[[cache defaultCachePathForKey:@"key"] stringByDeletingLastPathComponent] stringByAppendingPathComponent:@".bitmaps"];
+    NSArray<NSString *> *bitmapFiles = [[NSFileManager new] contentsOfDirectoryAtPath:bitmapPath error:nil];
+    NSUInteger bitmapCount = [bitmapFiles filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"pathExtension == 'bitmap'"]].count;
+    cache = nil;
+
+    // Cold queries, decoding the data and then mapping the bitmaps, holding the images
+    uint64_t decodedBytes = (uint64_t)kImageCount * kImageSize * kImageSize * 4;
+    NSUInteger (^coldQueries)(BOOL, NSUInteger *, CFTimeInterval *, uint64_t *) = ^NSUInteger(BOOL bitmaps, NSUInteger *dataReads, CFTimeInterval *time, uint64_t *peak) {
+        SDImageCache *coldCache = newCache(bitmaps);
+        NSMutableArray<UIImage *> *images = [NSMutableArray arrayWithCapacity:kImageCount];
+        NSUInteger correct = 0;
+        *dataReads = 0;
+        SDBenchmarkMemorySampler *sampler = [SDBenchmarkMemorySampler new];
+        [sampler start];
+        CFTimeInterval start = SDBenchmarkNow();
+        for (NSUInteger i = 0; i < kImageCount; i++) {
+            @autoreleasepool {
+                NSData *data = nil;
+                UIImage *image = SDBenchmarkQueryDisk(coldCache, keyForItem(i), &data);
+                if (image) {
+                    [images addObject:image];
+                }
+                if (data) {
+                    (*dataReads)++;
+                }
+            }
+        }
+        *time = SDBenchmarkNow() - start;
+        *peak = [sampler stop];
+        for (NSUInteger i = 0; i < images.count; i++) {
+            uint8_t red = 0, green = 0;
+            SDBenchmarkCenterPixel(images[i].CGImage, &red, &green);
+            if (abs(red - redForSeed(i)) <= 2) {
+                correct++;
+            }
+        }
+        return correct;
+    };
+    NSUInteger decodeReads = 0, bitmapReads = 0;
+    CFTimeInterval decodeTime = 0, bitmapTime = 0;
+    uint64_t decodePeak = 0, bitmapPeak = 0;
+    NSUInteger decodeCorrect = coldQueries(NO, &decodeReads, &decodeTime, &decodePeak);
+    NSUInteger bitmapCorrect = coldQueries(YES, &bitmapReads, &bitmapTime, &bitmapPeak);
+
+    // Replace the data of some keys while the other keys are queried concurrently, which stores their bitmaps again
+    cache = newCache(YES);
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < kImageCount; i++) {
+        dispatch_group_enter(group);
+        [cache queryCacheOperationForKey:keyForItem(i) done:^(UIImage *image, NSData *data, SDImageCacheType cacheType) {
+            dispatch_group_leave(group);
+        }];
+        if (i < kReplacedCount) {
+            @autoreleasepool {
+                UIImage *image = SDBenchmarkBitmapImage(kImageSize, i + 1);
+                NSData *data = [[SDWebImageCodersManager sharedInstance] encodedDataWithImage:image format:SDImageFormatPNG];
+                dispatch_group_enter(group);
+                [cache storeImage:image imageData:data forKey:keyForItem(i) toDisk:YES completion:^{
+                    dispatch_group_leave(group);
+                }];
+            }
+        }
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    cache = nil;
+    SDImageCache *coldCache = newCache(YES);
+    NSUInteger latest = 0;
+    for (NSUInteger i = 0; i < kImageCount; i++) {
+        @autoreleasepool {
+            UIImage *image = SDBenchmarkQueryDisk(coldCache, keyForItem(i), NULL);
+            uint8_t red = 0, green = 0;
+            SDBenchmarkCenterPixel(image.CGImage, &red, &green);
+            NSUInteger seed = i < kReplacedCount ? i + 1 : i;
+            if (image && abs(red - redForSeed(seed)) <= 2) {
+                latest++;
+            }
+        }
+    }
+
+    [self log:@"images=%lu decoded=%.1fMB bitmap files=%lu", (unsigned long)kImageCount, SDBenchmarkMB(decodedBytes), (unsigned long)bitmapCount];
+    [self log:@"decoding: time=%.1fms peak=%.1fMB data reads=%lu", decodeTime * 1000, SDBenchmarkMB(decodePeak), (unsigned long)decodeReads];
+    [self log:@"bitmaps: time=%.1fms peak=%.1fMB data reads=%lu", bitmapTime * 1000, SDBenchmarkMB(bitmapPeak), (unsigned long)bitmapReads];
+    [self log:@"after replacing %lu keys: %lu of %lu queries return the latest image", (unsigned long)kReplacedCount, (unsigned long)latest, (unsigned long)kImageCount];
+
+    [self expect:bitmapCount == kImageCount format:@"%lu bitmap files for %lu images", (unsigned long)bitmapCount, (unsigned long)kImageCount];
+    [self expect:bitmapFiles.count == bitmapCount format:@"%lu other files left in the bitmap directory", (unsigned long)(bitmapFiles.count - bitmapCount)];
+    [self expect:decodeCorrect == kImageCount && bitmapCorrect == kImageCount format:@"correct images: decoding %lu, bitmaps %lu, expected %lu", (unsigned long)decodeCorrect, (unsigned long)bitmapCorrect, (unsigned long)kImageCount];
+    [self expect:decodeReads == kImageCount format:@"decoding read the data %lu times", (unsigned long)decodeReads];
+    [self expect:bitmapReads == 0 format:@"%lu bitmap queries read the compressed data", (unsigned long)bitmapReads];
+    // The mapped files are clean pages backed by the files, not counted in the footprint
+    [self expect:bitmapPeak < decodedBytes / 2 format:@"bitmap peak %.1fMB, the decoded images are %.1fMB", SDBenchmarkMB(bitmapPeak), SDBenchmarkMB(decodedBytes)];
+    [self expect:latest == kImageCount format:@"%lu queries returned a stale or no image", (unsigned long)(kImageCount - latest)];
+}
+
+@end
+
@@ -7,6 +7,7 @@
 //
 
 #import "ViewController.h"
+#import "SDWebImageBenchmark.h"
 
 @interface ViewController ()
 
@@ -17,6 +18,24 @@
 - (void)viewDidLoad {
     [super viewDidLoad];
     // Do any additional setup after loading the view, typically from a nib.
+    NSString *benchmarkName = [SDWebImageBenchmark benchmarkNameFromLaunchArguments];
+    if (benchmarkName) {
+        [self runBenchmarkNamed:benchmarkName];
+    }
+}
+
+// wwt UI测试通过启动参数运行性能测试，结果显示在标签上
+- (void)runBenchmarkNamed:(NSString *)name {
+    UILabel *resultLabel = [[UILabel alloc] initWithFrame:CGRectInset(self.view.bounds, 16, 40)];
+    resultLabel.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    resultLabel.numberOfLines = 0;
+    resultLabel.font = [UIFont systemFontOfSize:12];
+    resultLabel.accessibilityIdentifier = @"benchmark.result";
+    resultLabel.text = [NSString stringWithFormat:@"RUNNING %@", name];
+    [self.view addSubview:resultLabel];
+    [SDWebImageBenchmark runBenchmarkNamed:name completion:^(BOOL passed, NSString * _Nonnull report) {
+        resultLabel.text = [NSString stringWithFormat:@"%@ %@\n%@", passed ? @"PASS" : @"FAIL", name, report];
+    }];
 }
 
 - (void)didReceiveMemoryWarning {
@@ -21,8 +21,7 @@
     
     // In UI tests it is usually best to stop immediately when a failure occurs.
     self.continueAfterFailure = NO;
-    // UI tests must launch the application that they test. Doing this in setup will make sure it happens for each test method.
-    [[[XCUIApplication alloc] init] launch];
+    // The benchmark tests launch the application themselves, with the benchmark in the launch arguments.
     
     // In UI tests it’s important to set the initial state - such as interface orientation - required for your tests before they run. The setUp method is a good place to do this.
 }
@@ -35,6 +34,70 @@
 - (void)testExample {
     // Use recording to get started writing UI tests.
     // Use XCTAssert and related functions to verify your tests produce the correct results.
+    [[[XCUIApplication alloc] init] launch];
+}
+
+#pragma mark - Benchmarks
+
+// wwt 启动app运行指定的性能测试，等待结果标签显示PASS或FAIL
+// Launches the app running the benchmark (see SDWebImageBenchmark.h) and asserts it passed.
+// The report is kept as an attachment of the test.
+- (void)runBenchmarkNamed:(NSString *)name timeout:(NSTimeInterval)timeout {
+    XCUIApplication *app = [[XCUIApplication alloc] init];
+    app.launchArguments = @[@"-SDWebImageBenchmark", name];
+    [app launch];
+    
+    XCUIElement *resultLabel = app.staticTexts[@"benchmark.result"];
+    NSPredicate *finished = [NSPredicate predicateWithFormat:@"label BEGINSWITH 'PASS' OR label BEGINSWITH 'FAIL'"];
+    [self expectationForPredicate:finished evaluatedWithObject:resultLabel handler:nil];
+    [self waitForExpectationsWithTimeout:timeout handler:nil];
+    
+    NSString *report = resultLabel.label;
+    XCTAttachment *attachment = [XCTAttachment attachmentWithString:report];
+    attachment.name = name;
+    attachment.lifetime = XCTAttachmentLifetimeKeepAlways;
+    [self addAttachment:attachment];
+    XCTAssertTrue([report hasPrefix:@"PASS"], @"%@", report);
+}
+
+- (void)testDiskCleanupBenchmark {
+    [self runBenchmarkNamed:@"DiskCleanup" timeout:300];
+}
+
+- (void)testAdversarialGIFBenchmark {
+    [self runBenchmarkNamed:@"AdversarialGIF" timeout:120];
+}
+
+- (void)testOnDemandFramesBenchmark {
+    [self runBenchmarkNamed:@"OnDemandFrames" timeout:120];
+}
+
+- (void)testFeedScrollBenchmark {
+    [self runBenchmarkNamed:@"FeedScroll" timeout:120];
+}
+
+- (void)testReadOnlyPathLookupBenchmark {
+    [self runBenchmarkNamed:@"ReadOnlyPathLookup" timeout:600];
+}
+
+- (void)testPrefetchBenchmark {
+    [self runBenchmarkNamed:@"Prefetch" timeout:120];
+}
+
+- (void)testFormatDetectionBenchmark {
+    [self runBenchmarkNamed:@"FormatDetection" timeout:120];
+}
+
+- (void)testLargeJPEGScaleDownBenchmark {
+    [self runBenchmarkNamed:@"LargeJPEGScaleDown" timeout:300];
+}
+
+- (void)testProgressiveDownloadBenchmark {
+    [self runBenchmarkNamed:@"ProgressiveDownload" timeout:120];
+}
+
+- (void)testDecodedBitmapsBenchmark {
+    [self runBenchmarkNamed:@"DecodedBitmaps" timeout:300];
 }
 
 @end
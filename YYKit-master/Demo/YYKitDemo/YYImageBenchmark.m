@@ -11,6 +11,9 @@
 #import <ImageIO/ImageIO.h>
 #import <MobileCoreServices/MobileCoreServices.h>
 #import "YYBPGCoder.h"
+#import <mach/mach.h>
+#import <sys/resource.h>
+#import <libkern/OSAtomic.h>
 
 /*
  Enable this value and run in simulator, the image will write to desktop.
@@ -19,6 +22,47 @@
 #define ENABLE_OUTPUT 0
 #define IMAGE_OUTPUT_DIR @"/Users/ibireme/Desktop/image_out/"
 
+/*
+ A local HTTP/2 server for the web image benchmark, it should serve JPEG images
+ at "image/0.jpg" ... "image/199.jpg". For example:
+     h2o, or `caddy file-server --listen :8443` with a self-signed certificate.
+ */
+#define IMAGE_SERVER_URL @"https://localhost:8443/"
+
+
+/// Serves a generated JPEG for "yybench://" URLs and counts the traffic.
+@interface YYBenchmarkURLProtocol : NSURLProtocol
+@end
+
+static NSData *YYBenchmarkURLData;
+static int32_t YYBenchmarkURLRequestCount;
+static int64_t YYBenchmarkURLByteCount;
+static int32_t YYBenchmarkDecodeCount;
+
+@implementation YYBenchmarkURLProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.scheme isEqualToString:@"yybench"];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    OSAtomicIncrement32(&YYBenchmarkURLRequestCount);
+    OSAtomicAdd64(YYBenchmarkURLData.length, &YYBenchmarkURLByteCount);
+    usleep(50 * 1000); // network latency
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{@"Content-Type" : @"image/jpeg", @"Content-Length" : @(YYBenchmarkURLData.length).stringValue}];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:YYBenchmarkURLData];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {}
+
+@end
+
 
 
 @implementation YYImageBenchmark {
@@ -40,6 +84,23 @@
     [self addCell:@"WebP Encode and Decode (Slow)" selector:@selector(runWebPBenchmark)];
     [self addCell:@"BPG Decode" selector:@selector(runBPGBenchmark)];
     [self addCell:@"Animated Image Decode" selector:@selector(runAnimatedImageBenchmark)];
+    [self addCell:@"Downsample Decode (12MP)" selector:@selector(runDownsampleDecodeBenchmark)];
+    [self addCell:@"Tile Decode (40MP, Slow)" selector:@selector(runTileDecodeBenchmark)];
+    [self addCell:@"Incremental Decode (12MP)" selector:@selector(runIncrementalDecodeBenchmark)];
+    [self addCell:@"Animated Encode (120 frames)" selector:@selector(runAnimatedEncodeBenchmark)];
+    [self addCell:@"Image Header Probe" selector:@selector(runImageProbeBenchmark)];
+    [self addCell:@"Request Coalescing" selector:@selector(runRequestCoalescingBenchmark)];
+    [self addCell:@"Web Image Loading (HTTP/2)" selector:@selector(runWebImageLoadingBenchmark)];
+    [self addCell:@"Viewport Scheduling (Scroll Trace)" selector:@selector(runViewportSchedulingBenchmark)];
+    [self addCell:@"Download To Disk Cache (10MB x 8)" selector:@selector(runDownloadToDiskCacheBenchmark)];
+    [self addCell:@"Progressive Blur JPEG (CPU per MB)" selector:@selector(runProgressiveBlurBenchmark)];
+    [self addCell:@"Resumable Download (Scroll Back)" selector:@selector(runResumableDownloadBenchmark)];
+    [self addCell:@"Conditional Revalidation (Refresh)" selector:@selector(runConditionalRevalidationBenchmark)];
+    [self addCell:@"Chained Transforms (Resize+Blur+Corner)" selector:@selector(runChainedTransformBenchmark)];
+    [self addCell:@"Mixed-size Decode Latency (p99)" selector:@selector(runMixedDecodeLatencyBenchmark)];
+    [self addCell:@"Bitmap Buffer Pool (1000 Thumbnails)" selector:@selector(runBitmapBufferPoolBenchmark)];
+    [self addCell:@"Image Type Detection (Fuzz Corpus)" selector:@selector(runImageTypeDetectionBenchmark)];
+    [self addCell:@"Bitmap Disk Tier (Cold Scroll)" selector:@selector(runBitmapDiskTierBenchmark)];
     
     [self.tableView reloadData];
 }
@@ -739,4 +800,1235 @@
 
 }
 
+- (void)runDownsampleDecodeBenchmark {
+    printf("==========================================\n");
+    printf("Downsample Decode Benchmark (12MP photo)\n");
+    
+    /// 4032x3024 (12MP) photo-like image, drawn at runtime to avoid a huge resource file.
+    UIImage *photo = nil;
+    @autoreleasepool {
+        size_t width = 4032, height = 3024;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        CGFloat colors[8] = {0.15, 0.35, 0.60, 1, 0.95, 0.75, 0.40, 1};
+        CGGradientRef gradient = CGGradientCreateWithColorComponents(YYCGColorSpaceGetDeviceRGB(), colors, NULL, 2);
+        CGContextDrawLinearGradient(context, gradient, CGPointZero, CGPointMake(width, height), 0);
+        CGGradientRelease(gradient);
+        srand(12);
+        for (int i = 0; i < 2000; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.5);
+            CGFloat r = 8 + rand() % 120;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        photo = [UIImage imageWithCGImage:imageRef];
+        CFRelease(imageRef);
+    }
+    
+    NSData *jpg = [YYImageEncoder encodeImage:photo type:YYImageTypeJPEG quality:0.9];
+    NSData *png = [YYImageEncoder encodeImage:photo type:YYImageTypePNG quality:1];
+    NSData *webp = YYImageWebPAvailable() ? [YYImageEncoder encodeImage:photo type:YYImageTypeWebP quality:0.8] : nil;
+    NSMutableArray *names = [NSMutableArray arrayWithObjects:@"jpg", @"png", nil];
+    NSMutableArray *datas = [NSMutableArray arrayWithObjects:jpg, png, nil];
+    if (webp) {
+        [names addObject:@"webp"];
+        [datas addObject:webp];
+    }
+    
+    /// 0 means full size, 180 is a 60x60pt avatar on @3x screen.
+    NSArray *maxPixelSizes = @[@0, @1024, @360, @180];
+    int count = 5;
+    
+    printf("type max_px   length  out_w  out_h  memory(KB) decode_time\n");
+    for (int i = 0; i < names.count; i++) {
+        NSString *name = names[i];
+        NSData *data = datas[i];
+        for (NSNumber *maxPixelSize in maxPixelSizes) {
+            __block size_t outWidth = 0, outHeight = 0, memory = 0;
+            YYBenchmark(^{
+                for (int r = 0; r < count; r++) {
+                    @autoreleasepool {
+                        YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:1 maxPixelSize:maxPixelSize.unsignedIntegerValue];
+                        CGImageRef imageRef = [decoder frameAtIndex:0 decodeForDisplay:YES].image.CGImage;
+                        outWidth = CGImageGetWidth(imageRef);
+                        outHeight = CGImageGetHeight(imageRef);
+                        memory = CGImageGetBytesPerRow(imageRef) * outHeight;
+                    }
+                }
+            }, ^(double ms) {
+                printf("%4s %6d %8d %6d %6d %11d %8.3f\n", name.UTF8String, maxPixelSize.intValue, (int)data.length, (int)outWidth, (int)outHeight, (int)(memory / 1024), ms / count);
+            });
+        }
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+/// Current physical memory footprint of the process in bytes.
+static int64_t YYBenchmarkMemoryFootprint() {
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.phys_footprint;
+}
+
+- (void)runTileDecodeBenchmark {
+    printf("==========================================\n");
+    printf("Tile Decode Benchmark (40MP image)\n");
+    
+    /// 7296x5472 (40MP) image, drawn at runtime to avoid a huge resource file.
+    NSData *png = nil, *jpg = nil, *webp = nil;
+    @autoreleasepool {
+        size_t width = 7296, height = 5472;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        CGFloat colors[8] = {0.20, 0.45, 0.30, 1, 0.90, 0.85, 0.55, 1};
+        CGGradientRef gradient = CGGradientCreateWithColorComponents(YYCGColorSpaceGetDeviceRGB(), colors, NULL, 2);
+        CGContextDrawLinearGradient(context, gradient, CGPointZero, CGPointMake(width, height), 0);
+        CGGradientRelease(gradient);
+        srand(40);
+        for (int i = 0; i < 5000; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.5);
+            CGFloat r = 8 + rand() % 200;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        UIImage *image = [UIImage imageWithCGImage:imageRef];
+        CFRelease(imageRef);
+        png = [YYImageEncoder encodeImage:image type:YYImageTypePNG quality:1];
+        jpg = [YYImageEncoder encodeImage:image type:YYImageTypeJPEG quality:0.9];
+        if (YYImageWebPAvailable()) webp = [YYImageEncoder encodeImage:image type:YYImageTypeWebP quality:0.8];
+    }
+    NSMutableArray *names = [NSMutableArray new];
+    NSMutableArray *datas = [NSMutableArray new];
+    if (png) { [names addObject:@"png"]; [datas addObject:png]; }
+    if (jpg) { [names addObject:@"jpg"]; [datas addObject:jpg]; }
+    if (webp) { [names addObject:@"webp"]; [datas addObject:webp]; }
+    
+    printf("type mode          time(ms) bitmap(KB) footprint_delta(KB)\n");
+    for (int i = 0; i < names.count; i++) {
+        NSString *name = names[i];
+        NSData *data = datas[i];
+        
+        // full decode
+        @autoreleasepool {
+            int64_t footprint = YYBenchmarkMemoryFootprint();
+            __block UIImage *image = nil;
+            YYBenchmark(^{
+                image = [[YYImageDecoder decoderWithData:data scale:1] frameAtIndex:0 decodeForDisplay:YES].image;
+            }, ^(double ms) {
+                int64_t delta = YYBenchmarkMemoryFootprint() - footprint;
+                size_t bitmap = CGImageGetBytesPerRow(image.CGImage) * CGImageGetHeight(image.CGImage);
+                printf("%4s %-13s %8.3f %10d %19d\n", name.UTF8String, "full", ms, (int)(bitmap / 1024), (int)(delta / 1024));
+            });
+            image = nil;
+        }
+        
+        // first tile (level 0, top-left), the middle tile, and the overview tile
+        @autoreleasepool {
+            YYImageTileDecoder *decoder = [YYImageTileDecoder decoderWithData:data scale:1];
+            NSUInteger middleColumn = [decoder columnCountAtLevel:0] / 2;
+            NSUInteger middleRow = [decoder rowCountAtLevel:0] / 2;
+            NSArray *modes = @[@"tile_first", @"tile_middle", @"tile_overview"];
+            for (NSString *mode in modes) {
+                int64_t footprint = YYBenchmarkMemoryFootprint();
+                __block UIImage *tile = nil;
+                YYBenchmark(^{
+                    if ([mode isEqualToString:@"tile_first"]) {
+                        tile = [decoder tileAtColumn:0 row:0 level:0];
+                    } else if ([mode isEqualToString:@"tile_middle"]) {
+                        tile = [decoder tileAtColumn:middleColumn row:middleRow level:0];
+                    } else {
+                        tile = [decoder tileAtColumn:0 row:0 level:decoder.maxLevel];
+                    }
+                }, ^(double ms) {
+                    int64_t delta = YYBenchmarkMemoryFootprint() - footprint;
+                    size_t bitmap = CGImageGetBytesPerRow(tile.CGImage) * CGImageGetHeight(tile.CGImage);
+                    printf("%4s %-13s %8.3f %10d %19d\n", name.UTF8String, mode.UTF8String, ms, (int)(bitmap / 1024), (int)(delta / 1024));
+                });
+            }
+        }
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+/// CPU time (user + system) of the process in milliseconds.
+static double YYBenchmarkCPUTime() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+- (void)runIncrementalDecodeBenchmark {
+    printf("==========================================\n");
+    printf("Incremental Decode Benchmark (12MP image, 64KB per update)\n");
+    
+    /// 4032x3024 (12MP) image, drawn at runtime to avoid a huge resource file.
+    NSData *png = nil, *jpg = nil, *webp = nil;
+    @autoreleasepool {
+        size_t width = 4032, height = 3024;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        CGFloat colors[8] = {0.55, 0.20, 0.35, 1, 0.30, 0.80, 0.90, 1};
+        CGGradientRef gradient = CGGradientCreateWithColorComponents(YYCGColorSpaceGetDeviceRGB(), colors, NULL, 2);
+        CGContextDrawLinearGradient(context, gradient, CGPointZero, CGPointMake(width, height), 0);
+        CGGradientRelease(gradient);
+        srand(28);
+        for (int i = 0; i < 2000; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.5);
+            CGFloat r = 8 + rand() % 120;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        
+        // progressive jpeg
+        NSMutableData *jpgData = [NSMutableData new];
+        CGImageDestinationRef destination = CGImageDestinationCreateWithData((CFMutableDataRef)jpgData, kUTTypeJPEG, 1, NULL);
+        if (destination) {
+            NSDictionary *properties = @{(id)kCGImageDestinationLossyCompressionQuality : @(0.9),
+                                         (id)kCGImagePropertyJFIFDictionary : @{(id)kCGImagePropertyJFIFIsProgressive : @(YES)}};
+            CGImageDestinationAddImage(destination, imageRef, (CFDictionaryRef)properties);
+            if (CGImageDestinationFinalize(destination)) jpg = jpgData;
+            CFRelease(destination);
+        }
+        UIImage *image = [UIImage imageWithCGImage:imageRef];
+        CFRelease(imageRef);
+        png = [YYImageEncoder encodeImage:image type:YYImageTypePNG quality:1];
+        if (YYImageWebPAvailable()) webp = [YYImageEncoder encodeImage:image type:YYImageTypeWebP quality:0.8];
+    }
+    NSMutableArray *names = [NSMutableArray new];
+    NSMutableArray *datas = [NSMutableArray new];
+    if (png) { [names addObject:@"png"]; [datas addObject:png]; }
+    if (webp) { [names addObject:@"webp"]; [datas addObject:webp]; }
+    if (jpg) { [names addObject:@"jpg"]; [datas addObject:jpg]; }
+    
+    /*
+     Simulate a download: append 64KB per update and display the partial image
+     every 4 updates. `decoder` is the YYImageDecoder (streaming for PNG/WebP),
+     `imageio` creates the partial image from an incremental CGImageSource, which
+     re-decodes the whole received data for every display.
+     Cumulative CPU time is printed at every 10% of the received bytes.
+     */
+    NSUInteger chunkLength = 64 * 1024;
+    int displayInterval = 4;
+    printf("type received(%%)    bytes decoder_cpu(ms) imageio_cpu(ms) decoded_rows\n");
+    for (int i = 0; i < names.count; i++) {
+        NSString *name = names[i];
+        NSData *data = datas[i];
+        NSUInteger updateCount = (data.length + chunkLength - 1) / chunkLength;
+        double decoderCPU[11] = {0}, imageioCPU[11] = {0};
+        NSUInteger rows[11] = {0};
+        
+        for (int mode = 0; mode < 2; mode++) @autoreleasepool {
+            YYImageDecoder *decoder = [[YYImageDecoder alloc] initWithScale:1];
+            CGImageSourceRef source = CGImageSourceCreateIncremental(NULL);
+            NSMutableData *received = [NSMutableData new];
+            int checkpoint = 1;
+            double begin = YYBenchmarkCPUTime();
+            for (NSUInteger u = 0; u < updateCount; u++) @autoreleasepool {
+                NSUInteger offset = u * chunkLength;
+                [received appendBytes:(const uint8_t *)data.bytes + offset length:MIN(chunkLength, data.length - offset)];
+                BOOL final = received.length == data.length;
+                BOOL display = final || (u % displayInterval == displayInterval - 1);
+                if (mode == 0) {
+                    [decoder updateData:received final:final];
+                    if (display && decoder.frameCount > 0) [decoder frameAtIndex:0 decodeForDisplay:YES];
+                } else if (source) {
+                    CGImageSourceUpdateData(source, (CFDataRef)received, final);
+                    if (display && CGImageSourceGetCount(source) > 0) {
+                        CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, 0, NULL);
+                        CGImageRef decoded = YYCGImageCreateDecodedCopy(imageRef, YES);
+                        if (imageRef) CFRelease(imageRef);
+                        if (decoded) CFRelease(decoded);
+                    }
+                }
+                while (checkpoint <= 10 && received.length * 10 >= data.length * checkpoint) {
+                    double cpu = YYBenchmarkCPUTime() - begin;
+                    if (mode == 0) {
+                        decoderCPU[checkpoint] = cpu;
+                        rows[checkpoint] = decoder.decodedRowCount;
+                    } else {
+                        imageioCPU[checkpoint] = cpu;
+                    }
+                    checkpoint++;
+                }
+            }
+            if (source) CFRelease(source);
+        }
+        for (int c = 1; c <= 10; c++) {
+            printf("%4s %11d %8d %15.1f %15.1f %12d\n", name.UTF8String, c * 10, (int)(data.length * c / 10), decoderCPU[c], imageioCPU[c], (int)rows[c]);
+        }
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runAnimatedEncodeBenchmark {
+    printf("==========================================\n");
+    printf("Animated Encode Benchmark (120 frames, 320x320)\n");
+    
+    /// sticker-like frames, drawn at runtime to avoid a huge resource file.
+    NSMutableArray *frames = [NSMutableArray new];
+    @autoreleasepool {
+        size_t size = 320;
+        srand(29);
+        for (int i = 0; i < 120; i++) {
+            CGContextRef context = CGBitmapContextCreate(NULL, size, size, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+            if (!context) return;
+            for (int c = 0; c < 40; c++) {
+                CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.8);
+                CGFloat r = 16 + rand() % 64;
+                CGFloat angle = (i * 3 + c * 9) * M_PI / 180;
+                CGContextFillEllipseInRect(context, CGRectMake(size / 2 + cos(angle) * c * 3 - r / 2, size / 2 + sin(angle) * c * 3 - r / 2, r, r));
+            }
+            CGImageRef imageRef = CGBitmapContextCreateImage(context);
+            CFRelease(context);
+            [frames addObject:[UIImage imageWithCGImage:imageRef]];
+            CFRelease(imageRef);
+        }
+    }
+    
+    NSMutableArray *types = [NSMutableArray arrayWithObject:@(YYImageTypePNG)];
+    if (YYImageWebPAvailable()) [types addObject:@(YYImageTypeWebP)];
+    NSUInteger coreCount = [NSProcessInfo processInfo].activeProcessorCount;
+    
+    printf("type threads   length  time(ms) speedup identical\n");
+    for (NSNumber *type in types) {
+        NSString *name = type.unsignedIntegerValue == YYImageTypePNG ? @"apng" : @"webp";
+        __block NSData *serial = nil;
+        __block double serialTime = 0;
+        for (NSUInteger threads = 1; threads <= coreCount; threads++) {
+            __block NSData *data = nil;
+            YYBenchmark(^{
+                YYImageEncoder *encoder = [[YYImageEncoder alloc] initWithType:type.unsignedIntegerValue];
+                encoder.maxConcurrentFrameCount = threads;
+                for (UIImage *frame in frames) {
+                    [encoder addImage:frame duration:0.04];
+                }
+                data = [encoder encode];
+            }, ^(double ms) {
+                if (threads == 1) {
+                    serial = data;
+                    serialTime = ms;
+                }
+                printf("%4s %7d %8d %9.3f %7.2f %9s\n", name.UTF8String, (int)threads, (int)data.length, ms, serialTime / ms, [data isEqualToData:serial] ? "yes" : "NO");
+            });
+        }
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runImageProbeBenchmark {
+    printf("==========================================\n");
+    printf("Image Header Probe Benchmark\n");
+    
+    NSArray *files = @[@"mew_baseline.jpg", @"mew_progressive.jpg", @"mew_baseline.png", @"mew_interlaced.png",
+                       @"ermilio.png", @"mew_baseline.gif", @"ermilio.gif", @"google@2x.webp", @"ermilio_q85.webp"];
+    int count = 1000;
+    
+    /// `probe`: YYImageProbeHeader(), `decoder`: create a YYImageDecoder (parse only, no frame decoded).
+    printf("file                   length  width height frames  probe(us) decoder(us)\n");
+    for (NSString *file in files) {
+        NSData *data = [NSData dataNamed:file];
+        if (!data) continue;
+        __block YYImageHeaderInfo info = {0};
+        __block double probeTime = 0, decoderTime = 0;
+        YYBenchmark(^{
+            for (int i = 0; i < count; i++) {
+                YYImageProbeHeader((__bridge CFDataRef)data, &info);
+            }
+        }, ^(double ms) {
+            probeTime = ms * 1000 / count;
+        });
+        YYBenchmark(^{
+            for (int i = 0; i < count; i++) {
+                @autoreleasepool {
+                    YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:1];
+                    [decoder width];
+                }
+            }
+        }, ^(double ms) {
+            decoderTime = ms * 1000 / count;
+        });
+        printf("%-20s %8d %6d %6d %6d %10.3f %11.3f\n", file.UTF8String, (int)data.length, (int)info.width, (int)info.height, (int)info.frameCount, probeTime, decoderTime);
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runRequestCoalescingBenchmark {
+    printf("==========================================\n");
+    printf("Request Coalescing Benchmark\n");
+    
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(1024, 1024), YES, 1);
+    CGContextRef context = UIGraphicsGetCurrentContext();
+    for (int i = 0; i < 64; i++) {
+        [[UIColor colorWithHue:i / 64.0 saturation:0.8 brightness:0.9 alpha:1] setFill];
+        CGContextFillEllipseInRect(context, CGRectMake((i % 8) * 128, (i / 8) * 128, 128 + i, 128 + i));
+    }
+    UIImage *source = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    YYBenchmarkURLData = UIImageJPEGRepresentation(source, 0.9);
+    [NSURLProtocol registerClass:[YYBenchmarkURLProtocol class]];
+    
+    /// 12 views showing the same avatar, plus 4 different images.
+    NSMutableArray *urls = [NSMutableArray new];
+    for (int i = 0; i < 12; i++) [urls addObject:[NSURL URLWithString:@"yybench://image/avatar.jpg"]];
+    for (int i = 0; i < 4; i++) [urls addObject:[NSURL URLWithString:[NSString stringWithFormat:@"yybench://image/%d.jpg", i]]];
+    YYWebImageTransformBlock transform = ^UIImage *(UIImage *image, NSURL *url) {
+        OSAtomicIncrement32(&YYBenchmarkDecodeCount);
+        return image;
+    };
+    
+    printf("coalescing requests  bytes(KB) decodes  time(ms) completions\n");
+    for (int coalescing = 0; coalescing <= 1; coalescing++) {
+        YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:nil queue:[NSOperationQueue new]];
+        manager.coalescesRequests = coalescing;
+        YYBenchmarkURLRequestCount = 0;
+        YYBenchmarkURLByteCount = 0;
+        YYBenchmarkDecodeCount = 0;
+        __block int32_t completions = 0;
+        YYBenchmark(^{
+            dispatch_group_t group = dispatch_group_create();
+            for (NSURL *url in urls) {
+                dispatch_group_enter(group);
+                [manager requestImageWithURL:url options:kNilOptions progress:nil transform:transform completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                    if (stage == YYWebImageStageProgress) return;
+                    if (image) OSAtomicIncrement32(&completions);
+                    dispatch_group_leave(group);
+                }];
+            }
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        }, ^(double ms) {
+            printf("%10s %8d %10.1f %7d %9.3f %11d\n", coalescing ? "on" : "off", YYBenchmarkURLRequestCount,
+                   YYBenchmarkURLByteCount / 1024.0, YYBenchmarkDecodeCount, ms, completions);
+        });
+    }
+    
+    [NSURLProtocol unregisterClass:[YYBenchmarkURLProtocol class]];
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runWebImageLoadingBenchmark {
+    printf("==========================================\n");
+    printf("Web Image Loading Benchmark\n");
+    printf("server: %s\n", IMAGE_SERVER_URL.UTF8String);
+    
+    int count = 200;
+    NSOperationQueue *queue = [NSOperationQueue new];
+    YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:nil queue:queue];
+    YYWebImageOptions options = YYWebImageOptionAllowInvalidSSLCertificates;
+    
+    printf("concurrent images/s  p50(ms)  p95(ms)  p99(ms) failed\n");
+    for (NSNumber *concurrent in @[@4, @16, @64]) {
+        queue.maxConcurrentOperationCount = concurrent.integerValue;
+        double *latency = calloc(count, sizeof(double));
+        __block int32_t failed = 0;
+        dispatch_group_t group = dispatch_group_create();
+        double begin = CACurrentMediaTime();
+        for (int i = 0; i < count; i++) {
+            NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"%@image/%d.jpg?c=%@", IMAGE_SERVER_URL, i, concurrent]];
+            double start = CACurrentMediaTime();
+            dispatch_group_enter(group);
+            [manager requestImageWithURL:url options:options progress:nil transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                if (stage == YYWebImageStageProgress) return;
+                latency[i] = (CACurrentMediaTime() - start) * 1000;
+                if (!image) OSAtomicIncrement32(&failed);
+                dispatch_group_leave(group);
+            }];
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        double time = CACurrentMediaTime() - begin;
+        
+        NSMutableArray *sorted = [NSMutableArray new];
+        for (int i = 0; i < count; i++) [sorted addObject:@(latency[i])];
+        [sorted sortUsingSelector:@selector(compare:)];
+        free(latency);
+        double p50 = [sorted[count * 50 / 100] doubleValue];
+        double p95 = [sorted[count * 95 / 100] doubleValue];
+        double p99 = [sorted[count * 99 / 100] doubleValue];
+        printf("%10d %8.1f %8.2f %8.2f %8.2f %6d\n", concurrent.intValue, count / time, p50, p95, p99, failed);
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runViewportSchedulingBenchmark {
+    printf("==========================================\n");
+    printf("Viewport Scheduling Benchmark\n");
+    printf("server: %s\n", IMAGE_SERVER_URL.UTF8String);
+    
+    /*
+     Replays a fling: a feed of 200 rows (6 rows per screen) scrolls from row 0 to
+     row 150 in 1 second (16ms per frame), then stops. Rows within 1 screen of the
+     viewport request their images, like the cells created by a table view.
+     Measures the time from the end of the scroll until all visible images are loaded.
+     */
+    int rowCount = 200, rowsPerScreen = 6, endRow = 150, frameCount = 60;
+    printf("scheduling  time-to-visible(ms)  requests  cancelled\n");
+    for (int mode = 0; mode <= 1; mode++) {
+        NSOperationQueue *queue = [NSOperationQueue new];
+        queue.maxConcurrentOperationCount = 4;
+        YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:nil queue:queue];
+        NSMutableDictionary *operations = [NSMutableDictionary new];
+        NSMutableSet *loaded = [NSMutableSet new];
+        NSLock *lock = [NSLock new];
+        __block int requests = 0, cancelled = 0;
+        
+        for (int frame = 0; frame <= frameCount; frame++) {
+            int top = endRow * frame / frameCount;
+            for (int row = MAX(top - rowsPerScreen, 0); row < MIN(top + rowsPerScreen * 2, rowCount); row++) {
+                if (operations[@(row)]) continue;
+                NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"%@image/%d.jpg?mode=%d", IMAGE_SERVER_URL, row, mode]];
+                YYWebImageOperation *operation = [manager requestImageWithURL:url options:YYWebImageOptionAllowInvalidSSLCertificates progress:nil transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                    if (stage != YYWebImageStageFinished || !image) return;
+                    [lock lock];
+                    [loaded addObject:@(row)];
+                    [lock unlock];
+                }];
+                if (operation) operations[@(row)] = operation;
+                requests++;
+            }
+            if (mode == 1) {
+                [operations enumerateKeysAndObjectsUsingBlock:^(NSNumber *key, YYWebImageOperation *operation, BOOL *stop) {
+                    int row = key.intValue;
+                    BOOL visible = row >= top && row < top + rowsPerScreen;
+                    CGFloat distance = row < top ? (top - row) / (CGFloat)rowsPerScreen : (row - top - rowsPerScreen) / (CGFloat)rowsPerScreen;
+                    if (![manager updateOperation:operation visible:visible distanceToViewport:MAX(distance, 0)]) cancelled++;
+                }];
+            }
+            usleep(16 * 1000);
+        }
+        
+        double begin = CACurrentMediaTime();
+        BOOL done = NO;
+        while (!done && CACurrentMediaTime() - begin < 30) {
+            done = YES;
+            [lock lock];
+            for (int row = endRow; row < endRow + rowsPerScreen; row++) {
+                if (![loaded containsObject:@(row)]) done = NO;
+            }
+            [lock unlock];
+            if (!done) usleep(1000);
+        }
+        double time = (CACurrentMediaTime() - begin) * 1000;
+        printf("%10s %20.1f %9d %10d%s\n", mode ? "viewport" : "fifo", time, requests, cancelled, done ? "" : " (timeout)");
+        [queue cancelAllOperations];
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runDownloadToDiskCacheBenchmark {
+    printf("==========================================\n");
+    printf("Download To Disk Cache Benchmark\n");
+    printf("server: %s (image/large/0.jpg ... image/large/7.jpg, ~10MB each)\n", IMAGE_SERVER_URL.UTF8String);
+    
+    /// `memory`: the response is accumulated in memory and copied to disk cache,
+    /// `file`: the response is written to a temporary file and moved into disk cache.
+    printf("sink    peak(MB)  time(ms) failed\n");
+    for (int mode = 0; mode <= 1; mode++) {
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"yy_download_benchmark_%d", mode]];
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        YYImageCache *cache = [[YYImageCache alloc] initWithPath:path];
+        YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:cache queue:[NSOperationQueue new]];
+        YYWebImageOptions options = YYWebImageOptionAllowInvalidSSLCertificates | YYWebImageOptionIgnoreImageDecoding;
+        /// with `YYWebImageOptionIgnoreDiskCache` the whole response is kept in memory as before
+        if (mode == 0) options |= YYWebImageOptionIgnoreDiskCache;
+        
+        __block int64_t peak = 0;
+        __block BOOL sampling = YES;
+        int64_t base = YYBenchmarkMemoryFootprint();
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+            while (sampling) {
+                int64_t footprint = YYBenchmarkMemoryFootprint() - base;
+                if (footprint > peak) peak = footprint;
+                usleep(2000);
+            }
+        });
+        
+        __block int32_t failed = 0;
+        dispatch_group_t group = dispatch_group_create();
+        double begin = CACurrentMediaTime();
+        for (int i = 0; i < 8; i++) {
+            NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"%@image/large/%d.jpg?mode=%d", IMAGE_SERVER_URL, i, mode]];
+            dispatch_group_enter(group);
+            [manager requestImageWithURL:url options:options progress:nil transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                if (stage == YYWebImageStageProgress) return;
+                if (!image) OSAtomicIncrement32(&failed);
+                dispatch_group_leave(group);
+            }];
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        double time = (CACurrentMediaTime() - begin) * 1000;
+        sampling = NO;
+        usleep(10000);
+        printf("%6s %9.1f %9.1f %6d\n", mode ? "file" : "memory", peak / 1024.0 / 1024.0, time, failed);
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    }
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runProgressiveBlurBenchmark {
+    printf("==========================================\n");
+    printf("Progressive Blur JPEG Benchmark (12MP progressive JPEG, file URL)\n");
+    
+    NSData *jpg = nil;
+    @autoreleasepool {
+        size_t width = 4032, height = 3024;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        srand(35);
+        for (int i = 0; i < 4000; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.6);
+            CGFloat r = 8 + rand() % 160;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        NSMutableData *jpgData = [NSMutableData new];
+        CGImageDestinationRef destination = CGImageDestinationCreateWithData((CFMutableDataRef)jpgData, kUTTypeJPEG, 1, NULL);
+        if (destination) {
+            NSDictionary *properties = @{(id)kCGImageDestinationLossyCompressionQuality : @(0.95),
+                                         (id)kCGImagePropertyJFIFDictionary : @{(id)kCGImagePropertyJFIFIsProgressive : @(YES)}};
+            CGImageDestinationAddImage(destination, imageRef, (CFDictionaryRef)properties);
+            if (CGImageDestinationFinalize(destination)) jpg = jpgData;
+            CFRelease(destination);
+        }
+        CFRelease(imageRef);
+    }
+    if (!jpg) return;
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_progressive_benchmark.jpg"];
+    [jpg writeToFile:path atomically:YES];
+    NSURL *url = [NSURL fileURLWithPath:path];
+    double mb = jpg.length / 1024.0 / 1024.0;
+    
+    /// `cpu/MB`: process CPU time (all threads) per MB received.
+    printf("option         size(MB)  cpu(ms)  cpu/MB(ms)  progressive images\n");
+    NSArray *names = @[@"none", @"progressive", @"blur"];
+    YYWebImageOptions optionList[] = {kNilOptions, YYWebImageOptionProgressive, YYWebImageOptionProgressiveBlur};
+    for (int i = 0; i < 3; i++) {
+        YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:nil queue:nil];
+        manager.coalescesRequests = NO;
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        __block int progressCount = 0;
+        double begin = YYBenchmarkCPUTime();
+        [manager requestImageWithURL:url options:optionList[i] | YYWebImageOptionIgnoreImageDecoding progress:nil transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+            if (stage == YYWebImageStageProgress) {
+                progressCount++;
+            } else {
+                dispatch_semaphore_signal(semaphore);
+            }
+        }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        double cpu = YYBenchmarkCPUTime() - begin;
+        printf("%-12s %9.2f %8.1f %11.1f %19d\n", ((NSString *)names[i]).UTF8String, mb, cpu, cpu / mb, progressCount);
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    
+    printf("------------------------------------------\n\n");
+}
+
+
+- (void)runResumableDownloadBenchmark {
+    printf("==========================================\n");
+    printf("Resumable Download Benchmark\n");
+    printf("server: %s (image/large/0.jpg ... image/large/7.jpg, with byte range support)\n", IMAGE_SERVER_URL.UTF8String);
+    
+    /*
+     Scroll-back: each image is cancelled after half of it is received (scrolled
+     past), then requested again (scrolled back). The result is compared with the
+     image data downloaded in one request.
+     */
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_resume_benchmark"];
+    NSString *referencePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_resume_benchmark_ref"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:referencePath error:NULL];
+    YYImageCache *cache = [[YYImageCache alloc] initWithPath:path];
+    YYImageCache *referenceCache = [[YYImageCache alloc] initWithPath:referencePath];
+    YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:cache queue:nil];
+    YYWebImageManager *referenceManager = [[YYWebImageManager alloc] initWithCache:referenceCache queue:nil];
+    YYWebImageOptions options = YYWebImageOptionAllowInvalidSSLCertificates | YYWebImageOptionIgnoreImageDecoding;
+    
+    printf("image   size(KB) first(KB) resumed(KB) second(KB) saved(KB) identical\n");
+    int64_t totalSaved = 0, totalSize = 0;
+    for (int i = 0; i < 8; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"%@image/large/%d.jpg", IMAGE_SERVER_URL, i]];
+        NSString *key = [manager cacheKeyForURL:url];
+        
+        // the first request, cancelled at 50%
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        __block NSInteger firstReceived = 0;
+        __block __weak YYWebImageOperation *weakOperation = nil;
+        YYWebImageOperation *operation = [manager requestImageWithURL:url options:options progress:^(NSInteger receivedSize, NSInteger expectedSize) {
+            firstReceived = receivedSize;
+            if (expectedSize > 0 && receivedSize >= expectedSize / 2) [weakOperation cancel];
+        } transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+            if (stage != YYWebImageStageProgress) dispatch_semaphore_signal(semaphore);
+        }];
+        weakOperation = operation;
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        usleep(100 * 1000); // wait for the partial data to be saved
+        
+        // scroll back: the second request resumes from the saved data
+        __block NSInteger resumed = -1, expected = 0;
+        [manager requestImageWithURL:url options:options progress:^(NSInteger receivedSize, NSInteger expectedSize) {
+            if (resumed < 0 && receivedSize > 0) resumed = receivedSize; // the saved data is reported first
+            expected = expectedSize;
+        } transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+            if (stage != YYWebImageStageProgress) dispatch_semaphore_signal(semaphore);
+        }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        
+        [referenceManager requestImageWithURL:url options:options progress:nil transform:nil completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+            if (stage != YYWebImageStageProgress) dispatch_semaphore_signal(semaphore);
+        }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        usleep(100 * 1000); // wait for the disk cache
+        
+        NSData *data = (id)[cache.diskCache objectForKey:key];
+        NSData *reference = (id)[referenceCache.diskCache objectForKey:key];
+        /// if the first chunk after the response is not the saved data (server ignores range), nothing is saved
+        NSInteger saved = (resumed > 0 && resumed <= firstReceived) ? resumed : 0;
+        totalSaved += saved;
+        totalSize += reference.length;
+        printf("%5d %10.1f %9.1f %11.1f %10.1f %9.1f %9s\n", i, reference.length / 1024.0, firstReceived / 1024.0, saved / 1024.0,
+               (expected - saved) / 1024.0, saved / 1024.0, (data && [data isEqualToData:reference]) ? "yes" : "NO");
+    }
+    printf("saved %.1f KB of %.1f KB (%.1f%%)\n", totalSaved / 1024.0, totalSize / 1024.0, totalSize ? totalSaved * 100.0 / totalSize : 0);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:referencePath error:NULL];
+    
+    printf("------------------------------------------\n\n");
+}
+
+- (void)runConditionalRevalidationBenchmark {
+    printf("==========================================\n");
+    printf("Conditional Revalidation Benchmark\n");
+    printf("server: %s (image/0.jpg ... image/31.jpg, with ETag or Last-Modified)\n", IMAGE_SERVER_URL.UTF8String);
+    
+    /*
+     Load the images into an empty cache, then refresh all of them with
+     YYWebImageOptionRefreshImageCache. With validators in the disk cache the
+     refresh sends conditional requests, unchanged images get `304 Not Modified`
+     and are read from cache; without cache every refresh downloads the image.
+     */
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_revalidation_benchmark"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    YYImageCache *cache = [[YYImageCache alloc] initWithPath:path];
+    YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:cache queue:nil];
+    YYWebImageManager *noCacheManager = [[YYWebImageManager alloc] initWithCache:nil queue:nil];
+    YYWebImageOptions options = YYWebImageOptionAllowInvalidSSLCertificates;
+    int count = 32;
+    
+    NSMutableArray *urls = [NSMutableArray new];
+    for (int i = 0; i < count; i++) {
+        [urls addObject:[NSURL URLWithString:[NSString stringWithFormat:@"%@image/%d.jpg", IMAGE_SERVER_URL, i]]];
+    }
+    
+    // returns the received bytes, the number of images from cache, and the time
+    void (^load)(YYWebImageManager *, YYWebImageOptions, int64_t *, int *, double *) = ^(YYWebImageManager *loader, YYWebImageOptions loadOptions, int64_t *bytes, int *cached, double *time) {
+        __block int64_t receivedBytes = 0;
+        __block int32_t fromCache = 0;
+        dispatch_group_t group = dispatch_group_create();
+        double begin = CACurrentMediaTime();
+        for (NSURL *url in urls) {
+            dispatch_group_enter(group);
+            __block NSInteger received = 0;
+            [loader requestImageWithURL:url options:loadOptions progress:^(NSInteger receivedSize, NSInteger expectedSize) {
+                received = receivedSize;
+            } transform:nil completion:^(UIImage *image, NSURL *imageURL, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                if (stage == YYWebImageStageProgress) return;
+                OSAtomicAdd64(received, &receivedBytes);
+                if (image && (from == YYWebImageFromDiskCache || from == YYWebImageFromMemoryCache)) OSAtomicIncrement32(&fromCache);
+                dispatch_group_leave(group);
+            }];
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        *time = (CACurrentMediaTime() - begin) * 1000;
+        *bytes = receivedBytes;
+        *cached = fromCache;
+    };
+    
+    int64_t bytes = 0;
+    int cached = 0;
+    double time = 0;
+    printf("mode                  received(KB)  304/cache  time(ms)\n");
+    load(manager, options, &bytes, &cached, &time);
+    printf("first load            %12.1f %10d %9.2f\n", bytes / 1024.0, cached, time);
+    usleep(200 * 1000); // wait for the disk cache
+    [cache.memoryCache removeAllObjects];
+    load(manager, options | YYWebImageOptionRefreshImageCache, &bytes, &cached, &time);
+    printf("refresh (conditional) %12.1f %10d %9.2f\n", bytes / 1024.0, cached, time);
+    load(noCacheManager, options | YYWebImageOptionRefreshImageCache, &bytes, &cached, &time);
+    printf("refresh (no cache)    %12.1f %10d %9.2f\n", bytes / 1024.0, cached, time);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    
+    printf("------------------------------------------\n\n");
+}
+
+- (void)runChainedTransformBenchmark {
+    printf("==========================================\n");
+    printf("Chained Transform Benchmark (1024x768 JPEG, resize 100x100 + blur 4 + corner 8)\n");
+    
+    NSData *jpg = nil;
+    @autoreleasepool {
+        size_t width = 1024, height = 768;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        srand(38);
+        for (int i = 0; i < 500; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.6);
+            CGFloat r = 8 + rand() % 120;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        jpg = UIImageJPEGRepresentation([UIImage imageWithCGImage:imageRef], 0.9);
+        CFRelease(imageRef);
+    }
+    if (!jpg) return;
+    
+    CGSize cellSize = CGSizeMake(100, 100);
+    YYWebImageTransformBlock block = ^UIImage *(UIImage *image, NSURL *url) {
+        image = [image imageByResizeToSize:cellSize contentMode:UIViewContentModeScaleAspectFill];
+        image = [image imageByBlurRadius:4 tintColor:nil tintMode:kCGBlendModeNormal saturation:1 maskImage:nil];
+        return [image imageByRoundCornerRadius:8];
+    };
+    YYWebImageTransformer *transformer = [YYWebImageTransformer transformerWithTransformers:@[
+        [YYWebImageTransformer resizeTransformerWithSize:cellSize contentMode:UIViewContentModeScaleAspectFill],
+        [YYWebImageTransformer blurTransformerWithRadius:4],
+        [YYWebImageTransformer roundCornerTransformerWithRadius:8 borderWidth:0 borderColor:nil]]];
+    
+    // render: the three steps one by one (UIImage+YYAdd) vs fused in one render pass
+    UIImage *image = [[YYImage imageWithData:jpg scale:2] imageByDecoded];
+    int count = 100;
+    printf("render          time/cell(ms)\n");
+    YYBenchmark(^{
+        for (int i = 0; i < count; i++) {
+            @autoreleasepool { block(image, nil); }
+        }
+    }, ^(double ms) {
+        printf("chained blocks %14.3f\n", ms / count);
+    });
+    YYBenchmark(^{
+        for (int i = 0; i < count; i++) {
+            @autoreleasepool { [transformer transformImage:image url:nil]; }
+        }
+    }, ^(double ms) {
+        printf("fused pass     %14.3f\n", ms / count);
+    });
+    
+    // cells: 32 images, loaded once, then scrolled back 3 times with the memory cache cleared (cold memory hit)
+    int cellCount = 32;
+    NSMutableArray *urls = [NSMutableArray new];
+    for (int i = 0; i < cellCount; i++) {
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"yy_transform_benchmark_%d.jpg", i]];
+        [jpg writeToFile:path atomically:YES];
+        [urls addObject:[NSURL fileURLWithPath:path]];
+    }
+    printf("cells (%d)       first(ms)  cold memory(ms/round)  second transform(ms)\n", cellCount);
+    for (int mode = 0; mode < 2; mode++) {
+        NSString *cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_transform_benchmark_cache"];
+        [[NSFileManager defaultManager] removeItemAtPath:cachePath error:NULL];
+        YYImageCache *cache = [[YYImageCache alloc] initWithPath:cachePath];
+        YYWebImageManager *manager = [[YYWebImageManager alloc] initWithCache:cache queue:nil];
+        double (^load)(YYWebImageTransformer *, YYWebImageTransformBlock) = ^double(YYWebImageTransformer *oneTransformer, YYWebImageTransformBlock oneBlock) {
+            dispatch_group_t group = dispatch_group_create();
+            double begin = CACurrentMediaTime();
+            for (NSURL *url in urls) {
+                dispatch_group_enter(group);
+                YYWebImageCompletionBlock completion = ^(UIImage *result, NSURL *imageURL, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+                    if (stage != YYWebImageStageProgress) dispatch_group_leave(group);
+                };
+                if (oneTransformer) {
+                    [manager requestImageWithURL:url options:kNilOptions maxPixelSize:0 progress:nil transformer:oneTransformer completion:completion];
+                } else {
+                    [manager requestImageWithURL:url options:kNilOptions progress:nil transform:oneBlock completion:completion];
+                }
+            }
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+            return (CACurrentMediaTime() - begin) * 1000;
+        };
+        YYWebImageTransformer *useTransformer = mode ? transformer : nil;
+        double first = load(useTransformer, block);
+        usleep(200 * 1000); // wait for the disk cache
+        double cold = 0;
+        for (int round = 0; round < 3; round++) {
+            [cache.memoryCache removeAllObjects];
+            cold += load(useTransformer, block);
+        }
+        // another cell style of the same images (larger corner)
+        YYWebImageTransformer *otherTransformer = [transformer transformerByAppendingTransformer:[YYWebImageTransformer roundCornerTransformerWithRadius:20 borderWidth:0 borderColor:nil]];
+        double second = load(mode ? otherTransformer : nil, ^UIImage *(UIImage *one, NSURL *url) {
+            return [block(one, url) imageByRoundCornerRadius:20];
+        });
+        printf("%-15s %9.2f %22.2f %21.2f\n", mode ? "transformer" : "transform block", first, cold / 3, second);
+        [[NSFileManager defaultManager] removeItemAtPath:cachePath error:NULL];
+    }
+    for (NSURL *url in urls) [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+    
+    printf("------------------------------------------\n\n");
+}
+
+static int YYBenchmarkCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+- (void)runMixedDecodeLatencyBenchmark {
+    printf("==========================================\n");
+    printf("Mixed-size Decode Latency Benchmark (10%% 4032x3024 + 90%% 200x200 JPEG)\n");
+    
+    NSData *(^makeJPEG)(size_t, size_t) = ^NSData *(size_t width, size_t height) {
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return nil;
+        for (int i = 0; i < 200; i++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.6);
+            CGFloat r = 4 + rand() % (width / 4);
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        NSData *data = UIImageJPEGRepresentation([UIImage imageWithCGImage:imageRef], 0.9);
+        CFRelease(imageRef);
+        return data;
+    };
+    srand(39);
+    NSData *large = makeJPEG(4032, 3024);
+    NSData *small = makeJPEG(200, 200);
+    if (!large || !small) return;
+    
+    // the tasks are submitted at once, a large task every 10 tasks
+    int count = 200;
+    double *latencies = malloc(count * sizeof(double));
+    double *smallLatencies = malloc(count * sizeof(double));
+    if (!latencies || !smallLatencies) {
+        free(latencies);
+        free(smallLatencies);
+        return;
+    }
+    printf("scheduler          total(ms)   p50(ms)   p99(ms)  p99 small(ms)\n");
+    for (int mode = 0; mode < 3; mode++) {
+        dispatch_group_t group = dispatch_group_create();
+        double begin = CACurrentMediaTime();
+        for (int i = 0; i < count; i++) {
+            NSData *data = (i % 10 == 0) ? large : small;
+            dispatch_group_enter(group);
+            dispatch_block_t block = ^{
+                @autoreleasepool {
+                    YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:2];
+                    [decoder frameAtIndex:0 decodeForDisplay:YES];
+                }
+                latencies[i] = (CACurrentMediaTime() - begin) * 1000;
+                dispatch_group_leave(group);
+            };
+            switch (mode) {
+                case 0: dispatch_async(YYDispatchQueueGetForQOS(NSQualityOfServiceUtility), block); break; // serial queue pool
+                case 1: dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), block); break;
+                default: YYDispatchExecutorAsync(NSQualityOfServiceUtility, block); break;
+            }
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        double total = (CACurrentMediaTime() - begin) * 1000;
+        
+        int smallCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (i % 10 != 0) smallLatencies[smallCount++] = latencies[i];
+        }
+        qsort(latencies, count, sizeof(double), YYBenchmarkCompareDouble);
+        qsort(smallLatencies, smallCount, sizeof(double), YYBenchmarkCompareDouble);
+        const char *names[] = {"serial queue pool", "global queue", "executor"};
+        printf("%-17s %10.2f %9.2f %9.2f %14.2f\n", names[mode], total,
+               latencies[count / 2], latencies[count * 99 / 100], smallLatencies[smallCount * 99 / 100]);
+    }
+    free(latencies);
+    free(smallLatencies);
+    
+    printf("------------------------------------------\n\n");
+}
+
+/// Minor page faults of the process.
+static long YYBenchmarkPageFaults() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_minflt;
+}
+
+- (void)runBitmapBufferPoolBenchmark {
+    printf("==========================================\n");
+    printf("Bitmap Buffer Pool Benchmark (1000 thumbnail decodes, 4 sizes)\n");
+    
+    // thumbnails of a feed: a few same sizes, decoded and then evicted from memory cache
+    NSMutableArray *thumbnails = [NSMutableArray new];
+    CGSize sizes[] = {{300, 300}, {300, 225}, {225, 300}, {600, 400}};
+    srand(40);
+    for (int i = 0; i < 4; i++) {
+        size_t width = sizes[i].width, height = sizes[i].height;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        for (int n = 0; n < 100; n++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.6);
+            CGFloat r = 4 + rand() % 80;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        NSData *jpg = UIImageJPEGRepresentation([UIImage imageWithCGImage:imageRef], 0.8);
+        CFRelease(imageRef);
+        if (!jpg) return;
+        [thumbnails addObject:jpg];
+    }
+    
+    YYImageBufferPool *pool = [YYImageBufferPool sharedPool];
+    NSUInteger costLimit = pool.costLimit;
+    int count = 1000;
+    printf("pool        time(ms)  allocations  reused  page faults\n");
+    for (int mode = 0; mode < 2; mode++) {
+        [pool removeAllBuffers];
+        pool.costLimit = mode ? costLimit : 0;
+        NSUInteger allocations = pool.allocationCount;
+        NSUInteger reused = pool.reuseCount;
+        long faults = YYBenchmarkPageFaults();
+        YYBenchmark(^{
+            for (int i = 0; i < count; i++) {
+                @autoreleasepool {
+                    NSData *jpg = thumbnails[i % thumbnails.count];
+                    YYImageDecoder *decoder = [YYImageDecoder decoderWithData:jpg scale:2];
+                    [decoder frameAtIndex:0 decodeForDisplay:YES];
+                }
+            }
+        }, ^(double ms) {
+            printf("%-9s %10.2f %12lu %7lu %12ld\n", mode ? "enabled" : "disabled", ms,
+                   (unsigned long)(pool.allocationCount - allocations),
+                   (unsigned long)(pool.reuseCount - reused),
+                   YYBenchmarkPageFaults() - faults);
+        });
+    }
+    pool.costLimit = costLimit;
+    
+    printf("------------------------------------------\n\n");
+}
+
+/// A header with the type it must be detected as. The same corpus is checked against
+/// `sd_imageFormatForImageData:` by the FormatDetection benchmark of SDWebImageParse, so the two signature tables can't drift.
+/// Only the formats known by both libraries are here (no ICNS, CUR or JPEG 2000), and every
+/// header is at least 16 bytes (YYImageDetectType needs 16 bytes, SDWebImage doesn't).
+typedef struct {
+    const char *bytes;
+    size_t length;
+    YYImageType type;
+} YYImageTypeCorpusEntry;
+
+#define YY_CORPUS_ENTRY(bytes, type) {bytes, sizeof(bytes) - 1, type}
+
+static const YYImageTypeCorpusEntry YYImageTypeCorpus[] = {
+    YY_CORPUS_ENTRY("\xFF\xD8\xFF\xE0\0\x10" "JFIF\0\1\1\0\0\1\0\1", YYImageTypeJPEG),
+    YY_CORPUS_ENTRY("\xFF\xD8\xFF\xDB\0\x43\0\x08\x06\x06\x07\x06\x05\x08\x07\x07", YYImageTypeJPEG),
+    YY_CORPUS_ENTRY("\xFF\xD8\0\0\0\0\0\0\0\0\0\0\0\0\0\0", YYImageTypeUnknown), // bare FF D8
+    YY_CORPUS_ENTRY("\x89PNG\r\n\x1A\n\0\0\0\x0D" "IHDR\0\0\0\x10", YYImageTypePNG),
+    YY_CORPUS_ENTRY("\x89PNG\r\n\x1A\0\0\0\0\x0D" "IHDR\0\0\0\x10", YYImageTypeUnknown), // broken signature
+    YY_CORPUS_ENTRY("GIF89a\x10\0\x10\0\x80\0\0\0\0\0", YYImageTypeGIF),
+    YY_CORPUS_ENTRY("GIF87a\x10\0\x10\0\x80\0\0\0\0\0", YYImageTypeGIF),
+    YY_CORPUS_ENTRY("GIF88a\x10\0\x10\0\x80\0\0\0\0\0", YYImageTypeUnknown),
+    YY_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8 \x18\0\0\0", YYImageTypeWebP),
+    YY_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8L\x18\0\0\0", YYImageTypeWebP),
+    YY_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPVP8X\x0A\0\0\0", YYImageTypeWebP), // animated, alpha
+    YY_CORPUS_ENTRY("RIFF\x24\0\0\0" "WAVEfmt \x10\0\0\0", YYImageTypeUnknown),
+    YY_CORPUS_ENTRY("RIFF\x24\0\0\0" "WEBPABCD\x10\0\0\0", YYImageTypeUnknown),
+    YY_CORPUS_ENTRY("\0\0\0\x18" "ftypheic\0\0\0\0" "mif1heic", YYImageTypeHEIC),
+    YY_CORPUS_ENTRY("\0\0\0\x18" "ftypheix\0\0\0\0" "mif1heix", YYImageTypeHEIC),
+    YY_CORPUS_ENTRY("\0\0\0\x18" "ftypmif1\0\0\0\0" "mif1heic", YYImageTypeHEIC),
+    YY_CORPUS_ENTRY("\0\0\0\x1C" "ftypavif\0\0\0\0" "avifmif1miaf", YYImageTypeAVIF),
+    YY_CORPUS_ENTRY("\0\0\0\x1C" "ftypmif1\0\0\0\0" "mif1heicavif", YYImageTypeAVIF),
+    YY_CORPUS_ENTRY("\0\0\0\x18" "ftypmp42\0\0\0\0" "mp42isom", YYImageTypeUnknown), // video
+    YY_CORPUS_ENTRY("\0\0\0\x10" "ftypmif1\0\0\0\0" "heic", YYImageTypeUnknown), // brand after the end of box
+    YY_CORPUS_ENTRY("II*\0\x08\0\0\0\x0E\0\0\x01\x03\0\x01\0", YYImageTypeTIFF),
+    YY_CORPUS_ENTRY("MM\0*\0\0\0\x08\0\x0E\x01\0\0\x03\0\0", YYImageTypeTIFF),
+    YY_CORPUS_ENTRY("II\0*\x08\0\0\0\x0E\0\0\x01\x03\0\x01\0", YYImageTypeUnknown),
+    YY_CORPUS_ENTRY("BM\x46\0\0\0\0\0\0\0\x36\0\0\0\x28\0\0\0", YYImageTypeBMP),
+    YY_CORPUS_ENTRY("BM\x46\0\0\0\0\0\0\0\x36\0\0\0\x07\0\0\0", YYImageTypeUnknown), // unknown DIB header
+    YY_CORPUS_ENTRY("\0\0\1\0\1\0\x10\x10\0\0\1\0\x20\0\0\0", YYImageTypeICO),
+    YY_CORPUS_ENTRY("\0\0\1\0\0\0\x10\x10\0\0\1\0\x20\0\0\0", YYImageTypeUnknown), // no image
+    YY_CORPUS_ENTRY("<html><head><title>404</title>", YYImageTypeUnknown),
+};
+
+/// Returns the count of corpus entries detected as a wrong type.
+static int YYImageTypeCheckCorpus(void) {
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(YYImageTypeCorpus) / sizeof(YYImageTypeCorpus[0]); i++) {
+        const YYImageTypeCorpusEntry *entry = &YYImageTypeCorpus[i];
+        CFDataRef data = CFDataCreateWithBytesNoCopy(NULL, (const UInt8 *)entry->bytes, entry->length, kCFAllocatorNull);
+        YYImageType type = YYImageDetectType(data);
+        CFRelease(data);
+        if (type != entry->type) {
+            printf("corpus #%zu: detected %s, expected %s\n", i,
+                   (YYImageTypeGetExtension(type) ?: @"unknown").UTF8String,
+                   (YYImageTypeGetExtension(entry->type) ?: @"unknown").UTF8String);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+- (void)runImageTypeDetectionBenchmark {
+    printf("==========================================\n");
+    printf("Image Type Detection Benchmark (signature table, mutated corpus)\n");
+    
+    // every corpus entry must be detected as its expected type
+    int corpusFailed = YYImageTypeCheckCorpus();
+    printf("corpus: %d headers, %d wrong\n", (int)(sizeof(YYImageTypeCorpus) / sizeof(YYImageTypeCorpus[0])), corpusFailed);
+    NSAssert(corpusFailed == 0, @"%d corpus headers detected as a wrong type", corpusFailed);
+    
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(16, 16), NO, 1);
+    [[UIColor orangeColor] setFill];
+    UIRectFill(CGRectMake(0, 0, 8, 16));
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    
+    // valid samples of every type the encoder can write
+    YYImageType types[] = {YYImageTypeJPEG, YYImageTypePNG, YYImageTypeGIF, YYImageTypeWebP, YYImageTypeTIFF, YYImageTypeBMP, YYImageTypeICO, YYImageTypeJPEG2000};
+    NSMutableArray *samples = [NSMutableArray new];
+    NSMutableArray *expected = [NSMutableArray new];
+    int failed = 0;
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (types[i] == YYImageTypeWebP && !YYImageWebPAvailable()) continue;
+        NSData *data = [YYImageEncoder encodeImage:image type:types[i] quality:0.9];
+        if (data.length < 16) continue;
+        YYImageType type = YYImageDetectType((__bridge CFDataRef)data);
+        if (type != types[i]) failed++;
+        printf("%-6s %6lu bytes  detected: %s\n", YYImageTypeGetExtension(types[i]).UTF8String,
+               (unsigned long)data.length, type == types[i] ? "yes" : "NO");
+        [samples addObject:data];
+        [expected addObject:@(types[i])];
+    }
+    if (samples.count == 0) return;
+    
+    // fuzz: flip bytes in the header of a valid sample, or use random noise;
+    // a result is wrong when it is neither the original type nor unknown
+    srand(47);
+    int count = 200000, misclassified = 0, noiseHits = 0;
+    uint8_t buffer[64];
+    for (int i = 0; i < count; i++) {
+        NSUInteger index = rand() % samples.count;
+        NSData *sample = samples[index];
+        size_t length = MIN(sample.length, sizeof(buffer));
+        [sample getBytes:buffer length:length];
+        if (i % 2) {
+            for (int n = 1 + rand() % 3; n > 0; n--) buffer[rand() % 16] ^= 1 << (rand() % 8);
+        } else {
+            for (size_t n = 0; n < sizeof(buffer); n++) buffer[n] = rand();
+            length = 16 + rand() % (sizeof(buffer) - 15);
+        }
+        CFDataRef data = CFDataCreateWithBytesNoCopy(NULL, buffer, length, kCFAllocatorNull);
+        YYImageType type = YYImageDetectType(data);
+        CFRelease(data);
+        if (i % 2) {
+            if (type != YYImageTypeUnknown && type != [expected[index] unsignedIntegerValue]) misclassified++;
+        } else {
+            if (type != YYImageTypeUnknown) noiseHits++;
+        }
+    }
+    printf("fuzz: %d mutated headers, %d misclassified; %d random headers, %d detected as image\n",
+           count / 2, misclassified, count / 2, noiseHits);
+    
+    // detection speed over the valid samples
+    int loop = 1000000;
+    __block NSUInteger sink = 0;
+    YYBenchmark(^{
+        for (int i = 0; i < loop; i++) {
+            sink ^= YYImageDetectType((__bridge CFDataRef)samples[i % samples.count]);
+        }
+    }, ^(double ms) {
+        printf("detect: %d calls  %8.2f ms  %6.1f ns/call\n", loop, ms, ms * 1e6 / loop);
+    });
+    if (failed) printf("%d valid samples not detected\n", failed);
+    NSAssert(failed == 0, @"%d encoded samples detected as a wrong type", failed);
+    
+    printf("------------------------------------------\n\n");
+}
+
+- (void)runBitmapDiskTierBenchmark {
+    printf("==========================================\n");
+    printf("Bitmap Disk Tier Benchmark (cold scroll of 200 thumbnails, time to pixel)\n");
+    
+    /*
+     A cold scroll after relaunch: nothing in memory cache, every thumbnail is
+     fetched from disk and its pixels are read once (as Core Animation does).
+     Without the bitmap tier the JPEG is read and decoded, with it the bitmap
+     file is mapped and the CGImage is created over the mapping.
+     */
+    int count = 200;
+    NSMutableArray *thumbnails = [NSMutableArray new];
+    srand(50);
+    for (int i = 0; i < 8; i++) {
+        size_t width = 300, height = 300;
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipFirst);
+        if (!context) return;
+        for (int n = 0; n < 100; n++) {
+            CGContextSetRGBFillColor(context, rand() % 256 / 255.0, rand() % 256 / 255.0, rand() % 256 / 255.0, 0.6);
+            CGFloat r = 4 + rand() % 80;
+            CGContextFillEllipseInRect(context, CGRectMake(rand() % width, rand() % height, r, r));
+        }
+        CGImageRef imageRef = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+        NSData *jpg = UIImageJPEGRepresentation([UIImage imageWithCGImage:imageRef], 0.8);
+        CFRelease(imageRef);
+        if (!jpg) return;
+        [thumbnails addObject:jpg];
+    }
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"yy_bitmap_tier_benchmark"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    YYImageCache *cache = [[YYImageCache alloc] initWithPath:path];
+    cache.bitmapCacheEnabled = YES;
+    for (int i = 0; i < count; i++) {
+        NSString *key = [NSString stringWithFormat:@"thumbnail_%d", i];
+        [cache setImage:nil imageData:thumbnails[i % thumbnails.count] forKey:key withType:YYImageCacheTypeDisk];
+    }
+    // the first launch decodes from disk and writes the bitmaps in background
+    for (int i = 0; i < count; i++) {
+        [cache getImageForKey:[NSString stringWithFormat:@"thumbnail_%d", i] withType:YYImageCacheTypeDisk];
+    }
+    for (int wait = 0; wait < 100 && cache.bitmapCache.totalCount < count; wait++) {
+        [NSThread sleepForTimeInterval:0.1];
+    }
+    printf("bitmap files: %ld  (%.2f MB)\n", (long)cache.bitmapCache.totalCount, cache.bitmapCache.totalCost / 1024.0 / 1024.0);
+    
+    printf("tier        time(ms)  per image(ms)  page faults\n");
+    for (int mode = 0; mode < 2; mode++) {
+        cache.bitmapCacheEnabled = mode == 1;
+        [cache.memoryCache removeAllObjects];
+        long faults = YYBenchmarkPageFaults();
+        YYBenchmark(^{
+            for (int i = 0; i < count; i++) {
+                @autoreleasepool {
+                    UIImage *image = [cache getImageForKey:[NSString stringWithFormat:@"thumbnail_%d", i] withType:YYImageCacheTypeDisk];
+                    CFDataRef pixels = CGDataProviderCopyData(CGImageGetDataProvider(image.CGImage));
+                    if (pixels) CFRelease(pixels);
+                }
+            }
+        }, ^(double ms) {
+            printf("%-9s %10.2f %14.3f %12ld\n", mode ? "bitmap" : "decode", ms, ms / count, YYBenchmarkPageFaults() - faults);
+        });
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    
+    printf("------------------------------------------\n\n");
+}
+
 @end
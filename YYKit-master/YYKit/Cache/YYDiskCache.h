@@ -173,6 +173,27 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property BOOL errorLogsEnabled;
 
+/**
+ Set `YES` to map the cached files into memory instead of reading them. Default is NO.
+ 
+ 设置成YES，文件缓存使用mmap读取，不拷贝到内存
+ 
+ @discussion A mapped value shares the pages with the file system cache. It's only
+ safe when the values are always written with `setObjectWithFileAtPath:extendedData:forKey:`,
+ which replaces the file by rename, because a file rewritten in place would change
+ (or truncate) the mapped data.
+ */
+@property BOOL mappedFileRead;
+
+/**
+ A counter increased every time objects may be removed from the cache (remove, remove
+ all, or trim), it's not increased when an object is replaced. A caller can remember
+ the keys it has found in the cache, and check them again only after the counter changes.
+ 
+ 移除或修剪缓存时增加的计数（替换对象时不增加），调用者可以记住已经确认存在的key，计数变化后再重新检查
+ */
+@property (readonly) NSUInteger removalCount;
+
 #pragma mark - Initializer
 ///=============================================================================
 /// @name Initializer
@@ -251,6 +272,28 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)containsObjectForKey:(NSString *)key withBlock:(void(^)(NSString *key, BOOL contains))block;
 
+/**
+ Returns the extended data of the value associated with a given key, without 
+ reading the value. This method may blocks the calling thread until the database
+ read finished.
+ 
+ 根据key获取扩展数据，不读取缓存的值（会阻塞线程）
+ 
+ @param key A string identifying the value. If nil, just return nil.
+ @return The extended data, or nil if not exists.
+ */
+- (nullable NSData *)extendedDataForKey:(NSString *)key;
+
+/**
+ Updates the access time of the value associated with a given key, so it's treated
+ as recently used by the LRU trim. The value is not read.
+ 
+ 更新指定key的访问时间，不读取缓存的值
+ 
+ @param key A string identifying the value. If nil, this method has no effect.
+ */
+- (void)touchObjectForKey:(NSString *)key;
+
 /**
  Returns the value associated with a given key.
  This method may blocks the calling thread until file read finished.
@@ -298,6 +341,34 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)setObject:(nullable id<NSCoding>)object forKey:(NSString *)key withBlock:(void(^)(void))block;
 
+/**
+ Returns a new path for a temporary file in the `tmp/` directory of the cache path
+ (nil if the cache has been released). Write the archived value to this file, then
+ pass it to `setObjectWithFileAtPath:extendedData:forKey:`. Files not set are
+ removed the next time a cache is created with this path.
+ 
+ 返回缓存目录下tmp/中一个临时文件的路径，没有使用的文件在下次创建缓存时删除
+ */
+- (nullable NSString *)temporaryFilePath;
+
+/**
+ Sets the content of a file as the archived value of the specified key in the cache.
+ The file is moved into the cache without copying, and removed if failed.
+ This method may blocks the calling thread until the database write finished.
+ 
+ 将文件的内容作为归档后的数据缓存，文件会被移动到缓存目录中，不需要把数据读入内存
+ 
+ @discussion The content is returned by `customUnarchiveBlock` (or NSKeyedUnarchiver)
+ when read, so the file should contain the archived value. It's typically used
+ with an identity archive block, like YYImageCache.
+ 
+ @param path         A file path returned by `temporaryFilePath`.
+ @param extendedData The extended data (pass nil to ignore it).
+ @param key          The key with which to associate the value.
+ @return Whether succeed.
+ */
+- (BOOL)setObjectWithFileAtPath:(NSString *)path extendedData:(nullable NSData *)extendedData forKey:(NSString *)key;
+
 /**
  Removes the value of the specified key in the cache.
  This method may blocks the calling thread until file delete finished.
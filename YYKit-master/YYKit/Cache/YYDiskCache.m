@@ -15,6 +15,7 @@
 #import "UIDevice+YYAdd.h"
 #import <objc/runtime.h>
 #import <time.h>
+#import <libkern/OSAtomic.h>
 
 // 信号量锁
 #define Lock() dispatch_semaphore_wait(self->_lock, DISPATCH_TIME_FOREVER)
@@ -74,6 +75,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     YYKVStorage *_kv;
     dispatch_semaphore_t _lock;
     dispatch_queue_t _queue;
+    volatile int32_t _removalCount; ///< changed with lock
 }
 
 // 根据自动修剪周期，递归的修剪缓存
@@ -105,6 +107,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 // 限制缓存到指定的大小
 - (void)_trimToCost:(NSUInteger)costLimit {
     if (costLimit >= INT_MAX) return;
+    OSAtomicIncrement32Barrier(&_removalCount);
     [_kv removeItemsToFitSize:(int)costLimit];
     
 }
@@ -112,12 +115,14 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 // 限制缓存到指定的数量
 - (void)_trimToCount:(NSUInteger)countLimit {
     if (countLimit >= INT_MAX) return;
+    OSAtomicIncrement32Barrier(&_removalCount);
     [_kv removeItemsToFitCount:(int)countLimit];
 }
 
 // 限制缓存到指定的时间
 - (void)_trimToAge:(NSTimeInterval)ageLimit {
     if (ageLimit <= 0) {
+        OSAtomicIncrement32Barrier(&_removalCount);
         [_kv removeAllItems];
         return;
     }
@@ -125,6 +130,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     if (timestamp <= ageLimit) return;
     long age = timestamp - ageLimit;
     if (age >= INT_MAX) return;
+    OSAtomicIncrement32Barrier(&_removalCount);
     [_kv removeItemsEarlierThanTime:(int)age];
 }
 
@@ -228,6 +234,21 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     return contains;
 }
 
+- (NSData *)extendedDataForKey:(NSString *)key {
+    if (!key) return nil;
+    Lock();
+    YYKVStorageItem *item = [_kv getItemInfoForKey:key];
+    Unlock();
+    return item.extendedData;
+}
+
+- (void)touchObjectForKey:(NSString *)key {
+    if (!key) return;
+    Lock();
+    [_kv touchItemForKey:key];
+    Unlock();
+}
+
 // 根据key判断是否有相应的缓存，异步执行，在blcok中回调
 - (void)containsObjectForKey:(NSString *)key withBlock:(void(^)(NSString *key, BOOL contains))block {
     if (!block) return;
@@ -318,6 +339,30 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     Unlock();
 }
 
+- (NSString *)temporaryFilePath {
+    Lock();
+    NSString *path = [_kv temporaryFilePath];
+    Unlock();
+    return path;
+}
+
+// 将文件的内容作为归档后的数据缓存，文件被移动到缓存目录中
+- (BOOL)setObjectWithFileAtPath:(NSString *)path extendedData:(NSData *)extendedData forKey:(NSString *)key {
+    if (!key || !path) return NO;
+    NSString *filename = nil;
+    if (_kv.type != YYKVStorageTypeSQLite) {
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL];
+        if (attributes.fileSize > _inlineThreshold) {
+            filename = [self _filenameForKey:key];
+        }
+    }
+    
+    Lock();
+    BOOL suc = [_kv saveItemWithKey:key fileAtPath:path filename:filename extendedData:extendedData];
+    Unlock();
+    return suc;
+}
+
 // 异步的缓存对象，成功的时候回调
 - (void)setObject:(id<NSCoding>)object forKey:(NSString *)key withBlock:(void(^)(void))block {
     __weak typeof(self) _self = self;
@@ -332,6 +377,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 - (void)removeObjectForKey:(NSString *)key {
     if (!key) return;
     Lock();
+    OSAtomicIncrement32Barrier(&_removalCount);
     [_kv removeItemForKey:key];
     Unlock();
 }
@@ -349,6 +395,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
 // 移除所有缓存
 - (void)removeAllObjects {
     Lock();
+    OSAtomicIncrement32Barrier(&_removalCount);
     [_kv removeAllItems];
     Unlock();
 }
@@ -374,6 +421,7 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
             return;
         }
         Lock();
+        OSAtomicIncrement32Barrier(&_removalCount);
         [_kv removeAllItemsWithProgressBlock:progress endBlock:end];
         Unlock();
     });
@@ -500,4 +548,22 @@ static void _YYDiskCacheSetGlobal(YYDiskCache *cache) {
     Unlock();
 }
 
+// 设置是否使用mmap读取文件
+- (BOOL)mappedFileRead {
+    Lock();
+    BOOL mapped = _kv.mappedFileRead;
+    Unlock();
+    return mapped;
+}
+
+- (void)setMappedFileRead:(BOOL)mappedFileRead {
+    Lock();
+    _kv.mappedFileRead = mappedFileRead;
+    Unlock();
+}
+
+- (NSUInteger)removalCount {
+    return (uint32_t)OSAtomicAdd32Barrier(0, &_removalCount);
+}
+
 @end
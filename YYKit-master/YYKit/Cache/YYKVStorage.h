@@ -106,6 +106,8 @@ typedef NS_ENUM(NSUInteger, YYKVStorageType) {
 @property (nonatomic, readonly) YYKVStorageType type;  ///< The type of this storage.
 // 是否允许错误日志
 @property (nonatomic) BOOL errorLogsEnabled;           ///< Set `YES` to enable error logs for debug.
+// 是否使用mmap读取文件，只有文件从不被原地改写时才是安全的
+@property (nonatomic) BOOL mappedFileRead;             ///< Set `YES` to map the files instead of reading them. Default is NO. Only safe when files are written with `saveItemWithKey:fileAtPath:filename:extendedData:`, which replaces them by rename.
 
 #pragma mark - Initializer
 ///=============================================================================
@@ -205,6 +207,42 @@ typedef NS_ENUM(NSUInteger, YYKVStorageType) {
                filename:(nullable NSString *)filename
            extendedData:(nullable NSData *)extendedData;
 
+/**
+ Returns a new path for a temporary file in the `tmp/` directory of the storage
+ path. Write the value to this file and pass it to
+ `saveItemWithKey:fileAtPath:filename:extendedData:`.
+ 
+ 返回存储目录下tmp/中一个临时文件的路径，写入后可以直接移动到缓存中，不需要再复制数据；
+ 没有保存的文件在下次创建存储时被移到垃圾文件夹并删除
+ 
+ @discussion The temporary file is on the same volume as the cached files, so it
+ can be moved into the storage without copying. `tmp/` is not the trash directory,
+ so emptying the trash never removes a file being written. Files not saved are
+ moved from `tmp/` to the trash and removed the next time the storage is created.
+ */
+- (NSString *)temporaryFilePath;
+
+/**
+ Save an item with the content of a file, or update the item with 'key' if it already exists.
+ The file is moved into the storage, you should not use the `path` after this call.
+ 
+ 将文件的内容保存为一个item，文件会被移动到缓存目录中（失败时会被删除）
+ 
+ @discussion If the `type` is YYKVStorageTypeSQLite or the `filename` is empty, 
+ the file is read and saved to sqlite, then removed.
+ 
+ @param key           The key, should not be empty (nil or zero length).
+ @param path          The file path, typically returned by `temporaryFilePath`.
+ @param filename      The filename.
+ @param extendedData  The extended data for this item (pass nil to ignore it).
+ 
+ @return Whether succeed.
+ */
+- (BOOL)saveItemWithKey:(NSString *)key
+             fileAtPath:(NSString *)path
+               filename:(nullable NSString *)filename
+           extendedData:(nullable NSData *)extendedData;
+
 #pragma mark - Remove Items
 ///=============================================================================
 /// @name Remove Items
@@ -385,6 +423,17 @@ typedef NS_ENUM(NSUInteger, YYKVStorageType) {
  */
 - (BOOL)itemExistsForKey:(NSString *)key;
 
+/**
+ Update the last access time of an item to now, without reading its value.
+ 
+ 更新指定key的最后访问时间，不读取数据
+ 
+ @param key  A specified key.
+ 
+ @return `YES` if succeed, `NO` if an error occurs.
+ */
+- (BOOL)touchItemForKey:(NSString *)key;
+
 /**
  Get total item count.
  获取缓存的数量
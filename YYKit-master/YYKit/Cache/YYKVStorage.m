@@ -34,6 +34,8 @@ static NSString *const kDBWalFileName = @"manifest.sqlite-wal";
 static NSString *const kDataDirectoryName = @"data";
 // 销毁目录的名字
 static NSString *const kTrashDirectoryName = @"trash";
+// 临时文件目录的名字
+static NSString *const kTempDirectoryName = @"tmp";
 
 /*
  File:
@@ -46,6 +48,8 @@ static NSString *const kTrashDirectoryName = @"trash";
            /e10adc3949ba59abbe56e057f20f883e
       /trash/
             /unused_file_or_folder
+      /tmp/
+          /temporary_file_being_written
  
  SQL:
  create table if not exists manifest (
@@ -71,6 +75,7 @@ static NSString *const kTrashDirectoryName = @"trash";
     NSString *_dbPath;    // 数据库路径
     NSString *_dataPath;  // 文件缓存路径
     NSString *_trashPath; // 删除所有缓存文件的时候先讲缓存目录下的文件移动到这个目录再删除，以实现快速清除缓存
+    NSString *_tempPath;  // 正在写入的临时文件，清空垃圾文件夹时不受影响
     
     sqlite3 *_db;
     CFMutableDictionaryRef _dbStmtCache;  // sql的stmt缓存，根据sql缓存，不需要每次都重新创建stmt，提高效率
@@ -244,6 +249,11 @@ static NSString *const kTrashDirectoryName = @"trash";
 
 // 根据key进行缓存
 - (BOOL)_dbSaveWithKey:(NSString *)key value:(NSData *)value fileName:(NSString *)fileName extendedData:(NSData *)extendedData {
+    return [self _dbSaveWithKey:key value:value size:(int)value.length fileName:fileName extendedData:extendedData];
+}
+
+// 保存数据，文件缓存时value可以为nil，size为文件的大小
+- (BOOL)_dbSaveWithKey:(NSString *)key value:(NSData *)value size:(int)size fileName:(NSString *)fileName extendedData:(NSData *)extendedData {
     // 这里的?1代表第一个参数，为下边的绑定做准备
     NSString *sql = @"insert or replace into manifest (key, filename, size, inline_data, modification_time, last_access_time, extended_data) values (?1, ?2, ?3, ?4, ?5, ?6, ?7);";
     sqlite3_stmt *stmt = [self _dbPrepareStmt:sql];
@@ -253,7 +263,7 @@ static NSString *const kTrashDirectoryName = @"trash";
     int timestamp = (int)time(NULL);
     sqlite3_bind_text(stmt, 1, key.UTF8String, -1, NULL);
     sqlite3_bind_text(stmt, 2, fileName.UTF8String, -1, NULL);
-    sqlite3_bind_int(stmt, 3, (int)value.length);
+    sqlite3_bind_int(stmt, 3, size);
     if (fileName.length == 0) {
         sqlite3_bind_blob(stmt, 4, value.bytes, (int)value.length, 0);
     } else {
@@ -680,10 +690,17 @@ static NSString *const kTrashDirectoryName = @"trash";
     return [data writeToFile:path atomically:NO];
 }
 
+// 将临时文件移动到文件缓存中（同一个卷上的rename，不复制数据）
+- (BOOL)_fileMoveWithPath:(NSString *)path toName:(NSString *)filename {
+    NSString *toPath = [_dataPath stringByAppendingPathComponent:filename];
+    return rename(path.fileSystemRepresentation, toPath.fileSystemRepresentation) == 0;
+}
+
 // 根据文件名字获取缓存的数据
 - (NSData *)_fileReadWithName:(NSString *)filename {
     NSString *path = [_dataPath stringByAppendingPathComponent:filename];
-    NSData *data = [NSData dataWithContentsOfFile:path];
+    // 映射的文件被rename替换或删除后，已经映射的内容依然有效
+    NSData *data = [NSData dataWithContentsOfFile:path options:(_mappedFileRead ? NSDataReadingMappedAlways : 0) error:NULL];
     return data;
 }
 
@@ -711,6 +728,18 @@ static NSString *const kTrashDirectoryName = @"trash";
     return suc;
 }
 
+// 将临时文件夹中残留的文件移动到垃圾文件夹
+- (BOOL)_fileMoveTempToTrash {
+    if (![[NSFileManager defaultManager] fileExistsAtPath:_tempPath]) return YES;
+    CFUUIDRef uuidRef = CFUUIDCreate(NULL);
+    CFStringRef uuid = CFUUIDCreateString(NULL, uuidRef);
+    CFRelease(uuidRef);
+    NSString *tmpPath = [_trashPath stringByAppendingPathComponent:(__bridge NSString *)(uuid)];
+    BOOL suc = [[NSFileManager defaultManager] moveItemAtPath:_tempPath toPath:tmpPath error:nil];
+    CFRelease(uuid);
+    return suc;
+}
+
 // 在后台清空垃圾文件夹
 - (void)_fileEmptyTrashInBackground {
     NSString *trashPath = _trashPath;
@@ -766,6 +795,8 @@ static NSString *const kTrashDirectoryName = @"trash";
     _dataPath = [path stringByAppendingPathComponent:kDataDirectoryName];
     // 垃圾文件夹
     _trashPath = [path stringByAppendingPathComponent:kTrashDirectoryName];
+    // 临时文件夹
+    _tempPath = [path stringByAppendingPathComponent:kTempDirectoryName];
     // 清除垃圾文件夹的队列
     _trashQueue = dispatch_queue_create("com.ibireme.cache.disk.trash", DISPATCH_QUEUE_SERIAL);
     // 数据库文件路径
@@ -787,6 +818,15 @@ static NSString *const kTrashDirectoryName = @"trash";
         NSLog(@"YYKVStorage init error:%@", error);
         return nil;
     }
+    // 上次意外退出时残留的临时文件移到垃圾文件夹，在创建临时文件之前重新创建临时文件夹
+    [self _fileMoveTempToTrash];
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:_tempPath
+                                   withIntermediateDirectories:YES
+                                                    attributes:nil
+                                                         error:&error]) {
+        NSLog(@"YYKVStorage init error:%@", error);
+        return nil;
+    }
     
     // 打开并初始化数据库表
     if (![self _dbOpen] || ![self _dbInitialize]) {
@@ -854,6 +894,37 @@ static NSString *const kTrashDirectoryName = @"trash";
     }
 }
 
+- (NSString *)temporaryFilePath {
+    // 临时文件放在单独的临时文件夹，清空垃圾文件夹时不会删除正在写入的文件；进程意外退出后残留的文件会在下次启动时被清除
+    CFUUIDRef uuidRef = CFUUIDCreate(NULL);
+    CFStringRef uuid = CFUUIDCreateString(NULL, uuidRef);
+    CFRelease(uuidRef);
+    NSString *path = [_tempPath stringByAppendingPathComponent:[(__bridge NSString *)uuid stringByAppendingString:@".tmp"]];
+    CFRelease(uuid);
+    return path;
+}
+
+- (BOOL)saveItemWithKey:(NSString *)key fileAtPath:(NSString *)path filename:(NSString *)filename extendedData:(NSData *)extendedData {
+    if (key.length == 0 || path.length == 0) return NO;
+    if (_type == YYKVStorageTypeSQLite || filename.length == 0) {
+        NSData *value = [NSData dataWithContentsOfFile:path];
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        return [self saveItemWithKey:key value:value filename:nil extendedData:extendedData];
+    }
+    
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL];
+    unsigned long long size = attributes.fileSize;
+    if (size == 0 || size > INT_MAX || ![self _fileMoveWithPath:path toName:filename]) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        return NO;
+    }
+    if (![self _dbSaveWithKey:key value:nil size:(int)size fileName:filename extendedData:extendedData]) {
+        [self _fileDeleteWithName:filename];
+        return NO;
+    }
+    return YES;
+}
+
 // 根据key移除缓存
 - (BOOL)removeItemForKey:(NSString *)key {
     if (key.length == 0) return NO;
@@ -1162,6 +1233,12 @@ static NSString *const kTrashDirectoryName = @"trash";
     return [self _dbGetItemCountWithKey:key] > 0;
 }
 
+// 更新访问时间
+- (BOOL)touchItemForKey:(NSString *)key {
+    if (key.length == 0) return NO;
+    return [self _dbUpdateAccessTimeWithKey:key];
+}
+
 // 获取缓存的数量
 - (int)getItemsCount {
     return [self _dbGetTotalItemCount];
@@ -105,6 +105,7 @@ static int _YYWebImageSetterKey;
     int32_t sentinel = [setter cancelWithNewURL:imageURL];
     
     dispatch_async_on_main_queue(^{
+        NSUInteger maxPixelSize = _YYWebImageMaxPixelSizeForViewSize(self.bounds.size, options);
         if ((options & YYWebImageOptionSetImageWithFadeAnimation) &&
             !(options & YYWebImageOptionAvoidSetImage)) {
             [self removeAnimationForKey:_YYWebImageFadeAnimationKey];
@@ -122,7 +123,7 @@ static int _YYWebImageSetterKey;
         if (manager.cache &&
             !(options & YYWebImageOptionUseNSURLCache) &&
             !(options & YYWebImageOptionRefreshImageCache)) {
-            imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory];
+            imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory maxPixelSize:maxPixelSize];
         }
         if (imageFromMemory) {
             if (!(options & YYWebImageOptionAvoidSetImage)) {
@@ -173,7 +174,7 @@ static int _YYWebImageSetterKey;
                 });
             };
             
-            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options manager:manager progress:_progress transform:transform completion:_completion];
+            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options maxPixelSize:maxPixelSize manager:manager progress:_progress transform:transform completion:_completion];
             weakSetter = setter;
         });
         
@@ -100,6 +100,30 @@ NS_ASSUME_NONNULL_BEGIN
                  transform:(nullable YYWebImageTransformBlock)transform
                 completion:(nullable YYWebImageCompletionBlock)completion;
 
+/**
+ Set the view's `image` with a specified URL, the image is transformed by a transformer.
+ 
+ @discussion The transformed image is cached with a key derived from the transformer's
+ identifier, so it's set from memory immediately next time without being transformed again.
+ 
+ @note 使用变换器设置图片，变换后的图片有单独的缓存，再次设置时直接从内存中获取
+ 
+ @param imageURL    The image url (remote or local file path).
+ @param placeholder The image to be set initially, until the image request finishes.
+ @param options     The options to use when request the image.
+ @param manager     The manager to create image request operation.
+ @param progress    The block invoked (on main thread) during image request.
+ @param transformer The transformer to process the image (on background thread).
+ @param completion  The block invoked (on main thread) when image request completed.
+ */
+- (void)setImageWithURL:(nullable NSURL *)imageURL
+               placeholder:(nullable UIImage *)placeholder
+                   options:(YYWebImageOptions)options
+                   manager:(nullable YYWebImageManager *)manager
+                  progress:(nullable YYWebImageProgressBlock)progress
+               transformer:(nullable YYWebImageTransformer *)transformer
+                completion:(nullable YYWebImageCompletionBlock)completion;
+
 /**
  Cancel the current image request.
  */
@@ -188,6 +212,31 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)cancelCurrentHighlightedImageRequest;
 
+
+
+#pragma mark - request priority
+
+/**
+ Reports the position of this view to the current image requests (image and
+ highlighted image), so that visible images are loaded first.
+ 
+ @discussion See `-[YYWebImageManager updateOperation:visible:distanceToViewport:]`.
+ A request cancelled as stale is restarted (without the original progress and
+ completion block) when the view comes back within the stale distance.
+ 
+ @param visible  Whether the view is visible now.
+ @param distance The distance from the view to the viewport, in viewport lengths.
+ */
+- (void)setCurrentImageRequestVisible:(BOOL)visible distanceToViewport:(CGFloat)distance;
+
+/**
+ Reports the position of this view in a scroll view to the current image requests.
+ You may call this method in `scrollViewDidScroll:` for the cells being displayed.
+ 
+ @param scrollView The scroll view which contains this view.
+ */
+- (void)updateCurrentImageRequestPriorityWithScrollView:(UIScrollView *)scrollView;
+
 @end
 
 NS_ASSUME_NONNULL_END
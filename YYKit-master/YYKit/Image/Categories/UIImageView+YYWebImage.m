@@ -99,6 +99,41 @@ static int _YYWebImageHighlightedSetterKey;
                progress:(YYWebImageProgressBlock)progress
               transform:(YYWebImageTransformBlock)transform
              completion:(YYWebImageCompletionBlock)completion {
+    [self _setImageWithURL:imageURL
+               placeholder:placeholder
+                   options:options
+                   manager:manager
+                  progress:progress
+                 transform:transform
+               transformer:nil
+                completion:completion];
+}
+
+- (void)setImageWithURL:(NSURL *)imageURL
+            placeholder:(UIImage *)placeholder
+                options:(YYWebImageOptions)options
+                manager:(YYWebImageManager *)manager
+               progress:(YYWebImageProgressBlock)progress
+            transformer:(YYWebImageTransformer *)transformer
+             completion:(YYWebImageCompletionBlock)completion {
+    [self _setImageWithURL:imageURL
+               placeholder:placeholder
+                   options:options
+                   manager:manager
+                  progress:progress
+                 transform:nil
+               transformer:transformer
+                completion:completion];
+}
+
+- (void)_setImageWithURL:(NSURL *)imageURL
+             placeholder:(UIImage *)placeholder
+                 options:(YYWebImageOptions)options
+                 manager:(YYWebImageManager *)manager
+                progress:(YYWebImageProgressBlock)progress
+               transform:(YYWebImageTransformBlock)transform
+             transformer:(YYWebImageTransformer *)transformer
+              completion:(YYWebImageCompletionBlock)completion {
     if ([imageURL isKindOfClass:[NSString class]]) imageURL = [NSURL URLWithString:(id)imageURL];
     manager = manager ? manager : [YYWebImageManager sharedManager];
     
@@ -110,6 +145,7 @@ static int _YYWebImageHighlightedSetterKey;
     int32_t sentinel = [setter cancelWithNewURL:imageURL];
     
     dispatch_async_on_main_queue(^{
+        NSUInteger maxPixelSize = _YYWebImageMaxPixelSizeForViewSize(self.bounds.size, options);
         if ((options & YYWebImageOptionSetImageWithFadeAnimation) &&
             !(options & YYWebImageOptionAvoidSetImage)) {
             if (!self.highlighted) {
@@ -129,7 +165,12 @@ static int _YYWebImageHighlightedSetterKey;
         if (manager.cache &&
             !(options & YYWebImageOptionUseNSURLCache) &&
             !(options & YYWebImageOptionRefreshImageCache)) {
-            imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory];
+            if (transformer) {
+                NSString *transformedKey = [manager cacheKeyForURL:imageURL transformer:transformer maxPixelSize:maxPixelSize];
+                imageFromMemory = [manager.cache getImageForKey:transformedKey withType:YYImageCacheTypeMemory maxPixelSize:0];
+            } else {
+                imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory maxPixelSize:maxPixelSize];
+            }
         }
         if (imageFromMemory) {
             if (!(options & YYWebImageOptionAvoidSetImage)) {
@@ -180,7 +221,7 @@ static int _YYWebImageHighlightedSetterKey;
                 });
             };
             
-            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options manager:manager progress:_progress transform:transform completion:_completion];
+            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options maxPixelSize:maxPixelSize manager:manager progress:_progress transform:transform transformer:transformer completion:_completion];
             weakSetter = setter;
         });
     });
@@ -275,6 +316,7 @@ static int _YYWebImageHighlightedSetterKey;
     int32_t sentinel = [setter cancelWithNewURL:imageURL];
     
     dispatch_async_on_main_queue(^{
+        NSUInteger maxPixelSize = _YYWebImageMaxPixelSizeForViewSize(self.bounds.size, options);
         if ((options & YYWebImageOptionSetImageWithFadeAnimation) &&
             !(options & YYWebImageOptionAvoidSetImage)) {
             if (self.highlighted) {
@@ -293,7 +335,7 @@ static int _YYWebImageHighlightedSetterKey;
         if (manager.cache &&
             !(options & YYWebImageOptionUseNSURLCache) &&
             !(options & YYWebImageOptionRefreshImageCache)) {
-            imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory];
+            imageFromMemory = [manager.cache getImageForKey:[manager cacheKeyForURL:imageURL] withType:YYImageCacheTypeMemory maxPixelSize:maxPixelSize];
         }
         if (imageFromMemory) {
             if (!(options & YYWebImageOptionAvoidSetImage)) {
@@ -344,7 +386,7 @@ static int _YYWebImageHighlightedSetterKey;
                 });
             };
             
-            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options manager:manager progress:_progress transform:transform completion:_completion];
+            newSentinel = [setter setOperationWithSentinel:sentinel url:imageURL options:options maxPixelSize:maxPixelSize manager:manager progress:_progress transform:transform completion:_completion];
             weakSetter = setter;
         });
     });
@@ -355,4 +397,42 @@ static int _YYWebImageHighlightedSetterKey;
     if (setter) [setter cancel];
 }
 
+
+#pragma mark - request priority
+
+- (void)setCurrentImageRequestVisible:(BOOL)visible distanceToViewport:(CGFloat)distance {
+    _YYWebImageSetter *setter = objc_getAssociatedObject(self, &_YYWebImageSetterKey);
+    if ([setter updateWithVisible:visible distanceToViewport:distance] && setter.staleCancelled && setter.imageURL) {
+        // 被取消的请求重新回到范围内，重新请求
+        YYWebImageManager *manager = setter.manager;
+        if (visible || manager.staleDistanceToViewport <= 0 || distance <= manager.staleDistanceToViewport) {
+            [self _setImageWithURL:setter.imageURL placeholder:self.image options:setter.options manager:manager progress:nil transform:setter.transform transformer:setter.transformer completion:nil];
+        }
+    }
+    
+    setter = objc_getAssociatedObject(self, &_YYWebImageHighlightedSetterKey);
+    if ([setter updateWithVisible:visible distanceToViewport:distance] && setter.staleCancelled && setter.imageURL) {
+        YYWebImageManager *manager = setter.manager;
+        if (visible || manager.staleDistanceToViewport <= 0 || distance <= manager.staleDistanceToViewport) {
+            [self setHighlightedImageWithURL:setter.imageURL placeholder:self.highlightedImage options:setter.options manager:manager progress:nil transform:setter.transform completion:nil];
+        }
+    }
+}
+
+- (void)updateCurrentImageRequestPriorityWithScrollView:(UIScrollView *)scrollView {
+    if (!scrollView || !self.window) {
+        [self setCurrentImageRequestVisible:NO distanceToViewport:CGFLOAT_MAX];
+        return;
+    }
+    CGRect viewport = scrollView.bounds;
+    if (viewport.size.width <= 0 || viewport.size.height <= 0) return;
+    CGRect frame = [self convertRect:self.bounds toView:scrollView];
+    BOOL visible = CGRectIntersectsRect(frame, viewport) && !self.hidden;
+    // 在滚动方向上到可见区域的距离（以可见区域的长度为单位）
+    CGFloat dx = MAX(CGRectGetMinX(viewport) - CGRectGetMaxX(frame), CGRectGetMinX(frame) - CGRectGetMaxX(viewport));
+    CGFloat dy = MAX(CGRectGetMinY(viewport) - CGRectGetMaxY(frame), CGRectGetMinY(frame) - CGRectGetMaxY(viewport));
+    CGFloat distance = MAX(MAX(dx / viewport.size.width, dy / viewport.size.height), 0);
+    [self setCurrentImageRequestVisible:visible distanceToViewport:distance];
+}
+
 @end
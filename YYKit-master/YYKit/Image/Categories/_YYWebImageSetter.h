@@ -21,6 +21,10 @@ extern NSString *const _YYWebImageFadeAnimationKey;
 extern const NSTimeInterval _YYWebImageFadeTime;
 extern const NSTimeInterval _YYWebImageProgressiveFadeTime;
 
+/// Returns the max pixel size to decode image for a view with `size` (in points),
+/// or 0 if the options does not contain `YYWebImageOptionDownsampleToViewSize`.
+extern NSUInteger _YYWebImageMaxPixelSizeForViewSize(CGSize size, YYWebImageOptions options);
+
 /**
  Private class used by web image categories.
  Typically, you should not use this class directly.
@@ -30,6 +34,13 @@ extern const NSTimeInterval _YYWebImageProgressiveFadeTime;
 @property (nullable, nonatomic, readonly) NSURL *imageURL;
 /// Current sentinel.
 @property (nonatomic, readonly) int32_t sentinel;
+/// Whether current operation was cancelled as stale by `updateWithVisible:distanceToViewport:`.
+@property (nonatomic, readonly) BOOL staleCancelled;
+/// The manager, options and transform of current operation, used to restart a stale request.
+@property (nullable, nonatomic, readonly, weak) YYWebImageManager *manager;
+@property (nonatomic, readonly) YYWebImageOptions options;
+@property (nullable, nonatomic, readonly) YYWebImageTransformBlock transform;
+@property (nullable, nonatomic, readonly) YYWebImageTransformer *transformer;
 
 /// Create new operation for web image and return a sentinel value.
 - (int32_t)setOperationWithSentinel:(int32_t)sentinel
@@ -40,6 +51,31 @@ extern const NSTimeInterval _YYWebImageProgressiveFadeTime;
                           transform:(nullable YYWebImageTransformBlock)transform
                          completion:(nullable YYWebImageCompletionBlock)completion;
 
+/// Create new operation for web image which decodes the image at reduced size, and return a sentinel value.
+- (int32_t)setOperationWithSentinel:(int32_t)sentinel
+                                url:(nullable NSURL *)imageURL
+                            options:(YYWebImageOptions)options
+                       maxPixelSize:(NSUInteger)maxPixelSize
+                            manager:(YYWebImageManager *)manager
+                           progress:(nullable YYWebImageProgressBlock)progress
+                          transform:(nullable YYWebImageTransformBlock)transform
+                         completion:(nullable YYWebImageCompletionBlock)completion;
+
+/// Create new operation for web image which transforms the image with a transformer, and return a sentinel value.
+- (int32_t)setOperationWithSentinel:(int32_t)sentinel
+                                url:(nullable NSURL *)imageURL
+                            options:(YYWebImageOptions)options
+                       maxPixelSize:(NSUInteger)maxPixelSize
+                            manager:(YYWebImageManager *)manager
+                           progress:(nullable YYWebImageProgressBlock)progress
+                          transform:(nullable YYWebImageTransformBlock)transform
+                        transformer:(nullable YYWebImageTransformer *)transformer
+                         completion:(nullable YYWebImageCompletionBlock)completion;
+
+/// Update the priority of current operation with the position of the view, returns NO if it was cancelled as stale.
+/// The position is remembered and applied to the operations created later.
+- (BOOL)updateWithVisible:(BOOL)visible distanceToViewport:(CGFloat)distance;
+
 /// Cancel and return a sentinel value. The imageURL will be set to nil.
 - (int32_t)cancel;
 
@@ -17,12 +17,27 @@ NSString *const _YYWebImageFadeAnimationKey = @"YYWebImageFade";
 const NSTimeInterval _YYWebImageFadeTime = 0.2;
 const NSTimeInterval _YYWebImageProgressiveFadeTime = 0.4;
 
+NSUInteger _YYWebImageMaxPixelSizeForViewSize(CGSize size, YYWebImageOptions options) {
+    if (!(options & YYWebImageOptionDownsampleToViewSize)) return 0;
+    CGFloat length = MAX(size.width, size.height);
+    if (length <= 0) return 0; // not layout yet, decode at full size
+    return (NSUInteger)ceil(length * [UIScreen mainScreen].scale);
+}
+
 
 @implementation _YYWebImageSetter {
     dispatch_semaphore_t _lock;
     NSURL *_imageURL;
     NSOperation *_operation;
     int32_t _sentinel;
+    __weak YYWebImageManager *_manager;
+    YYWebImageOptions _options;
+    YYWebImageTransformBlock _transform;
+    YYWebImageTransformer *_transformer;
+    BOOL _staleCancelled;
+    BOOL _hasViewport; ///< whether the position of view is reported
+    BOOL _visible;
+    CGFloat _distance;
 }
 
 - (instancetype)init {
@@ -38,6 +53,41 @@ const NSTimeInterval _YYWebImageProgressiveFadeTime = 0.4;
     return imageURL;
 }
 
+- (BOOL)staleCancelled {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    BOOL staleCancelled = _staleCancelled;
+    dispatch_semaphore_signal(_lock);
+    return staleCancelled;
+}
+
+- (YYWebImageManager *)manager {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    YYWebImageManager *manager = _manager;
+    dispatch_semaphore_signal(_lock);
+    return manager;
+}
+
+- (YYWebImageOptions)options {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    YYWebImageOptions options = _options;
+    dispatch_semaphore_signal(_lock);
+    return options;
+}
+
+- (YYWebImageTransformBlock)transform {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    YYWebImageTransformBlock transform = _transform;
+    dispatch_semaphore_signal(_lock);
+    return transform;
+}
+
+- (YYWebImageTransformer *)transformer {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    YYWebImageTransformer *transformer = _transformer;
+    dispatch_semaphore_signal(_lock);
+    return transformer;
+}
+
 - (void)dealloc {
     OSAtomicIncrement32(&_sentinel);
     [_operation cancel];
@@ -50,29 +100,106 @@ const NSTimeInterval _YYWebImageProgressiveFadeTime = 0.4;
                            progress:(YYWebImageProgressBlock)progress
                           transform:(YYWebImageTransformBlock)transform
                          completion:(YYWebImageCompletionBlock)completion {
+    return [self setOperationWithSentinel:sentinel
+                                      url:imageURL
+                                  options:options
+                             maxPixelSize:0
+                                  manager:manager
+                                 progress:progress
+                                transform:transform
+                               completion:completion];
+}
+
+- (int32_t)setOperationWithSentinel:(int32_t)sentinel
+                                url:(NSURL *)imageURL
+                            options:(YYWebImageOptions)options
+                       maxPixelSize:(NSUInteger)maxPixelSize
+                            manager:(YYWebImageManager *)manager
+                           progress:(YYWebImageProgressBlock)progress
+                          transform:(YYWebImageTransformBlock)transform
+                         completion:(YYWebImageCompletionBlock)completion {
+    return [self setOperationWithSentinel:sentinel
+                                      url:imageURL
+                                  options:options
+                             maxPixelSize:maxPixelSize
+                                  manager:manager
+                                 progress:progress
+                                transform:transform
+                              transformer:nil
+                               completion:completion];
+}
+
+- (int32_t)setOperationWithSentinel:(int32_t)sentinel
+                                url:(NSURL *)imageURL
+                            options:(YYWebImageOptions)options
+                       maxPixelSize:(NSUInteger)maxPixelSize
+                            manager:(YYWebImageManager *)manager
+                           progress:(YYWebImageProgressBlock)progress
+                          transform:(YYWebImageTransformBlock)transform
+                        transformer:(YYWebImageTransformer *)transformer
+                         completion:(YYWebImageCompletionBlock)completion {
     if (sentinel != _sentinel) {
         if (completion) completion(nil, imageURL, YYWebImageFromNone, YYWebImageStageCancelled, nil);
         return _sentinel;
     }
     
-    NSOperation *operation = [manager requestImageWithURL:imageURL options:options progress:progress transform:transform completion:completion];
+    NSOperation *operation = nil;
+    if (transformer) {
+        operation = [manager requestImageWithURL:imageURL options:options maxPixelSize:maxPixelSize progress:progress transformer:transformer completion:completion];
+    } else {
+        operation = [manager requestImageWithURL:imageURL options:options maxPixelSize:maxPixelSize progress:progress transform:transform completion:completion];
+    }
     if (!operation && completion) {
         NSDictionary *userInfo = @{ NSLocalizedDescriptionKey : @"YYWebImageOperation create failed." };
         completion(nil, imageURL, YYWebImageFromNone, YYWebImageStageFinished, [NSError errorWithDomain:@"com.ibireme.yykit.webimage" code:-1 userInfo:userInfo]);
     }
     
+    BOOL hasViewport = NO, visible = NO;
+    CGFloat distance = 0;
     dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
     if (sentinel == _sentinel) {
         if (_operation) [_operation cancel];
         _operation = operation;
+        _manager = manager;
+        _options = options;
+        _transform = transform;
+        _transformer = transformer;
+        _staleCancelled = NO;
+        hasViewport = _hasViewport;
+        visible = _visible;
+        distance = _distance;
         sentinel = OSAtomicIncrement32(&_sentinel);
     } else {
         [operation cancel];
+        operation = nil;
     }
     dispatch_semaphore_signal(_lock);
+    if (hasViewport && [operation isKindOfClass:[YYWebImageOperation class]]) {
+        [self updateWithVisible:visible distanceToViewport:distance];
+    }
     return sentinel;
 }
 
+- (BOOL)updateWithVisible:(BOOL)visible distanceToViewport:(CGFloat)distance {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    _hasViewport = YES;
+    _visible = visible;
+    _distance = distance;
+    YYWebImageOperation *operation = (id)_operation;
+    YYWebImageManager *manager = _manager;
+    dispatch_semaphore_signal(_lock);
+    if (!operation || !manager) return YES;
+    
+    if ([manager updateOperation:operation visible:visible distanceToViewport:distance]) return YES;
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    if (_operation == operation) {
+        _operation = nil;
+        _staleCancelled = YES;
+    }
+    dispatch_semaphore_signal(_lock);
+    return NO;
+}
+
 - (int32_t)cancel {
     return [self cancelWithNewURL:nil];
 }
@@ -85,6 +212,9 @@ const NSTimeInterval _YYWebImageProgressiveFadeTime = 0.4;
         _operation = nil;
     }
     _imageURL = imageURL;
+    _transform = nil;
+    _transformer = nil;
+    _staleCancelled = NO;
     sentinel = OSAtomicIncrement32(&_sentinel);
     dispatch_semaphore_signal(_lock);
     return sentinel;
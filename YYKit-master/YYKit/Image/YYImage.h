@@ -48,6 +48,15 @@ NS_ASSUME_NONNULL_BEGIN
 + (nullable YYImage *)imageWithData:(NSData *)data;
 + (nullable YYImage *)imageWithData:(NSData *)data scale:(CGFloat)scale;
 
+/**
+ Creates an image from data, decoded frames are scaled down so that the longer
+ side is not larger than `maxPixelSize` (pass 0 for full size).
+ 
+ @note 使用data生成图片，解码时将图片缩小到最大像素边长以内，用于只需要显示缩略图的场景
+ */
++ (nullable YYImage *)imageWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize;
+- (nullable instancetype)initWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize;
+
 /**
  If the image is created from data or file, then the value indicates the data type.
  */
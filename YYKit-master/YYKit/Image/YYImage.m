@@ -61,6 +61,10 @@
     return [[self alloc] initWithData:data scale:scale];
 }
 
++ (YYImage *)imageWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize {
+    return [[self alloc] initWithData:data scale:scale maxPixelSize:maxPixelSize];
+}
+
 - (instancetype)initWithContentsOfFile:(NSString *)path {
     NSData *data = [NSData dataWithContentsOfFile:path];
     return [self initWithData:data scale:path.pathScale];
@@ -71,11 +75,15 @@
 }
 
 - (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale {
+    return [self initWithData:data scale:scale maxPixelSize:0];
+}
+
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize {
     if (data.length == 0) return nil;
     if (scale <= 0) scale = [UIScreen mainScreen].scale;
     _preloadedLock = dispatch_semaphore_create(1);
     @autoreleasepool {
-        YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:scale];
+        YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:scale maxPixelSize:maxPixelSize];
         YYImageFrame *frame = [decoder frameAtIndex:0 decodeForDisplay:YES];
         UIImage *image = frame.image;
         if (!image) return nil;
@@ -123,9 +131,10 @@
 
 - (instancetype)initWithCoder:(NSCoder *)aDecoder {
     NSNumber *scale = [aDecoder decodeObjectForKey:@"YYImageScale"];
+    NSNumber *maxPixelSize = [aDecoder decodeObjectForKey:@"YYImageMaxPixelSize"];
     NSData *data = [aDecoder decodeObjectForKey:@"YYImageData"];
     if (data.length) {
-        self = [self initWithData:data scale:scale.doubleValue];
+        self = [self initWithData:data scale:scale.doubleValue maxPixelSize:maxPixelSize.unsignedIntegerValue];
     } else {
         self = [super initWithCoder:aDecoder];
     }
@@ -135,6 +144,7 @@
 - (void)encodeWithCoder:(NSCoder *)aCoder {
     if (_decoder.data.length) {
         [aCoder encodeObject:@(self.scale) forKey:@"YYImageScale"];
+        [aCoder encodeObject:@(_decoder.maxPixelSize) forKey:@"YYImageMaxPixelSize"];
         [aCoder encodeObject:_decoder.data forKey:@"YYImageData"];
     } else {
         [super encodeWithCoder:aCoder]; // Apple use UIImagePNGRepresentation() to encode UIImage.
@@ -67,14 +67,45 @@ typedef NS_OPTIONS(NSUInteger, YYImageCacheType) {
 /** The name of the cache. Default is nil. */
 @property (nullable, copy) NSString *name;
 
-/** The underlying memory cache. see `YYMemoryCache` for more information.*/
-// 内存缓存
+/** 
+ The underlying memory cache. see `YYMemoryCache` for more information.
+ The idle decoded bitmap buffers in `YYImageBufferPool` are counted against the
+ memory cache's `costLimit`, they are freed first when the limit is exceeded.
+ */
+// 内存缓存，YYImageBufferPool中空闲的位图缓存也计入costLimit，超出时先释放空闲的缓存
 @property (strong, readonly) YYMemoryCache *memoryCache;
 
 /** The underlying disk cache. see `YYDiskCache` for more information.*/
 // 硬盘缓存
 @property (strong, readonly) YYDiskCache *diskCache;
 
+/**
+ Whether to keep the decoded bitmaps of still images in a third, disk based tier. Default is NO.
+ 
+ 是否在磁盘上保存静态图片解码后的位图，默认为NO
+ 
+ @discussion When enabled, the decoded bitmap of an image is written to a page-aligned
+ file (with the pixel format, stride, scale and orientation in its header) when the
+ image is stored or decoded from disk cache. The next time the image is fetched from
+ disk, for example after the app is relaunched, the file is mapped into memory and
+ the `CGImage` is created over the mapping, without reading or decoding the image data.
+ 
+ One bitmap is kept for each key and `maxPixelSize`. A bitmap carries the token of
+ the image data it was decoded from, and is dropped once that data is removed or
+ replaced. Animated images and bitmaps larger than 4MB are not stored.
+ 
+ @note 每个尺寸单独保存一个位图，原始数据被删除或替换后位图失效
+ */
+@property (nonatomic) BOOL bitmapCacheEnabled;
+
+/**
+ The disk cache of the decoded bitmaps, nil until `bitmapCacheEnabled` is set to YES.
+ The files are evicted by LRU, its `costLimit` is 128MB by default.
+ 
+ 解码位图的磁盘缓存，按LRU淘汰，默认最多128MB
+ */
+@property (nullable, strong, readonly) YYDiskCache *bitmapCache;
+
 /**
  Whether decode animated image when fetch image from disk cache. Default is YES.
  
@@ -157,6 +188,106 @@ typedef NS_OPTIONS(NSUInteger, YYImageCacheType) {
           forKey:(NSString *)key
         withType:(YYImageCacheType)type;
 
+/**
+ Sets the image with the specified key in the cache, the image in memory cache is
+ scaled down to the max pixel size.
+ This method returns immediately and executes the store operation in background.
+ 
+ 使用key缓存缩小后的图片，内存缓存中保存缩小后的位图，磁盘缓存中仍然保存原始的图片数据
+ 
+ @discussion The memory cache stores the downsampled image with a key derived from
+ `key` and `maxPixelSize`, so thumbnails of different size never replace each other
+ or the full size image. The disk cache always stores the original `imageData` 
+ with `key`; if `imageData` is nil and `maxPixelSize` is not 0, nothing is written
+ to disk, because the downsampled image is not the original image.
+ 
+ @param image        The downsampled image to be stored in the memory cache.
+ @param imageData    The original image data to be stored in the cache.
+ @param key          The key with which to associate the image. If nil, this method has no effect.
+ @param type         The cache type to store image.
+ @param maxPixelSize The max pixel size of the image in memory cache, 0 means no limit.
+ */
+- (void)setImage:(nullable UIImage *)image
+       imageData:(nullable NSData *)imageData
+          forKey:(NSString *)key
+        withType:(YYImageCacheType)type
+    maxPixelSize:(NSUInteger)maxPixelSize;
+
+/**
+ Sets the image with the specified key in the cache, and stores the HTTP response
+ validators of the image data in the disk cache.
+ This method returns immediately and executes the store operation in background.
+ 
+ 缓存图片，同时把响应的验证字段（ETag、Last-Modified）保存到磁盘缓存的扩展数据中
+ 
+ @param image        The downsampled image to be stored in the memory cache.
+ @param imageData    The original image data to be stored in the cache.
+ @param validators   The response validators with the keys `ETag` and `Last-Modified`, 
+    they are stored only if the image data is stored in disk cache.
+ @param key          The key with which to associate the image. If nil, this method has no effect.
+ @param type         The cache type to store image.
+ @param maxPixelSize The max pixel size of the image in memory cache, 0 means no limit.
+ */
+- (void)setImage:(nullable UIImage *)image
+       imageData:(nullable NSData *)imageData
+      validators:(nullable NSDictionary<NSString *, NSString *> *)validators
+          forKey:(NSString *)key
+        withType:(YYImageCacheType)type
+    maxPixelSize:(NSUInteger)maxPixelSize;
+
+/**
+ Returns a new path for a temporary file in the disk cache directory, or nil if 
+ not available. Write the downloaded image data to this file, then pass it to 
+ `setImage:imageDataFileAtPath:validators:forKey:maxPixelSize:`.
+ 
+ 返回磁盘缓存目录中的临时文件路径，下载的数据可以直接写入这个文件
+ */
+- (nullable NSString *)temporaryImageDataPath;
+
+/**
+ Sets the image with the specified key in the cache, the original image data is
+ the content of a file which is moved into the disk cache without copying.
+ This method may blocks the calling thread until the disk cache is updated.
+ 
+ 缓存图片，磁盘缓存中的原始数据由文件移动得到，不需要把数据读入内存
+ 
+ @param image        The (downsampled) image to be stored in the memory cache, pass nil to avoid it.
+ @param path         A file path returned by `temporaryImageDataPath` with the original
+    image data. The file is removed if it cannot be stored.
+ @param validators   The response validators with the keys `ETag` and `Last-Modified`.
+ @param key          The key with which to associate the image. If nil, this method has no effect.
+ @param maxPixelSize The max pixel size of the image in memory cache, 0 means no limit.
+ @return Whether the image data is stored in disk cache.
+ */
+- (BOOL)setImage:(nullable UIImage *)image
+imageDataFileAtPath:(NSString *)path
+      validators:(nullable NSDictionary<NSString *, NSString *> *)validators
+          forKey:(NSString *)key
+    maxPixelSize:(NSUInteger)maxPixelSize;
+
+/**
+ Returns the HTTP response validators stored with the image data in disk cache.
+ The image data is not read. This method may blocks the calling thread until
+ the database read finished.
+ 
+ 获取磁盘缓存中图片数据对应的验证字段，用于发送条件请求（会阻塞线程）
+ 
+ @param key A string identifying the image. If nil, just return nil.
+ @return A dictionary with the keys `ETag` and `Last-Modified`, or nil if there's
+    no validator (or no image) associated with key.
+ */
+- (nullable NSDictionary<NSString *, NSString *> *)validatorsForKey:(NSString *)key;
+
+/**
+ Marks the image data in disk cache as recently used, for example when the server
+ responds `304 Not Modified`. The image data is not read.
+ 
+ 更新磁盘缓存中图片的访问时间（例如服务器返回304时），不读取图片数据
+ 
+ @param key A string identifying the image. If nil, this method has no effect.
+ */
+- (void)touchImageForKey:(NSString *)key;
+
 /**
  Removes the image of the specified key in the cache (both memory and disk).
  This method returns immediately and executes the remove operation in background.
@@ -172,6 +303,7 @@ typedef NS_OPTIONS(NSUInteger, YYImageCacheType) {
  This method returns immediately and executes the remove operation in background.
  
  根据key移除缓存指定的缓存，这个方法马上返回，实际移除操作在后台队列
+ The downsampled images of the key (stored with a max pixel size) are removed as well.
  
  @param key  The key identifying the image to be removed. If nil, this method has no effect.
  @param type The cache type to remove image.
@@ -227,6 +359,20 @@ typedef NS_OPTIONS(NSUInteger, YYImageCacheType) {
  */
 - (nullable UIImage *)getImageForKey:(NSString *)key withType:(YYImageCacheType)type;
 
+/**
+ Returns the image associated with a given key, scaled down to the max pixel size.
+ If the image is not in memory and the `type` contains `YYImageCacheTypeDisk`,
+ this method may blocks the calling thread until file read finished.
+ 
+ 根据key获取缩小后的图片，从磁盘读取时直接以缩小的尺寸解码（会阻塞线程）
+ 
+ @param key          A string identifying the image. If nil, just return nil.
+ @param type         The cache type.
+ @param maxPixelSize The max pixel size of the returned image, 0 means no limit.
+ @return The image associated with key, or nil if no image is associated with key.
+ */
+- (nullable UIImage *)getImageForKey:(NSString *)key withType:(YYImageCacheType)type maxPixelSize:(NSUInteger)maxPixelSize;
+
 /**
  Asynchronously get the image associated with a given key.
  
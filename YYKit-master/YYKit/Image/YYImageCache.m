@@ -15,25 +15,34 @@
 #import "UIImage+YYAdd.h"
 #import "NSObject+YYAdd.h"
 #import "YYImage.h"
+#import <sys/mman.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <pthread.h>
 
 #if __has_include("YYDispatchQueuePool.h")
 #import "YYDispatchQueuePool.h"
 #endif
 
 
-static inline dispatch_queue_t YYImageCacheIOQueue() {
-#ifdef YYDispatchQueuePool_h
-    return YYDispatchQueueGetForQOS(NSQualityOfServiceDefault);
-#else
-    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
-#endif
+/// Runs a block for disk IO (image encoding and writing). The block may block on disk,
+/// so it runs on its own queue instead of the decode executor (one worker per CPU).
+static inline void YYImageCacheIOAsync(dispatch_block_t block) {
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.ibireme.yykit.cache.io", DISPATCH_QUEUE_CONCURRENT);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+    });
+    dispatch_async(queue, block);
 }
 
-static inline dispatch_queue_t YYImageCacheDecodeQueue() {
+/// Runs a block for image decoding, on the executor shared with web image and async rendering.
+static inline void YYImageCacheDecodeAsync(dispatch_block_t block) {
 #ifdef YYDispatchQueuePool_h
-    return YYDispatchQueueGetForQOS(NSQualityOfServiceUtility);
+    YYDispatchExecutorAsync(NSQualityOfServiceUtility, block);
 #else
-    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), block);
 #endif
 }
 
@@ -43,10 +52,192 @@ static inline dispatch_queue_t YYImageCacheDecodeQueue() {
 - (NSUInteger)imageCost:(UIImage *)image;
 // 根据data获取图片
 - (UIImage *)imageFromData:(NSData *)data;
+// 根据data获取缩小后的图片
+- (UIImage *)imageFromData:(NSData *)data maxPixelSize:(NSUInteger)maxPixelSize;
+// 添加到内存缓存，缩小的图片使用派生的key并记录尺寸
+- (void)_setMemoryImage:(UIImage *)image forKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize;
+// 从位图缓存中获取图片
+- (UIImage *)_bitmapImageForKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize;
+// 添加到位图缓存，token为nil时使用磁盘缓存中原始数据的token
+- (void)_setBitmapImage:(UIImage *)image forKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize dataToken:(NSNumber *)token;
 @end
 
+/// The max cost of a bitmap stored in bitmap cache (4MB, a 1024x1024 bitmap).
+static const NSUInteger YYImageBitmapMaxCost = 4 * 1024 * 1024;
+
+#define YY_IMAGE_BITMAP_MAGIC 0x4D425959 // "YYBM"
+#define YY_IMAGE_BITMAP_VERSION 2
+
+/// The max count of the data tokens remembered for the bitmap cache.
+static const NSUInteger YYImageDataTokenMaxCount = 4096;
+
+/// The count of keys with downsampled images in memory cache, exceeding it removes the keys
+/// whose downsampled images were all evicted from memory cache.
+static const NSUInteger YYImageMemoryKeySizesPruneCount = 4096;
+
+/// The header of a decoded bitmap file. The pixels start at `dataOffset`, which
+/// is a page boundary, so the mapped pixels are page-aligned.
+typedef struct {
+    uint32_t magic;         ///< YY_IMAGE_BITMAP_MAGIC
+    uint32_t version;       ///< YY_IMAGE_BITMAP_VERSION
+    uint32_t width;         ///< width in pixels
+    uint32_t height;        ///< height in pixels
+    uint32_t bytesPerRow;   ///< stride, 64 bytes aligned
+    uint32_t bitmapInfo;    ///< CGBitmapInfo, 8 bits per component and 32 bits per pixel in device RGB
+    uint32_t dataOffset;    ///< offset of the pixels in file
+    uint32_t orientation;   ///< UIImageOrientation
+    uint32_t maxPixelSize;  ///< the max pixel size the bitmap was decoded for, 0 means the original size
+    float scale;            ///< UIImage scale
+    uint64_t dataToken;     ///< the token of the image data the bitmap was decoded from
+} YYImageBitmapHeader;
+
+/// Writes the decoded bitmap of the image to a new file at path.
+static BOOL YYImageBitmapWriteFile(UIImage *image, NSUInteger maxPixelSize, uint64_t dataToken, NSString *path) {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef || !path) return NO;
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    if (width == 0 || height == 0) return NO;
+    
+    size_t bytesPerRow = ((width * 4) + 63) / 64 * 64;
+    size_t pageSize = (size_t)getpagesize();
+    size_t dataOffset = (sizeof(YYImageBitmapHeader) + pageSize - 1) / pageSize * pageSize;
+    size_t length = dataOffset + bytesPerRow * height;
+    
+    CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(imageRef) & kCGBitmapAlphaInfoMask;
+    BOOL hasAlpha = !(alphaInfo == kCGImageAlphaNone || alphaInfo == kCGImageAlphaNoneSkipFirst || alphaInfo == kCGImageAlphaNoneSkipLast);
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | (hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst);
+    
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return NO;
+    if (ftruncate(fd, (off_t)length) != 0) {
+        close(fd);
+        return NO;
+    }
+    uint8_t *bytes = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) return NO;
+    
+    YYImageBitmapHeader header = {0};
+    header.magic = YY_IMAGE_BITMAP_MAGIC;
+    header.version = YY_IMAGE_BITMAP_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.bytesPerRow = (uint32_t)bytesPerRow;
+    header.bitmapInfo = bitmapInfo;
+    header.dataOffset = (uint32_t)dataOffset;
+    header.orientation = (uint32_t)image.imageOrientation;
+    header.maxPixelSize = (uint32_t)maxPixelSize;
+    header.scale = image.scale;
+    header.dataToken = dataToken;
+    
+    // 直接绘制到映射的文件中，不经过中间的内存
+    BOOL suc = NO;
+    CGContextRef context = CGBitmapContextCreate(bytes + dataOffset, width, height, 8, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo);
+    if (context) {
+        CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+        CGContextRelease(context);
+        memcpy(bytes, &header, sizeof(header));
+        suc = YES;
+    }
+    munmap(bytes, length);
+    return suc;
+}
+
+static void YYImageBitmapReleaseData(void *info, const void *data, size_t size) {
+    if (info) CFRelease(info);
+}
+
+/// Creates an image over the (mapped) bitmap file data, nothing is copied or decoded.
+/// Returns nil if the bitmap is not decoded from the image data with the token.
+static UIImage *YYImageBitmapImageFromData(NSData *data, NSUInteger maxPixelSize, uint64_t dataToken) {
+    if (data.length < sizeof(YYImageBitmapHeader)) return nil;
+    YYImageBitmapHeader header;
+    memcpy(&header, data.bytes, sizeof(header));
+    if (header.magic != YY_IMAGE_BITMAP_MAGIC || header.version != YY_IMAGE_BITMAP_VERSION) return nil;
+    if (header.maxPixelSize != maxPixelSize || header.dataToken != dataToken) return nil;
+    if (header.width == 0 || header.height == 0 || header.bytesPerRow < header.width * 4) return nil;
+    if (header.orientation > UIImageOrientationRightMirrored || header.scale <= 0) return nil;
+    size_t size = (size_t)header.bytesPerRow * header.height;
+    if (header.dataOffset < sizeof(header) || data.length < header.dataOffset + size) return nil;
+    
+    // the provider keeps the mapping alive
+    CGDataProviderRef provider = CGDataProviderCreateWithData((__bridge_retained void *)data, (const uint8_t *)data.bytes + header.dataOffset, size, YYImageBitmapReleaseData);
+    if (!provider) return nil;
+    CGImageRef imageRef = CGImageCreate(header.width, header.height, 8, 32, header.bytesPerRow, YYCGColorSpaceGetDeviceRGB(), header.bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    if (!imageRef) return nil;
+    UIImage *image = [UIImage imageWithCGImage:imageRef scale:header.scale orientation:(UIImageOrientation)header.orientation];
+    CGImageRelease(imageRef);
+    image.isDecodedForDisplay = YES;
+    return image;
+}
 
-@implementation YYImageCache
+/// Returns the memory cache key for the image downsampled to the max pixel size.
+static inline NSString *YYImageCacheMemoryKey(NSString *key, NSUInteger maxPixelSize) {
+    if (maxPixelSize == 0) return key;
+    return [key stringByAppendingFormat:@"#yy_max_px=%lu", (unsigned long)maxPixelSize];
+}
+
+/// Returns a new token for the image data stored in disk cache, the decoded bitmaps
+/// keep the token of the data they are decoded from.
+static uint64_t YYImageCacheNewDataToken(void) {
+    uint64_t token = 0;
+    while (token == 0) arc4random_buf(&token, sizeof(token));
+    return token;
+}
+
+/// Returns the disk cache extended data with the image scale, response validators and data token.
+static NSData *YYImageCacheExtendedData(CGFloat scale, NSDictionary *validators, uint64_t dataToken) {
+    if (scale <= 0 && validators.count == 0 && dataToken == 0) return nil;
+    NSMutableDictionary *info = [NSMutableDictionary new];
+    if (scale > 0) info[@"scale"] = @(scale);
+    if (dataToken) info[@"token"] = @(dataToken);
+    NSString *eTag = validators[@"ETag"];
+    NSString *lastModified = validators[@"Last-Modified"];
+    if ([eTag isKindOfClass:[NSString class]]) info[@"ETag"] = eTag;
+    if ([lastModified isKindOfClass:[NSString class]]) info[@"Last-Modified"] = lastModified;
+    return [NSKeyedArchiver archivedDataWithRootObject:info];
+}
+
+/// Returns the info in the disk cache extended data.
+/// 旧版本的扩展数据只保存了scale (NSNumber)，新版本保存的是字典
+static NSDictionary *YYImageCacheExtendedInfo(NSData *extendedData) {
+    if (extendedData.length == 0) return nil;
+    id info = nil;
+    @try {
+        info = [NSKeyedUnarchiver unarchiveObjectWithData:extendedData];
+    } @catch (NSException *exception) {
+        // nothing to do...
+    }
+    if ([info isKindOfClass:[NSNumber class]]) return @{@"scale" : info};
+    if ([info isKindOfClass:[NSDictionary class]]) return info;
+    return nil;
+}
+
+/// Returns the data token in the disk cache extended info, 0 if there's none (written by an old version).
+static uint64_t YYImageCacheDataToken(NSDictionary *info) {
+    NSNumber *token = info[@"token"];
+    return [token isKindOfClass:[NSNumber class]] ? token.unsignedLongLongValue : 0;
+}
+
+/// Returns the data token of the image data read from disk cache.
+static NSNumber *YYImageCacheDataTokenOfData(NSData *data) {
+    return @(YYImageCacheDataToken(YYImageCacheExtendedInfo([YYDiskCache getExtendedDataFromObject:data])));
+}
+
+
+@implementation YYImageCache {
+    pthread_mutex_t _bitmapLock; ///< guards the bitmap cache, the enabled flag and the data tokens
+    NSMutableDictionary<NSString *, NSNumber *> *_dataTokens; ///< key -> token of the image data in disk cache
+    NSUInteger _dataTokensRemovalCount; ///< `removalCount` of disk cache the tokens are valid for
+    NSUInteger _dataTokensWriteCount; ///< increased when a token is written by this cache
+    pthread_mutex_t _memoryKeysLock; ///< guards the memory key sizes
+    NSMutableDictionary<NSString *, NSMutableSet<NSNumber *> *> *_memoryKeySizes; ///< key -> max pixel sizes of the downsampled images in memory cache
+    NSUInteger _memoryKeySizesPruneCount; ///< prune the memory key sizes when the count exceeds it
+}
+@synthesize bitmapCacheEnabled = _bitmapCacheEnabled;
+@synthesize bitmapCache = _bitmapCache;
 
 // 获取高度和每行的字节，相乘就是内存大小
 - (NSUInteger)imageCost:(UIImage *)image {
@@ -59,21 +250,160 @@ static inline dispatch_queue_t YYImageCacheDecodeQueue() {
     return cost;
 }
 
+- (void)_setMemoryImage:(UIImage *)image forKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize {
+    if (!image) return;
+    // 记录缩小图片的尺寸，移除key时一起移除
+    if (maxPixelSize > 0) [self _addMemoryKeySize:maxPixelSize forKey:key];
+    [_memoryCache setObject:image forKey:YYImageCacheMemoryKey(key, maxPixelSize) withCost:[self imageCost:image]];
+    NSUInteger costLimit = _memoryCache.costLimit;
+    if (costLimit == NSUIntegerMax) return;
+    // 内存池中空闲的位图缓存也计入内存开销，超出时先释放空闲的缓存
+    YYImageBufferPool *pool = [YYImageBufferPool sharedPool];
+    NSUInteger totalCost = _memoryCache.totalCost;
+    NSUInteger poolCost = pool.totalCost;
+    if (poolCost > 0 && totalCost + poolCost > costLimit) {
+        [pool trimToCost:totalCost < costLimit ? costLimit - totalCost : 0];
+    }
+}
+
+/// Remembers a downsampled image of the key in memory cache.
+- (void)_addMemoryKeySize:(NSUInteger)maxPixelSize forKey:(NSString *)key {
+    pthread_mutex_lock(&_memoryKeysLock);
+    NSMutableSet<NSNumber *> *sizes = _memoryKeySizes[key];
+    if (!sizes) {
+        if (_memoryKeySizes.count >= _memoryKeySizesPruneCount) {
+            // 只保留内存缓存中还有缩小图片的key
+            NSMutableArray<NSString *> *evictedKeys = [NSMutableArray new];
+            [_memoryKeySizes enumerateKeysAndObjectsUsingBlock:^(NSString *sizedKey, NSMutableSet<NSNumber *> *sizedSizes, BOOL *stop) {
+                for (NSNumber *size in sizedSizes) {
+                    if ([_memoryCache containsObjectForKey:YYImageCacheMemoryKey(sizedKey, size.unsignedIntegerValue)]) return;
+                }
+                [evictedKeys addObject:sizedKey];
+            }];
+            [_memoryKeySizes removeObjectsForKeys:evictedKeys];
+            _memoryKeySizesPruneCount = MAX(YYImageMemoryKeySizesPruneCount, _memoryKeySizes.count * 2);
+        }
+        sizes = [NSMutableSet new];
+        _memoryKeySizes[key] = sizes;
+    }
+    [sizes addObject:@(maxPixelSize)];
+    pthread_mutex_unlock(&_memoryKeysLock);
+}
+
+/// Removes the image of the key and all its downsampled images from memory cache.
+- (void)_removeMemoryImagesForKey:(NSString *)key {
+    pthread_mutex_lock(&_memoryKeysLock);
+    NSSet<NSNumber *> *sizes = _memoryKeySizes[key];
+    [_memoryKeySizes removeObjectForKey:key];
+    pthread_mutex_unlock(&_memoryKeysLock);
+    [_memoryCache removeObjectForKey:key];
+    for (NSNumber *size in sizes) {
+        [_memoryCache removeObjectForKey:YYImageCacheMemoryKey(key, size.unsignedIntegerValue)];
+    }
+}
+
+/// Returns the bitmap cache if it's enabled.
+- (YYDiskCache *)_enabledBitmapCache {
+    pthread_mutex_lock(&_bitmapLock);
+    YYDiskCache *bitmapCache = _bitmapCacheEnabled ? _bitmapCache : nil;
+    pthread_mutex_unlock(&_bitmapLock);
+    return bitmapCache;
+}
+
+/// Returns the token of the image data in disk cache, or nil if there's no data for the key.
+/// 位图命中时需要确认原始数据还在并且没有被替换。token记录在内存中，磁盘缓存没有移除过对象时不再查询数据库
+- (NSNumber *)_dataTokenForKey:(NSString *)key {
+    NSUInteger removalCount = _diskCache.removalCount;
+    pthread_mutex_lock(&_bitmapLock);
+    if (_dataTokensRemovalCount != removalCount) {
+        [_dataTokens removeAllObjects];
+        _dataTokensRemovalCount = removalCount;
+    }
+    NSNumber *token = _dataTokens[key];
+    NSUInteger writeCount = _dataTokensWriteCount;
+    pthread_mutex_unlock(&_bitmapLock);
+    if (token) return token;
+    
+    NSData *extendedData = [_diskCache extendedDataForKey:key];
+    if (!extendedData && ![_diskCache containsObjectForKey:key]) return nil;
+    token = @(YYImageCacheDataToken(YYImageCacheExtendedInfo(extendedData)));
+    pthread_mutex_lock(&_bitmapLock);
+    // 查询期间有对象被移除或者写入了新的数据时不记录
+    if (_dataTokensRemovalCount == removalCount && _dataTokensWriteCount == writeCount) {
+        if (_dataTokens.count >= YYImageDataTokenMaxCount) [_dataTokens removeAllObjects];
+        _dataTokens[key] = token;
+    }
+    pthread_mutex_unlock(&_bitmapLock);
+    return token;
+}
+
+/// Remembers the token of the image data just written to disk cache.
+- (void)_didWriteDataToken:(uint64_t)token forKey:(NSString *)key {
+    pthread_mutex_lock(&_bitmapLock);
+    _dataTokensWriteCount++;
+    if (_bitmapCacheEnabled) {
+        if (_dataTokens.count >= YYImageDataTokenMaxCount) [_dataTokens removeAllObjects];
+        _dataTokens[key] = @(token);
+    }
+    pthread_mutex_unlock(&_bitmapLock);
+}
+
+- (UIImage *)_bitmapImageForKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize {
+    YYDiskCache *bitmapCache = [self _enabledBitmapCache];
+    if (!bitmapCache) return nil;
+    // 每个尺寸的位图单独保存，交替使用不同尺寸时不会互相覆盖
+    NSString *bitmapKey = YYImageCacheMemoryKey(key, maxPixelSize);
+    NSData *data = (id)[bitmapCache objectForKey:bitmapKey];
+    if (!data) return nil;
+    // 原始数据已经被删除、淘汰或替换时，位图也不再有效
+    NSNumber *token = [self _dataTokenForKey:key];
+    UIImage *image = token ? YYImageBitmapImageFromData(data, maxPixelSize, token.unsignedLongLongValue) : nil;
+    if (!image) [bitmapCache removeObjectForKey:bitmapKey];
+    return image;
+}
+
+- (void)_setBitmapImage:(UIImage *)image forKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize dataToken:(NSNumber *)token {
+    YYDiskCache *bitmapCache = [self _enabledBitmapCache];
+    if (!bitmapCache || !image.CGImage) return;
+    // 动态图和过大的位图不保存
+    if (image.images.count > 1) return;
+    if ([image conformsToProtocol:@protocol(YYAnimatedImage)] &&
+        [(id<YYAnimatedImage>)image animatedImageFrameCount] > 1) return;
+    if ((CGImageGetWidth(image.CGImage) * 4 + 63) / 64 * 64 * CGImageGetHeight(image.CGImage) > YYImageBitmapMaxCost) return;
+    
+    __weak typeof(self) _self = self;
+    YYImageCacheIOAsync(^{
+        __strong typeof(_self) self = _self;
+        if (!self) return;
+        NSNumber *dataToken = token ?: [self _dataTokenForKey:key];
+        if (!dataToken) return; // no image data to decode from
+        NSString *path = [bitmapCache temporaryFilePath];
+        if (!path) return;
+        if (YYImageBitmapWriteFile(image, maxPixelSize, dataToken.unsignedLongLongValue, path)) {
+            [bitmapCache setObjectWithFileAtPath:path extendedData:nil forKey:YYImageCacheMemoryKey(key, maxPixelSize)];
+        } else {
+            [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        }
+    });
+}
+
 - (UIImage *)imageFromData:(NSData *)data {
+    return [self imageFromData:data maxPixelSize:0];
+}
+
+- (UIImage *)imageFromData:(NSData *)data maxPixelSize:(NSUInteger)maxPixelSize {
     // 根据data获取缓存的scale如果没有sacle则使用屏幕scale
-    NSData *scaleData = [YYDiskCache getExtendedDataFromObject:data];
-    CGFloat scale = 0;
-    if (scaleData) {
-        scale = ((NSNumber *)[NSKeyedUnarchiver unarchiveObjectWithData:scaleData]).doubleValue;
-    }
+    NSDictionary *info = YYImageCacheExtendedInfo([YYDiskCache getExtendedDataFromObject:data]);
+    NSNumber *scaleValue = info[@"scale"];
+    CGFloat scale = [scaleValue isKindOfClass:[NSNumber class]] ? scaleValue.doubleValue : 0;
     if (scale <= 0) scale = [UIScreen mainScreen].scale;
     UIImage *image;
     // 如果支持动态图
     if (_allowAnimatedImage) {
-        image = [[YYImage alloc] initWithData:data scale:scale];
+        image = [[YYImage alloc] initWithData:data scale:scale maxPixelSize:maxPixelSize];
         if (_decodeForDisplay) image = [image imageByDecoded];
     } else {
-        YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:scale];
+        YYImageDecoder *decoder = [YYImageDecoder decoderWithData:data scale:scale maxPixelSize:maxPixelSize];
         image = [decoder frameAtIndex:0 decodeForDisplay:_decodeForDisplay].image;
     }
     return image;
@@ -117,62 +447,157 @@ static inline dispatch_queue_t YYImageCacheDecodeQueue() {
     _diskCache = diskCache;
     _allowAnimatedImage = YES;
     _decodeForDisplay = YES;
+    pthread_mutex_init(&_bitmapLock, NULL);
+    _dataTokens = [NSMutableDictionary new];
+    pthread_mutex_init(&_memoryKeysLock, NULL);
+    _memoryKeySizes = [NSMutableDictionary new];
+    _memoryKeySizesPruneCount = YYImageMemoryKeySizesPruneCount;
     return self;
 }
 
+- (void)dealloc {
+    pthread_mutex_destroy(&_bitmapLock);
+    pthread_mutex_destroy(&_memoryKeysLock);
+}
+
+- (BOOL)bitmapCacheEnabled {
+    pthread_mutex_lock(&_bitmapLock);
+    BOOL enabled = _bitmapCacheEnabled;
+    pthread_mutex_unlock(&_bitmapLock);
+    return enabled;
+}
+
+- (YYDiskCache *)bitmapCache {
+    pthread_mutex_lock(&_bitmapLock);
+    YYDiskCache *bitmapCache = _bitmapCache;
+    pthread_mutex_unlock(&_bitmapLock);
+    return bitmapCache;
+}
+
+- (void)setBitmapCacheEnabled:(BOOL)bitmapCacheEnabled {
+    pthread_mutex_lock(&_bitmapLock);
+    if (bitmapCacheEnabled && !_bitmapCache) {
+        // 位图文件总是以文件保存，使用mmap读取，文件只通过rename替换
+        NSString *path = [_diskCache.path stringByAppendingPathComponent:@"bitmaps"];
+        YYDiskCache *bitmapCache = [[YYDiskCache alloc] initWithPath:path inlineThreshold:0];
+        bitmapCache.customArchiveBlock = ^(id object) { return (NSData *)object; };
+        bitmapCache.customUnarchiveBlock = ^(NSData *data) { return (id)data; };
+        bitmapCache.mappedFileRead = YES;
+        bitmapCache.costLimit = 128 * 1024 * 1024;
+        _bitmapCache = bitmapCache;
+    }
+    _bitmapCacheEnabled = bitmapCacheEnabled && _bitmapCache;
+    pthread_mutex_unlock(&_bitmapLock);
+}
+
 - (void)setImage:(UIImage *)image forKey:(NSString *)key {
     [self setImage:image imageData:nil forKey:key withType:YYImageCacheTypeAll];
 }
 
 - (void)setImage:(UIImage *)image imageData:(NSData *)imageData forKey:(NSString *)key withType:(YYImageCacheType)type {
+    [self setImage:image imageData:imageData forKey:key withType:type maxPixelSize:0];
+}
+
+- (void)setImage:(UIImage *)image imageData:(NSData *)imageData forKey:(NSString *)key withType:(YYImageCacheType)type maxPixelSize:(NSUInteger)maxPixelSize {
+    [self setImage:image imageData:imageData validators:nil forKey:key withType:type maxPixelSize:maxPixelSize];
+}
+
+- (void)setImage:(UIImage *)image imageData:(NSData *)imageData validators:(NSDictionary *)validators forKey:(NSString *)key withType:(YYImageCacheType)type maxPixelSize:(NSUInteger)maxPixelSize {
     if (!key || (image == nil && imageData.length == 0)) return;
     
     __weak typeof(self) _self = self;
     if (type & YYImageCacheTypeMemory) { // add to memory cache
+        // 缩小后的图片使用派生的key，不会覆盖原尺寸的图片
         if (image) {
             if (image.isDecodedForDisplay) {
-                [_memoryCache setObject:image forKey:key withCost:[_self imageCost:image]];
+                [self _setMemoryImage:image forKey:key maxPixelSize:maxPixelSize];
             } else {
-                dispatch_async(YYImageCacheDecodeQueue(), ^{
+                YYImageCacheDecodeAsync(^{
                     __strong typeof(_self) self = _self;
                     if (!self) return;
-                    [self.memoryCache setObject:[image imageByDecoded] forKey:key withCost:[self imageCost:image]];
+                    [self _setMemoryImage:[image imageByDecoded] forKey:key maxPixelSize:maxPixelSize];
                 });
             }
         } else if (imageData) {
-            dispatch_async(YYImageCacheDecodeQueue(), ^{
+            YYImageCacheDecodeAsync(^{
                 __strong typeof(_self) self = _self;
                 if (!self) return;
-                UIImage *newImage = [self imageFromData:imageData];
-                [self.memoryCache setObject:newImage forKey:key withCost:[self imageCost:newImage]];
+                UIImage *newImage = [self imageFromData:imageData maxPixelSize:maxPixelSize];
+                [self _setMemoryImage:newImage forKey:key maxPixelSize:maxPixelSize];
             });
         }
     }
     if (type & YYImageCacheTypeDisk) { // add to disk cache
+        // 新数据使用新的token，之前解码的位图都会失效
+        uint64_t token = YYImageCacheNewDataToken();
         if (imageData) {
-            if (image) {
-                [YYDiskCache setExtendedData:[NSKeyedArchiver archivedDataWithRootObject:@(image.scale)] toObject:imageData];
-            }
+            [YYDiskCache setExtendedData:YYImageCacheExtendedData(image.scale, validators, token) toObject:imageData];
             [_diskCache setObject:imageData forKey:key];
-        } else if (image) {
-            dispatch_async(YYImageCacheIOQueue(), ^{
+            [self _didWriteDataToken:token forKey:key];
+            if (image) [self _setBitmapImage:image forKey:key maxPixelSize:maxPixelSize dataToken:@(token)];
+        } else if (image && maxPixelSize == 0) { // never store a downsampled image as original
+            YYImageCacheIOAsync(^{
                 __strong typeof(_self) self = _self;
                 if (!self) return;
                 NSData *data = [image imageDataRepresentation];
-                [YYDiskCache setExtendedData:[NSKeyedArchiver archivedDataWithRootObject:@(image.scale)] toObject:data];
+                if (!data) return;
+                [YYDiskCache setExtendedData:YYImageCacheExtendedData(image.scale, validators, token) toObject:data];
                 [self.diskCache setObject:data forKey:key];
+                [self _didWriteDataToken:token forKey:key];
+                [self _setBitmapImage:image forKey:key maxPixelSize:0 dataToken:@(token)];
             });
+        } else if (image) {
+            [self _setBitmapImage:image forKey:key maxPixelSize:maxPixelSize dataToken:nil];
         }
     }
 }
 
+- (NSString *)temporaryImageDataPath {
+    return [_diskCache temporaryFilePath];
+}
+
+- (BOOL)setImage:(UIImage *)image imageDataFileAtPath:(NSString *)path validators:(NSDictionary *)validators forKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize {
+    if (!path) return NO;
+    if (!key) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        return NO;
+    }
+    uint64_t token = YYImageCacheNewDataToken();
+    NSData *extendedData = YYImageCacheExtendedData(image.scale, validators, token);
+    BOOL suc = [_diskCache setObjectWithFileAtPath:path extendedData:extendedData forKey:key];
+    if (suc) [self _didWriteDataToken:token forKey:key];
+    if (image) [self setImage:image imageData:nil forKey:key withType:YYImageCacheTypeMemory maxPixelSize:maxPixelSize];
+    if (suc && image) [self _setBitmapImage:image forKey:key maxPixelSize:maxPixelSize dataToken:@(token)];
+    return suc;
+}
+
+- (NSDictionary *)validatorsForKey:(NSString *)key {
+    if (!key) return nil;
+    NSDictionary *info = YYImageCacheExtendedInfo([_diskCache extendedDataForKey:key]);
+    NSMutableDictionary *validators = [NSMutableDictionary new];
+    NSString *eTag = info[@"ETag"];
+    NSString *lastModified = info[@"Last-Modified"];
+    if ([eTag isKindOfClass:[NSString class]]) validators[@"ETag"] = eTag;
+    if ([lastModified isKindOfClass:[NSString class]]) validators[@"Last-Modified"] = lastModified;
+    return validators.count ? validators : nil;
+}
+
+- (void)touchImageForKey:(NSString *)key {
+    [_diskCache touchObjectForKey:key];
+}
+
 - (void)removeImageForKey:(NSString *)key {
     [self removeImageForKey:key withType:YYImageCacheTypeAll];
 }
 
 - (void)removeImageForKey:(NSString *)key withType:(YYImageCacheType)type {
-    if (type & YYImageCacheTypeMemory) [_memoryCache removeObjectForKey:key];
-    if (type & YYImageCacheTypeDisk) [_diskCache removeObjectForKey:key];
+    if (!key) return;
+    if (type & YYImageCacheTypeMemory) [self _removeMemoryImagesForKey:key];
+    if (type & YYImageCacheTypeDisk) {
+        // 其他尺寸的位图在下次读取时因为token失效而被删除
+        [_diskCache removeObjectForKey:key];
+        [self.bitmapCache removeObjectForKey:key];
+    }
 }
 
 - (BOOL)containsImageForKey:(NSString *)key {
@@ -194,16 +619,26 @@ static inline dispatch_queue_t YYImageCacheDecodeQueue() {
 }
 
 - (UIImage *)getImageForKey:(NSString *)key withType:(YYImageCacheType)type {
+    return [self getImageForKey:key withType:type maxPixelSize:0];
+}
+
+- (UIImage *)getImageForKey:(NSString *)key withType:(YYImageCacheType)type maxPixelSize:(NSUInteger)maxPixelSize {
     if (!key) return nil;
+    NSString *memoryKey = YYImageCacheMemoryKey(key, maxPixelSize);
     if (type & YYImageCacheTypeMemory) {
-        UIImage *image = [_memoryCache objectForKey:key];
+        UIImage *image = [_memoryCache objectForKey:memoryKey];
         if (image) return image;
     }
     if (type & YYImageCacheTypeDisk) {
-        NSData *data = (id)[_diskCache objectForKey:key];
-        UIImage *image = [self imageFromData:data];
+        // 优先使用磁盘上解码后的位图，不需要再解码
+        UIImage *image = [self _bitmapImageForKey:key maxPixelSize:maxPixelSize];
+        if (!image) {
+            NSData *data = (id)[_diskCache objectForKey:key];
+            image = [self imageFromData:data maxPixelSize:maxPixelSize];
+            if (image) [self _setBitmapImage:image forKey:key maxPixelSize:maxPixelSize dataToken:YYImageCacheDataTokenOfData(data)];
+        }
         if (image && (type & YYImageCacheTypeMemory)) {
-            [_memoryCache setObject:image forKey:key withCost:[self imageCost:image]];
+            [self _setMemoryImage:image forKey:key maxPixelSize:maxPixelSize];
         }
         return image;
     }
@@ -226,10 +661,14 @@ static inline dispatch_queue_t YYImageCacheDecodeQueue() {
         }
         
         if (type & YYImageCacheTypeDisk) {
-            NSData *data = (id)[_diskCache objectForKey:key];
-            image = [self imageFromData:data];
+            image = [self _bitmapImageForKey:key maxPixelSize:0];
+            if (!image) {
+                NSData *data = (id)[_diskCache objectForKey:key];
+                image = [self imageFromData:data];
+                if (image) [self _setBitmapImage:image forKey:key maxPixelSize:0 dataToken:YYImageCacheDataTokenOfData(data)];
+            }
             if (image) {
-                [_memoryCache setObject:image forKey:key];
+                [self _setMemoryImage:image forKey:key maxPixelSize:0];
                 dispatch_async(dispatch_get_main_queue(), ^{
                     block(image, YYImageCacheTypeDisk);
                 });
@@ -11,6 +11,8 @@
 
 #import <UIKit/UIKit.h>
 
+@class YYMemoryCache;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -29,6 +31,8 @@ typedef NS_ENUM(NSUInteger, YYImageType) {
     YYImageTypePNG,         ///< png
     YYImageTypeWebP,        ///< webp
     YYImageTypeOther,       ///< other image format
+    YYImageTypeHEIC,        ///< heic, heif (decoded by ImageIO, iOS 11 or later)
+    YYImageTypeAVIF,        ///< avif (decoded by ImageIO, iOS 16 or later)
 };
 
 
@@ -161,6 +165,23 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
 @property (nonatomic, readonly) NSUInteger height;         ///< Image canvas height.
 // 是否完成
 @property (nonatomic, readonly, getter=isFinalized) BOOL finalized;
+// 解码输出的最大像素边长，0代表不限制
+@property (nonatomic, readonly) NSUInteger maxPixelSize;   ///< Max pixel size of decoded frame, 0 means no limit.
+
+/**
+ The number of canvas rows decoded so far by the streaming decoder.
+ 
+ @discussion Still WebP and non-interlaced PNG are decoded in streaming mode before
+ the data is finalized: each call of `updateData:final:` only parses and decodes
+ the bytes received since the last call, and the first frame contains the rows
+ decoded so far (the rest is transparent). You may compare this value between
+ updates to skip redundant progressive display. It's 0 when the incremental data
+ is decoded by ImageIO (such as JPEG) or before any row is decoded, and equals to
+ `height` after the data is finalized and decoded.
+ 
+ @note 流式解码已经解出的画布行数；静态WebP和非隔行PNG在数据不完整时只处理新收到的字节，可用于跳过没有新行的渐进显示
+ */
+@property (nonatomic, readonly) NSUInteger decodedRowCount;
 
 /**
  Creates an image decoder.
@@ -170,7 +191,26 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
  
  根据比例生成解码器
  */
-- (instancetype)initWithScale:(CGFloat)scale NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithScale:(CGFloat)scale;
+
+/**
+ Creates an image decoder which downsamples the decoded frames.
+ 
+ @discussion The `width` and `height` properties always return the source canvas
+ size, while the frames returned by `frameAtIndex:decodeForDisplay:` are scaled
+ down (keeping aspect ratio) so that the longer side is not larger than 
+ `maxPixelSize`. The image is never scaled up. ImageIO formats use the thumbnail
+ generated at decode time, WebP is scaled inside libwebp, and APNG frames are 
+ box filtered scanline by scanline.
+ 
+ @param scale        Image's scale.
+ @param maxPixelSize The max pixel size of decoded frame, pass 0 to decode at
+    full size.
+ @return An image decoder.
+ 
+ @note 根据比例和最大像素边长生成解码器，解码时直接输出缩小后的位图，避免为缩略图解码全尺寸位图
+ */
+- (instancetype)initWithScale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize NS_DESIGNATED_INITIALIZER;
 
 /**
  Updates the incremental image with new data.
@@ -203,6 +243,17 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
  */
 + (nullable instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale;
 
+/**
+ Convenience method to create a downsampling decoder with specified data.
+ @param data         Image data.
+ @param scale        Image's scale.
+ @param maxPixelSize The max pixel size of decoded frame, 0 means no limit.
+ @return A new decoder, or nil if an error occurs.
+ 
+ @note 一个便利的方式直接使用data生成缩小解码的解码器
+ */
++ (nullable instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize;
+
 /**
  Decodes and returns a frame from a specified index.
  @param index  Frame image index (zero-based).
@@ -246,6 +297,111 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
 
 
 
+#pragma mark - Tile Decoder
+
+/**
+ A tile decoder to decode sub-rectangles of very large images.
+ 
+ @discussion This class decodes an arbitrary rect of the image at a scale level
+ (level 0 is full size, level n is 1/2^n of the full size) without decoding the 
+ whole bitmap when possible:
+ 
+ * WebP (still): decoded with libwebp cropping (and scaling for level > 0).
+ * PNG/APNG (non-interlaced): inflated row by row, decoding stops once the last
+   row of the rect is reached, only two scanlines are kept during inflating.
+   APNG is decoded as its default image.
+ * Other formats (and interlaced PNG, animated WebP): the rect is cropped from an
+   ImageIO image that is not decoded and not cached, so the full bitmap is never
+   kept. For level > 0 the image is subsampled by ImageIO (JPEG is reduced in the
+   DCT) on iOS 9 and later.
+ 
+ A tile row is decoded once as a strip of the full level width, and its tiles are
+ cropped from the strip. Only the last strip is kept. Tiles are cached in `tileCache`
+ (a `YYMemoryCache`, least recently used tiles are evicted first). The image orientation is not applied, the rect is in the 
+ image's pixel coordinates. This class is thread-safe.
+ 
+ @note 大图的区域解码器，按照缩放等级(0为原尺寸，n为原尺寸的1/2^n)解码任意矩形区域，尽量避免解码整张位图：
+       WebP使用libwebp裁剪解码，PNG/APNG(非隔行扫描)逐行inflate并在到达区域最后一行时停止，其他格式从不缓存
+       解码结果的ImageIO图片中裁剪(支持时由ImageIO降采样)；每行瓦片解码一次整行的条带再裁剪；解码的瓦片缓存在LRU的tileCache中；不处理图片方向；这个类是线程安全的
+ 
+ Example:
+ 
+    YYImageTileDecoder *decoder = [YYImageTileDecoder decoderWithData:data scale:2.0];
+    // tile of the visible area at 1/4 size
+    UIImage *tile = [decoder tileAtColumn:2 row:1 level:2];
+ */
+@interface YYImageTileDecoder : NSObject
+@property (nonatomic, readonly) NSData *data;          ///< Image data.
+@property (nonatomic, readonly) YYImageType type;      ///< Image data type.
+@property (nonatomic, readonly) CGFloat scale;         ///< Image scale of the returned tiles.
+@property (nonatomic, readonly) NSUInteger width;      ///< Image width in pixels.
+@property (nonatomic, readonly) NSUInteger height;     ///< Image height in pixels.
+@property (nonatomic, readonly) NSUInteger tileSize;   ///< Tile width and height in pixels (at every level).
+@property (nonatomic, readonly) NSUInteger maxLevel;   ///< The level at which the whole image fits in one tile.
+
+/**
+ The tile cache. Default cost limit is 32MB (cost is the bitmap size in bytes).
+ 
+ @note 瓦片缓存，默认内存上限为32MB
+ */
+@property (nonatomic, readonly) YYMemoryCache *tileCache;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+/**
+ Creates a tile decoder.
+ 
+ @param data     Image data.
+ @param scale    Image's scale.
+ @param tileSize Tile width and height in pixels, 0 means default (256).
+ @return A new tile decoder, or nil if the image size cannot be read.
+ 
+ @note 根据图片数据生成区域解码器，只读取图片的尺寸，不解码
+ */
+- (nullable instancetype)initWithData:(NSData *)data scale:(CGFloat)scale tileSize:(NSUInteger)tileSize NS_DESIGNATED_INITIALIZER;
+
+/**
+ Convenience method to create a tile decoder with default tile size (256).
+ 
+ @note 使用默认的瓦片大小生成区域解码器
+ */
++ (nullable instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale;
+
+/**
+ Decodes a rect of the image, the result is not cached.
+ 
+ @param rect  The rect in image pixels (level 0), it will be clipped to image bounds.
+ @param level The scale level, the returned image size is rect.size / 2^level.
+ @return A decoded image, or nil if an error occurs.
+ 
+ @note 解码指定区域(原尺寸像素坐标)并按等级缩小，结果不缓存
+ */
+- (nullable UIImage *)imageInRect:(CGRect)rect level:(NSUInteger)level;
+
+/**
+ Returns the tile at the specified position and level, tiles are cached.
+ 
+ @param column Tile column, the tile's rect at the level is 
+    (column * tileSize, row * tileSize, tileSize, tileSize) clipped to image bounds.
+ @param row    Tile row.
+ @param level  The scale level.
+ @return A decoded tile image, or nil if the position is out of range or an error occurs.
+ 
+ @note 获取指定等级和位置的瓦片，瓦片会被缓存
+ */
+- (nullable UIImage *)tileAtColumn:(NSUInteger)column row:(NSUInteger)row level:(NSUInteger)level;
+
+/// Returns the tile column count at the specified level.
+- (NSUInteger)columnCountAtLevel:(NSUInteger)level;
+
+/// Returns the tile row count at the specified level.
+- (NSUInteger)rowCountAtLevel:(NSUInteger)level;
+
+@end
+
+
+
 #pragma mark - Encoder
 
 /**
@@ -285,6 +441,19 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
 // 压缩质量，只针对JPG/JP2/WebP类型
 @property (nonatomic) CGFloat quality;            ///< Compress quality, 0.0~1.0, only available for JPG/JP2/WebP.
 
+/**
+ The max number of frames compressed concurrently when encoding APNG or animated
+ WebP. Default is the active processor count, set 1 to encode the frames one
+ after another on the calling thread.
+ 
+ @discussion Each frame is compressed independently on a worker thread, then 
+ the frames are assembled in order, so the output is byte-identical to the
+ serial encoding.
+ 
+ @note APNG和动态WebP的帧并行编码数量，默认为CPU核心数，1代表在当前线程逐帧编码；各帧独立编码后按顺序组装，输出与串行编码完全相同
+ */
+@property (nonatomic) NSUInteger maxConcurrentFrameCount;
+
 - (instancetype)init UNAVAILABLE_ATTRIBUTE;
 + (instancetype)new UNAVAILABLE_ATTRIBUTE;
 
@@ -366,6 +535,58 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
 @end
 
 
+#pragma mark - Bitmap Buffer Pool
+
+/**
+ A size-class pool of bitmap buffers used by the decoded images.
+ 
+ @discussion `YYCGImageCreateDecodedCopy()` (and the decoders using it) draws into 
+ a buffer taken from this pool, and the decoded image's data provider returns the 
+ buffer to the pool when the image is released (e.g. evicted from `YYImageCache`). 
+ So decoding images of the same size reuses the same memory pages instead of 
+ mapping and faulting in a new multi-MB allocation each time.
+ 
+ Buffers are grouped by size class (4 classes per power of two, at most 25% wasted).
+ The idle buffers are counted by `totalCost`; they are freed when `costLimit` is
+ exceeded, when the app receives a memory warning or enters background. 
+ `YYImageCache` counts the idle buffers against its memory cost limit. 
+ This class is thread-safe.
+ 
+ @note 解码位图的内存池：解码图片时从池中按尺寸等级取出缓存，图片释放时缓存回到池中，相同尺寸的图片复用已经映射的内存页，
+       避免频繁分配大块内存和缺页中断；空闲缓存的大小计入YYImageCache的内存开销限制，内存警告和进入后台时释放
+ */
+@interface YYImageBufferPool : NSObject
+
+/// The shared pool used by the image decoders.
++ (instancetype)sharedPool;
+
+/**
+ The maximum total bytes of the idle buffers. Default is 1/64 of the physical
+ memory (at most 64MB). Set it to 0 to disable pooling.
+ */
+@property NSUInteger costLimit;
+
+/// The total bytes of the idle buffers in the pool.
+@property (readonly) NSUInteger totalCost;
+
+/// The count of buffers allocated by the pool (not reused).
+@property (readonly) NSUInteger allocationCount;
+
+/// The count of buffers reused from the pool.
+@property (readonly) NSUInteger reuseCount;
+
+/**
+ Free the idle buffers until the `totalCost` is below or equal to the specified value.
+ @param cost The total cost allowed to remain.
+ */
+- (void)trimToCost:(NSUInteger)cost;
+
+/// Free all idle buffers.
+- (void)removeAllBuffers;
+
+@end
+
+
 #pragma mark - UIImage
 
 @interface UIImage (YYImageCoder)
@@ -425,9 +646,39 @@ typedef NS_ENUM(NSUInteger, YYImageBlendOperation) {
 #pragma mark - Helper
 
 /// Detect a data's image type by reading the data's header 16 bytes (very fast).
+/// The header is matched against a signature table with raw byte compares, nothing is allocated.
 // 通过读取16字节的数据头监测数据头像的类型（速度非常快）
 CG_EXTERN YYImageType YYImageDetectType(CFDataRef data);
 
+/// Image information read from the file header, see YYImageProbeHeader().
+typedef struct {
+    YYImageType type;               ///< image type
+    NSUInteger width;               ///< canvas width in pixels (before orientation)
+    NSUInteger height;              ///< canvas height in pixels (before orientation)
+    NSUInteger frameCount;          ///< frame count, 1 for still image
+    NSUInteger loopCount;           ///< loop count, 0 means infinite
+    UIImageOrientation orientation; ///< EXIF orientation (JPEG)
+    BOOL hasAlpha;                  ///< whether the image may contain alpha channel
+} YYImageHeaderInfo;
+
+/**
+ Read the image size and animation info from the data's header, without
+ decoding or copying the data (very fast).
+ 
+ @discussion PNG/APNG reads `IHDR` and `acTL`, GIF reads the logical screen 
+ descriptor and counts the frames by skipping the data sub-blocks, WebP reads
+ `VP8X`/`VP8 `/`VP8L` (and counts `ANMF` chunks by their headers), JPEG reads
+ `SOF` and the EXIF orientation. Other types are probed with the properties of
+ CGImageSource.
+ 
+ @param data The image data (may be incomplete).
+ @param info The output info, pass NULL to ignore.
+ @return Whether the image size is found.
+ 
+ @note 只读取文件头获取图片尺寸、帧数、循环次数和方向，不解码也不复制数据（速度非常快），可以在解码前用于布局
+ */
+CG_EXTERN BOOL YYImageProbeHeader(CFDataRef data, YYImageHeaderInfo *_Nullable info);
+
 /// Convert YYImageType to UTI (such as kUTTypeJPEG).
 // 将YYImageType转换为UTI类型
 CG_EXTERN CFStringRef _Nullable YYImageTypeToUTType(YYImageType type);
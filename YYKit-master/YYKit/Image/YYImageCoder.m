@@ -18,8 +18,10 @@
 #import <AssetsLibrary/AssetsLibrary.h>
 #import <objc/runtime.h>
 #import <pthread.h>
+#import <libkern/OSAtomic.h>
 #import <zlib.h>
 #import "YYImage.h"
+#import "YYMemoryCache.h"
 #import "YYKitMacro.h"
 
 // 判断是否倒入了webP库
@@ -627,6 +629,351 @@ static uint8_t *yy_png_copy_frame_data_at_index(const uint8_t *data,
 }
 
 
+/// The png pixel format used to convert a scanline to premultiplied bgrA.
+typedef struct {
+    uint8_t color_type;     ///< see yy_png_chunk_IHDR
+    uint8_t bit_depth;      ///< 1, 2, 4, 8, 16
+    uint8_t channels;       ///< samples per pixel
+    bool has_trns_key;      ///< gray/rgb image with `tRNS` color key
+    uint16_t trns_key[3];   ///< `tRNS` color key (gray or rgb)
+    bool has_palette;       ///< `PLTE` is read
+    uint8_t palette[256 * 4]; ///< premultiplied bgrA palette (indexed-color image)
+} yy_png_pixel_format;
+
+/// Paeth predictor, see PNG spec 9.4.
+static inline uint8_t yy_png_paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = (int)a + (int)b - (int)c;
+    int pa = abs(p - (int)a);
+    int pb = abs(p - (int)b);
+    int pc = abs(p - (int)c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+/**
+ Reverse the scanline filter in place.
+ @param filter filter type (the first byte of scanline)
+ @param row    scanline without filter type byte
+ @param prev   previous reconstructed scanline (zero for the first scanline)
+ @param length scanline length in bytes
+ @param bpp    bytes per complete pixel, at least 1
+ @return false if the filter type is invalid
+ */
+static bool yy_png_unfilter_row(uint8_t filter, uint8_t *row, const uint8_t *prev, size_t length, size_t bpp) {
+    switch (filter) {
+        case 0: { // None
+        } break;
+        case 1: { // Sub
+            for (size_t i = bpp; i < length; i++) row[i] += row[i - bpp];
+        } break;
+        case 2: { // Up
+            for (size_t i = 0; i < length; i++) row[i] += prev[i];
+        } break;
+        case 3: { // Average
+            for (size_t i = 0; i < bpp; i++) row[i] += prev[i] >> 1;
+            for (size_t i = bpp; i < length; i++) row[i] += ((int)row[i - bpp] + (int)prev[i]) >> 1;
+        } break;
+        case 4: { // Paeth
+            for (size_t i = 0; i < bpp; i++) row[i] += prev[i];
+            for (size_t i = bpp; i < length; i++) row[i] += yy_png_paeth(row[i - bpp], prev[i], prev[i - bpp]);
+        } break;
+        default: return false;
+    }
+    return true;
+}
+
+/// Returns the sample at `index` of a reconstructed scanline.
+static inline uint16_t yy_png_row_sample(const uint8_t *row, size_t index, uint8_t bit_depth) {
+    switch (bit_depth) {
+        case 8: return row[index];
+        case 16: return (uint16_t)((row[index * 2] << 8) | row[index * 2 + 1]);
+        default: {
+            size_t bit = index * bit_depth;
+            return (row[bit >> 3] >> (8 - bit_depth - (bit & 7))) & ((1 << bit_depth) - 1);
+        }
+    }
+}
+
+/// Scale a sample to 8 bit.
+static inline uint8_t yy_png_sample_to_8bit(uint16_t sample, uint8_t bit_depth) {
+    switch (bit_depth) {
+        case 8: return (uint8_t)sample;
+        case 16: return (uint8_t)(sample >> 8);
+        default: return (uint8_t)(sample * 255 / ((1 << bit_depth) - 1));
+    }
+}
+
+/// Convert pixels [x, x + width) of a reconstructed scanline to premultiplied bgrA.
+static void yy_png_convert_row(const uint8_t *row, const yy_png_pixel_format *format, uint32_t x, uint32_t width, uint8_t *dst) {
+    uint8_t depth = format->bit_depth;
+    for (uint32_t i = 0; i < width; i++) {
+        size_t px = (size_t)x + i;
+        uint8_t *out = dst + i * 4;
+        if (format->color_type == 3) {
+            memcpy(out, format->palette + yy_png_row_sample(row, px, depth) * 4, 4);
+            continue;
+        }
+        uint16_t r, g, b;
+        uint8_t a = 255;
+        switch (format->color_type) {
+            case 0: {
+                r = g = b = yy_png_row_sample(row, px, depth);
+                if (format->has_trns_key && r == format->trns_key[0]) a = 0;
+            } break;
+            case 2: {
+                r = yy_png_row_sample(row, px * 3, depth);
+                g = yy_png_row_sample(row, px * 3 + 1, depth);
+                b = yy_png_row_sample(row, px * 3 + 2, depth);
+                if (format->has_trns_key && r == format->trns_key[0] && g == format->trns_key[1] && b == format->trns_key[2]) a = 0;
+            } break;
+            case 4: {
+                r = g = b = yy_png_row_sample(row, px * 2, depth);
+                a = yy_png_sample_to_8bit(yy_png_row_sample(row, px * 2 + 1, depth), depth);
+            } break;
+            default: { // 6
+                r = yy_png_row_sample(row, px * 4, depth);
+                g = yy_png_row_sample(row, px * 4 + 1, depth);
+                b = yy_png_row_sample(row, px * 4 + 2, depth);
+                a = yy_png_sample_to_8bit(yy_png_row_sample(row, px * 4 + 3, depth), depth);
+            } break;
+        }
+        out[0] = (uint8_t)((yy_png_sample_to_8bit(b, depth) * a + 127) / 255);
+        out[1] = (uint8_t)((yy_png_sample_to_8bit(g, depth) * a + 127) / 255);
+        out[2] = (uint8_t)((yy_png_sample_to_8bit(r, depth) * a + 127) / 255);
+        out[3] = a;
+    }
+}
+
+/**
+ Init the pixel format with png header.
+ @return false if the png is interlaced or the format is not supported.
+ */
+static bool yy_png_pixel_format_init_with_header(yy_png_pixel_format *format, const yy_png_chunk_IHDR *header) {
+    if (header->width == 0 || header->height == 0) return false;
+    if (header->compression_method != 0 || header->filter_method != 0) return false;
+    if (header->interlace_method != 0) return false; // Adam7 rows are not contiguous
+    
+    memset(format, 0, sizeof(yy_png_pixel_format));
+    format->color_type = header->color_type;
+    format->bit_depth = header->bit_depth;
+    switch (header->color_type) {
+        case 0: format->channels = 1; break;
+        case 2: format->channels = 3; break;
+        case 3: format->channels = 1; break;
+        case 4: format->channels = 2; break;
+        case 6: format->channels = 4; break;
+        default: return false;
+    }
+    switch (header->bit_depth) {
+        case 1: case 2: case 4: {
+            if (header->color_type != 0 && header->color_type != 3) return false;
+        } break;
+        case 8: break;
+        case 16: {
+            if (header->color_type == 3) return false;
+        } break;
+        default: return false;
+    }
+    for (uint32_t p = 0; p < 256; p++) format->palette[p * 4 + 3] = 0xFF;
+    return true;
+}
+
+/// Read a chunk before `IDAT` (`PLTE` and `tRNS`), other chunks are ignored.
+static void yy_png_pixel_format_add_chunk(yy_png_pixel_format *format, uint32_t fourcc, const uint8_t *chunk_data, uint32_t length) {
+    if (fourcc == YY_FOUR_CC('P', 'L', 'T', 'E')) {
+        uint32_t count = MIN(length / 3, 256);
+        for (uint32_t p = 0; p < count; p++) {
+            format->palette[p * 4 + 0] = chunk_data[p * 3 + 2];
+            format->palette[p * 4 + 1] = chunk_data[p * 3 + 1];
+            format->palette[p * 4 + 2] = chunk_data[p * 3 + 0];
+        }
+        format->has_palette = true;
+    } else if (fourcc == YY_FOUR_CC('t', 'R', 'N', 'S')) {
+        if (format->color_type == 3) {
+            uint32_t count = MIN(length, 256);
+            for (uint32_t p = 0; p < count; p++) format->palette[p * 4 + 3] = chunk_data[p];
+        } else if (format->color_type == 0 && length >= 2) {
+            format->has_trns_key = true;
+            format->trns_key[0] = yy_swap_endian_uint16(*((uint16_t *)chunk_data));
+        } else if (format->color_type == 2 && length >= 6) {
+            format->has_trns_key = true;
+            format->trns_key[0] = yy_swap_endian_uint16(*((uint16_t *)chunk_data));
+            format->trns_key[1] = yy_swap_endian_uint16(*((uint16_t *)(chunk_data + 2)));
+            format->trns_key[2] = yy_swap_endian_uint16(*((uint16_t *)(chunk_data + 4)));
+        }
+    }
+}
+
+/**
+ Finish the pixel format when the first `IDAT` is reached (premultiply the palette).
+ @return false if the indexed-color png has no palette.
+ */
+static bool yy_png_pixel_format_finish(yy_png_pixel_format *format) {
+    if (format->color_type != 3) return true;
+    if (!format->has_palette) return false;
+    for (uint32_t p = 0; p < 256; p++) {
+        uint8_t *entry = format->palette + p * 4;
+        entry[0] = (uint8_t)((entry[0] * entry[3] + 127) / 255);
+        entry[1] = (uint8_t)((entry[1] * entry[3] + 127) / 255);
+        entry[2] = (uint8_t)((entry[2] * entry[3] + 127) / 255);
+    }
+    return true;
+}
+
+/**
+ Read the pixel format (and palette) of a png.
+ @return false if the png is interlaced or the format is not supported.
+ */
+static bool yy_png_pixel_format_init(yy_png_pixel_format *format, const uint8_t *data, yy_png_info *info) {
+    if (!yy_png_pixel_format_init_with_header(format, &info->header)) return false;
+    for (uint32_t i = 0; i < info->chunk_num; i++) {
+        yy_png_chunk_info *chunk = info->chunks + i;
+        if (chunk->fourcc == YY_FOUR_CC('I', 'D', 'A', 'T')) break; // PLTE and tRNS must precede IDAT
+        yy_png_pixel_format_add_chunk(format, chunk->fourcc, data + chunk->offset + 8, chunk->length);
+    }
+    return yy_png_pixel_format_finish(format);
+}
+
+/**
+ The state of a streaming png decoder. The chunk parser and the inflate stream
+ are retained between updates, so each received byte is parsed and inflated only
+ once, and the reconstructed rows are converted into a premultiplied bgrA canvas.
+ 
+ @note 渐进式PNG解码状态：保留chunk解析位置和inflate状态，每个字节只处理一次
+ */
+typedef struct {
+    uint64_t offset;            ///< offset of the next chunk to parse
+    uint32_t idat_consumed;     ///< consumed data bytes of the current `IDAT` chunk
+    bool header_ready;          ///< `IHDR` is parsed
+    bool format_ready;          ///< the first `IDAT` is reached, canvas is allocated
+    bool failed;                ///< interlaced, not supported or corrupted
+    yy_png_chunk_IHDR header;
+    yy_png_pixel_format format;
+    z_stream stream;
+    bool stream_inited;
+    size_t row_length;          ///< scanline length without filter type byte
+    size_t bpp;                 ///< bytes per complete pixel, at least 1
+    uint8_t *cur;               ///< current scanline (with filter type byte)
+    uint8_t *prev;              ///< previous reconstructed scanline
+    uint8_t *canvas;            ///< premultiplied bgrA, `header.height` rows
+    size_t canvas_stride;       ///< canvas bytes per row
+    uint32_t decoded_rows;      ///< rows written to canvas
+} yy_png_stream;
+
+static void yy_png_stream_release(yy_png_stream *s) {
+    if (s) {
+        if (s->stream_inited) inflateEnd(&s->stream);
+        if (s->cur) free(s->cur);
+        if (s->prev) free(s->prev);
+        if (s->canvas) free(s->canvas);
+        free(s);
+    }
+}
+
+/// Inflate data of an `IDAT` chunk, reconstruct the completed scanlines to canvas.
+static bool yy_png_stream_inflate(yy_png_stream *s, const uint8_t *bytes, uint32_t length) {
+    s->stream.next_in = (Bytef *)bytes;
+    s->stream.avail_in = length;
+    while (s->decoded_rows < s->header.height) {
+        int ret = inflate(&s->stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) return false;
+        bool row_done = s->stream.avail_out == 0;
+        if (row_done) {
+            if (!yy_png_unfilter_row(s->cur[0], s->cur + 1, s->prev + 1, s->row_length, s->bpp)) return false;
+            yy_png_convert_row(s->cur + 1, &s->format, 0, s->header.width, s->canvas + s->decoded_rows * s->canvas_stride);
+            s->decoded_rows++;
+            uint8_t *tmp = s->prev;
+            s->prev = s->cur;
+            s->cur = tmp;
+            s->stream.next_out = s->cur;
+            s->stream.avail_out = (uInt)(s->row_length + 1);
+        }
+        if (ret == Z_STREAM_END) break;
+        if (!row_done && (s->stream.avail_in == 0 || ret == Z_BUF_ERROR)) break; // need more data
+    }
+    return true;
+}
+
+/// Called when the first `IDAT` is reached, allocate scanlines, canvas and inflate stream.
+static bool yy_png_stream_prepare(yy_png_stream *s) {
+    if (!yy_png_pixel_format_finish(&s->format)) return false;
+    size_t bits_per_pixel = (size_t)s->format.channels * s->format.bit_depth;
+    s->row_length = ((size_t)s->header.width * bits_per_pixel + 7) / 8;
+    s->bpp = bits_per_pixel >= 8 ? bits_per_pixel / 8 : 1;
+    s->canvas_stride = ((size_t)s->header.width * 4 + 31) / 32 * 32; // 32 bytes aligned
+    if (s->canvas_stride / 4 < s->header.width) return false; // overflow
+    if (s->header.height > SIZE_MAX / s->canvas_stride) return false;
+    s->cur = calloc(1, s->row_length + 1);
+    s->prev = calloc(1, s->row_length + 1);
+    s->canvas = calloc(s->header.height, s->canvas_stride);
+    if (!s->cur || !s->prev || !s->canvas) return false;
+    if (inflateInit(&s->stream) != Z_OK) return false;
+    s->stream_inited = true;
+    s->stream.next_out = s->cur;
+    s->stream.avail_out = (uInt)(s->row_length + 1);
+    s->format_ready = true;
+    return true;
+}
+
+/**
+ Parse and decode the newly received bytes.
+ 
+ @param s      stream state, created with calloc() and released with yy_png_stream_release()
+ @param data   all the png data received so far (only the bytes after the last update are read)
+ @param length the data's length in bytes
+ @return false if the png cannot be decoded by the stream (interlaced, not supported
+ or corrupted), the caller should fall back to the whole-buffer decoder.
+ */
+static bool yy_png_stream_update(yy_png_stream *s, const uint8_t *data, uint64_t length) {
+    if (s->failed) return false;
+    if (s->offset == 0) {
+        if (length < 8) return true;
+        if (*((uint32_t *)data) != YY_FOUR_CC(0x89, 0x50, 0x4E, 0x47) ||
+            *((uint32_t *)(data + 4)) != YY_FOUR_CC(0x0D, 0x0A, 0x1A, 0x0A)) goto fail;
+        s->offset = 8;
+    }
+    while (s->decoded_rows < s->header.height || !s->header_ready) {
+        if (s->offset + 8 > length) break;
+        const uint8_t *chunk = data + s->offset;
+        uint32_t chunk_length = yy_swap_endian_uint32(*((uint32_t *)chunk));
+        uint32_t fourcc = *((uint32_t *)(chunk + 4));
+        uint64_t chunk_end = s->offset + 12 + chunk_length;
+        if (!s->header_ready && fourcc != YY_FOUR_CC('I', 'H', 'D', 'R')) goto fail;
+        
+        if (fourcc == YY_FOUR_CC('I', 'D', 'A', 'T')) {
+            // IDAT data is inflated as soon as it arrives, no need to wait for the whole chunk
+            if (!s->format_ready && !yy_png_stream_prepare(s)) goto fail;
+            uint64_t available = MIN((uint64_t)chunk_length, length - (s->offset + 8));
+            if (available > s->idat_consumed) {
+                if (!yy_png_stream_inflate(s, chunk + 8 + s->idat_consumed, (uint32_t)(available - s->idat_consumed))) goto fail;
+                s->idat_consumed = (uint32_t)available;
+            }
+            if (chunk_end > length) break;
+            s->idat_consumed = 0;
+        } else {
+            if (chunk_end > length) break; // wait for the whole chunk
+            if (fourcc == YY_FOUR_CC('I', 'H', 'D', 'R')) {
+                if (s->header_ready || chunk_length != 13) goto fail;
+                yy_png_chunk_IHDR_read(&s->header, chunk + 8);
+                if (!yy_png_pixel_format_init_with_header(&s->format, &s->header)) goto fail;
+                s->header_ready = true;
+            } else if (fourcc == YY_FOUR_CC('I', 'E', 'N', 'D')) {
+                s->offset = chunk_end;
+                break;
+            } else if (!s->format_ready) {
+                yy_png_pixel_format_add_chunk(&s->format, fourcc, chunk + 8, chunk_length);
+            }
+        }
+        s->offset = chunk_end;
+    }
+    return true;
+    
+fail:
+    s->failed = true;
+    return false;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Helper
@@ -667,6 +1014,196 @@ BOOL YYCGColorSpaceIsDeviceGray(CGColorSpaceRef space) {
     return space && CFEqual(space, YYCGColorSpaceGetDeviceGray());
 }
 
+/// Returns the size class (buffer capacity) of a bitmap length, 4 classes per power of two.
+static inline size_t YYImageBufferSizeClass(size_t length) {
+    if (length <= 4096) return 4096;
+    size_t high = (size_t)1 << (sizeof(unsigned long) * 8 - 1 - __builtin_clzl(length - 1));
+    size_t step = MAX(high >> 2, (size_t)4096);
+    return YYImageByteAlign(length, step);
+}
+
+static int YYImageBufferSizeClassCompareDescending(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x > y ? -1 : x < y ? 1 : 0;
+}
+
+@implementation YYImageBufferPool {
+    pthread_mutex_t _lock;
+    CFMutableDictionaryRef _freeLists; ///< size class -> first idle buffer, an idle buffer stores the next one in its first bytes
+    NSUInteger _totalCost;
+    NSUInteger _costLimit;
+    NSUInteger _allocationCount;
+    NSUInteger _reuseCount;
+}
+
+/// Takes a buffer with at least `length` bytes, the buffer contents are undefined.
+static void *YYImageBufferPoolAlloc(YYImageBufferPool *pool, size_t length) {
+    size_t capacity = YYImageBufferSizeClass(length);
+    const void *key = (const void *)capacity;
+    pthread_mutex_lock(&pool->_lock);
+    void *buffer = (void *)CFDictionaryGetValue(pool->_freeLists, key);
+    if (buffer) {
+        void *next = *(void **)buffer;
+        if (next) CFDictionarySetValue(pool->_freeLists, key, next);
+        else CFDictionaryRemoveValue(pool->_freeLists, key);
+        pool->_totalCost -= capacity;
+        pool->_reuseCount++;
+    } else {
+        pool->_allocationCount++;
+    }
+    pthread_mutex_unlock(&pool->_lock);
+    if (!buffer) buffer = malloc(capacity);
+    return buffer;
+}
+
+/// Returns a buffer taken by YYImageBufferPoolAlloc() to the pool, or frees it when the pool is full.
+static void YYImageBufferPoolRecycle(YYImageBufferPool *pool, void *buffer, size_t length) {
+    if (!buffer) return;
+    size_t capacity = YYImageBufferSizeClass(length);
+    const void *key = (const void *)capacity;
+    pthread_mutex_lock(&pool->_lock);
+    if (pool->_totalCost + capacity <= pool->_costLimit) {
+        *(void **)buffer = (void *)CFDictionaryGetValue(pool->_freeLists, key);
+        CFDictionarySetValue(pool->_freeLists, key, buffer);
+        pool->_totalCost += capacity;
+        buffer = NULL;
+    }
+    pthread_mutex_unlock(&pool->_lock);
+    if (buffer) free(buffer);
+}
+
++ (instancetype)sharedPool {
+    static YYImageBufferPool *pool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pool = [YYImageBufferPool new];
+    });
+    return pool;
+}
+
+- (instancetype)init {
+    self = [super init];
+    pthread_mutex_init(&_lock, NULL);
+    _freeLists = CFDictionaryCreateMutable(CFAllocatorGetDefault(), 0, NULL, NULL);
+    unsigned long long limit = [NSProcessInfo processInfo].physicalMemory / 64;
+    _costLimit = (NSUInteger)MIN(limit, 64ULL * 1024 * 1024);
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_appDidReceiveMemoryWarningNotification) name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_appDidEnterBackgroundNotification) name:UIApplicationDidEnterBackgroundNotification object:nil];
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidEnterBackgroundNotification object:nil];
+    [self removeAllBuffers];
+    CFRelease(_freeLists);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)_appDidReceiveMemoryWarningNotification {
+    [self removeAllBuffers];
+}
+
+- (void)_appDidEnterBackgroundNotification {
+    [self removeAllBuffers];
+}
+
+- (NSUInteger)costLimit {
+    pthread_mutex_lock(&_lock);
+    NSUInteger costLimit = _costLimit;
+    pthread_mutex_unlock(&_lock);
+    return costLimit;
+}
+
+- (void)setCostLimit:(NSUInteger)costLimit {
+    pthread_mutex_lock(&_lock);
+    _costLimit = costLimit;
+    pthread_mutex_unlock(&_lock);
+    [self trimToCost:costLimit];
+}
+
+- (NSUInteger)totalCost {
+    pthread_mutex_lock(&_lock);
+    NSUInteger totalCost = _totalCost;
+    pthread_mutex_unlock(&_lock);
+    return totalCost;
+}
+
+- (NSUInteger)allocationCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _allocationCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)reuseCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _reuseCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (void)trimToCost:(NSUInteger)cost {
+    void *trashList = NULL;
+    pthread_mutex_lock(&_lock);
+    CFIndex count = _totalCost > cost ? CFDictionaryGetCount(_freeLists) : 0;
+    size_t *classes = count > 0 ? malloc(count * sizeof(size_t)) : NULL;
+    if (classes) {
+        // 先释放大的缓存
+        CFDictionaryGetKeysAndValues(_freeLists, (const void **)classes, NULL);
+        qsort(classes, count, sizeof(size_t), YYImageBufferSizeClassCompareDescending);
+        for (CFIndex i = 0; i < count && _totalCost > cost; i++) {
+            const void *key = (const void *)classes[i];
+            void *buffer = (void *)CFDictionaryGetValue(_freeLists, key);
+            while (buffer && _totalCost > cost) {
+                void *next = *(void **)buffer;
+                *(void **)buffer = trashList;
+                trashList = buffer;
+                _totalCost -= classes[i];
+                buffer = next;
+            }
+            if (buffer) CFDictionarySetValue(_freeLists, key, buffer);
+            else CFDictionaryRemoveValue(_freeLists, key);
+        }
+        free(classes);
+    }
+    pthread_mutex_unlock(&_lock);
+    // 在锁外释放内存
+    while (trashList) {
+        void *next = *(void **)trashList;
+        free(trashList);
+        trashList = next;
+    }
+}
+
+- (void)removeAllBuffers {
+    [self trimToCost:0];
+}
+
+@end
+
+/// Takes a buffer from the shared pool, see YYImageBufferPoolAlloc().
+static inline void *YYImageBufferAlloc(size_t length) {
+    return YYImageBufferPoolAlloc([YYImageBufferPool sharedPool], length);
+}
+
+/// Returns a buffer to the shared pool, see YYImageBufferPoolRecycle().
+static inline void YYImageBufferRecycle(void *buffer, size_t length) {
+    YYImageBufferPoolRecycle([YYImageBufferPool sharedPool], buffer, length);
+}
+
+/**
+ A callback used in CGDataProviderCreateWithData() to return a pooled buffer to the shared pool.
+ 
+ Example:
+ 
+ void *data = YYImageBufferAlloc(size);
+ CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, data, size, YYCGDataProviderRecycleDataCallback);
+ */
+static void YYCGDataProviderRecycleDataCallback(void *info, const void *data, size_t size) {
+    YYImageBufferRecycle((void *)data, size);
+}
+
 /**
  A callback used in CGDataProviderCreateWithData() to release data.
  
@@ -864,19 +1401,18 @@ static BOOL YYCGImageDecodeToBitmapBufferWith32BitFormat(CGImageRef srcImage, vI
     } else {
         contextBitmapInfo |= alphaFirst ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaPremultipliedLast;
     }
-    // 创建位图上下文
-    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), contextBitmapInfo);
+    // 创建位图上下文，临时的位图缓存从内存池中取出，复制后放回池中
+    size_t bytesPerRow = YYImageByteAlign(width * 4, 64);
+    size_t length = height * bytesPerRow;
+    void *data = YYImageBufferAlloc(length);
+    CGContextRef context = NULL;
+    if (!data) goto fail;
+    memset(data, 0, length);
+    context = CGBitmapContextCreate(data, width, height, 8, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), contextBitmapInfo);
     if (!context) goto fail;
     
     // 将图片绘制到上下文（解码和转化）
     CGContextDrawImage(context, CGRectMake(0, 0, width, height), srcImage); // decode and convert
-    // 每行的字节数
-    size_t bytesPerRow = CGBitmapContextGetBytesPerRow(context);
-    // 大小
-    size_t length = height * bytesPerRow;
-    // 获取图像数据指针
-    void *data = CGBitmapContextGetData(context);
-    if (length == 0 || !data) goto fail;
     
     // 分配数据的空间
     dest->data = malloc(length);
@@ -906,16 +1442,204 @@ static BOOL YYCGImageDecodeToBitmapBufferWith32BitFormat(CGImageRef srcImage, vI
     }
     
     CFRelease(context);
+    YYImageBufferRecycle(data, length);
     return YES;
     
 fail:
     if (context) CFRelease(context);
+    if (data) YYImageBufferRecycle(data, length);
     if (dest->data) free(dest->data);
     dest->data = NULL;
     return NO;
     return NO;
 }
 
+/// Accumulates one source row (32-bit pixels) into the box filter sums of a destination row.
+static inline void YYImageBoxAccumulateRow(const uint8_t *row, const size_t *xStarts, size_t dstWidth, uint64_t *sums) {
+    for (size_t x = 0; x < dstWidth; x++) {
+        uint64_t *sum = sums + x * 4;
+        const uint8_t *p = row + xStarts[x] * 4;
+        const uint8_t *end = row + xStarts[x + 1] * 4;
+        for (; p < end; p += 4) {
+            sum[0] += p[0];
+            sum[1] += p[1];
+            sum[2] += p[2];
+            sum[3] += p[3];
+        }
+    }
+}
+
+/// Writes the average of the box filter sums which accumulated `rows` source rows.
+static inline void YYImageBoxOutputRow(const uint64_t *sums, const size_t *xStarts, size_t dstWidth, size_t rows, uint8_t *out) {
+    for (size_t x = 0; x < dstWidth; x++) {
+        const uint64_t *sum = sums + x * 4;
+        uint64_t count = (uint64_t)rows * (xStarts[x + 1] - xStarts[x]);
+        uint64_t half = count / 2;
+        out[x * 4 + 0] = (uint8_t)((sum[0] + half) / count);
+        out[x * 4 + 1] = (uint8_t)((sum[1] + half) / count);
+        out[x * 4 + 2] = (uint8_t)((sum[2] + half) / count);
+        out[x * 4 + 3] = (uint8_t)((sum[3] + half) / count);
+    }
+}
+
+/**
+ Downsample a premultiplied 32-bit bitmap with box filter, scanline by scanline.
+ 
+ @discussion Every destination pixel is the average of the source pixels it covers.
+ Only one row of accumulators (dstWidth * 4) is used, the source rows are walked
+ from top to bottom exactly once.
+ 
+ @note 使用盒式滤波逐行缩小预乘的32位位图；目标像素是它覆盖的源像素的平均值，只需要一行累加器
+ */
+static BOOL YYImageBoxDownsample32Bit(const uint8_t *src, size_t srcWidth, size_t srcHeight, size_t srcStride,
+                                      uint8_t *dst, size_t dstWidth, size_t dstHeight, size_t dstStride) {
+    if (!src || !dst) return NO;
+    if (dstWidth == 0 || dstHeight == 0) return NO;
+    if (dstWidth > srcWidth || dstHeight > srcHeight) return NO;
+    
+    size_t *xStarts = malloc((dstWidth + 1) * sizeof(size_t));
+    uint64_t *sums = malloc(dstWidth * 4 * sizeof(uint64_t));
+    if (!xStarts || !sums) {
+        if (xStarts) free(xStarts);
+        if (sums) free(sums);
+        return NO;
+    }
+    for (size_t x = 0; x <= dstWidth; x++) {
+        xStarts[x] = x * srcWidth / dstWidth;
+    }
+    
+    for (size_t y = 0; y < dstHeight; y++) {
+        size_t sy0 = y * srcHeight / dstHeight;
+        size_t sy1 = (y + 1) * srcHeight / dstHeight;
+        memset(sums, 0, dstWidth * 4 * sizeof(uint64_t));
+        for (size_t sy = sy0; sy < sy1; sy++) {
+            YYImageBoxAccumulateRow(src + sy * srcStride, xStarts, dstWidth, sums);
+        }
+        YYImageBoxOutputRow(sums, xStarts, dstWidth, sy1 - sy0, dst + y * dstStride);
+    }
+    free(xStarts);
+    free(sums);
+    return YES;
+}
+
+/**
+ Create a decoded (BGRA8888 premultiplied) copy of the image scaled down to the 
+ specified size with box filter.
+ 
+ @note 将图像解压后使用盒式滤波缩小到指定大小
+ */
+static CGImageRef YYCGImageCreateBoxDownsampledCopy(CGImageRef imageRef, size_t width, size_t height) CF_RETURNS_RETAINED {
+    if (!imageRef) return NULL;
+    size_t srcWidth = CGImageGetWidth(imageRef);
+    size_t srcHeight = CGImageGetHeight(imageRef);
+    if (srcWidth == 0 || srcHeight == 0 || width == 0 || height == 0) return NULL;
+    if (width > srcWidth || height > srcHeight) return NULL;
+    
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst; //bgrA
+    CGContextRef context = CGBitmapContextCreate(NULL, srcWidth, srcHeight, 8, 0, YYCGColorSpaceGetDeviceRGB(), bitmapInfo);
+    if (!context) return NULL;
+    CGContextDrawImage(context, CGRectMake(0, 0, srcWidth, srcHeight), imageRef); // decode
+    const uint8_t *srcBytes = CGBitmapContextGetData(context);
+    size_t srcStride = CGBitmapContextGetBytesPerRow(context);
+    
+    size_t bytesPerRow = YYImageByteAlign(width * 4, 32);
+    size_t length = bytesPerRow * height;
+    uint8_t *pixels = malloc(length);
+    if (!pixels) goto fail;
+    if (!YYImageBoxDownsample32Bit(srcBytes, srcWidth, srcHeight, srcStride, pixels, width, height, bytesPerRow)) goto fail;
+    CFRelease(context);
+    context = NULL;
+    
+    CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels, length, YYCGDataProviderReleaseDataCallback);
+    if (!provider) goto fail;
+    pixels = NULL; // hold by provider
+    CGImageRef image = CGImageCreate(width, height, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CFRelease(provider);
+    return image;
+    
+fail:
+    if (context) CFRelease(context);
+    if (pixels) free(pixels);
+    return NULL;
+}
+
+static bool yy_png_decode_region(const uint8_t *data, yy_png_info *info, const yy_png_pixel_format *format,
+                                 uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                                 uint8_t *dst, uint32_t dst_width, uint32_t dst_height, size_t dst_stride);
+
+/**
+ Decode a png straight to a decoded (BGRA8888 premultiplied) image scaled down 
+ to the specified size with box filter.
+ 
+ @discussion The rows are inflated and filtered one by one, only the output bitmap
+ and two scanlines are allocated, the full size image is never created.
+ Returns NULL if the png is interlaced or the pixel format is not supported.
+ 
+ @note 逐行解码png并直接缩小，只分配输出位图和两行扫描线，不生成原尺寸图像；隔行扫描或不支持的格式返回NULL
+ */
+static CGImageRef YYCGImageCreateWithPNGDataDownsampled(const uint8_t *bytes, uint32_t size, size_t width, size_t height) CF_RETURNS_RETAINED {
+    if (!bytes || width == 0 || height == 0) return NULL;
+    yy_png_info *info = yy_png_info_create(bytes, size);
+    if (!info) return NULL;
+    
+    CGImageRef image = NULL;
+    uint32_t srcWidth = info->header.width;
+    uint32_t srcHeight = info->header.height;
+    yy_png_pixel_format format;
+    if (width <= srcWidth && height <= srcHeight && yy_png_pixel_format_init(&format, bytes, info)) {
+        size_t bytesPerRow = YYImageByteAlign(width * 4, 32);
+        size_t length = bytesPerRow * height;
+        uint8_t *pixels = calloc(1, length);
+        if (pixels && yy_png_decode_region(bytes, info, &format, 0, 0, srcWidth, srcHeight,
+                                           pixels, (uint32_t)width, (uint32_t)height, bytesPerRow)) {
+            CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels, length, YYCGDataProviderReleaseDataCallback);
+            if (provider) {
+                pixels = NULL; // hold by provider
+                image = CGImageCreate(width, height, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst, provider, NULL, false, kCGRenderingIntentDefault);
+                CFRelease(provider);
+            }
+        }
+        if (pixels) free(pixels);
+    }
+    yy_png_info_release(info);
+    return image;
+}
+
+/**
+ Create a decoded (BGRA8888 premultiplied) image with a copy of the premultiplied
+ bgrA buffer, scaled down to the specified size with box filter if needed.
+ 
+ @note 复制预乘的bgrA缓存生成已解压的图像，目标尺寸较小时使用盒式滤波缩小
+ */
+static CGImageRef YYCGImageCreateWithBGRABuffer(const uint8_t *src, size_t srcWidth, size_t srcHeight, size_t srcStride,
+                                                size_t width, size_t height) CF_RETURNS_RETAINED {
+    if (!src || srcWidth == 0 || srcHeight == 0 || width == 0 || height == 0) return NULL;
+    if (width > srcWidth || height > srcHeight) return NULL;
+    
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst; //bgrA
+    size_t bytesPerRow = YYImageByteAlign(width * 4, 32);
+    size_t length = bytesPerRow * height;
+    uint8_t *pixels = malloc(length);
+    if (!pixels) return NULL;
+    if (width == srcWidth && height == srcHeight) {
+        for (size_t y = 0; y < height; y++) {
+            memcpy(pixels + y * bytesPerRow, src + y * srcStride, width * 4);
+        }
+    } else if (!YYImageBoxDownsample32Bit(src, srcWidth, srcHeight, srcStride, pixels, width, height, bytesPerRow)) {
+        free(pixels);
+        return NULL;
+    }
+    
+    CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels, length, YYCGDataProviderReleaseDataCallback);
+    if (!provider) {
+        free(pixels);
+        return NULL;
+    }
+    CGImageRef image = CGImageCreate(width, height, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CFRelease(provider);
+    return image;
+}
+
 // 创建一个image的解压缩的copy
 CGImageRef YYCGImageCreateDecodedCopy(CGImageRef imageRef, BOOL decodeForDisplay) {
     if (!imageRef) return NULL;
@@ -937,11 +1661,26 @@ CGImageRef YYCGImageCreateDecodedCopy(CGImageRef imageRef, BOOL decodeForDisplay
         // same as UIGraphicsBeginImageContext() and -[UIView drawRect:]
         CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host;
         bitmapInfo |= hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst;
-        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), bitmapInfo);
-        if (!context) return NULL;
+        // 位图缓存从内存池中取出，图片释放时回到池中
+        size_t bytesPerRow = YYImageByteAlign(width * 4, 64);
+        size_t length = bytesPerRow * height;
+        void *pixels = YYImageBufferAlloc(length);
+        if (!pixels) return NULL;
+        if (hasAlpha) memset(pixels, 0, length); // reused buffer is not zeroed
+        CGContextRef context = CGBitmapContextCreate(pixels, width, height, 8, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo);
+        if (!context) {
+            YYImageBufferRecycle(pixels, length);
+            return NULL;
+        }
         CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef); // decode
-        CGImageRef newImage = CGBitmapContextCreateImage(context);
         CFRelease(context);
+        CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, pixels, length, YYCGDataProviderRecycleDataCallback);
+        if (!provider) {
+            YYImageBufferRecycle(pixels, length);
+            return NULL;
+        }
+        CGImageRef newImage = CGImageCreate(width, height, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+        CFRelease(provider);
         return newImage;
         
     } else {
@@ -1149,84 +1888,345 @@ CGImageRef YYCGImageCreateCopyWithOrientation(CGImageRef imageRef, UIImageOrient
     return YYCGImageCreateAffineTransformCopy(imageRef, transform, destSize, destBitmapInfo);
 }
 
+// 读取小端/大端整数
+static inline uint16_t YYImageReadUInt16(const uint8_t *p, BOOL bigEndian) {
+    return bigEndian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+static inline uint32_t YYImageReadUInt24LE(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static inline uint32_t YYImageReadUInt32(const uint8_t *p, BOOL bigEndian) {
+    return bigEndian ?
+    ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3] :
+    ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+/// Validators take the matched header and confirm the type, or return `YYImageTypeUnknown` to keep searching.
+typedef YYImageType (*YYImageSignatureValidator)(const uint8_t *bytes, size_t length, YYImageType type);
+
+/// RIFF....WEBP followed by a `VP8 `, `VP8L` or `VP8X` chunk.
+static YYImageType YYImageValidateWebP(const uint8_t *bytes, size_t length, YYImageType type) {
+    if (memcmp(bytes + 8, "WEBP", 4) != 0) return YYImageTypeUnknown;
+    if (memcmp(bytes + 12, "VP8 ", 4) == 0 || memcmp(bytes + 12, "VP8L", 4) == 0 || memcmp(bytes + 12, "VP8X", 4) == 0) {
+        return type;
+    }
+    return YYImageTypeUnknown;
+}
+
+/// ISO base media `ftyp` box: the major brand, or the compatible brands for `mif1`/`msf1`.
+static YYImageType YYImageTypeForBrand(const uint8_t *brand) {
+    static const char *heicBrands[] = {"heic", "heix", "hevc", "hevx", "heim", "heis", "hevm", "hevs"};
+    if (memcmp(brand, "avif", 4) == 0 || memcmp(brand, "avis", 4) == 0) return YYImageTypeAVIF;
+    for (size_t i = 0; i < sizeof(heicBrands) / sizeof(heicBrands[0]); i++) {
+        if (memcmp(brand, heicBrands[i], 4) == 0) return YYImageTypeHEIC;
+    }
+    return YYImageTypeUnknown;
+}
+
+static YYImageType YYImageValidateFileType(const uint8_t *bytes, size_t length, YYImageType type) {
+    YYImageType major = YYImageTypeForBrand(bytes + 8);
+    if (major != YYImageTypeUnknown) return major;
+    if (memcmp(bytes + 8, "mif1", 4) != 0 && memcmp(bytes + 8, "msf1", 4) != 0) return YYImageTypeUnknown;
+    // size, type, major brand, minor version, then compatible brands until the end of box
+    size_t end = MIN((size_t)YYImageReadUInt32(bytes, YES), length);
+    YYImageType compatible = YYImageTypeUnknown;
+    for (size_t offset = 16; offset + 4 <= end; offset += 4) {
+        YYImageType brand = YYImageTypeForBrand(bytes + offset);
+        if (brand == YYImageTypeAVIF) return brand;
+        if (brand != YYImageTypeUnknown) compatible = brand;
+    }
+    return compatible;
+}
+
+/// BM, then the DIB header size must be one of the known versions.
+static YYImageType YYImageValidateBMP(const uint8_t *bytes, size_t length, YYImageType type) {
+    if (length < 18) return YYImageTypeUnknown;
+    switch (bytes[14] | (bytes[15] << 8) | (bytes[16] << 16) | ((uint32_t)bytes[17] << 24)) {
+        case 12: case 16: case 40: case 52: case 56: case 64: case 108: case 124:
+            return type;
+        default:
+            return YYImageTypeUnknown;
+    }
+}
+
+/// ICO/CUR with a non-zero image count.
+static YYImageType YYImageValidateICO(const uint8_t *bytes, size_t length, YYImageType type) {
+    return (bytes[4] == 0 && bytes[5] == 0) ? YYImageTypeUnknown : type;
+}
+
+typedef struct {
+    YYImageType type;
+    uint8_t offset;
+    uint8_t length;
+    const char *magic;
+    YYImageSignatureValidator validator;
+} YYImageSignature;
+
+// 文件签名表，按常见程度排序，前缀匹配后再由validator做进一步检查
+// SDWebImage的NSData+ImageContentType.m中有相同的表（两个库不能共享代码），修改时两边都要改，
+// 两边的测试语料（YYImageBenchmark和SDWebImageBenchmark的FormatDetection）检查相同的签名
+// http://www.garykessler.net/library/file_sigs.html
+static const YYImageSignature YYImageSignatures[] = {
+    {YYImageTypeJPEG,     0, 3, "\xFF\xD8\xFF", NULL},
+    {YYImageTypePNG,      0, 8, "\x89PNG\r\n\x1A\n", NULL}, // PNG, APNG
+    {YYImageTypeGIF,      0, 6, "GIF89a", NULL},
+    {YYImageTypeGIF,      0, 6, "GIF87a", NULL},
+    {YYImageTypeWebP,     0, 4, "RIFF", YYImageValidateWebP},
+    {YYImageTypeUnknown,  4, 4, "ftyp", YYImageValidateFileType}, // HEIC, AVIF
+    {YYImageTypeTIFF,     0, 4, "II*\0", NULL},
+    {YYImageTypeTIFF,     0, 4, "MM\0*", NULL},
+    {YYImageTypeBMP,      0, 2, "BM", YYImageValidateBMP},
+    {YYImageTypeICO,      0, 4, "\0\0\1\0", YYImageValidateICO},
+    {YYImageTypeICO,      0, 4, "\0\0\2\0", YYImageValidateICO}, // CUR
+    {YYImageTypeICNS,     0, 4, "icns", NULL},
+    {YYImageTypeJPEG2000, 0, 4, "\xFF\x4F\xFF\x51", NULL}, // J2K codestream
+    {YYImageTypeJPEG2000, 4, 8, "jP  \r\n\x87\n", NULL},   // JP2
+};
+
 // 利用图像压缩类型
 YYImageType YYImageDetectType(CFDataRef data) {
     if (!data) return YYImageTypeUnknown;
-    uint64_t length = CFDataGetLength(data);
+    size_t length = CFDataGetLength(data);
     if (length < 16) return YYImageTypeUnknown;
     
-    // 获取数据指针
-    const char *bytes = (char *)CFDataGetBytePtr(data);
+    // 直接比较原始字节，不做任何分配
+    const uint8_t *bytes = CFDataGetBytePtr(data);
+    for (size_t i = 0; i < sizeof(YYImageSignatures) / sizeof(YYImageSignatures[0]); i++) {
+        const YYImageSignature *signature = &YYImageSignatures[i];
+        if (memcmp(bytes + signature->offset, signature->magic, signature->length) != 0) continue;
+        YYImageType type = signature->type;
+        if (signature->validator) {
+            type = signature->validator(bytes, length, type);
+        }
+        if (type != YYImageTypeUnknown) return type;
+    }
+    return YYImageTypeUnknown;
+}
+
+/// PNG: `IHDR` is the first chunk, `acTL` and `tRNS` must precede `IDAT`.
+static BOOL YYImageProbePNG(const uint8_t *bytes, size_t length, YYImageHeaderInfo *info) {
+    if (length < 33) return NO;
+    if (*((uint32_t *)(bytes + 12)) != YY_FOUR_CC('I', 'H', 'D', 'R')) return NO;
+    info->width = YYImageReadUInt32(bytes + 16, YES);
+    info->height = YYImageReadUInt32(bytes + 20, YES);
+    info->hasAlpha = bytes[25] == 4 || bytes[25] == 6; // gray + alpha, rgba
+    info->frameCount = 1;
     
-    // 获取前32位
-    uint32_t magic4 = *((uint32_t *)bytes);
-    switch (magic4) {
-        case YY_FOUR_CC(0x4D, 0x4D, 0x00, 0x2A): { // big endian TIFF
-            return YYImageTypeTIFF;
-        } break;
-            
-        case YY_FOUR_CC(0x49, 0x49, 0x2A, 0x00): { // little endian TIFF
-            return YYImageTypeTIFF;
-        } break;
-            
-        case YY_FOUR_CC(0x00, 0x00, 0x01, 0x00): { // ICO
-            return YYImageTypeICO;
-        } break;
-            
-        case YY_FOUR_CC(0x00, 0x00, 0x02, 0x00): { // CUR
-            return YYImageTypeICO;
-        } break;
-            
-        case YY_FOUR_CC('i', 'c', 'n', 's'): { // ICNS
-            return YYImageTypeICNS;
+    uint64_t offset = 33;
+    while (offset + 8 <= length) {
+        uint32_t chunkLength = YYImageReadUInt32(bytes + offset, YES);
+        uint32_t fourcc = *((uint32_t *)(bytes + offset + 4));
+        if (fourcc == YY_FOUR_CC('I', 'D', 'A', 'T')) break;
+        if (fourcc == YY_FOUR_CC('a', 'c', 'T', 'L') && chunkLength == 8 && offset + 16 <= length) {
+            uint32_t frameCount = YYImageReadUInt32(bytes + offset + 8, YES);
+            info->frameCount = frameCount > 0 ? frameCount : 1;
+            info->loopCount = YYImageReadUInt32(bytes + offset + 12, YES);
+        } else if (fourcc == YY_FOUR_CC('t', 'R', 'N', 'S')) {
+            info->hasAlpha = YES;
+        }
+        offset += (uint64_t)chunkLength + 12;
+    }
+    return info->width > 0 && info->height > 0;
+}
+
+/// Skip GIF data sub-blocks, returns the offset after the block terminator.
+static size_t YYImageSkipGIFSubBlocks(const uint8_t *bytes, size_t length, size_t offset) {
+    while (offset < length) {
+        uint8_t size = bytes[offset];
+        offset += 1 + size;
+        if (size == 0) break;
+    }
+    return offset;
+}
+
+/// GIF: logical screen descriptor, then walk the blocks (the LZW data is skipped by sub-block size).
+static BOOL YYImageProbeGIF(const uint8_t *bytes, size_t length, YYImageHeaderInfo *info) {
+    if (length < 13) return NO;
+    info->width = YYImageReadUInt16(bytes + 6, NO);
+    info->height = YYImageReadUInt16(bytes + 8, NO);
+    
+    uint8_t flags = bytes[10];
+    size_t offset = 13;
+    if (flags & 0x80) offset += 3 * (1 << ((flags & 0x07) + 1)); // global color table
+    NSUInteger frameCount = 0;
+    while (offset < length) {
+        uint8_t block = bytes[offset];
+        if (block == 0x21) { // extension
+            if (offset + 2 > length) break;
+            uint8_t label = bytes[offset + 1];
+            size_t sub = offset + 2;
+            if (label == 0xFF && sub + 16 <= length && bytes[sub] == 11 &&
+                memcmp(bytes + sub + 1, "NETSCAPE2.0", 11) == 0 && bytes[sub + 12] >= 3 && bytes[sub + 13] == 1) {
+                info->loopCount = YYImageReadUInt16(bytes + sub + 14, NO);
+            } else if (label == 0xF9 && sub + 2 <= length && bytes[sub] >= 4 && (bytes[sub + 1] & 0x01)) {
+                info->hasAlpha = YES; // graphic control extension with transparent color
+            }
+            offset = YYImageSkipGIFSubBlocks(bytes, length, sub);
+        } else if (block == 0x2C) { // image descriptor
+            frameCount++;
+            if (offset + 10 > length) break;
+            uint8_t imageFlags = bytes[offset + 9];
+            offset += 10;
+            if (imageFlags & 0x80) offset += 3 * (1 << ((imageFlags & 0x07) + 1)); // local color table
+            offset = YYImageSkipGIFSubBlocks(bytes, length, offset + 1); // LZW minimum code size
+        } else { // trailer or unknown block
+            break;
+        }
+    }
+    info->frameCount = frameCount > 0 ? frameCount : 1;
+    return info->width > 0 && info->height > 0;
+}
+
+/// WebP: the first chunk is `VP8 `, `VP8L` or `VP8X`, animated webp is followed by `ANIM` and `ANMF` chunks.
+static BOOL YYImageProbeWebP(const uint8_t *bytes, size_t length, YYImageHeaderInfo *info) {
+    if (length < 30) return NO;
+    uint32_t fourcc = *((uint32_t *)(bytes + 12));
+    const uint8_t *payload = bytes + 20;
+    info->frameCount = 1;
+    switch (fourcc) {
+        case YY_FOUR_CC('V', 'P', '8', ' '): { // lossy: frame tag (3), start code (3), width (2), height (2)
+            if (payload[3] != 0x9D || payload[4] != 0x01 || payload[5] != 0x2A) return NO;
+            info->width = YYImageReadUInt16(payload + 6, NO) & 0x3FFF;
+            info->height = YYImageReadUInt16(payload + 8, NO) & 0x3FFF;
         } break;
             
-        case YY_FOUR_CC('G', 'I', 'F', '8'): { // GIF
-            return YYImageTypeGIF;
+        case YY_FOUR_CC('V', 'P', '8', 'L'): { // lossless: signature (1), width-1 (14 bits), height-1 (14 bits), alpha (1 bit)
+            if (payload[0] != 0x2F) return NO;
+            uint32_t bits = YYImageReadUInt32(payload + 1, NO);
+            info->width = (bits & 0x3FFF) + 1;
+            info->height = ((bits >> 14) & 0x3FFF) + 1;
+            info->hasAlpha = (bits >> 28) & 0x01;
         } break;
             
-        case YY_FOUR_CC(0x89, 'P', 'N', 'G'): {  // PNG
-            uint32_t tmp = *((uint32_t *)(bytes + 4));
-            if (tmp == YY_FOUR_CC('\r', '\n', 0x1A, '\n')) {
-                return YYImageTypePNG;
+        case YY_FOUR_CC('V', 'P', '8', 'X'): { // extended: flags (4), canvas width-1 (3), canvas height-1 (3)
+            uint8_t flags = payload[0];
+            info->width = YYImageReadUInt24LE(payload + 4) + 1;
+            info->height = YYImageReadUInt24LE(payload + 7) + 1;
+            info->hasAlpha = (flags & 0x10) != 0;
+            if (flags & 0x02) { // animation
+                NSUInteger frameCount = 0;
+                uint64_t offset = 12 + 8 + YYImageReadUInt32(bytes + 16, NO);
+                while (offset + 8 <= length) {
+                    uint32_t chunk = *((uint32_t *)(bytes + offset));
+                    uint32_t chunkLength = YYImageReadUInt32(bytes + offset + 4, NO);
+                    if (chunk == YY_FOUR_CC('A', 'N', 'I', 'M') && offset + 14 <= length) {
+                        info->loopCount = YYImageReadUInt16(bytes + offset + 12, NO);
+                    } else if (chunk == YY_FOUR_CC('A', 'N', 'M', 'F')) {
+                        frameCount++;
+                    }
+                    offset += 8 + (uint64_t)chunkLength + (chunkLength & 1); // chunks are padded to even size
+                }
+                info->frameCount = frameCount > 0 ? frameCount : 1;
             }
         } break;
             
-        case YY_FOUR_CC('R', 'I', 'F', 'F'): { // WebP
-            uint32_t tmp = *((uint32_t *)(bytes + 8));
-            if (tmp == YY_FOUR_CC('W', 'E', 'B', 'P')) {
-                return YYImageTypeWebP;
-            }
-        } break;
-        /*
-        case YY_FOUR_CC('B', 'P', 'G', 0xFB): { // BPG
-            return YYImageTypeBPG;
-        } break;
-        */
+        default: return NO;
     }
+    return info->width > 0 && info->height > 0;
+}
+
+/// EXIF orientation in the TIFF header of `APP1` segment.
+static UIImageOrientation YYImageProbeEXIFOrientation(const uint8_t *exif, size_t length) {
+    if (length < 14 || memcmp(exif, "Exif\0\0", 6) != 0) return UIImageOrientationUp;
+    const uint8_t *tiff = exif + 6;
+    size_t tiffLength = length - 6;
+    BOOL bigEndian;
+    if (tiff[0] == 'M' && tiff[1] == 'M') bigEndian = YES;
+    else if (tiff[0] == 'I' && tiff[1] == 'I') bigEndian = NO;
+    else return UIImageOrientationUp;
     
-    uint16_t magic2 = *((uint16_t *)bytes);
-    switch (magic2) {
-        case YY_TWO_CC('B', 'A'):
-        case YY_TWO_CC('B', 'M'):
-        case YY_TWO_CC('I', 'C'):
-        case YY_TWO_CC('P', 'I'):
-        case YY_TWO_CC('C', 'I'):
-        case YY_TWO_CC('C', 'P'): { // BMP
-            return YYImageTypeBMP;
+    uint64_t ifd = YYImageReadUInt32(tiff + 4, bigEndian);
+    if (ifd + 2 > tiffLength) return UIImageOrientationUp;
+    uint16_t count = YYImageReadUInt16(tiff + ifd, bigEndian);
+    for (uint16_t i = 0; i < count; i++) {
+        uint64_t entry = ifd + 2 + (uint64_t)i * 12;
+        if (entry + 12 > tiffLength) break;
+        if (YYImageReadUInt16(tiff + entry, bigEndian) == 0x0112) { // orientation, SHORT
+            return YYUIImageOrientationFromEXIFValue(YYImageReadUInt16(tiff + entry + 8, bigEndian));
+        }
+    }
+    return UIImageOrientationUp;
+}
+
+/// JPEG: walk the marker segments until `SOF` (EXIF `APP1` precedes it).
+static BOOL YYImageProbeJPEG(const uint8_t *bytes, size_t length, YYImageHeaderInfo *info) {
+    info->frameCount = 1;
+    uint64_t offset = 2;
+    while (offset + 4 <= length) {
+        if (bytes[offset] != 0xFF) break;
+        uint8_t marker = bytes[offset + 1];
+        if (marker == 0xFF) { // fill byte
+            offset++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) { // segments without length
+            offset += 2;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) break; // EOI, SOS
+        uint16_t segmentLength = YYImageReadUInt16(bytes + offset + 2, YES);
+        if (segmentLength < 2) break;
+        const uint8_t *segment = bytes + offset + 4;
+        BOOL complete = offset + 2 + segmentLength <= length;
+        if (marker == 0xE1 && complete) {
+            info->orientation = YYImageProbeEXIFOrientation(segment, segmentLength - 2);
+        } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            // SOFn: precision (1), height (2), width (2)
+            if (offset + 9 > length) break;
+            info->height = YYImageReadUInt16(segment + 1, YES);
+            info->width = YYImageReadUInt16(segment + 3, YES);
+            break;
         }
-        case YY_TWO_CC(0xFF, 0x4F): { // JPEG2000
-            return YYImageTypeJPEG2000;
+        offset += 2 + segmentLength;
+    }
+    return info->width > 0 && info->height > 0;
+}
+
+/// Other formats: CGImageSource reads the properties from the header without decoding.
+static BOOL YYImageProbeImageIO(CFDataRef data, YYImageHeaderInfo *info) {
+    CGImageSourceRef source = CGImageSourceCreateWithData(data, NULL);
+    if (!source) return NO;
+    info->frameCount = CGImageSourceGetCount(source);
+    CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, (CFDictionaryRef)@{(id)kCGImageSourceShouldCache : @(NO)});
+    CFRelease(source);
+    if (!properties) return NO;
+    NSInteger width = 0, height = 0, orientation = 0;
+    CFTypeRef value = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+    if (value) CFNumberGetValue(value, kCFNumberNSIntegerType, &width);
+    value = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+    if (value) CFNumberGetValue(value, kCFNumberNSIntegerType, &height);
+    value = CFDictionaryGetValue(properties, kCGImagePropertyOrientation);
+    if (value) CFNumberGetValue(value, kCFNumberNSIntegerType, &orientation);
+    value = CFDictionaryGetValue(properties, kCGImagePropertyHasAlpha);
+    if (value) info->hasAlpha = CFBooleanGetValue(value);
+    CFRelease(properties);
+    info->width = width > 0 ? width : 0;
+    info->height = height > 0 ? height : 0;
+    info->orientation = YYUIImageOrientationFromEXIFValue(orientation);
+    return info->width > 0 && info->height > 0;
+}
+
+// 只读取文件头获取图片信息
+BOOL YYImageProbeHeader(CFDataRef data, YYImageHeaderInfo *info) {
+    YYImageHeaderInfo result = {0};
+    result.orientation = UIImageOrientationUp;
+    result.type = YYImageDetectType(data);
+    BOOL found = NO;
+    if (result.type != YYImageTypeUnknown) {
+        const uint8_t *bytes = CFDataGetBytePtr(data);
+        size_t length = CFDataGetLength(data);
+        switch (result.type) {
+            case YYImageTypePNG: found = YYImageProbePNG(bytes, length, &result); break;
+            case YYImageTypeGIF: found = YYImageProbeGIF(bytes, length, &result); break;
+            case YYImageTypeWebP: found = YYImageProbeWebP(bytes, length, &result); break;
+            case YYImageTypeJPEG: found = YYImageProbeJPEG(bytes, length, &result); break;
+            default: found = YYImageProbeImageIO(data, &result); break;
         }
     }
-    
-    // JPG             FF D8 FF
-    if (memcmp(bytes,"\377\330\377",3) == 0) return YYImageTypeJPEG;
-    
-    // JP2
-    if (memcmp(bytes + 4, "\152\120\040\040\015", 5) == 0) return YYImageTypeJPEG2000;
-    
-    return YYImageTypeUnknown;
+    if (info) *info = result;
+    return found;
 }
 
 // 将YYImageType转换为UTI
@@ -1240,6 +2240,8 @@ CFStringRef YYImageTypeToUTType(YYImageType type) {
         case YYImageTypeICNS: return kUTTypeAppleICNS;
         case YYImageTypeGIF: return kUTTypeGIF;
         case YYImageTypePNG: return kUTTypePNG;
+        case YYImageTypeHEIC: return CFSTR("public.heic");
+        case YYImageTypeAVIF: return CFSTR("public.avif");
         default: return NULL;
     }
 }
@@ -1255,7 +2257,9 @@ YYImageType YYImageTypeFromUTType(CFStringRef uti) {
                 (id)kUTTypeICO : @(YYImageTypeICO),
                 (id)kUTTypeAppleICNS : @(YYImageTypeICNS),
                 (id)kUTTypeGIF : @(YYImageTypeGIF),
-                (id)kUTTypePNG : @(YYImageTypePNG)};
+                (id)kUTTypePNG : @(YYImageTypePNG),
+                @"public.heic" : @(YYImageTypeHEIC),
+                @"public.avif" : @(YYImageTypeAVIF)};
     });
     if (!uti) return YYImageTypeUnknown;
     NSNumber *num = dic[(__bridge __strong id)(uti)];
@@ -1274,6 +2278,8 @@ NSString *YYImageTypeGetExtension(YYImageType type) {
         case YYImageTypeGIF: return @"gif";
         case YYImageTypePNG: return @"png";
         case YYImageTypeWebP: return @"webp";
+        case YYImageTypeHEIC: return @"heic";
+        case YYImageTypeAVIF: return @"avif";
         default: return nil;
     }
 }
@@ -1639,6 +2645,17 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     WebPDemuxer *_webpSource;
 #endif
     
+    // 数据不完整时的流式解码状态
+    yy_png_stream *_pngStream;      ///< non-interlaced png
+    BOOL _pngStreamFailed;          ///< fallback to ImageIO
+#if YYIMAGE_WEBP_ENABLED
+    WebPIDecoder *_webpIDecoder;    ///< still webp
+    uint8_t *_webpICanvas;          ///< premultiplied bgrA output of `_webpIDecoder`
+    size_t _webpICanvasStride;
+    NSUInteger _webpIConsumedLength;///< bytes appended to `_webpIDecoder`
+    BOOL _webpIDecoderFailed;       ///< animated or corrupted, wait for the whole data
+#endif
+    
     // 图片方向
     UIImageOrientation _orientation;
     // 帧锁
@@ -1659,14 +2676,20 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 #if YYIMAGE_WEBP_ENABLED
     if (_webpSource) WebPDemuxDelete(_webpSource);
 #endif
+    [self _releaseStreamingSources];
     if (_blendCanvas) CFRelease(_blendCanvas);
     pthread_mutex_destroy(&_lock);
 }
 
 // 根据data生成解压器
 + (instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale {
+    return [self decoderWithData:data scale:scale maxPixelSize:0];
+}
+
+// 根据data生成缩小解码的解压器
++ (instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize {
     if (!data) return nil;
-    YYImageDecoder *decoder = [[YYImageDecoder alloc] initWithScale:scale];
+    YYImageDecoder *decoder = [[YYImageDecoder alloc] initWithScale:scale maxPixelSize:maxPixelSize];
     [decoder updateData:data final:YES];
     if (decoder.frameCount == 0) return nil;
     return decoder;
@@ -1678,9 +2701,15 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 
 // 根据比例初始化解压器
 - (instancetype)initWithScale:(CGFloat)scale {
+    return [self initWithScale:scale maxPixelSize:0];
+}
+
+// 根据比例和最大像素边长初始化解压器
+- (instancetype)initWithScale:(CGFloat)scale maxPixelSize:(NSUInteger)maxPixelSize {
     self = [super init];
     if (scale <= 0) scale = 1;
     _scale = scale;
+    _maxPixelSize = maxPixelSize;
     _framesLock = dispatch_semaphore_create(1);
     // 创建递归锁
     // @note 递归锁：允许在同一个线程对同一个锁获取多次，并通过对应次数的Unlock解锁，在未完全解锁的时候其他线程的请求在等待状态
@@ -1855,8 +2884,8 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     image.isDecodedForDisplay = YES;
     frame.image = image;
     if (extendToCanvas) {
-        frame.width = _width;
-        frame.height = _height;
+        frame.width = CGImageGetWidth(image.CGImage);
+        frame.height = CGImageGetHeight(image.CGImage);
         frame.offsetX = 0;
         frame.offsetY = 0;
         frame.dispose = YYImageDisposeNone;
@@ -1881,22 +2910,176 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     return CFBridgingRelease(properties);
 }
 
-#pragma private
+#pragma private
+// 缩小解码的比例，不缩小时为1
+- (CGFloat)_downsampleRatio {
+    if (_maxPixelSize == 0 || _width == 0 || _height == 0) return 1;
+    NSUInteger longSide = MAX(_width, _height);
+    if (longSide <= _maxPixelSize) return 1;
+    return (CGFloat)_maxPixelSize / longSide;
+}
+
+// 按比例缩小后的像素长度，至少为1
+static inline size_t YYImageScaledLength(size_t length, CGFloat ratio) {
+    if (ratio >= 1) return length;
+    size_t scaled = (size_t)round(length * ratio);
+    return scaled < 1 ? 1 : scaled;
+}
+
 // 更新数据源
 - (void)_updateSource {
     switch (_type) {
         case YYImageTypeWebP: {
+            // 数据不完整时流式解码，完成后再用WebPDemuxer完整解析
+            if (!_finalized && [self _updateSourceWebPStream]) break;
+            [self _releaseStreamingSources];
+            _decodedRowCount = 0;
+            _frameCount = 0;
             [self _updateSourceWebP];
         } break;
             
         case YYImageTypePNG: {
+            if (!_finalized && [self _updateSourcePNGStream]) break;
+            [self _releaseStreamingSources];
+            _decodedRowCount = 0;
             [self _updateSourceAPNG];
         } break;
             
         default: {
+            _decodedRowCount = 0;
             [self _updateSourceImageIO];
         } break;
     }
+    if (_finalized) _decodedRowCount = _frameCount > 0 ? _height : 0;
+}
+
+// 释放流式解码状态
+- (void)_releaseStreamingSources {
+    if (_pngStream) {
+        yy_png_stream_release(_pngStream);
+        _pngStream = NULL;
+    }
+#if YYIMAGE_WEBP_ENABLED
+    if (_webpIDecoder) {
+        WebPIDelete(_webpIDecoder);
+        _webpIDecoder = NULL;
+    }
+    if (_webpICanvas) {
+        free(_webpICanvas);
+        _webpICanvas = NULL;
+    }
+#endif
+}
+
+// 流式解码的画布，不在流式解码时返回NULL
+- (const uint8_t *)_streamingCanvasWithStride:(size_t *)stride {
+    if (_finalized) return NULL;
+    if (_pngStream && _pngStream->canvas) {
+        *stride = _pngStream->canvas_stride;
+        return _pngStream->canvas;
+    }
+#if YYIMAGE_WEBP_ENABLED
+    if (_webpIDecoder && _webpICanvas) {
+        *stride = _webpICanvasStride;
+        return _webpICanvas;
+    }
+#endif
+    return NULL;
+}
+
+// 流式解码只有一帧，画布上已经解码的行在取帧时生成图像
+- (void)_updateStreamingFrameWithWidth:(NSUInteger)width height:(NSUInteger)height decodedRows:(NSUInteger)rows {
+    _width = width;
+    _height = height;
+    _orientation = UIImageOrientationUp;
+    _loopCount = 0;
+    _needBlend = NO;
+    _decodedRowCount = rows;
+    if (rows == 0) return;
+    if (_frames.count == 1) return; // only the canvas is changed
+    
+    _YYImageDecoderFrame *frame = [_YYImageDecoderFrame new];
+    frame.index = 0;
+    frame.blendFromIndex = 0;
+    frame.width = width;
+    frame.height = height;
+    frame.hasAlpha = YES;
+    frame.isFullSize = YES;
+    _frameCount = 1;
+    dispatch_semaphore_wait(_framesLock, DISPATCH_TIME_FOREVER);
+    _frames = @[frame];
+    dispatch_semaphore_signal(_framesLock);
+}
+
+/**
+ Decode the png bytes received since the last update.
+ @return NO if the png cannot be decoded in streaming mode (interlaced, not
+ supported or corrupted), ImageIO should be used instead.
+ */
+- (BOOL)_updateSourcePNGStream {
+    if (_pngStreamFailed) return NO;
+    if (!_pngStream) {
+        _pngStream = calloc(1, sizeof(yy_png_stream));
+        if (!_pngStream) {
+            _pngStreamFailed = YES;
+            return NO;
+        }
+    }
+    if (!yy_png_stream_update(_pngStream, _data.bytes, _data.length)) {
+        _pngStreamFailed = YES;
+        return NO;
+    }
+    if (!_pngStream->header_ready) return YES; // wait for `IHDR`
+    [self _updateStreamingFrameWithWidth:_pngStream->header.width height:_pngStream->header.height decodedRows:_pngStream->decoded_rows];
+    return YES;
+}
+
+/**
+ Append the webp bytes received since the last update to WebPIDecoder.
+ @return NO if the webp cannot be decoded in streaming mode (animated or corrupted).
+ */
+- (BOOL)_updateSourceWebPStream {
+#if YYIMAGE_WEBP_ENABLED
+    if (_webpIDecoderFailed) return NO;
+    if (!_webpIDecoder) {
+        WebPBitstreamFeatures features;
+        VP8StatusCode status = WebPGetFeatures(_data.bytes, _data.length, &features);
+        if (status == VP8_STATUS_NOT_ENOUGH_DATA) return YES; // wait for header
+        if (status != VP8_STATUS_OK || features.has_animation || features.width < 1 || features.height < 1) {
+            _webpIDecoderFailed = YES;
+            return NO;
+        }
+        size_t stride = YYImageByteAlign((size_t)features.width * 4, 32);
+        size_t length = stride * features.height;
+        _webpICanvas = calloc(1, length);
+        if (_webpICanvas) _webpIDecoder = WebPINewRGB(MODE_bgrA, _webpICanvas, length, (int)stride);
+        if (!_webpIDecoder) {
+            [self _releaseStreamingSources];
+            _webpIDecoderFailed = YES;
+            return NO;
+        }
+        _webpICanvasStride = stride;
+        _webpIConsumedLength = 0;
+        _width = features.width;
+        _height = features.height;
+    }
+    if (_data.length > _webpIConsumedLength) {
+        // WebPIAppend() copies the new bytes, so `_data` can be mutated later
+        VP8StatusCode status = WebPIAppend(_webpIDecoder, (const uint8_t *)_data.bytes + _webpIConsumedLength, _data.length - _webpIConsumedLength);
+        _webpIConsumedLength = _data.length;
+        if (status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
+            [self _releaseStreamingSources];
+            _webpIDecoderFailed = YES;
+            return NO;
+        }
+    }
+    int lastY = 0;
+    if (!WebPIDecGetRGB(_webpIDecoder, &lastY, NULL, NULL, NULL)) lastY = 0;
+    [self _updateStreamingFrameWithWidth:_width height:_height decodedRows:MIN((NSUInteger)MAX(lastY, 0), _height)];
+    return YES;
+#else
+    return NO;
+#endif
 }
 
 - (void)_updateSourceWebP {
@@ -1912,9 +3095,9 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     
     /*
      https://developers.google.com/speed/webp/docs/api
-     The documentation said we can use WebPIDecoder to decode webp progressively, 
-     but currently it can only returns an empty image (not same as progressive jpegs),
-     so we don't use progressive decoding.
+     WebPIDecoder decodes webp progressively row by row (not same as progressive
+     jpegs), it's used for still webp before the data is finalized, see
+     `_updateSourceWebPStream`.
      
      When using WebPDecode() to decode multi-frame webp, we will get the error
      "VP8_STATUS_UNSUPPORTED_FEATURE", so we first use WebPDemuxer to unpack it.
@@ -2231,10 +3414,35 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     if (_frames.count <= index) return NULL;
     // 获取要处理的帧
     _YYImageDecoderFrame *frame = _frames[index];
+    // 缩小解码的比例和缩小后的画布大小
+    CGFloat ratio = [self _downsampleRatio];
+    size_t canvasWidth = YYImageScaledLength(_width, ratio);
+    size_t canvasHeight = YYImageScaledLength(_height, ratio);
+    
+    // 流式解码中，直接从画布上已经解码的行生成图像
+    size_t streamingStride = 0;
+    const uint8_t *streamingCanvas = [self _streamingCanvasWithStride:&streamingStride];
+    if (streamingCanvas) {
+        CGImageRef imageRef = YYCGImageCreateWithBGRABuffer(streamingCanvas, _width, _height, streamingStride, canvasWidth, canvasHeight);
+        if (imageRef && decoded) *decoded = YES;
+        return imageRef;
+    }
     
     // 如果有_source根据_source生成图像
     if (_source) {
-        CGImageRef imageRef = CGImageSourceCreateImageAtIndex(_source, index, (CFDictionaryRef)@{(id)kCGImageSourceShouldCache:@(YES)});
+        CGImageRef imageRef = NULL;
+        if (ratio < 1) {
+            // 解码时直接生成缩略图，不生成全尺寸的位图
+            NSUInteger maxPixelSize = MAX(YYImageScaledLength(frame.width, ratio), YYImageScaledLength(frame.height, ratio));
+            NSDictionary *options = @{(id)kCGImageSourceCreateThumbnailFromImageAlways : @(YES),
+                                      (id)kCGImageSourceCreateThumbnailWithTransform : @(NO),
+                                      (id)kCGImageSourceShouldCacheImmediately : @(YES),
+                                      (id)kCGImageSourceThumbnailMaxPixelSize : @(maxPixelSize)};
+            imageRef = CGImageSourceCreateThumbnailAtIndex(_source, index, (CFDictionaryRef)options);
+        }
+        if (!imageRef) {
+            imageRef = CGImageSourceCreateImageAtIndex(_source, index, (CFDictionaryRef)@{(id)kCGImageSourceShouldCache:@(YES)});
+        }
         
         // 如果需要展开到画布
         if (imageRef && extendToCanvas) {
@@ -2242,7 +3450,7 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
             size_t width = CGImageGetWidth(imageRef);
             size_t height = CGImageGetHeight(imageRef);
             // 如果画布大小与图像大小相同，解压图像
-            if (width == _width && height == _height) {
+            if (width == canvasWidth && height == canvasHeight) {
                 CGImageRef imageRefExtended = YYCGImageCreateDecodedCopy(imageRef, YES);
                 if (imageRefExtended) {
                     CFRelease(imageRef);
@@ -2251,9 +3459,15 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
                 }
             } else {
                 // 生成上下文，并将在上下文解压图像
-                CGContextRef context = CGBitmapContextCreate(NULL, _width, _height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+                CGContextRef context = CGBitmapContextCreate(NULL, canvasWidth, canvasHeight, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
                 if (context) {
-                    CGContextDrawImage(context, CGRectMake(0, _height - height, width, height), imageRef);
+                    if (ratio < 1) {
+                        // 缩略图的大小可能与按比例计算的大小有舍入误差，在原始坐标系中绘制
+                        CGContextScaleCTM(context, (CGFloat)canvasWidth / _width, (CGFloat)canvasHeight / _height);
+                        CGContextDrawImage(context, CGRectMake(0, (CGFloat)_height - frame.height, frame.width, frame.height), imageRef);
+                    } else {
+                        CGContextDrawImage(context, CGRectMake(0, _height - height, width, height), imageRef);
+                    }
                     CGImageRef imageRefExtended = CGBitmapContextCreateImage(context);
                     CFRelease(context);
                     if (imageRefExtended) {
@@ -2272,31 +3486,56 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
         uint32_t size = 0;
         uint8_t *bytes = yy_png_copy_frame_data_at_index(_data.bytes, _apngSource, (uint32_t)index, &size);
         if (!bytes) return NULL;
-        CGDataProviderRef provider = CGDataProviderCreateWithData(bytes, bytes, size, YYCGDataProviderReleaseDataCallback);
-        if (!provider) {
-            free(bytes);
-            return NULL;
-        }
-        bytes = NULL; // hold by provider
         
-        CGImageSourceRef source = CGImageSourceCreateWithDataProvider(provider, NULL);
-        if (!source) {
-            CFRelease(provider);
-            return NULL;
+        CGImageRef imageRef = NULL;
+        if (ratio < 1) {
+            // 逐行解码帧数据并直接缩小，不生成原尺寸的帧图像
+            imageRef = YYCGImageCreateWithPNGDataDownsampled(bytes, size, YYImageScaledLength(frame.width, ratio), YYImageScaledLength(frame.height, ratio));
+            if (imageRef) {
+                free(bytes);
+                bytes = NULL;
+                if (decoded && !extendToCanvas) *decoded = YES;
+            }
         }
-        CFRelease(provider);
         
-        if(CGImageSourceGetCount(source) < 1) {
+        if (!imageRef) {
+            CGDataProviderRef provider = CGDataProviderCreateWithData(bytes, bytes, size, YYCGDataProviderReleaseDataCallback);
+            if (!provider) {
+                free(bytes);
+                return NULL;
+            }
+            bytes = NULL; // hold by provider
+            
+            CGImageSourceRef source = CGImageSourceCreateWithDataProvider(provider, NULL);
+            if (!source) {
+                CFRelease(provider);
+                return NULL;
+            }
+            CFRelease(provider);
+            
+            if(CGImageSourceGetCount(source) < 1) {
+                CFRelease(source);
+                return NULL;
+            }
+            
+            // 需要缩小时不缓存解码结果，原尺寸的帧只在绘制到缩小前的位图时解码一次
+            imageRef = CGImageSourceCreateImageAtIndex(source, 0, (CFDictionaryRef)@{(id)kCGImageSourceShouldCache:@(ratio >= 1)});
             CFRelease(source);
-            return NULL;
+            if (!imageRef) return NULL;
+            if (ratio < 1) {
+                // 隔行扫描的帧：解码后逐行盒式滤波缩小
+                CGImageRef imageRefScaled = YYCGImageCreateBoxDownsampledCopy(imageRef, YYImageScaledLength(frame.width, ratio), YYImageScaledLength(frame.height, ratio));
+                if (imageRefScaled) {
+                    CFRelease(imageRef);
+                    imageRef = imageRefScaled;
+                    if (decoded && !extendToCanvas) *decoded = YES;
+                }
+            }
         }
-        
-        CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, 0, (CFDictionaryRef)@{(id)kCGImageSourceShouldCache:@(YES)});
-        CFRelease(source);
-        if (!imageRef) return NULL;
         if (extendToCanvas) {
-            CGContextRef context = CGBitmapContextCreate(NULL, _width, _height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst); //bgrA
+            CGContextRef context = CGBitmapContextCreate(NULL, canvasWidth, canvasHeight, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst); //bgrA
             if (context) {
+                CGContextScaleCTM(context, (CGFloat)canvasWidth / _width, (CGFloat)canvasHeight / _height);
                 CGContextDrawImage(context, CGRectMake(frame.offsetX, frame.offsetY, frame.width, frame.height), imageRef);
                 CFRelease(imageRef);
                 imageRef = CGBitmapContextCreateImage(context);
@@ -2317,9 +3556,16 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
         int frameHeight = iter.height;
         if (frameWidth < 1 || frameHeight < 1) return NULL;
         
-        int width = extendToCanvas ? (int)_width : frameWidth;
-        int height = extendToCanvas ? (int)_height : frameHeight;
-        if (width > _width || height > _height) return NULL;
+        // 缩小解码时，帧大小和偏移量按比例缩小
+        int scaledFrameWidth = (int)YYImageScaledLength(frameWidth, ratio);
+        int scaledFrameHeight = (int)YYImageScaledLength(frameHeight, ratio);
+        int offsetX = ratio < 1 ? (int)round(iter.x_offset * ratio) : iter.x_offset;
+        int offsetY = ratio < 1 ? (int)round(iter.y_offset * ratio) : iter.y_offset;
+        
+        int width = extendToCanvas ? (int)canvasWidth : scaledFrameWidth;
+        int height = extendToCanvas ? (int)canvasHeight : scaledFrameHeight;
+        if ((size_t)width > canvasWidth || (size_t)height > canvasHeight) return NULL;
+        if (scaledFrameWidth > width || scaledFrameHeight > height) return NULL;
         
         const uint8_t *payload = iter.fragment.bytes;
         size_t payloadSize = iter.fragment.size;
@@ -2351,6 +3597,12 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
         config.output.u.RGBA.rgba = pixels;
         config.output.u.RGBA.stride = (int)bytesPerRow;
         config.output.u.RGBA.size = length;
+        if (scaledFrameWidth != frameWidth || scaledFrameHeight != frameHeight) {
+            // 由libwebp在解码时缩小
+            config.options.use_scaling = 1;
+            config.options.scaled_width = scaledFrameWidth;
+            config.options.scaled_height = scaledFrameHeight;
+        }
         VP8StatusCode result = WebPDecode(payload, payloadSize, &config); // decode
         if ((result != VP8_STATUS_OK) && (result != VP8_STATUS_NOT_ENOUGH_DATA)) {
             WebPDemuxReleaseIterator(&iter);
@@ -2359,12 +3611,12 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
         }
         WebPDemuxReleaseIterator(&iter);
         
-        if (extendToCanvas && (iter.x_offset != 0 || iter.y_offset != 0)) {
+        if (extendToCanvas && (offsetX != 0 || offsetY != 0)) {
             void *tmp = calloc(1, length);
             if (tmp) {
                 vImage_Buffer src = {pixels, height, width, bytesPerRow};
                 vImage_Buffer dest = {tmp, height, width, bytesPerRow};
-                vImage_CGAffineTransform transform = {1, 0, 0, 1, iter.x_offset, -iter.y_offset};
+                vImage_CGAffineTransform transform = {1, 0, 0, 1, offsetX, -offsetY};
                 uint8_t backColor[4] = {0};
                 vImage_Error error = vImageAffineWarpCG_ARGB8888(&src, &dest, NULL, &transform, backColor, kvImageBackgroundColorFill);
                 if (error == kvImageNoError) {
@@ -2395,7 +3647,14 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 - (BOOL)_createBlendContextIfNeeded {
     if (!_blendCanvas) {
         _blendFrameIndex = NSNotFound;
-        _blendCanvas = CGBitmapContextCreate(NULL, _width, _height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+        // 缩小解码时画布也缩小，并通过CTM保持帧的坐标系不变
+        CGFloat ratio = [self _downsampleRatio];
+        size_t canvasWidth = YYImageScaledLength(_width, ratio);
+        size_t canvasHeight = YYImageScaledLength(_height, ratio);
+        _blendCanvas = CGBitmapContextCreate(NULL, canvasWidth, canvasHeight, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+        if (_blendCanvas && ratio < 1) {
+            CGContextScaleCTM(_blendCanvas, (CGFloat)canvasWidth / _width, (CGFloat)canvasHeight / _height);
+        }
     }
     BOOL suc = _blendCanvas != NULL;
     return suc;
@@ -2527,6 +3786,473 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 @end
 
 
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Tile Decoder
+
+#define YY_IMAGE_TILE_DEFAULT_SIZE 256
+#define YY_IMAGE_TILE_CACHE_COST_LIMIT (32 * 1024 * 1024)
+
+/// Returns the pixel length at a scale level (1/2^level, rounded up).
+static inline size_t YYImageTileLevelLength(size_t length, NSUInteger level) {
+    if (level == 0) return length;
+    if (level >= sizeof(size_t) * 8) return length ? 1 : 0;
+    size_t scaled = (length + ((size_t)1 << level) - 1) >> level;
+    return scaled < 1 ? 1 : scaled;
+}
+
+/**
+ Decode a region of a non-interlaced png to premultiplied bgrA, and scale it down
+ with box filter if needed.
+ 
+ @discussion The `IDAT` chunks are inflated in place, only two scanlines are 
+ allocated. Rows above the region are reconstructed and dropped, and decoding 
+ stops as soon as the last row of the region is reached.
+ 
+ @param data       png data
+ @param info       png info, see yy_png_info_create()
+ @param format     pixel format, see yy_png_pixel_format_init()
+ @param x,y,width,height region in image pixels
+ @param dst        destination buffer (premultiplied bgrA)
+ @param dst_width  destination width, not larger than region width
+ @param dst_height destination height, not larger than region height
+ @param dst_stride destination bytes per row
+ @return whether succeed
+ 
+ @note 逐行inflate并重建扫描线，只分配两行的缓存，到达区域最后一行时停止解码
+ */
+static bool yy_png_decode_region(const uint8_t *data, yy_png_info *info, const yy_png_pixel_format *format,
+                                 uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                                 uint8_t *dst, uint32_t dst_width, uint32_t dst_height, size_t dst_stride) {
+    const yy_png_chunk_IHDR *header = &info->header;
+    if (width == 0 || height == 0 || dst_width == 0 || dst_height == 0) return false;
+    if ((uint64_t)x + width > header->width || (uint64_t)y + height > header->height) return false;
+    if (dst_width > width || dst_height > height) return false;
+    
+    size_t bits_per_pixel = (size_t)format->channels * format->bit_depth;
+    size_t row_length = ((size_t)header->width * bits_per_pixel + 7) / 8;
+    size_t bpp = bits_per_pixel >= 8 ? bits_per_pixel / 8 : 1;
+    bool scale = dst_width != width || dst_height != height;
+    
+    bool finished = false;
+    bool stream_inited = false;
+    uint8_t *cur = calloc(1, row_length + 1);
+    uint8_t *prev = calloc(1, row_length + 1);
+    uint8_t *line = NULL; // converted row before box filter
+    size_t *x_starts = NULL;
+    uint64_t *sums = NULL;
+    if (!cur || !prev) goto end;
+    if (scale) {
+        line = malloc((size_t)width * 4);
+        x_starts = malloc(((size_t)dst_width + 1) * sizeof(size_t));
+        sums = calloc((size_t)dst_width * 4, sizeof(uint64_t));
+        if (!line || !x_starts || !sums) goto end;
+        for (size_t i = 0; i <= dst_width; i++) x_starts[i] = i * width / dst_width;
+    }
+    
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    if (inflateInit(&stream) != Z_OK) goto end;
+    stream_inited = true;
+    stream.next_out = cur;
+    stream.avail_out = (uInt)(row_length + 1);
+    
+    uint32_t row = 0;
+    uint32_t dst_row = 0;
+    uint32_t dst_row_start = 0;
+    for (uint32_t i = 0; i < info->chunk_num && !finished; i++) {
+        yy_png_chunk_info *chunk = info->chunks + i;
+        if (chunk->fourcc != YY_FOUR_CC('I', 'D', 'A', 'T')) continue;
+        stream.next_in = (Bytef *)(data + chunk->offset + 8);
+        stream.avail_in = chunk->length;
+        for (;;) {
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) goto end;
+            bool row_done = stream.avail_out == 0;
+            if (row_done) {
+                if (!yy_png_unfilter_row(cur[0], cur + 1, prev + 1, row_length, bpp)) goto end;
+                if (row >= y) {
+                    uint32_t region_row = row - y;
+                    if (!scale) {
+                        yy_png_convert_row(cur + 1, format, x, width, dst + region_row * dst_stride);
+                    } else {
+                        yy_png_convert_row(cur + 1, format, x, width, line);
+                        YYImageBoxAccumulateRow(line, x_starts, dst_width, sums);
+                        uint32_t dst_row_end = (uint32_t)((uint64_t)(dst_row + 1) * height / dst_height);
+                        if (region_row + 1 == dst_row_end) {
+                            YYImageBoxOutputRow(sums, x_starts, dst_width, dst_row_end - dst_row_start, dst + dst_row * dst_stride);
+                            memset(sums, 0, (size_t)dst_width * 4 * sizeof(uint64_t));
+                            dst_row++;
+                            dst_row_start = dst_row_end;
+                        }
+                    }
+                }
+                row++;
+                if (row >= y + height) {
+                    finished = true;
+                    break;
+                }
+                uint8_t *tmp = prev;
+                prev = cur;
+                cur = tmp;
+                stream.next_out = cur;
+                stream.avail_out = (uInt)(row_length + 1);
+            }
+            if (ret == Z_STREAM_END) goto end; // not enough rows
+            if (!row_done && (stream.avail_in == 0 || ret == Z_BUF_ERROR)) break; // need next IDAT
+        }
+    }
+    
+end:
+    if (stream_inited) inflateEnd(&stream);
+    if (cur) free(cur);
+    if (prev) free(prev);
+    if (line) free(line);
+    if (x_starts) free(x_starts);
+    if (sums) free(sums);
+    return finished;
+}
+
+#if YYIMAGE_WEBP_ENABLED
+/**
+ Decode a region of a still WebP with libwebp cropping (and scaling).
+ 
+ @note 使用libwebp的裁剪(和缩放)功能解码静态WebP的一个区域
+ */
+static CGImageRef YYCGImageCreateWithWebPDataInRect(const uint8_t *bytes, size_t length,
+                                                    uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                                                    size_t dstWidth, size_t dstHeight) CF_RETURNS_RETAINED {
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config)) return NULL;
+    if (WebPGetFeatures(bytes, length, &config.input) != VP8_STATUS_OK) return NULL;
+    if (config.input.has_animation) return NULL;
+    
+    // the crop origin is snapped to even position for lossy image (YUV420),
+    // decode the snapped rect and drop the extra column/row later.
+    uint32_t cropX = x & ~1u;
+    uint32_t cropY = y & ~1u;
+    uint32_t cropWidth = x + width - cropX;
+    uint32_t cropHeight = y + height - cropY;
+    size_t decodeWidth = (size_t)ceil((double)cropWidth * dstWidth / width);
+    size_t decodeHeight = (size_t)ceil((double)cropHeight * dstHeight / height);
+    size_t padX = decodeWidth - dstWidth;
+    size_t padY = decodeHeight - dstHeight;
+    
+    config.options.use_cropping = 1;
+    config.options.crop_left = (int)cropX;
+    config.options.crop_top = (int)cropY;
+    config.options.crop_width = (int)cropWidth;
+    config.options.crop_height = (int)cropHeight;
+    if (decodeWidth != cropWidth || decodeHeight != cropHeight) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = (int)decodeWidth;
+        config.options.scaled_height = (int)decodeHeight;
+    }
+    
+    size_t bytesPerRow = YYImageByteAlign(decodeWidth * 4, 32);
+    size_t bufferLength = bytesPerRow * decodeHeight;
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst; //bgrA
+    void *pixels = calloc(1, bufferLength);
+    if (!pixels) return NULL;
+    
+    config.output.colorspace = MODE_bgrA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = pixels;
+    config.output.u.RGBA.stride = (int)bytesPerRow;
+    config.output.u.RGBA.size = bufferLength;
+    if (WebPDecode(bytes, length, &config) != VP8_STATUS_OK) {
+        free(pixels);
+        return NULL;
+    }
+    
+    CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels, bufferLength, YYCGDataProviderReleaseDataCallback);
+    if (!provider) {
+        free(pixels);
+        return NULL;
+    }
+    pixels = NULL; // hold by provider
+    CGImageRef imageRef = CGImageCreate(decodeWidth, decodeHeight, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CFRelease(provider);
+    if (imageRef && (padX || padY)) {
+        CGImageRef cropped = CGImageCreateWithImageInRect(imageRef, CGRectMake(padX, padY, dstWidth, dstHeight));
+        CFRelease(imageRef);
+        imageRef = cropped;
+    }
+    return imageRef;
+}
+#endif
+
+
+/**
+ Copy a rect of the image to a new bitmap of dstWidth x dstHeight, so the result
+ does not retain the source image.
+ 
+ @note 复制图片的一个区域到新的位图，结果不持有原图片
+ */
+static CGImageRef YYCGImageCreateCopyInRect(CGImageRef imageRef, CGRect rect, size_t dstWidth, size_t dstHeight) CF_RETURNS_RETAINED {
+    if (!imageRef || dstWidth == 0 || dstHeight == 0) return NULL;
+    CGImageRef cropped = CGImageCreateWithImageInRect(imageRef, rect);
+    if (!cropped) return NULL;
+    CGImageRef copied = NULL;
+    CGContextRef context = CGBitmapContextCreate(NULL, dstWidth, dstHeight, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    if (context) {
+        CGContextDrawImage(context, CGRectMake(0, 0, dstWidth, dstHeight), cropped);
+        copied = CGBitmapContextCreateImage(context);
+        CFRelease(context);
+    }
+    CFRelease(cropped);
+    return copied;
+}
+
+
+@implementation YYImageTileDecoder {
+    pthread_mutex_t _lock;
+    yy_png_info *_pngInfo;          ///< non-NULL if png region decoding is available
+    yy_png_pixel_format _pngFormat;
+    BOOL _webpRegionAvailable;      ///< still webp
+    CGImageSourceRef _source;       ///< fallback: image source of other formats
+    CGImageRef _levelImage;         ///< fallback: the image at `_levelImageLevel`, not decoded
+    NSUInteger _levelImageLevel;
+    CGImageRef _strip;              ///< the decoded tile row `_stripRow` at `_stripLevel`
+    NSUInteger _stripLevel;
+    NSUInteger _stripRow;
+}
+
+- (void)dealloc {
+    if (_pngInfo) yy_png_info_release(_pngInfo);
+    if (_source) CFRelease(_source);
+    if (_levelImage) CFRelease(_levelImage);
+    if (_strip) CFRelease(_strip);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (instancetype)init {
+    @throw [NSException exceptionWithName:@"YYImageTileDecoder init error" reason:@"YYImageTileDecoder must be initialized with data. Use 'initWithData:scale:tileSize:' instead." userInfo:nil];
+    return [self initWithData:[NSData new] scale:1 tileSize:0];
+}
+
++ (instancetype)decoderWithData:(NSData *)data scale:(CGFloat)scale {
+    return [[self alloc] initWithData:data scale:scale tileSize:0];
+}
+
+- (instancetype)initWithData:(NSData *)data scale:(CGFloat)scale tileSize:(NSUInteger)tileSize {
+    if (data.length == 0) return nil;
+    self = [super init];
+    if (!self) return nil;
+    if (scale <= 0) scale = 1;
+    if (tileSize == 0) tileSize = YY_IMAGE_TILE_DEFAULT_SIZE;
+    _data = data;
+    _scale = scale;
+    _tileSize = tileSize;
+    _type = YYImageDetectType((__bridge CFDataRef)data);
+    _levelImageLevel = NSNotFound;
+    _stripLevel = NSNotFound;
+    
+    // 只读取图片尺寸，不解码
+    switch (_type) {
+        case YYImageTypePNG: {
+            if (data.length <= UINT32_MAX) {
+                _pngInfo = yy_png_info_create(data.bytes, (uint32_t)data.length);
+            }
+            if (_pngInfo) {
+                _width = _pngInfo->header.width;
+                _height = _pngInfo->header.height;
+                if (!yy_png_pixel_format_init(&_pngFormat, data.bytes, _pngInfo)) {
+                    yy_png_info_release(_pngInfo);
+                    _pngInfo = NULL;
+                }
+            }
+        } break;
+#if YYIMAGE_WEBP_ENABLED
+        case YYImageTypeWebP: {
+            WebPBitstreamFeatures features;
+            if (WebPGetFeatures(data.bytes, data.length, &features) == VP8_STATUS_OK) {
+                _width = features.width;
+                _height = features.height;
+                _webpRegionAvailable = !features.has_animation;
+            }
+        } break;
+#endif
+        default: break;
+    }
+    if (_width == 0 || _height == 0) {
+        CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+        if (source) {
+            CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+            if (properties) {
+                NSInteger width = 0, height = 0;
+                CFTypeRef value = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+                if (value) CFNumberGetValue(value, kCFNumberNSIntegerType, &width);
+                value = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+                if (value) CFNumberGetValue(value, kCFNumberNSIntegerType, &height);
+                _width = width > 0 ? width : 0;
+                _height = height > 0 ? height : 0;
+                CFRelease(properties);
+            }
+            CFRelease(source);
+        }
+    }
+    if (_width == 0 || _height == 0) return nil;
+    
+    while (YYImageTileLevelLength(_width, _maxLevel) > _tileSize ||
+           YYImageTileLevelLength(_height, _maxLevel) > _tileSize) {
+        _maxLevel++;
+    }
+    
+    _tileCache = [YYMemoryCache new];
+    _tileCache.name = @"YYImageTileDecoder";
+    _tileCache.costLimit = YY_IMAGE_TILE_CACHE_COST_LIMIT;
+    pthread_mutex_init_recursive(&_lock, false);
+    return self;
+}
+
+- (NSUInteger)columnCountAtLevel:(NSUInteger)level {
+    return (YYImageTileLevelLength(_width, level) + _tileSize - 1) / _tileSize;
+}
+
+- (NSUInteger)rowCountAtLevel:(NSUInteger)level {
+    return (YYImageTileLevelLength(_height, level) + _tileSize - 1) / _tileSize;
+}
+
+- (UIImage *)imageInRect:(CGRect)rect level:(NSUInteger)level {
+    rect = CGRectIntegral(CGRectIntersection(rect, CGRectMake(0, 0, _width, _height)));
+    if (CGRectIsEmpty(rect)) return nil;
+    CGImageRef imageRef = [self _newImageInRect:rect
+                                       dstWidth:YYImageTileLevelLength(rect.size.width, level)
+                                      dstHeight:YYImageTileLevelLength(rect.size.height, level)
+                                          level:level];
+    if (!imageRef) return nil;
+    UIImage *image = [UIImage imageWithCGImage:imageRef scale:_scale orientation:UIImageOrientationUp];
+    CFRelease(imageRef);
+    image.isDecodedForDisplay = YES;
+    return image;
+}
+
+- (UIImage *)tileAtColumn:(NSUInteger)column row:(NSUInteger)row level:(NSUInteger)level {
+    if (column >= [self columnCountAtLevel:level] || row >= [self rowCountAtLevel:level]) return nil;
+    NSString *key = [NSString stringWithFormat:@"%lu_%lu_%lu", (unsigned long)level, (unsigned long)column, (unsigned long)row];
+    UIImage *tile = [_tileCache objectForKey:key];
+    if (tile) return tile;
+    
+    // tile rect at the level
+    size_t levelWidth = YYImageTileLevelLength(_width, level);
+    size_t levelHeight = YYImageTileLevelLength(_height, level);
+    size_t tileX = column * _tileSize;
+    size_t tileWidth = MIN(_tileSize, levelWidth - tileX);
+    size_t tileHeight = MIN(_tileSize, levelHeight - row * _tileSize);
+    
+    // 同一行的瓦片从解码一次的条带中裁剪，每行只解码一次
+    CGImageRef strip = [self _newStripAtRow:row level:level];
+    if (!strip) return nil;
+    tileWidth = MIN(tileWidth, CGImageGetWidth(strip) - MIN(tileX, CGImageGetWidth(strip)));
+    tileHeight = MIN(tileHeight, CGImageGetHeight(strip));
+    CGImageRef imageRef = tileWidth > 0 ? YYCGImageCreateCopyInRect(strip, CGRectMake(tileX, 0, tileWidth, tileHeight), tileWidth, tileHeight) : NULL;
+    CFRelease(strip);
+    if (!imageRef) return nil;
+    tile = [UIImage imageWithCGImage:imageRef scale:_scale orientation:UIImageOrientationUp];
+    NSUInteger cost = CGImageGetBytesPerRow(imageRef) * CGImageGetHeight(imageRef);
+    CFRelease(imageRef);
+    tile.isDecodedForDisplay = YES;
+    [_tileCache setObject:tile forKey:key withCost:cost];
+    return tile;
+}
+
+#pragma private
+
+// 解码指定区域(原尺寸像素坐标)，输出dstWidth x dstHeight的位图
+- (CGImageRef)_newImageInRect:(CGRect)rect dstWidth:(size_t)dstWidth dstHeight:(size_t)dstHeight level:(NSUInteger)level CF_RETURNS_RETAINED {
+    uint32_t x = (uint32_t)rect.origin.x;
+    uint32_t y = (uint32_t)rect.origin.y;
+    uint32_t width = (uint32_t)rect.size.width;
+    uint32_t height = (uint32_t)rect.size.height;
+    if (width == 0 || height == 0 || dstWidth == 0 || dstHeight == 0) return NULL;
+    CGImageRef imageRef = NULL;
+    
+    if (_pngInfo) {
+        size_t bytesPerRow = YYImageByteAlign(dstWidth * 4, 32);
+        size_t length = bytesPerRow * dstHeight;
+        uint8_t *pixels = calloc(1, length);
+        if (pixels && yy_png_decode_region(_data.bytes, _pngInfo, &_pngFormat, x, y, width, height,
+                                           pixels, (uint32_t)dstWidth, (uint32_t)dstHeight, bytesPerRow)) {
+            CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels, length, YYCGDataProviderReleaseDataCallback);
+            if (provider) {
+                pixels = NULL; // hold by provider
+                imageRef = CGImageCreate(dstWidth, dstHeight, 8, 32, bytesPerRow, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst, provider, NULL, false, kCGRenderingIntentDefault);
+                CFRelease(provider);
+            }
+        }
+        if (pixels) free(pixels);
+        if (imageRef) return imageRef;
+    }
+    
+#if YYIMAGE_WEBP_ENABLED
+    if (_webpRegionAvailable) {
+        imageRef = YYCGImageCreateWithWebPDataInRect(_data.bytes, _data.length, x, y, width, height, dstWidth, dstHeight);
+        if (imageRef) return imageRef;
+    }
+#endif
+    
+    // 其他格式：从没有解码的图片中裁剪区域再绘制，ImageIO只在绘制时解码，不会保留整张图片的位图
+    CGImageRef levelImage = [self _newLevelImage:level];
+    if (!levelImage) return NULL;
+    CGFloat scaleX = CGImageGetWidth(levelImage) / (CGFloat)_width;
+    CGFloat scaleY = CGImageGetHeight(levelImage) / (CGFloat)_height;
+    CGRect levelRect = CGRectIntegral(CGRectMake(x * scaleX, y * scaleY, width * scaleX, height * scaleY));
+    imageRef = YYCGImageCreateCopyInRect(levelImage, levelRect, dstWidth, dstHeight);
+    CFRelease(levelImage);
+    return imageRef;
+}
+
+// 解码一行瓦片的条带(等级中的整行宽度)，只缓存最近使用的一个条带
+- (CGImageRef)_newStripAtRow:(NSUInteger)row level:(NSUInteger)level CF_RETURNS_RETAINED {
+    pthread_mutex_lock(&_lock);
+    CGImageRef strip = NULL;
+    if (_strip && _stripLevel == level && _stripRow == row) strip = (CGImageRef)CFRetain(_strip);
+    pthread_mutex_unlock(&_lock);
+    if (strip) return strip;
+    
+    size_t levelWidth = YYImageTileLevelLength(_width, level);
+    size_t levelHeight = YYImageTileLevelLength(_height, level);
+    size_t stripY = row * _tileSize;
+    size_t stripHeight = MIN(_tileSize, levelHeight - stripY);
+    size_t y = MIN(stripY << level, _height - 1);
+    size_t height = MIN(stripHeight << level, _height - y);
+    stripHeight = MIN(stripHeight, height);
+    levelWidth = MIN(levelWidth, _width);
+    // decoded outside the lock, so tiles of other rows are not blocked
+    strip = [self _newImageInRect:CGRectMake(0, y, _width, height) dstWidth:levelWidth dstHeight:stripHeight level:level];
+    if (!strip) return NULL;
+    
+    pthread_mutex_lock(&_lock);
+    if (_strip) CFRelease(_strip);
+    _strip = (CGImageRef)CFRetain(strip);
+    _stripLevel = level;
+    _stripRow = row;
+    pthread_mutex_unlock(&_lock);
+    return strip;
+}
+
+// 回退路径：获取等级对应的图片，不解码也不缓存解码结果。支持时使用ImageIO的降采样(JPEG在DCT阶段缩小)
+- (CGImageRef)_newLevelImage:(NSUInteger)level CF_RETURNS_RETAINED {
+    pthread_mutex_lock(&_lock);
+    if (!_source) _source = CGImageSourceCreateWithData((__bridge CFDataRef)_data, NULL);
+    if (_source && _levelImageLevel != level) {
+        if (_levelImage) CFRelease(_levelImage);
+        NSMutableDictionary *options = [NSMutableDictionary new];
+        options[(id)kCGImageSourceShouldCache] = @(NO);
+        if (level > 0 && &kCGImageSourceSubsampleFactor != NULL) { // iOS 9
+            options[(id)kCGImageSourceSubsampleFactor] = @(1 << MIN(level, 3)); // 2, 4 or 8
+        }
+        _levelImage = CGImageSourceCreateImageAtIndex(_source, 0, (CFDictionaryRef)options);
+        _levelImageLevel = _levelImage ? level : NSNotFound;
+    }
+    CGImageRef levelImage = _levelImage ? (CGImageRef)CFRetain(_levelImage) : NULL;
+    pthread_mutex_unlock(&_lock);
+    return levelImage;
+}
+
+@end
+
+
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Encoder
 
@@ -2582,6 +4308,7 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
         default:
             break;
     }
+    _maxConcurrentFrameCount = [NSProcessInfo processInfo].activeProcessorCount;
     
     return self;
 }
@@ -2734,6 +4461,64 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
     return (CGImageRef)CFRetain(imageRef);
 }
 
+/**
+ Compress every frame with `block` on at most `maxConcurrentFrameCount` threads.
+ Each worker takes the next frame index until all frames are done, the results
+ are kept in frame order.
+ 
+ @return Frame data array, or nil if any frame failed.
+ 
+ @note 多线程逐帧编码，结果按帧顺序返回；任何一帧失败返回nil
+ */
+- (NSArray<NSData *> *)_encodeFramesWithBlock:(NSData *(^)(NSUInteger index))block {
+    NSUInteger count = _images.count;
+    NSUInteger workerCount = MIN(MAX(_maxConcurrentFrameCount, 1), count);
+    if (workerCount <= 1) {
+        NSMutableArray *datas = [NSMutableArray new];
+        for (NSUInteger i = 0; i < count; i++) {
+            @autoreleasepool {
+                NSData *data = block(i);
+                if (!data) return nil;
+                [datas addObject:data];
+            }
+        }
+        return datas;
+    }
+    
+    CFTypeRef *results = calloc(count, sizeof(CFTypeRef));
+    if (!results) return nil;
+    __block volatile int32_t nextIndex = -1;
+    __block volatile int32_t failed = 0;
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_get_global_queue(qos_class_self(), 0);
+    for (NSUInteger w = 0; w < workerCount; w++) {
+        dispatch_group_async(group, queue, ^{
+            for (;;) {
+                NSUInteger index = (NSUInteger)OSAtomicIncrement32(&nextIndex);
+                if (index >= count || failed) break;
+                @autoreleasepool {
+                    NSData *data = block(index);
+                    if (data) {
+                        results[index] = CFBridgingRetain(data); // each index is written by only one worker
+                    } else {
+                        OSAtomicIncrement32(&failed);
+                    }
+                }
+            }
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    
+    NSMutableArray *datas = failed ? nil : [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        if (!results[i]) continue;
+        id data = CFBridgingRelease(results[i]);
+        [datas addObject:data];
+    }
+    free(results);
+    return datas;
+}
+
 // 编码图像
 - (NSData *)_encodeWithImageIO {
     NSMutableData *data = [NSMutableData new];
@@ -2767,22 +4552,29 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 
 - (NSData *)_encodeAPNG {
     // encode APNG (ImageIO doesn't support APNG encoding, so we use a custom encoder)
-    NSMutableArray *pngDatas = [NSMutableArray new];
+    // 各帧独立压缩为png，再按顺序组装为fcTL/fdAT
+    NSArray *frameDatas = [self _encodeFramesWithBlock:^NSData *(NSUInteger index) {
+        CGImageRef decoded = [self _newCGImageFromIndex:index decoded:YES];
+        if (!decoded) return nil;
+        size_t width = CGImageGetWidth(decoded);
+        size_t height = CGImageGetHeight(decoded);
+        CFDataRef frameData = (width < 1 || height < 1) ? NULL : YYCGImageCreateEncodedData(decoded, YYImageTypePNG, 1);
+        CFRelease(decoded);
+        return CFBridgingRelease(frameData);
+    }];
+    if (!frameDatas) return nil;
+    NSMutableArray *pngDatas = frameDatas.mutableCopy;
     NSMutableArray *pngSizes = [NSMutableArray new];
     NSUInteger canvasWidth = 0, canvasHeight = 0;
-    for (int i = 0; i < _images.count; i++) {
-        CGImageRef decoded = [self _newCGImageFromIndex:i decoded:YES];
-        if (!decoded) return nil;
-        CGSize size = CGSizeMake(CGImageGetWidth(decoded), CGImageGetHeight(decoded));
+    for (NSData *frameData in pngDatas) {
+        // the frame size is read from `IHDR`, the first chunk of png
+        if (frameData.length < 24) return nil;
+        yy_png_chunk_IHDR header;
+        yy_png_chunk_IHDR_read(&header, (const uint8_t *)frameData.bytes + 16);
+        CGSize size = CGSizeMake(header.width, header.height);
         [pngSizes addObject:[NSValue valueWithCGSize:size]];
         if (canvasWidth < size.width) canvasWidth = size.width;
         if (canvasHeight < size.height) canvasHeight = size.height;
-        CFDataRef frameData = YYCGImageCreateEncodedData(decoded, YYImageTypePNG, 1);
-        CFRelease(decoded);
-        if (!frameData) return nil;
-        [pngDatas addObject:(__bridge id)(frameData)];
-        CFRelease(frameData);
-        if (size.width < 1 || size.height < 1) return nil;
     }
     CGSize firstFrameSize = [(NSValue *)[pngSizes firstObject] CGSizeValue];
     if (firstFrameSize.width < canvasWidth || firstFrameSize.height < canvasHeight) {
@@ -2919,16 +4711,17 @@ CGImageRef YYCGImageCreateWithWebPData(CFDataRef webpData,
 - (NSData *)_encodeWebP {
 #if YYIMAGE_WEBP_ENABLED
     // encode webp
-    NSMutableArray *webpDatas = [NSMutableArray new];
-    for (NSUInteger i = 0; i < _images.count; i++) {
-        CGImageRef image = [self _newCGImageFromIndex:i decoded:NO];
+    // 各帧独立压缩，再按顺序使用WebPMux组装
+    BOOL lossless = _lossless;
+    CGFloat quality = _quality;
+    NSArray *webpDatas = [self _encodeFramesWithBlock:^NSData *(NSUInteger index) {
+        CGImageRef image = [self _newCGImageFromIndex:index decoded:NO];
         if (!image) return nil;
-        CFDataRef frameData = YYCGImageCreateEncodedWebPData(image, _lossless, _quality, 4, YYImagePresetDefault);
+        CFDataRef frameData = YYCGImageCreateEncodedWebPData(image, lossless, quality, 4, YYImagePresetDefault);
         CFRelease(image);
-        if (!frameData) return nil;
-        [webpDatas addObject:(__bridge id)frameData];
-        CFRelease(frameData);
-    }
+        return CFBridgingRelease(frameData);
+    }];
+    if (!webpDatas) return nil;
     if (webpDatas.count == 1) {
         return webpDatas.firstObject;
     } else {
@@ -46,7 +46,9 @@ typedef NS_OPTIONS(NSUInteger, YYWebImageOptions) {
     /// Handles cookies stored in NSHTTPCookieStore.
     YYWebImageOptionHandleCookies = 1 << 6,
     
-    /// Load the image from remote and refresh the image cache.
+    /// Load the image from remote and refresh the image cache. If the image in disk
+    /// cache has validators (ETag or Last-Modified), a conditional request is sent,
+    /// and the cached image is used when the server responds `304 Not Modified`.
     YYWebImageOptionRefreshImageCache = 1 << 7,
     
     /// Do not load image from/to disk cache.
@@ -74,6 +76,11 @@ typedef NS_OPTIONS(NSUInteger, YYWebImageOptions) {
     /// This flag will add the URL to a blacklist (in memory) when the URL fail to be downloaded,
     /// so the library won't keep trying.
     YYWebImageOptionIgnoreFailedURL = 1 << 14,
+    
+    /// Decode the image at the pixel size of the view (view's bounds * screen scale)
+    /// instead of the full size, the original image data is still saved to disk cache.
+    /// This is only handled by UIImageView and CALayer categories.
+    YYWebImageOptionDownsampleToViewSize = 1 << 15,
 };
 
 /// Indicated where the image came from.
@@ -158,6 +165,104 @@ typedef void (^YYWebImageCompletionBlock)(UIImage * _Nullable image,
 
 
 
+/**
+ An identifiable image transform, such as resize, round corner or blur.
+ 
+ @discussion Unlike `YYWebImageTransformBlock`, a transformer has an `identifier`,
+ so the transformed image can be cached with a key derived from the image cache key
+ and the identifier. When an image is requested with a transformer, the transformed
+ image is stored in the memory and disk cache with the derived key, and the original
+ image data is stored in the disk cache with the original key. Later requests get
+ the transformed image from cache directly, and a request with another transformer
+ transforms the original image from disk without downloading it again.
+ 
+ Transformers can be chained with `transformerWithTransformers:`. Consecutive resize,
+ round corner and blur steps are fused into one render pass: the image is drawn
+ into a single bitmap (at the final size, with the clip of the corner), blurred in
+ place, and clipped in place, instead of creating an intermediate image for each step.
+ 
+ Transformers are immutable and can be used from any thread.
+ 
+ @note 可以标识的图片变换。变换后的图片使用派生的key缓存在内存和磁盘中，原始图片数据仍然使用原key缓存；
+ 多个变换可以串联，连续的缩放、圆角、模糊会合并在一次绘制中完成
+ */
+@interface YYWebImageTransformer : NSObject
+
+/// The identifier of the transform, used to derive the cache key of the transformed image.
+@property (nonatomic, readonly) NSString *identifier;
+
+/**
+ Creates a transformer with a block.
+ 
+ @param identifier An identifier which is unique for the transform of the block, 
+    two transformers with the same identifier must produce the same image.
+ @param block      The transform block, which will be invoked on background thread.
+ @return A new transformer, or nil if the identifier or block is nil.
+ */
++ (nullable instancetype)transformerWithIdentifier:(NSString *)identifier block:(YYWebImageTransformBlock)block;
+
+/**
+ Creates a transformer which resizes the image to the specified size.
+ Same as `-[UIImage imageByResizeToSize:contentMode:]`.
+ 
+ @param size        The new size (in points), should be positive.
+ @param contentMode The content mode for image content.
+ */
++ (nullable instancetype)resizeTransformerWithSize:(CGSize)size contentMode:(UIViewContentMode)contentMode;
+
+/**
+ Creates a transformer which rounds the corners of the image.
+ Same as `-[UIImage imageByRoundCornerRadius:borderWidth:borderColor:]`.
+ 
+ @param radius      The radius of each corner oval.
+ @param borderWidth The inset border line width.
+ @param borderColor The border stroke color, nil means clear color.
+ */
++ (nullable instancetype)roundCornerTransformerWithRadius:(CGFloat)radius
+                                              borderWidth:(CGFloat)borderWidth
+                                              borderColor:(nullable UIColor *)borderColor;
+
+/**
+ Creates a transformer which blurs the image.
+ Same as `-[UIImage imageByBlurRadius:tintColor:tintMode:saturation:maskImage:]`
+ without tint, saturation and mask.
+ 
+ @param radius The radius of the blur in points, should be positive.
+ */
++ (nullable instancetype)blurTransformerWithRadius:(CGFloat)radius;
+
+/**
+ Creates a transformer which applies the transformers in order.
+ The identifier is composed by the identifiers of the transformers.
+ 
+ @param transformers An array of transformers, should not be empty.
+ */
++ (nullable instancetype)transformerWithTransformers:(NSArray<YYWebImageTransformer *> *)transformers;
+
+/**
+ Returns a new transformer which applies the receiver and then the specified transformer.
+ */
+- (YYWebImageTransformer *)transformerByAppendingTransformer:(YYWebImageTransformer *)transformer;
+
+/**
+ Transforms an image.
+ 
+ @param image The image to transform.
+ @param url   The image url (remote or local file path).
+ @return The transformed image, or nil if an error occurs.
+ */
+- (nullable UIImage *)transformImage:(UIImage *)image url:(nullable NSURL *)url;
+
+/**
+ Returns the cache key of the transformed image.
+ 
+ @param key          The cache key of the original image.
+ @param maxPixelSize The max pixel size of the original image to be transformed, 0 means no limit.
+ */
+- (NSString *)cacheKeyForKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize;
+
+@end
+
 
 /**
  A manager to create and manage web image operation.
@@ -167,6 +272,11 @@ typedef void (^YYWebImageCompletionBlock)(UIImage * _Nullable image,
 /**
  Returns global YYWebImageManager instance.
  
+ @discussion Its queue runs at most 6 operations at the same time, so the waiting
+ operations are started in the order of their `queuePriority`.
+ 
+ @note 共享实例的队列最多同时执行6个操作，等待中的操作按优先级开始
+ 
  @return YYWebImageManager shared instance.
  */
 + (instancetype)sharedManager;
@@ -201,6 +311,79 @@ typedef void (^YYWebImageCompletionBlock)(UIImage * _Nullable image,
                                             transform:(nullable YYWebImageTransformBlock)transform
                                            completion:(nullable YYWebImageCompletionBlock)completion;
 
+/**
+ Creates and returns a new image operation which decodes the image at reduced size,
+ the operation will start immediately.
+ 
+ @param url          The image url (remote or local file path).
+ @param options      The options to control image operation.
+ @param maxPixelSize The max pixel size of the decoded image, 0 means no limit.
+    See `YYWebImageOperation.maxPixelSize` for more information.
+ @param progress     Progress block which will be invoked on background thread (pass nil to avoid).
+ @param transform    Transform block which will be invoked on background thread  (pass nil to avoid).
+ @param completion   Completion block which will be invoked on background thread  (pass nil to avoid).
+ @return A new image operation.
+ */
+- (nullable YYWebImageOperation *)requestImageWithURL:(NSURL *)url
+                                              options:(YYWebImageOptions)options
+                                         maxPixelSize:(NSUInteger)maxPixelSize
+                                             progress:(nullable YYWebImageProgressBlock)progress
+                                            transform:(nullable YYWebImageTransformBlock)transform
+                                           completion:(nullable YYWebImageCompletionBlock)completion;
+
+/**
+ Creates and returns a new image operation which transforms the image with a
+ transformer, the operation will start immediately.
+ 
+ @discussion The transformed image is cached with the key returned by 
+ `cacheKeyForURL:transformer:maxPixelSize:`, the completion receives the transformed
+ image. See `YYWebImageTransformer` for more information.
+ 
+ @note 使用变换器请求图片，变换后的图片使用派生的key缓存，下次请求时直接从缓存获取，不需要重新变换
+ 
+ @param url          The image url (remote or local file path).
+ @param options      The options to control image operation.
+ @param maxPixelSize The max pixel size of the decoded image before transform, 0 means no limit.
+ @param progress     Progress block which will be invoked on background thread (pass nil to avoid).
+ @param transformer  The transformer (pass nil to avoid).
+ @param completion   Completion block which will be invoked on background thread  (pass nil to avoid).
+ @return A new image operation.
+ */
+- (nullable YYWebImageOperation *)requestImageWithURL:(NSURL *)url
+                                              options:(YYWebImageOptions)options
+                                         maxPixelSize:(NSUInteger)maxPixelSize
+                                             progress:(nullable YYWebImageProgressBlock)progress
+                                          transformer:(nullable YYWebImageTransformer *)transformer
+                                           completion:(nullable YYWebImageCompletionBlock)completion;
+
+/**
+ Updates the priority of an image request with the position of the view that shows it.
+ 
+ @discussion Visible requests get the highest priority, the others are demoted by
+ the distance to the viewport. The priority is used by the operation queue while
+ the operation is waiting, and by the URL session task (HTTP/2 stream priority)
+ after it starts. Operations only wait in a queue with a bounded
+ `maxConcurrentOperationCount` (the shared manager's queue runs 6 at a time). A request that is not visible and farther than
+ `staleDistanceToViewport` is cancelled, its completion receives
+ `YYWebImageStageCancelled`.
+ You may call this method from any thread, typically in `scrollViewDidScroll:`.
+ 
+ @note 根据视图到可见区域的距离调整请求优先级，距离过远的请求会被取消
+ 
+ @param operation An operation returned by this manager.
+ @param visible   Whether the view is visible now.
+ @param distance  The distance from the view to the viewport, in viewport lengths
+    (0 means adjacent to the viewport). Ignored when `visible` is YES.
+ @return NO if the request was cancelled as stale, otherwise YES.
+ */
+- (BOOL)updateOperation:(YYWebImageOperation *)operation visible:(BOOL)visible distanceToViewport:(CGFloat)distance;
+
+/**
+ Returns the queue priority for a view with the specified visibility and
+ distance to the viewport (in viewport lengths).
+ */
++ (NSOperationQueuePriority)queuePriorityForVisible:(BOOL)visible distanceToViewport:(CGFloat)distance;
+
 /**
  The image cache used by image operation. 
  You can set it to nil to avoid image cache.
@@ -224,6 +407,29 @@ typedef void (^YYWebImageCompletionBlock)(UIImage * _Nullable image,
  */
 @property (nullable, nonatomic, copy) YYWebImageTransformBlock sharedTransformBlock;
 
+/**
+ Whether identical in-flight requests share one image operation. Default is YES.
+ 
+ @discussion Requests with the same cache key, options, max pixel size and
+ transformer identifier are coalesced: only one operation loads and decodes the
+ image, and every caller receives the progress and completion of the shared work.
+ A transform block cannot be compared between requests, so the requests with a
+ transform block (including `sharedTransformBlock`) are never coalesced, use a 
+ `YYWebImageTransformer` instead. The
+ operation returned to each caller can be cancelled independently, the shared
+ work is cancelled only when the last caller cancels. The `credential` and
+ `shouldUseCredentialStorage` of the returned operation are ignored when
+ coalesced, use `username` and `password` of the manager instead.
+ */
+@property (nonatomic) BOOL coalescesRequests;
+
+/**
+ The distance to viewport (in viewport lengths) beyond which a request reported by
+ `updateOperation:visible:distanceToViewport:` is cancelled as stale. 
+ Default is 3, set 0 to never cancel.
+ */
+@property (nonatomic) CGFloat staleDistanceToViewport;
+
 /**
  The image request timeout interval in seconds. Default is 15.
  */
@@ -275,6 +481,16 @@ typedef void (^YYWebImageCompletionBlock)(UIImage * _Nullable image,
  */
 - (NSString *)cacheKeyForURL:(NSURL *)url;
 
+/**
+ Returns the cache key of the image transformed by a transformer for a specified URL.
+ 
+ @param url          A specified URL.
+ @param transformer  A transformer, pass nil to get the key of the original image.
+ @param maxPixelSize The max pixel size of the decoded image before transform, 0 means no limit.
+ @return Cache key used in YYImageCache.
+ */
+- (NSString *)cacheKeyForURL:(NSURL *)url transformer:(nullable YYWebImageTransformer *)transformer maxPixelSize:(NSUInteger)maxPixelSize;
+
 @end
 
 NS_ASSUME_NONNULL_END
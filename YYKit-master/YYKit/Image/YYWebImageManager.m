@@ -13,8 +13,544 @@
 #import "YYImageCache.h"
 #import "YYWebImageOperation.h"
 #import "YYImageCoder.h"
+#import "YYCGUtilities.h"
+#import "YYKitMacro.h"
+#import "UIColor+YYAdd.h"
+#import <Accelerate/Accelerate.h>
 
-@implementation YYWebImageManager
+
+@class _YYWebImageRenderPass;
+
+@interface YYWebImageTransformer ()
+- (instancetype)initWithIdentifier:(NSString *)identifier;
+@end
+
+/// Transformers which can be fused into a render pass.
+@interface _YYWebImageRenderTransformer : YYWebImageTransformer
+/// Adds the step to the pass, returns NO if it can not be fused into the pass.
+- (BOOL)addToRenderPass:(_YYWebImageRenderPass *)pass;
+@end
+
+@interface _YYWebImageResizeTransformer : _YYWebImageRenderTransformer {
+    @package
+    CGSize _size;
+    UIViewContentMode _contentMode;
+}
+@end
+
+@interface _YYWebImageRoundCornerTransformer : _YYWebImageRenderTransformer {
+    @package
+    CGFloat _radius;
+    CGFloat _borderWidth;
+    UIColor *_borderColor;
+}
+@end
+
+@interface _YYWebImageBlurTransformer : _YYWebImageRenderTransformer {
+    @package
+    CGFloat _radius;
+}
+@end
+
+@interface _YYWebImageBlockTransformer : YYWebImageTransformer {
+    @package
+    YYWebImageTransformBlock _block;
+}
+@end
+
+@interface _YYWebImagePipelineTransformer : YYWebImageTransformer {
+    @package
+    NSArray *_transformers; ///< Array<YYWebImageTransformer>, no pipeline in it
+}
+@end
+
+
+/**
+ Consecutive resize, round corner and blur steps rendered in one bitmap:
+ the image is drawn at the final size with the clip of the first corner, then 
+ blurred in place, then the corner after the blur is cleared in place.
+ */
+@interface _YYWebImageRenderPass : NSObject {
+    @package
+    CGSize _size;           ///< canvas size (in points)
+    CGRect _imageRect;      ///< where the image is drawn
+    CGRect _clipRect;       ///< the canvas of the resize steps
+    _YYWebImageRoundCornerTransformer *_corner;     ///< applied when drawing the image
+    CGFloat _blurRadius;
+    _YYWebImageRoundCornerTransformer *_blurCorner; ///< applied after blur
+}
+- (instancetype)initWithImageSize:(CGSize)size;
+- (UIImage *)renderImage:(UIImage *)image;
+@end
+
+@implementation _YYWebImageRenderPass
+
+- (instancetype)initWithImageSize:(CGSize)size {
+    self = [super init];
+    _size = size;
+    _imageRect = (CGRect){CGPointZero, size};
+    _clipRect = _imageRect;
+    return self;
+}
+
+/// Returns the clip path of a round corner step, or nil if nothing is visible.
+static UIBezierPath *_YYRoundCornerClipPath(_YYWebImageRoundCornerTransformer *corner, CGRect rect) {
+    CGFloat minSize = MIN(rect.size.width, rect.size.height);
+    if (corner->_borderWidth >= minSize / 2) return nil;
+    UIBezierPath *path = [UIBezierPath bezierPathWithRoundedRect:CGRectInset(rect, corner->_borderWidth, corner->_borderWidth) byRoundingCorners:UIRectCornerAllCorners cornerRadii:CGSizeMake(corner->_radius, corner->_borderWidth)];
+    [path closePath];
+    return path;
+}
+
+/// Strokes the border of a round corner step in current context.
+static void _YYRoundCornerStrokeBorder(_YYWebImageRoundCornerTransformer *corner, CGRect rect, CGFloat scale) {
+    CGFloat borderWidth = corner->_borderWidth;
+    CGFloat minSize = MIN(rect.size.width, rect.size.height);
+    if (!corner->_borderColor || borderWidth <= 0 || borderWidth >= minSize / 2) return;
+    CGFloat strokeInset = (floor(borderWidth * scale) + 0.5) / scale;
+    CGRect strokeRect = CGRectInset(rect, strokeInset, strokeInset);
+    CGFloat strokeRadius = corner->_radius > scale / 2 ? corner->_radius - scale / 2 : 0;
+    UIBezierPath *path = [UIBezierPath bezierPathWithRoundedRect:strokeRect byRoundingCorners:UIRectCornerAllCorners cornerRadii:CGSizeMake(strokeRadius, borderWidth)];
+    [path closePath];
+    path.lineWidth = borderWidth;
+    [corner->_borderColor setStroke];
+    [path stroke];
+}
+
+- (UIImage *)renderImage:(UIImage *)image {
+    if (!image.CGImage) return nil;
+    CGFloat scale = image.scale;
+    size_t width = (size_t)ceil(_size.width * scale);
+    size_t height = (size_t)ceil(_size.height * scale);
+    if (width == 0 || height == 0) return nil;
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, YYCGColorSpaceGetDeviceRGB(), kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    if (!context) return nil;
+    CGRect rect = (CGRect){CGPointZero, _size};
+    
+    // 使用UIKit坐标系（单位为点）绘制
+    CGContextTranslateCTM(context, 0, height);
+    CGContextScaleCTM(context, scale, -scale);
+    UIGraphicsPushContext(context);
+    CGContextClearRect(context, rect);
+    CGContextSaveGState(context);
+    CGContextClipToRect(context, _clipRect);
+    UIBezierPath *clipPath = _corner ? _YYRoundCornerClipPath(_corner, rect) : nil;
+    if (clipPath) [clipPath addClip];
+    if (!_corner || clipPath) [image drawInRect:_imageRect];
+    CGContextRestoreGState(context);
+    if (_corner) _YYRoundCornerStrokeBorder(_corner, rect, scale);
+    UIGraphicsPopContext();
+    
+    // 在位图中直接模糊，不创建中间图片
+    if (_blurRadius > __FLT_EPSILON__) {
+        vImage_Buffer effect, scratch;
+        effect.data = CGBitmapContextGetData(context);
+        effect.width = CGBitmapContextGetWidth(context);
+        effect.height = CGBitmapContextGetHeight(context);
+        effect.rowBytes = CGBitmapContextGetBytesPerRow(context);
+        scratch = effect;
+        scratch.data = malloc(effect.rowBytes * effect.height);
+        if (effect.data && scratch.data) {
+            // same as -[UIImage imageByBlurRadius:...], three box blurs approximate the Gaussian blur
+            CGFloat inputRadius = _blurRadius * scale;
+            if (inputRadius - 2.0 < __FLT_EPSILON__) inputRadius = 2.0;
+            uint32_t radius = floor((inputRadius * 3.0 * sqrt(2 * M_PI) / 4 + 0.5) / 2);
+            radius |= 1;
+            int iterations;
+            if (_blurRadius * scale < 0.5) iterations = 1;
+            else if (_blurRadius * scale < 1.5) iterations = 2;
+            else iterations = 3;
+            vImage_Buffer *input = &effect, *output = &scratch;
+            vImage_Error tempSize = vImageBoxConvolve_ARGB8888(input, output, NULL, 0, 0, radius, radius, NULL, kvImageGetTempBufferSize | kvImageEdgeExtend);
+            void *temp = tempSize > 0 ? malloc(tempSize) : NULL;
+            for (int i = 0; i < iterations; i++) {
+                vImageBoxConvolve_ARGB8888(input, output, temp, 0, 0, radius, radius, NULL, kvImageEdgeExtend);
+                YY_SWAP(input, output);
+            }
+            if (temp) free(temp);
+            if (input != &effect) memcpy(effect.data, scratch.data, effect.rowBytes * effect.height);
+        }
+        if (scratch.data) free(scratch.data);
+    }
+    
+    // 模糊之后的圆角：直接清除圆角外的像素，不需要再绘制一次
+    if (_blurCorner) {
+        UIGraphicsPushContext(context);
+        UIBezierPath *path = _YYRoundCornerClipPath(_blurCorner, rect);
+        CGContextSaveGState(context);
+        CGContextSetBlendMode(context, kCGBlendModeClear);
+        if (path) {
+            CGContextAddRect(context, rect);
+            CGContextAddPath(context, path.CGPath);
+            CGContextEOFillPath(context);
+        } else {
+            CGContextFillRect(context, rect);
+        }
+        CGContextRestoreGState(context);
+        _YYRoundCornerStrokeBorder(_blurCorner, rect, scale);
+        UIGraphicsPopContext();
+    }
+    
+    CGImageRef imageRef = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!imageRef) return nil;
+    UIImage *result = [UIImage imageWithCGImage:imageRef scale:scale orientation:UIImageOrientationUp];
+    CGImageRelease(imageRef);
+    result.isDecodedForDisplay = YES;
+    return result;
+}
+
+@end
+
+
+@implementation YYWebImageTransformer
+
+- (instancetype)initWithIdentifier:(NSString *)identifier {
+    self = [super init];
+    _identifier = identifier.copy;
+    return self;
+}
+
++ (instancetype)transformerWithIdentifier:(NSString *)identifier block:(YYWebImageTransformBlock)block {
+    if (identifier.length == 0 || !block) return nil;
+    _YYWebImageBlockTransformer *transformer = [[_YYWebImageBlockTransformer alloc] initWithIdentifier:identifier];
+    transformer->_block = [block copy];
+    return transformer;
+}
+
++ (instancetype)resizeTransformerWithSize:(CGSize)size contentMode:(UIViewContentMode)contentMode {
+    if (size.width <= 0 || size.height <= 0) return nil;
+    NSString *identifier = [NSString stringWithFormat:@"resize(%.2fx%.2f,%ld)", size.width, size.height, (long)contentMode];
+    _YYWebImageResizeTransformer *transformer = [[_YYWebImageResizeTransformer alloc] initWithIdentifier:identifier];
+    transformer->_size = size;
+    transformer->_contentMode = contentMode;
+    return transformer;
+}
+
++ (instancetype)roundCornerTransformerWithRadius:(CGFloat)radius borderWidth:(CGFloat)borderWidth borderColor:(UIColor *)borderColor {
+    NSString *color = borderColor ? [borderColor hexStringWithAlpha] : @"none";
+    NSString *identifier = [NSString stringWithFormat:@"corner(%.2f,%.2f,%@)", radius, borderWidth, color];
+    _YYWebImageRoundCornerTransformer *transformer = [[_YYWebImageRoundCornerTransformer alloc] initWithIdentifier:identifier];
+    transformer->_radius = radius;
+    transformer->_borderWidth = borderWidth;
+    transformer->_borderColor = borderColor;
+    return transformer;
+}
+
++ (instancetype)blurTransformerWithRadius:(CGFloat)radius {
+    if (radius <= 0) return nil;
+    NSString *identifier = [NSString stringWithFormat:@"blur(%.2f)", radius];
+    _YYWebImageBlurTransformer *transformer = [[_YYWebImageBlurTransformer alloc] initWithIdentifier:identifier];
+    transformer->_radius = radius;
+    return transformer;
+}
+
++ (instancetype)transformerWithTransformers:(NSArray<YYWebImageTransformer *> *)transformers {
+    NSMutableArray *steps = [NSMutableArray new];
+    for (YYWebImageTransformer *transformer in transformers) {
+        if ([transformer isKindOfClass:[_YYWebImagePipelineTransformer class]]) {
+            [steps addObjectsFromArray:((_YYWebImagePipelineTransformer *)transformer)->_transformers];
+        } else if ([transformer isKindOfClass:[YYWebImageTransformer class]]) {
+            [steps addObject:transformer];
+        }
+    }
+    if (steps.count == 0) return nil;
+    if (steps.count == 1) return steps.firstObject;
+    NSString *identifier = [[steps valueForKey:@"identifier"] componentsJoinedByString:@"|"];
+    _YYWebImagePipelineTransformer *transformer = [[_YYWebImagePipelineTransformer alloc] initWithIdentifier:identifier];
+    transformer->_transformers = steps.copy;
+    return transformer;
+}
+
+- (YYWebImageTransformer *)transformerByAppendingTransformer:(YYWebImageTransformer *)transformer {
+    if (!transformer) return self;
+    return [YYWebImageTransformer transformerWithTransformers:@[self, transformer]];
+}
+
+- (UIImage *)transformImage:(UIImage *)image url:(NSURL *)url {
+    return image;
+}
+
+- (NSString *)cacheKeyForKey:(NSString *)key maxPixelSize:(NSUInteger)maxPixelSize {
+    // 派生的key包含变换的标识和原图解码的尺寸
+    NSString *transformedKey = [key stringByAppendingFormat:@"#yy_transform=%@", _identifier];
+    if (maxPixelSize == 0) return transformedKey;
+    return [transformedKey stringByAppendingFormat:@"#yy_max_px=%lu", (unsigned long)maxPixelSize];
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p, %@>", self.class, self, _identifier];
+}
+
+@end
+
+
+@implementation _YYWebImageRenderTransformer
+
+- (BOOL)addToRenderPass:(_YYWebImageRenderPass *)pass {
+    return NO;
+}
+
+- (UIImage *)transformImage:(UIImage *)image url:(NSURL *)url {
+    if (!image) return nil;
+    _YYWebImageRenderPass *pass = [[_YYWebImageRenderPass alloc] initWithImageSize:image.size];
+    [self addToRenderPass:pass];
+    return [pass renderImage:image];
+}
+
+@end
+
+@implementation _YYWebImageResizeTransformer
+
+- (BOOL)addToRenderPass:(_YYWebImageRenderPass *)pass {
+    if (pass->_corner || pass->_blurRadius > 0 || pass->_blurCorner) return NO;
+    // 连续的缩放合并为一次绘制：把之前的画布按内容模式映射到新的画布中
+    CGRect fit = YYCGRectFitWithContentMode((CGRect){CGPointZero, _size}, pass->_size, _contentMode);
+    CGFloat sx = fit.size.width / pass->_size.width;
+    CGFloat sy = fit.size.height / pass->_size.height;
+    CGRect (^map)(CGRect) = ^(CGRect r) {
+        return CGRectMake(fit.origin.x + r.origin.x * sx, fit.origin.y + r.origin.y * sy, r.size.width * sx, r.size.height * sy);
+    };
+    pass->_imageRect = map(pass->_imageRect);
+    pass->_clipRect = map(pass->_clipRect);
+    pass->_size = _size;
+    return YES;
+}
+
+@end
+
+@implementation _YYWebImageRoundCornerTransformer
+
+- (BOOL)addToRenderPass:(_YYWebImageRenderPass *)pass {
+    if (pass->_blurRadius > 0) {
+        if (pass->_blurCorner) return NO;
+        pass->_blurCorner = self;
+    } else {
+        if (pass->_corner) return NO;
+        pass->_corner = self;
+    }
+    return YES;
+}
+
+@end
+
+@implementation _YYWebImageBlurTransformer
+
+- (BOOL)addToRenderPass:(_YYWebImageRenderPass *)pass {
+    if (pass->_blurRadius > 0 || pass->_blurCorner) return NO;
+    pass->_blurRadius = _radius;
+    return YES;
+}
+
+@end
+
+@implementation _YYWebImageBlockTransformer
+
+- (UIImage *)transformImage:(UIImage *)image url:(NSURL *)url {
+    if (!image) return nil;
+    return _block(image, url);
+}
+
+@end
+
+@implementation _YYWebImagePipelineTransformer
+
+- (UIImage *)transformImage:(UIImage *)image url:(NSURL *)url {
+    _YYWebImageRenderPass *pass = nil;
+    for (YYWebImageTransformer *transformer in _transformers) {
+        if (!image) return nil;
+        if (![transformer isKindOfClass:[_YYWebImageRenderTransformer class]]) {
+            if (pass) image = [pass renderImage:image];
+            pass = nil;
+            if (image) image = [transformer transformImage:image url:url];
+            continue;
+        }
+        _YYWebImageRenderTransformer *step = (id)transformer;
+        if (!pass) pass = [[_YYWebImageRenderPass alloc] initWithImageSize:image.size];
+        if (![step addToRenderPass:pass]) {
+            image = [pass renderImage:image];
+            if (!image) return nil;
+            pass = [[_YYWebImageRenderPass alloc] initWithImageSize:image.size];
+            [step addToRenderPass:pass];
+        }
+    }
+    if (pass && image) image = [pass renderImage:image];
+    return image;
+}
+
+@end
+
+
+@class _YYWebImageCoalescedOperation;
+
+/// The requests sharing one image operation.
+@interface _YYWebImageRequestGroup : NSObject
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, strong) YYWebImageOperation *operation; ///< the shared work
+@property (nonatomic, strong) NSMutableArray *subscribers;    ///< Array<_YYWebImageCoalescedOperation>
+@end
+
+@implementation _YYWebImageRequestGroup
+@end
+
+
+@interface YYWebImageManager ()
+- (void)_cancelSubscriber:(_YYWebImageCoalescedOperation *)subscriber;
+@end
+
+
+@interface YYWebImageOperation (YYWebImageManager)
+- (instancetype)_initForwardingWithRequest:(NSURLRequest *)request
+                                   options:(YYWebImageOptions)options
+                                     cache:(YYImageCache *)cache
+                                  cacheKey:(NSString *)cacheKey;
+@end
+
+
+/**
+ The operation returned to a caller when requests are coalesced. It does no work
+ itself, the shared operation of its group forwards progress and result to it.
+ */
+@interface _YYWebImageCoalescedOperation : YYWebImageOperation
+@property (nonatomic, strong) _YYWebImageRequestGroup *group;
+- (instancetype)initWithRequest:(NSURLRequest *)request
+                        options:(YYWebImageOptions)options
+                          cache:(YYImageCache *)cache
+                       cacheKey:(NSString *)cacheKey
+                       progress:(YYWebImageProgressBlock)progress
+                     completion:(YYWebImageCompletionBlock)completion
+                        manager:(YYWebImageManager *)manager;
+- (void)_receiveProgress:(NSInteger)receivedSize expectedSize:(NSInteger)expectedSize;
+- (void)_receiveImage:(UIImage *)image url:(NSURL *)url from:(YYWebImageFromType)from stage:(YYWebImageStage)stage error:(NSError *)error;
+@end
+
+@implementation _YYWebImageCoalescedOperation {
+    NSRecursiveLock *_stateLock;
+    BOOL _coalescedExecuting;
+    BOOL _coalescedFinished;
+    BOOL _coalescedCancelled;
+    YYWebImageProgressBlock _subscriberProgress;
+    YYWebImageCompletionBlock _subscriberCompletion;
+    __weak YYWebImageManager *_manager;
+}
+
+- (instancetype)initWithRequest:(NSURLRequest *)request
+                        options:(YYWebImageOptions)options
+                          cache:(YYImageCache *)cache
+                       cacheKey:(NSString *)cacheKey
+                       progress:(YYWebImageProgressBlock)progress
+                     completion:(YYWebImageCompletionBlock)completion
+                        manager:(YYWebImageManager *)manager {
+    // the blocks are kept by subclass, the super class never loads anything
+    self = [super _initForwardingWithRequest:request options:options cache:cache cacheKey:cacheKey];
+    if (!self) return nil;
+    _stateLock = [NSRecursiveLock new];
+    _subscriberProgress = [progress copy];
+    _subscriberCompletion = [completion copy];
+    _manager = manager;
+    return self;
+}
+
+- (void)_setExecuting:(BOOL)executing finished:(BOOL)finished {
+    if (_coalescedExecuting != executing) {
+        [self willChangeValueForKey:@"isExecuting"];
+        _coalescedExecuting = executing;
+        [self didChangeValueForKey:@"isExecuting"];
+    }
+    if (_coalescedFinished != finished) {
+        [self willChangeValueForKey:@"isFinished"];
+        _coalescedFinished = finished;
+        [self didChangeValueForKey:@"isFinished"];
+    }
+}
+
+- (void)_receiveProgress:(NSInteger)receivedSize expectedSize:(NSInteger)expectedSize {
+    [_stateLock lock];
+    if (_coalescedExecuting && _subscriberProgress) _subscriberProgress(receivedSize, expectedSize);
+    [_stateLock unlock];
+}
+
+- (void)_receiveImage:(UIImage *)image url:(NSURL *)url from:(YYWebImageFromType)from stage:(YYWebImageStage)stage error:(NSError *)error {
+    [_stateLock lock];
+    if (_coalescedExecuting) {
+        if (_subscriberCompletion) _subscriberCompletion(image, url, from, stage, error);
+        if (stage != YYWebImageStageProgress) {
+            [self _setExecuting:NO finished:YES];
+            _group = nil;
+        }
+    }
+    [_stateLock unlock];
+}
+
+- (void)start {
+    [_stateLock lock];
+    if (!_coalescedFinished && !_coalescedExecuting) {
+        [self _setExecuting:!_coalescedCancelled finished:_coalescedCancelled];
+    }
+    [_stateLock unlock];
+}
+
+- (void)cancel {
+    [_stateLock lock];
+    BOOL shouldNotify = NO;
+    if (!_coalescedCancelled) {
+        [self willChangeValueForKey:@"isCancelled"];
+        _coalescedCancelled = YES;
+        [self didChangeValueForKey:@"isCancelled"];
+        shouldNotify = _coalescedExecuting;
+        if (_coalescedExecuting) [self _setExecuting:NO finished:YES];
+    }
+    [_stateLock unlock];
+    if (!shouldNotify) return;
+    
+    [_manager _cancelSubscriber:self];
+    _group = nil;
+    YYWebImageCompletionBlock completion = _subscriberCompletion;
+    NSURL *url = self.request.URL;
+    if (completion) {
+        // same as YYWebImageOperation, the cancelled stage is delivered asynchronously
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            completion(nil, url, YYWebImageFromNone, YYWebImageStageCancelled, nil);
+        });
+    }
+}
+
+- (BOOL)isExecuting {
+    [_stateLock lock];
+    BOOL executing = _coalescedExecuting;
+    [_stateLock unlock];
+    return executing;
+}
+
+- (BOOL)isFinished {
+    [_stateLock lock];
+    BOOL finished = _coalescedFinished;
+    [_stateLock unlock];
+    return finished;
+}
+
+- (BOOL)isCancelled {
+    [_stateLock lock];
+    BOOL cancelled = _coalescedCancelled;
+    [_stateLock unlock];
+    return cancelled;
+}
+
+- (BOOL)isConcurrent {
+    return YES;
+}
+
+- (BOOL)isAsynchronous {
+    return YES;
+}
+
+@end
+
+
+@implementation YYWebImageManager {
+    NSMutableDictionary *_requestGroups; ///< Dictionary<key, _YYWebImageRequestGroup>
+    dispatch_semaphore_t _requestGroupsLock;
+}
 
 + (instancetype)sharedManager {
     static YYWebImageManager *manager;
@@ -22,6 +558,8 @@
     dispatch_once(&onceToken, ^{
         YYImageCache *cache = [YYImageCache sharedCache];
         NSOperationQueue *queue = [NSOperationQueue new];
+        // 限制并发数，等待中的操作才会按queuePriority的顺序开始
+        queue.maxConcurrentOperationCount = 6;
         if ([queue respondsToSelector:@selector(setQualityOfService:)]) {
             queue.qualityOfService = NSQualityOfServiceBackground;
         }
@@ -41,6 +579,10 @@
     _cache = cache;
     _queue = queue;
     _timeout = 15.0;
+    _coalescesRequests = YES;
+    _staleDistanceToViewport = 3;
+    _requestGroups = [NSMutableDictionary new];
+    _requestGroupsLock = dispatch_semaphore_create(1);
     if (YYImageWebPAvailable()) {
         _headers = @{ @"Accept" : @"image/webp,image/*;q=0.8" };
     } else {
@@ -54,6 +596,40 @@
                                     progress:(YYWebImageProgressBlock)progress
                                    transform:(YYWebImageTransformBlock)transform
                                   completion:(YYWebImageCompletionBlock)completion {
+    return [self requestImageWithURL:url
+                             options:options
+                        maxPixelSize:0
+                            progress:progress
+                           transform:transform
+                          completion:completion];
+}
+
+- (YYWebImageOperation *)requestImageWithURL:(NSURL *)url
+                                     options:(YYWebImageOptions)options
+                                maxPixelSize:(NSUInteger)maxPixelSize
+                                    progress:(YYWebImageProgressBlock)progress
+                                   transform:(YYWebImageTransformBlock)transform
+                                  completion:(YYWebImageCompletionBlock)completion {
+    if (!transform) transform = _sharedTransformBlock;
+    return [self _requestImageWithURL:url options:options maxPixelSize:maxPixelSize progress:progress transform:transform transformer:nil completion:completion];
+}
+
+- (YYWebImageOperation *)requestImageWithURL:(NSURL *)url
+                                     options:(YYWebImageOptions)options
+                                maxPixelSize:(NSUInteger)maxPixelSize
+                                    progress:(YYWebImageProgressBlock)progress
+                                 transformer:(YYWebImageTransformer *)transformer
+                                  completion:(YYWebImageCompletionBlock)completion {
+    return [self _requestImageWithURL:url options:options maxPixelSize:maxPixelSize progress:progress transform:nil transformer:transformer completion:completion];
+}
+
+- (YYWebImageOperation *)_requestImageWithURL:(NSURL *)url
+                                      options:(YYWebImageOptions)options
+                                 maxPixelSize:(NSUInteger)maxPixelSize
+                                     progress:(YYWebImageProgressBlock)progress
+                                    transform:(YYWebImageTransformBlock)transform
+                                  transformer:(YYWebImageTransformer *)transformer
+                                   completion:(YYWebImageCompletionBlock)completion {
     
     NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
     request.timeoutInterval = _timeout;
@@ -62,29 +638,167 @@
     request.HTTPShouldUsePipelining = YES;
     request.cachePolicy = (options & YYWebImageOptionUseNSURLCache) ?
         NSURLRequestUseProtocolCachePolicy : NSURLRequestReloadIgnoringLocalCacheData;
+    NSString *cacheKey = [self cacheKeyForURL:url];
+    
+    // transform block没有可比较的标识，带transform block的请求不合并
+    if (!_coalescesRequests || !url || transform) {
+        YYWebImageOperation *operation = [self _newOperationWithRequest:request options:options cacheKey:cacheKey maxPixelSize:maxPixelSize progress:progress transform:transform transformer:transformer completion:completion];
+        [self _startOperation:operation];
+        return operation;
+    }
+    
+    // 相同缓存键、选项、缩小尺寸和变换器标识的请求共享一个操作
+    NSString *groupKey = [NSString stringWithFormat:@"%@|%lu|%lu|%@", cacheKey ? cacheKey : url.absoluteString,
+                          (unsigned long)options, (unsigned long)maxPixelSize, transformer ? transformer.identifier : @""];
+    _YYWebImageCoalescedOperation *subscriber = [[_YYWebImageCoalescedOperation alloc] initWithRequest:request options:options cache:_cache cacheKey:cacheKey progress:progress completion:completion manager:self];
+    if (!subscriber) return nil;
+    subscriber.maxPixelSize = maxPixelSize;
+    
+    YYWebImageOperation *sharedOperation = nil;
+    dispatch_semaphore_wait(_requestGroupsLock, DISPATCH_TIME_FOREVER);
+    _YYWebImageRequestGroup *group = _requestGroups[groupKey];
+    if (!group) {
+        group = [_YYWebImageRequestGroup new];
+        group.key = groupKey;
+        group.subscribers = [NSMutableArray new];
+        __weak typeof(self) _self = self;
+        __weak _YYWebImageRequestGroup *weakGroup = group;
+        sharedOperation = [self _newOperationWithRequest:request options:options cacheKey:cacheKey maxPixelSize:maxPixelSize progress:^(NSInteger receivedSize, NSInteger expectedSize) {
+            [_self _requestGroup:weakGroup didReceiveProgress:receivedSize expectedSize:expectedSize];
+        } transform:transform transformer:transformer completion:^(UIImage *image, NSURL *url, YYWebImageFromType from, YYWebImageStage stage, NSError *error) {
+            [_self _requestGroup:weakGroup didReceiveImage:image url:url from:from stage:stage error:error];
+        }];
+        if (sharedOperation) {
+            group.operation = sharedOperation;
+            _requestGroups[groupKey] = group;
+        }
+    }
+    if (group.operation) {
+        [group.subscribers addObject:subscriber];
+        subscriber.group = group;
+    }
+    dispatch_semaphore_signal(_requestGroupsLock);
+    if (!subscriber.group) return nil;
+    
+    [subscriber start];
+    if (sharedOperation) [self _startOperation:sharedOperation];
+    return subscriber;
+}
+
++ (NSOperationQueuePriority)queuePriorityForVisible:(BOOL)visible distanceToViewport:(CGFloat)distance {
+    if (visible) return NSOperationQueuePriorityVeryHigh;
+    if (distance <= 0.5) return NSOperationQueuePriorityHigh;
+    if (distance <= 1.5) return NSOperationQueuePriorityNormal;
+    if (distance <= 3) return NSOperationQueuePriorityLow;
+    return NSOperationQueuePriorityVeryLow;
+}
+
+- (BOOL)updateOperation:(YYWebImageOperation *)operation visible:(BOOL)visible distanceToViewport:(CGFloat)distance {
+    if (!operation || operation.isFinished || operation.isCancelled) return YES;
+    if (!visible && _staleDistanceToViewport > 0 && distance > _staleDistanceToViewport) {
+        [operation cancel];
+        return NO;
+    }
+    NSOperationQueuePriority priority = [self.class queuePriorityForVisible:visible distanceToViewport:distance];
+    if (![operation isKindOfClass:[_YYWebImageCoalescedOperation class]]) {
+        operation.queuePriority = priority;
+        return YES;
+    }
     
+    // 共享操作使用所有请求中最高的优先级
+    _YYWebImageCoalescedOperation *subscriber = (id)operation;
+    subscriber.queuePriority = priority;
+    YYWebImageOperation *sharedOperation = nil;
+    dispatch_semaphore_wait(_requestGroupsLock, DISPATCH_TIME_FOREVER);
+    _YYWebImageRequestGroup *group = subscriber.group;
+    for (_YYWebImageCoalescedOperation *one in group.subscribers) {
+        if (one.queuePriority > priority) priority = one.queuePriority;
+    }
+    sharedOperation = group.operation;
+    dispatch_semaphore_signal(_requestGroupsLock);
+    sharedOperation.queuePriority = priority;
+    return YES;
+}
+
+#pragma mark - Private
+
+- (YYWebImageOperation *)_newOperationWithRequest:(NSURLRequest *)request
+                                          options:(YYWebImageOptions)options
+                                         cacheKey:(NSString *)cacheKey
+                                     maxPixelSize:(NSUInteger)maxPixelSize
+                                         progress:(YYWebImageProgressBlock)progress
+                                        transform:(YYWebImageTransformBlock)transform
+                                      transformer:(YYWebImageTransformer *)transformer
+                                       completion:(YYWebImageCompletionBlock)completion {
     YYWebImageOperation *operation = [[YYWebImageOperation alloc] initWithRequest:request
                                                                           options:options
                                                                             cache:_cache
-                                                                         cacheKey:[self cacheKeyForURL:url]
+                                                                         cacheKey:cacheKey
                                                                          progress:progress
-                                                                        transform:transform ? transform : _sharedTransformBlock
+                                                                        transform:transform
                                                                        completion:completion];
-
+    operation.maxPixelSize = maxPixelSize;
+    operation.transformer = transformer;
     if (_username && _password) {
         operation.credential = [NSURLCredential credentialWithUser:_username password:_password persistence:NSURLCredentialPersistenceForSession];
     }
-    if (operation) {
-        NSOperationQueue *queue = _queue;
-        if (queue) {
-            [queue addOperation:operation];
-        } else {
-            [operation start];
+    return operation;
+}
+
+- (void)_startOperation:(YYWebImageOperation *)operation {
+    if (!operation) return;
+    NSOperationQueue *queue = _queue;
+    if (queue) {
+        [queue addOperation:operation];
+    } else {
+        [operation start];
+    }
+}
+
+// 分发共享操作的进度
+- (void)_requestGroup:(_YYWebImageRequestGroup *)group didReceiveProgress:(NSInteger)receivedSize expectedSize:(NSInteger)expectedSize {
+    if (!group) return;
+    dispatch_semaphore_wait(_requestGroupsLock, DISPATCH_TIME_FOREVER);
+    NSArray *subscribers = group.subscribers.copy;
+    dispatch_semaphore_signal(_requestGroupsLock);
+    for (_YYWebImageCoalescedOperation *subscriber in subscribers) {
+        [subscriber _receiveProgress:receivedSize expectedSize:expectedSize];
+    }
+}
+
+// 分发共享操作的结果，完成后移除请求组
+- (void)_requestGroup:(_YYWebImageRequestGroup *)group didReceiveImage:(UIImage *)image url:(NSURL *)url from:(YYWebImageFromType)from stage:(YYWebImageStage)stage error:(NSError *)error {
+    if (!group) return;
+    dispatch_semaphore_wait(_requestGroupsLock, DISPATCH_TIME_FOREVER);
+    NSArray *subscribers = group.subscribers.copy;
+    if (stage != YYWebImageStageProgress) {
+        if (_requestGroups[group.key] == group) [_requestGroups removeObjectForKey:group.key];
+        [group.subscribers removeAllObjects];
+    }
+    dispatch_semaphore_signal(_requestGroupsLock);
+    for (_YYWebImageCoalescedOperation *subscriber in subscribers) {
+        [subscriber _receiveImage:image url:url from:from stage:stage error:error];
+    }
+}
+
+// 取消一个请求，最后一个请求取消时取消共享操作
+- (void)_cancelSubscriber:(_YYWebImageCoalescedOperation *)subscriber {
+    YYWebImageOperation *operation = nil;
+    dispatch_semaphore_wait(_requestGroupsLock, DISPATCH_TIME_FOREVER);
+    _YYWebImageRequestGroup *group = subscriber.group;
+    if (group && [group.subscribers indexOfObjectIdenticalTo:subscriber] != NSNotFound) {
+        [group.subscribers removeObjectIdenticalTo:subscriber];
+        if (group.subscribers.count == 0) {
+            if (_requestGroups[group.key] == group) [_requestGroups removeObjectForKey:group.key];
+            operation = group.operation;
         }
     }
-    return operation;
+    dispatch_semaphore_signal(_requestGroupsLock);
+    [operation cancel];
 }
 
+#pragma mark - Public
+
 - (NSDictionary *)headersForURL:(NSURL *)url {
     if (!url) return nil;
     return _headersFilter ? _headersFilter(url, _headers) : _headers;
@@ -95,4 +809,10 @@
     return _cacheKeyFilter ? _cacheKeyFilter(url) : url.absoluteString;
 }
 
+- (NSString *)cacheKeyForURL:(NSURL *)url transformer:(YYWebImageTransformer *)transformer maxPixelSize:(NSUInteger)maxPixelSize {
+    NSString *cacheKey = [self cacheKeyForURL:url];
+    if (!cacheKey || !transformer) return cacheKey;
+    return [transformer cacheKeyForKey:cacheKey maxPixelSize:maxPixelSize];
+}
+
 @end
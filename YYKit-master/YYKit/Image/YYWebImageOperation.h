@@ -30,12 +30,22 @@ NS_ASSUME_NONNULL_BEGIN
  operation is started, it will:
  
      1. Get the image from the cache, if exist, return it with `completion` block.
-     2. Start an URL connection to fetch image from the request, invoke the `progress`
+     2. Start an URL session task to fetch image from the request, invoke the `progress`
         to notify request progress (and invoke `completion` block to return the 
         progressive image if enabled by progressive option).
      3. Process the image by invoke the `transform` block.
      4. Put the image to cache and return it with `completion` block.
  
+ All operations share one URL session (HTTP/2 requests to the same host are
+ multiplexed, at most 6 connections per host). The session callbacks of each
+ operation are handled in its own serial queue, and the image decoding (including
+ progressive decoding) always runs in the image decode queues.
+ 
+ When a download is cancelled or fails, the received data is kept in the disk cache
+ (if the response supports byte ranges and has an ETag or Last-Modified validator),
+ the next request for the same image resumes it with an HTTP Range request, and
+ downloads the whole image again if the server ignores the range.
+ 
  */
 @interface YYWebImageOperation : NSOperation
 
@@ -46,22 +56,48 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readonly)                   YYWebImageOptions options;   ///< The operation's option.
 
 /**
- Whether the URL connection should consult the credential storage for authenticating 
- the connection. Default is YES.
+ Whether the URL session task should consult the credential storage for authenticating 
+ the request. Default is YES.
  
- @discussion This is the value that is returned in the `NSURLConnectionDelegate` 
- method `-connectionShouldUseCredentialStorage:`.
+ @discussion When there's no `credential`, the authentication challenge is handled
+ by the session (with the credential storage) if this value is YES, otherwise the
+ request continues without credential.
  */
 @property (nonatomic) BOOL shouldUseCredentialStorage;
 
 /**
- The credential used for authentication challenges in `-connection:didReceiveAuthenticationChallenge:`.
+ The credential used for authentication challenges in `-URLSession:task:didReceiveChallenge:completionHandler:`.
  
  @discussion This will be overridden by any shared credentials that exist for the 
  username or password of the request URL, if present.
  */
 @property (nullable, nonatomic, strong) NSURLCredential *credential;
 
+/**
+ The max pixel size of the decoded image. Default is 0 (decode at full size).
+ 
+ @discussion When the value is not 0, the downloaded (or disk cached) image is 
+ decoded directly at reduced size so that the longer side is not larger than this
+ value. The original image data is still stored in the disk cache, and the 
+ downsampled image is stored in the memory cache with a derived key.
+ You should set this value before the operation starts.
+ 
+ @note 解码图片的最大像素边长，不为0时直接以缩小的尺寸解码，磁盘缓存中仍保存原始数据；需要在操作开始前设置
+ */
+@property (nonatomic) NSUInteger maxPixelSize;
+
+/**
+ The transformer to process the image, used after the `transform` block. Default is nil.
+ 
+ @discussion When the value is not nil, the transformed image is stored in the
+ memory and disk cache with the key derived by `-[YYWebImageTransformer cacheKeyForKey:maxPixelSize:]`,
+ and the original image data is stored in the disk cache with `cacheKey`. 
+ You should set this value before the operation starts.
+ 
+ @note 图片变换器，变换后的图片使用派生的key缓存；需要在操作开始前设置
+ */
+@property (nullable, nonatomic, strong) YYWebImageTransformer *transformer;
+
 /**
  Creates and returns a new operation.
  
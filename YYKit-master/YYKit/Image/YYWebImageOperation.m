@@ -12,10 +12,12 @@
 #import "YYWebImageOperation.h"
 #import "UIApplication+YYAdd.h"
 #import "YYImage.h"
-#import "YYWeakProxy.h"
+#import "YYDiskCache.h"
 #import "UIImage+YYAdd.h"
 #import <ImageIO/ImageIO.h>
 #import "YYKitMacro.h"
+#import <fcntl.h>
+#import <unistd.h>
 
 #if __has_include("YYDispatchQueuePool.h")
 #import "YYDispatchQueuePool.h"
@@ -25,6 +27,9 @@
 
 #define MIN_PROGRESSIVE_TIME_INTERVAL 0.2
 #define MIN_PROGRESSIVE_BLUR_TIME_INTERVAL 0.4
+#define MAX_CONNECTIONS_PER_HOST 6
+#define MIN_DATA_FILE_SIZE (1024 * 64)
+#define MIN_PARTIAL_DATA_SIZE (1024 * 16)
 
 /// Returns YES if the right-bottom pixel is filled.
 // 返回右下角的像素是否被填充了
@@ -44,16 +49,148 @@ static BOOL YYCGImageLastPixelFilled(CGImageRef image) {
     return !isAlpha;
 }
 
-/// Returns JPEG SOS (Start Of Scan) Marker
-static NSData *JPEGSOSMarker() {
-    // "Start Of Scan" Marker
-    static NSData *marker = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        uint8_t bytes[2] = {0xFF, 0xDA};
-        marker = [NSData dataWithBytes:bytes length:2];
-    });
-    return marker;
+/// Returns the URL session task priority (0~1) for an operation queue priority.
+static float YYURLSessionTaskPriority(NSOperationQueuePriority priority) {
+    float value = (priority - NSOperationQueuePriorityVeryLow) / (float)(NSOperationQueuePriorityVeryHigh - NSOperationQueuePriorityVeryLow);
+    return value < 0 ? 0 : value > 1 ? 1 : value;
+}
+
+typedef NS_ENUM(uint8_t, YYJPEGScanState) {
+    YYJPEGScanStateSOI0 = 0, ///< expect 0xFF of SOI
+    YYJPEGScanStateSOI1,     ///< expect 0xD8 of SOI
+    YYJPEGScanStateData,     ///< search 0xFF in entropy coded data
+    YYJPEGScanStateMarker,   ///< the byte after 0xFF
+    YYJPEGScanStateLength0,  ///< high byte of segment length
+    YYJPEGScanStateLength1,  ///< low byte of segment length
+    YYJPEGScanStateSkip,     ///< skip segment payload
+};
+
+/**
+ A streaming JPEG marker scanner, it keeps the state across the received chunks,
+ so every byte is scanned only once. Segment payloads (e.g. EXIF thumbnail) are
+ skipped, so the markers of embedded JPEG are not counted.
+ */
+typedef struct {
+    YYJPEGScanState state;
+    uint8_t marker;       ///< current marker
+    uint8_t lengthHigh;   ///< high byte of current segment length
+    uint8_t frameMarker;  ///< SOFn marker, 0 if not found yet
+    bool notJPEG;         ///< not a JPEG (or broken), stop scanning
+    uint32_t skip;        ///< remaining bytes of current segment payload
+    uint32_t scanCount;   ///< count of SOS (Start Of Scan) marker
+} YYJPEGScanner;
+
+static void YYJPEGScannerFeed(YYJPEGScanner *s, const uint8_t *bytes, size_t length) {
+    const uint8_t *p = bytes, *end = bytes + length;
+    while (p < end && !s->notJPEG) {
+        switch (s->state) {
+            case YYJPEGScanStateSOI0: {
+                if (*p++ != 0xFF) s->notJPEG = true;
+                else s->state = YYJPEGScanStateSOI1;
+            } break;
+            case YYJPEGScanStateSOI1: {
+                if (*p++ != 0xD8) s->notJPEG = true;
+                else s->state = YYJPEGScanStateData;
+            } break;
+            case YYJPEGScanStateData: {
+                const uint8_t *ff = memchr(p, 0xFF, end - p);
+                if (ff) {
+                    p = ff + 1;
+                    s->state = YYJPEGScanStateMarker;
+                } else {
+                    p = end;
+                }
+            } break;
+            case YYJPEGScanStateMarker: {
+                uint8_t marker = *p++;
+                if (marker == 0xFF) break; // fill byte
+                if (marker == 0x00 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) {
+                    s->state = YYJPEGScanStateData; // stuffed byte, TEM, RSTn, SOI, EOI: no payload
+                } else {
+                    s->marker = marker;
+                    s->state = YYJPEGScanStateLength0;
+                }
+            } break;
+            case YYJPEGScanStateLength0: {
+                s->lengthHigh = *p++;
+                s->state = YYJPEGScanStateLength1;
+            } break;
+            case YYJPEGScanStateLength1: {
+                uint32_t segmentLength = ((uint32_t)s->lengthHigh << 8) | *p++;
+                if (segmentLength < 2) {
+                    s->notJPEG = true;
+                    break;
+                }
+                uint8_t marker = s->marker;
+                if (marker == 0xDA) {
+                    s->scanCount++;
+                } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                    if (!s->frameMarker) s->frameMarker = marker; // SOFn (not DHT, JPG, DAC)
+                }
+                s->skip = segmentLength - 2;
+                s->state = s->skip ? YYJPEGScanStateSkip : YYJPEGScanStateData;
+            } break;
+            case YYJPEGScanStateSkip: {
+                size_t n = MIN((size_t)s->skip, (size_t)(end - p));
+                p += n;
+                s->skip -= (uint32_t)n;
+                if (s->skip == 0) s->state = YYJPEGScanStateData;
+            } break;
+        }
+    }
+}
+
+/// Whether the SOFn marker is a progressive frame (SOF2, SOF6, SOF10, SOF14).
+static BOOL YYJPEGFrameMarkerIsProgressive(uint8_t marker) {
+    return marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE;
+}
+
+/// Returns the value of a header field of a response, the field name is case-insensitive.
+static NSString *YYHTTPHeaderValue(NSHTTPURLResponse *response, NSString *field) {
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return nil;
+    if ([response respondsToSelector:@selector(valueForHTTPHeaderField:)]) {
+        return [response valueForHTTPHeaderField:field]; // iOS 13
+    }
+    NSDictionary *headers = response.allHeaderFields;
+    NSString *value = headers[field];
+    if (value) return value;
+    for (NSString *key in headers) {
+        if ([key isKindOfClass:[NSString class]] && [key caseInsensitiveCompare:field] == NSOrderedSame) {
+            return headers[key];
+        }
+    }
+    return nil;
+}
+
+/// Returns the disk cache key of the partial content for an image cache key.
+static NSString *YYWebImagePartialKey(NSString *cacheKey) {
+    return [cacheKey stringByAppendingString:@"#partial"];
+}
+
+/// Returns the validators (ETag, Last-Modified) of a response, or nil if there's none.
+static NSDictionary *YYWebImageResponseValidators(NSURLResponse *response) {
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return nil;
+    NSMutableDictionary *validators = [NSMutableDictionary new];
+    NSString *eTag = YYHTTPHeaderValue((NSHTTPURLResponse *)response, @"ETag");
+    NSString *lastModified = YYHTTPHeaderValue((NSHTTPURLResponse *)response, @"Last-Modified");
+    if (eTag.length) validators[@"ETag"] = eTag;
+    if (lastModified.length) validators[@"Last-Modified"] = lastModified;
+    return validators.count ? validators : nil;
+}
+
+/// Returns the first byte position and the complete length from a "Content-Range: bytes a-b/length" header,
+/// the length is -1 if unknown.
+static BOOL YYParseContentRange(NSString *contentRange, long long *first, long long *length) {
+    if (![contentRange hasPrefix:@"bytes "]) return NO;
+    NSScanner *scanner = [NSScanner scannerWithString:[contentRange substringFromIndex:6]];
+    long long firstByte = 0, lastByte = 0;
+    if (![scanner scanLongLong:&firstByte] || ![scanner scanString:@"-" intoString:NULL] ||
+        ![scanner scanLongLong:&lastByte] || ![scanner scanString:@"/" intoString:NULL]) return NO;
+    long long completeLength = -1;
+    if (![scanner scanLongLong:&completeLength]) completeLength = -1; // "*"
+    *first = firstByte;
+    *length = completeLength;
+    return YES;
 }
 
 // URL黑名单
@@ -89,7 +226,208 @@ static void URLInBlackListAdd(NSURL *url) {
 }
 
 
-@interface YYWebImageOperation() <NSURLConnectionDelegate>
+@interface YYWebImageOperation ()
+- (void)_task:(NSURLSessionTask *)task didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition disposition, NSURLCredential *credential))completionHandler;
+- (void)_task:(NSURLSessionTask *)task didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition disposition))completionHandler;
+- (void)_task:(NSURLSessionTask *)task didReceiveData:(NSData *)data;
+- (void)_task:(NSURLSessionTask *)task willCacheResponse:(NSCachedURLResponse *)cachedResponse completionHandler:(void (^)(NSCachedURLResponse *cachedResponse))completionHandler;
+- (void)_task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error;
+- (dispatch_queue_t)_taskQueue;
+/// For an operation that forwards the result of another operation (a coalesced request),
+/// it never loads anything, so the task queue, lock and decode token are not created.
+- (instancetype)_initForwardingWithRequest:(NSURLRequest *)request
+                                   options:(YYWebImageOptions)options
+                                     cache:(YYImageCache *)cache
+                                  cacheKey:(NSString *)cacheKey NS_DESIGNATED_INITIALIZER;
+@end
+
+
+/**
+ The delegate of the shared image URL session. It only routes the callbacks to
+ the serial queue of each operation, so that different tasks are handled
+ concurrently and the session's delegate queue is never blocked by image work.
+ */
+@interface _YYWebImageSessionRouter : NSObject <NSURLSessionDataDelegate>
+- (void)setOperation:(YYWebImageOperation *)operation forTask:(NSURLSessionTask *)task;
+@end
+
+@implementation _YYWebImageSessionRouter {
+    NSMapTable *_operations; ///< taskIdentifier -> weak YYWebImageOperation
+    dispatch_semaphore_t _lock;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) return nil;
+    _operations = [NSMapTable strongToWeakObjectsMapTable];
+    _lock = dispatch_semaphore_create(1);
+    return self;
+}
+
+- (void)setOperation:(YYWebImageOperation *)operation forTask:(NSURLSessionTask *)task {
+    if (!task) return;
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    if (operation) {
+        [_operations setObject:operation forKey:@(task.taskIdentifier)];
+    } else {
+        [_operations removeObjectForKey:@(task.taskIdentifier)];
+    }
+    dispatch_semaphore_signal(_lock);
+}
+
+- (YYWebImageOperation *)_operationForTask:(NSURLSessionTask *)task {
+    dispatch_semaphore_wait(_lock, DISPATCH_TIME_FOREVER);
+    YYWebImageOperation *operation = [_operations objectForKey:@(task.taskIdentifier)];
+    dispatch_semaphore_signal(_lock);
+    return operation;
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential *))completionHandler {
+    YYWebImageOperation *operation = [self _operationForTask:task];
+    if (!operation) {
+        completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
+        return;
+    }
+    dispatch_async([operation _taskQueue], ^{
+        [operation _task:task didReceiveChallenge:challenge completionHandler:completionHandler];
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    YYWebImageOperation *operation = [self _operationForTask:dataTask];
+    if (!operation) {
+        completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+    dispatch_async([operation _taskQueue], ^{
+        [operation _task:dataTask didReceiveResponse:response completionHandler:completionHandler];
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    YYWebImageOperation *operation = [self _operationForTask:dataTask];
+    if (!operation) return;
+    dispatch_async([operation _taskQueue], ^{
+        [operation _task:dataTask didReceiveData:data];
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask willCacheResponse:(NSCachedURLResponse *)proposedResponse completionHandler:(void (^)(NSCachedURLResponse *))completionHandler {
+    YYWebImageOperation *operation = [self _operationForTask:dataTask];
+    if (!operation) {
+        completionHandler(nil);
+        return;
+    }
+    dispatch_async([operation _taskQueue], ^{
+        [operation _task:dataTask willCacheResponse:proposedResponse completionHandler:completionHandler];
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    YYWebImageOperation *operation = [self _operationForTask:task];
+    [self setOperation:nil forTask:task];
+    if (!operation) return;
+    dispatch_async([operation _taskQueue], ^{
+        [operation _task:task didCompleteWithError:error];
+    });
+}
+
+@end
+
+
+/**
+ The storage of `_YYWebImageDataBuffer`. The bytes are freed when the buffer and
+ all the snapshots of the storage are released.
+ */
+@interface _YYWebImageDataStorage : NSObject {
+@public
+    uint8_t *_bytes;
+    NSUInteger _capacity;
+}
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+@end
+
+@implementation _YYWebImageDataStorage
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (!self) return nil;
+    _bytes = malloc(capacity > 0 ? capacity : 1);
+    if (!_bytes) return nil;
+    _capacity = capacity;
+    return self;
+}
+- (void)dealloc {
+    if (_bytes) free(_bytes);
+}
+@end
+
+/**
+ An append-only buffer of the downloaded bytes.
+ 
+ @discussion The bytes before `length` are never modified, so a snapshot is a
+ no-copy `NSData` over the current storage. The storage grows by doubling, the
+ old storage is kept alive by its snapshots. Not thread-safe, the buffer is used
+ on the task queue of the operation, the snapshots can be read in any thread.
+ 
+ @note 只追加的下载缓存；快照不复制数据，直接引用当前的存储，扩容时旧的存储由快照持有
+ */
+@interface _YYWebImageDataBuffer : NSObject
+@property (nonatomic, readonly) NSUInteger length;
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length;
+- (BOOL)appendData:(NSData *)data;
+- (NSData *)snapshot;
+@end
+
+@implementation _YYWebImageDataBuffer {
+    _YYWebImageDataStorage *_storage;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (!self) return nil;
+    _storage = [[_YYWebImageDataStorage alloc] initWithCapacity:capacity > 0 ? capacity : 16 * 1024];
+    if (!_storage) return nil;
+    return self;
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length {
+    if (length == 0) return YES;
+    if (length > _storage->_capacity - _length) {
+        NSUInteger capacity = _storage->_capacity * 2;
+        if (capacity < _length + length) capacity = _length + length;
+        _YYWebImageDataStorage *storage = [[_YYWebImageDataStorage alloc] initWithCapacity:capacity];
+        if (!storage) return NO;
+        memcpy(storage->_bytes, _storage->_bytes, _length);
+        _storage = storage;
+    }
+    memcpy(_storage->_bytes + _length, bytes, length);
+    _length += length;
+    return YES;
+}
+
+- (BOOL)appendData:(NSData *)data {
+    __block BOOL result = YES;
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        if (![self appendBytes:bytes length:byteRange.length]) {
+            result = NO;
+            *stop = YES;
+        }
+    }];
+    return result;
+}
+
+- (NSData *)snapshot {
+    _YYWebImageDataStorage *storage = _storage;
+    return [[NSData alloc] initWithBytesNoCopy:storage->_bytes length:_length deallocator:^(void *bytes, NSUInteger length) {
+        [storage class]; // hold the storage until the snapshot is released
+    }];
+}
+
+@end
+
+
+@interface YYWebImageOperation()
 // 是否正在运行
 @property (readwrite, getter=isExecuting) BOOL executing;
 // 是否完成了
@@ -100,10 +438,36 @@ static void URLInBlackListAdd(NSURL *url) {
 @property (readwrite, getter=isStarted) BOOL started;
 // 递归锁
 @property (nonatomic, strong) NSRecursiveLock *lock;
-// URL连接
-@property (nonatomic, strong) NSURLConnection *connection;
-// 下载的数据（可变）
-@property (nonatomic, strong) NSMutableData *data;
+// URL会话任务
+@property (nonatomic, strong) NSURLSessionDataTask *task;
+// 处理任务回调的串行队列
+@property (nonatomic, strong) dispatch_queue_t taskQueue;
+#ifdef YYDispatchQueuePool_h
+// 解码任务的取消标记，操作取消后还未开始的解码任务会被跳过
+@property (nonatomic, strong) YYDispatchCancellationToken *decodeToken;
+#endif
+// 下载中的数据（只追加，渐进解码使用它的快照）
+@property (nonatomic, strong) _YYWebImageDataBuffer *dataBuffer;
+// 下载完成的数据
+@property (nonatomic, strong) NSData *data;
+// 直接写入磁盘缓存的下载文件（临时文件），以及文件描述符
+@property (nonatomic, copy) NSString *dataFilePath;
+@property (nonatomic, assign) int dataFile;
+// 下载完成后映射的文件数据
+@property (nonatomic, strong) NSData *fileData;
+// 已接收的数据大小
+@property (nonatomic, assign) NSInteger receivedSize;
+// 断点续传：上次保存的部分数据，以及响应的验证器（ETag或Last-Modified）
+@property (nonatomic, strong) NSData *resumeData;
+@property (nonatomic, copy) NSString *resumeValidator;
+// 断点续传时不带Range的原请求，部分数据过期时用它重新请求
+@property (nonatomic, strong) NSURLRequest *resumeRequest;
+@property (nonatomic, copy) NSString *partialValidator;
+// 条件请求：是否正在使用缓存的验证字段重新验证，以及是否已经验证过（304之后缓存读取失败时不再重复验证）
+@property (nonatomic, assign) BOOL revalidating;
+@property (nonatomic, assign) BOOL revalidated;
+// 下载的图片是否被transform修改过（缓存的不是服务器的原始数据时，不保存验证字段）
+@property (nonatomic, assign) BOOL imageTransformed;
 // 预期的文件大小
 @property (nonatomic, assign) NSInteger expectedSize;
 // 后台任务的id
@@ -117,14 +481,22 @@ static void URLInBlackListAdd(NSURL *url) {
 @property (nonatomic, assign) BOOL progressiveIgnored;
 // 是否渐进式的检测
 @property (nonatomic, assign) BOOL progressiveDetected;
-// 渐进式的扫描长度
-@property (nonatomic, assign) NSUInteger progressiveScanedLength;
+// 渐进式JPEG的流式扫描器
+@property (nonatomic, assign) YYJPEGScanner progressiveScanner;
+// 上次渐进解码时已扫描到的SOS数量
+@property (nonatomic, assign) uint32_t progressiveScanCount;
 // 渐渐式的显示计数
 @property (nonatomic, assign) NSUInteger progressiveDisplayCount;
+// 上次渐进显示时流式解码的行数
+@property (nonatomic, assign) NSUInteger progressiveDecodedRowCount;
+// 是否有渐进解码正在进行（在解码队列中）
+@property (nonatomic, assign) BOOL progressiveDecoding;
 
 // 回调block
 @property (nonatomic, copy) YYWebImageProgressBlock progress;
 @property (nonatomic, copy) YYWebImageTransformBlock transform;
+// 变换后的图片的缓存key（由变换器派生）
+@property (nonatomic, copy) NSString *transformedCacheKey;
 @property (nonatomic, copy) YYWebImageCompletionBlock completion;
 @end
 
@@ -134,35 +506,39 @@ static void URLInBlackListAdd(NSURL *url) {
 @synthesize finished = _finished;
 @synthesize cancelled = _cancelled;
 
-/// Network thread entry point.
-+ (void)_networkThreadMain:(id)object {
-    @autoreleasepool {
-        [[NSThread currentThread] setName:@"com.ibireme.yykit.webimage.request"];
-        NSRunLoop *runLoop = [NSRunLoop currentRunLoop];
-        [runLoop addPort:[NSMachPort port] forMode:NSDefaultRunLoopMode];
-        [runLoop run];
-    }
+/// Global session router, used as the delegate of the image URL session.
++ (_YYWebImageSessionRouter *)_sessionRouter {
+    static _YYWebImageSessionRouter *router = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        router = [_YYWebImageSessionRouter new];
+    });
+    return router;
 }
 
-/// Global image request network thread, used by NSURLConnection delegate.
-+ (NSThread *)_networkThread {
-    static NSThread *thread = nil;
+/// Global image URL session, multiplexes the requests to the same host (HTTP/2).
++ (NSURLSession *)_session {
+    static NSURLSession *session = nil;
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        thread = [[NSThread alloc] initWithTarget:self selector:@selector(_networkThreadMain:) object:nil];
-        if ([thread respondsToSelector:@selector(setQualityOfService:)]) {
-            thread.qualityOfService = NSQualityOfServiceBackground;
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.HTTPMaximumConnectionsPerHost = MAX_CONNECTIONS_PER_HOST;
+        configuration.HTTPShouldUsePipelining = YES;
+        configuration.URLCache = [NSURLCache sharedURLCache];
+        NSOperationQueue *delegateQueue = [NSOperationQueue new];
+        delegateQueue.name = @"com.ibireme.yykit.webimage.session";
+        delegateQueue.maxConcurrentOperationCount = 1; // only routes the callbacks
+        if ([delegateQueue respondsToSelector:@selector(setQualityOfService:)]) {
+            delegateQueue.qualityOfService = NSQualityOfServiceUtility;
         }
-        [thread start];
+        session = [NSURLSession sessionWithConfiguration:configuration delegate:[self _sessionRouter] delegateQueue:delegateQueue];
     });
-    return thread;
+    return session;
 }
 
+#ifndef YYDispatchQueuePool_h
 /// Global image queue, used for image reading and decoding.
 + (dispatch_queue_t)_imageQueue {
-#ifdef YYDispatchQueuePool_h
-    return YYDispatchQueueGetForQOS(NSQualityOfServiceUtility);
-#else
     #define MAX_QUEUE_COUNT 16
     static int queueCount;
     static dispatch_queue_t queues[MAX_QUEUE_COUNT];
@@ -187,6 +563,41 @@ static void URLInBlackListAdd(NSURL *url) {
     if (cur < 0) cur = -cur;
     return queues[(cur) % queueCount];
     #undef MAX_QUEUE_COUNT
+}
+#endif
+
+/// Runs a block for image writing (encoding and disk IO). Not on the decode executor,
+/// a blocked writing would hold one of its workers.
++ (void)_imageAsync:(dispatch_block_t)block {
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.ibireme.yykit.webimage.io", DISPATCH_QUEUE_CONCURRENT);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+    });
+    dispatch_async(queue, block);
+}
+
+/// Runs a block for the partial data reading and writing. The queue is serial, so a partial
+/// content is never removed after a newer one is saved. Blocking IO does not use the decode workers.
++ (void)_partialDataAsync:(dispatch_block_t)block {
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.ibireme.yykit.webimage.partial", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+    });
+    dispatch_async(queue, block);
+}
+
+/// Runs a block for the image decoding of this operation, the block is skipped if the
+/// operation is cancelled before it starts. High priority (visible) requests run first.
+- (void)_decodeAsync:(dispatch_block_t)block {
+#ifdef YYDispatchQueuePool_h
+    NSQualityOfService qos = self.queuePriority >= NSOperationQueuePriorityHigh ? NSQualityOfServiceUserInitiated : NSQualityOfServiceUtility;
+    [[YYDispatchExecutor sharedExecutor] async:qos token:_decodeToken block:block];
+#else
+    dispatch_async([self.class _imageQueue], block);
 #endif
 }
 
@@ -217,11 +628,36 @@ static void URLInBlackListAdd(NSURL *url) {
     _finished = NO;
     _cancelled = NO;
     _taskID = UIBackgroundTaskInvalid;
+    _dataFile = -1;
     _lock = [NSRecursiveLock new];
+    // 每个操作一个串行队列，不同的操作在全局并发队列上并行执行
+    _taskQueue = dispatch_queue_create("com.ibireme.yykit.webimage.request", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(_taskQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+#ifdef YYDispatchQueuePool_h
+    _decodeToken = [YYDispatchCancellationToken new];
+#endif
+    return self;
+}
+
+- (instancetype)_initForwardingWithRequest:(NSURLRequest *)request
+                                   options:(YYWebImageOptions)options
+                                     cache:(YYImageCache *)cache
+                                  cacheKey:(NSString *)cacheKey {
+    self = [super init];
+    if (!self) return nil;
+    if (!request) return nil;
+    _request = request;
+    _options = options;
+    _cache = cache;
+    _cacheKey = cacheKey ? cacheKey : request.URL.absoluteString;
+    _shouldUseCredentialStorage = YES;
+    _taskID = UIBackgroundTaskInvalid;
+    _dataFile = -1;
     return self;
 }
 
 - (void)dealloc {
+    [self _removeDataFile];
     [_lock lock];
     if (_taskID != UIBackgroundTaskInvalid) {
         [[UIApplication sharedExtensionApplication] endBackgroundTask:_taskID];
@@ -230,8 +666,8 @@ static void URLInBlackListAdd(NSURL *url) {
     if ([self isExecuting]) {
         self.cancelled = YES;
         self.finished = YES;
-        if (_connection) {
-            [_connection cancel];
+        if (_task) {
+            [_task cancel];
             if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
                 [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
             }
@@ -254,7 +690,76 @@ static void URLInBlackListAdd(NSURL *url) {
     [_lock unlock];
 }
 
-#pragma mark - Runs in operation thread
+#pragma mark - Runs in operation queue
+
+- (dispatch_queue_t)_taskQueue {
+    return _taskQueue;
+}
+
+// 关闭并删除下载的临时文件
+- (void)_removeDataFile {
+    if (_dataFile >= 0) {
+        close(_dataFile);
+        _dataFile = -1;
+    }
+    if (_dataFilePath) {
+        unlink(_dataFilePath.fileSystemRepresentation);
+        _dataFilePath = nil;
+    }
+    _fileData = nil;
+}
+
+// 取消或失败时保存已经下载的数据，下次请求时使用Range继续下载
+- (void)_savePartialData {
+    NSString *validator = _partialValidator;
+    _partialValidator = nil;
+    _resumeData = nil;
+    if (!validator || !_cache || _receivedSize < MIN_PARTIAL_DATA_SIZE) return;
+    if (_expectedSize > 0 && _receivedSize >= _expectedSize) return;
+    
+    NSDictionary *info = @{@"validator" : validator, @"length" : @(_expectedSize)};
+    NSData *extendedData = [NSKeyedArchiver archivedDataWithRootObject:info];
+    NSString *partialKey = YYWebImagePartialKey(_cacheKey);
+    YYDiskCache *diskCache = _cache.diskCache;
+    if (_dataFile >= 0) {
+        close(_dataFile);
+        _dataFile = -1;
+        NSString *path = _dataFilePath;
+        _dataFilePath = nil; // moved to disk cache
+        [YYWebImageOperation _partialDataAsync:^{
+            [diskCache setObjectWithFileAtPath:path extendedData:extendedData forKey:partialKey];
+        }];
+    } else if (_dataBuffer.length) {
+        NSData *data = [_dataBuffer snapshot];
+        [YYDiskCache setExtendedData:extendedData toObject:data];
+        [YYWebImageOperation _partialDataAsync:^{
+            [diskCache setObject:data forKey:partialKey];
+        }];
+    }
+}
+
+// 将收到的数据追加到临时文件，失败时（比如磁盘已满）改为写入内存
+- (void)_appendDataToFile:(NSData *)data {
+    const uint8_t *bytes = data.bytes;
+    size_t length = data.length, written = 0;
+    while (written < length) {
+        ssize_t result = write(_dataFile, bytes + written, length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += result;
+    }
+    if (written == length) return;
+    
+    close(_dataFile);
+    _dataFile = -1;
+    NSData *fileData = [NSData dataWithContentsOfFile:_dataFilePath];
+    _dataBuffer = [[_YYWebImageDataBuffer alloc] initWithCapacity:(fileData.length + length) * 2];
+    [_dataBuffer appendData:fileData];
+    [_dataBuffer appendBytes:bytes + written length:length - written];
+    [self _removeDataFile];
+}
 
 - (void)_finish {
     self.executing = NO;
@@ -262,15 +767,29 @@ static void URLInBlackListAdd(NSURL *url) {
     [self _endBackgroundTask];
 }
 
-// runs on network thread
+// runs on image queue, transforms the image with the transformer and caches the result with the derived key
+- (UIImage *)_transformImage:(UIImage *)image {
+    UIImage *newImage = [_transformer transformImage:image url:_request.URL];
+    if (newImage && _cache && _transformedCacheKey) {
+        YYImageCacheType cacheType = (_options & YYWebImageOptionIgnoreDiskCache) ? YYImageCacheTypeMemory : YYImageCacheTypeAll;
+        [_cache setImage:newImage imageData:nil forKey:_transformedCacheKey withType:cacheType maxPixelSize:0];
+    }
+    return newImage;
+}
+
+// runs on task queue
 - (void)_startOperation {
     if ([self isCancelled]) return;
     @autoreleasepool {
+        if (_transformer && _cacheKey) _transformedCacheKey = [_transformer cacheKeyForKey:_cacheKey maxPixelSize:_maxPixelSize];
         // get image from cache
         if (_cache &&
             !(_options & YYWebImageOptionUseNSURLCache) &&
             !(_options & YYWebImageOptionRefreshImageCache)) {
-            UIImage *image = [_cache getImageForKey:_cacheKey withType:YYImageCacheTypeMemory];
+            // 有变换器时直接获取变换后的图片
+            UIImage *image = _transformedCacheKey ?
+                [_cache getImageForKey:_transformedCacheKey withType:YYImageCacheTypeMemory maxPixelSize:0] :
+                [_cache getImageForKey:_cacheKey withType:YYImageCacheTypeMemory maxPixelSize:_maxPixelSize];
             if (image) {
                 [_lock lock];
                 if (![self isCancelled]) {
@@ -282,25 +801,40 @@ static void URLInBlackListAdd(NSURL *url) {
             }
             if (!(_options & YYWebImageOptionIgnoreDiskCache)) {
                 __weak typeof(self) _self = self;
-                dispatch_async([self.class _imageQueue], ^{
+                [self _decodeAsync:^{
                     __strong typeof(_self) self = _self;
                     if (!self || [self isCancelled]) return;
-                    UIImage *image = [self.cache getImageForKey:self.cacheKey withType:YYImageCacheTypeDisk];
+                    UIImage *image = nil;
+                    if (self.transformedCacheKey) {
+                        image = [self.cache getImageForKey:self.transformedCacheKey withType:YYImageCacheTypeAll maxPixelSize:0];
+                        if (!image) {
+                            // 没有变换后的缓存时，变换磁盘中的原图，不需要重新下载
+                            image = [self.cache getImageForKey:self.cacheKey withType:YYImageCacheTypeDisk maxPixelSize:self.maxPixelSize];
+                            if (image && self.transform) image = self.transform(image, self.request.URL);
+                            if (image) image = [self _transformImage:image];
+                        }
+                    } else {
+                        image = [self.cache getImageForKey:self.cacheKey withType:YYImageCacheTypeDisk maxPixelSize:self.maxPixelSize];
+                        if (image) [self.cache setImage:image imageData:nil forKey:self.cacheKey withType:YYImageCacheTypeMemory maxPixelSize:self.maxPixelSize];
+                    }
                     if (image) {
-                        [self.cache setImage:image imageData:nil forKey:self.cacheKey withType:YYImageCacheTypeMemory];
-                        [self performSelector:@selector(_didReceiveImageFromDiskCache:) onThread:[self.class _networkThread] withObject:image waitUntilDone:NO];
+                        dispatch_async(self.taskQueue, ^{
+                            [self _didReceiveImageFromDiskCache:image];
+                        });
                     } else {
-                        [self performSelector:@selector(_startRequest:) onThread:[self.class _networkThread] withObject:nil waitUntilDone:NO];
+                        dispatch_async(self.taskQueue, ^{
+                            [self _startRequest:nil];
+                        });
                     }
-                });
+                }];
                 return;
             }
         }
     }
-    [self performSelector:@selector(_startRequest:) onThread:[self.class _networkThread] withObject:nil waitUntilDone:NO];
+    [self _startRequest:nil];
 }
 
-// runs on network thread
+// runs on task queue
 - (void)_startRequest:(id)object {
     if ([self isCancelled]) return;
     @autoreleasepool {
@@ -322,10 +856,73 @@ static void URLInBlackListAdd(NSURL *url) {
             _expectedSize = (fileSize != nil) ? fileSize.unsignedIntegerValue : -1;
         }
         
+        // 刷新缓存时，如果磁盘缓存中保存了验证字段，发送条件请求，服务器返回304时直接使用缓存
+        NSURLRequest *request = _request;
+        _revalidating = NO;
+        if (_cache && (_options & YYWebImageOptionRefreshImageCache) &&
+            !(_options & YYWebImageOptionIgnoreDiskCache) && !_revalidated && !_request.URL.isFileURL) {
+            NSDictionary *validators = [_cache validatorsForKey:_cacheKey];
+            if (validators) {
+                NSMutableURLRequest *conditionalRequest = request.mutableCopy;
+                if (validators[@"ETag"]) [conditionalRequest setValue:validators[@"ETag"] forHTTPHeaderField:@"If-None-Match"];
+                if (validators[@"Last-Modified"]) [conditionalRequest setValue:validators[@"Last-Modified"] forHTTPHeaderField:@"If-Modified-Since"];
+                request = conditionalRequest;
+                _revalidating = YES;
+            }
+        }
+        
+        // 有之前保存的部分数据时，使用Range请求剩余的部分；在IO队列中读取部分数据，不阻塞任务队列
+        if (_cache && !(_options & YYWebImageOptionIgnoreDiskCache) && !_request.URL.isFileURL && !_revalidating) {
+            YYDiskCache *diskCache = _cache.diskCache;
+            NSString *partialKey = YYWebImagePartialKey(_cacheKey);
+            __weak typeof(self) _self = self;
+            [YYWebImageOperation _partialDataAsync:^{
+                __strong typeof(_self) self = _self;
+                if (!self || [self isCancelled]) return;
+                NSData *partialData = (id)[diskCache objectForKey:partialKey];
+                dispatch_async(self.taskQueue, ^{
+                    [self _startTaskWithRequest:request partialData:partialData];
+                });
+            }];
+            return;
+        }
+        [self _startTaskWithRequest:request partialData:nil];
+    }
+}
+
+// runs on task queue
+- (void)_startTaskWithRequest:(NSURLRequest *)request partialData:(NSData *)partialData {
+    if ([self isCancelled]) return;
+    @autoreleasepool {
+        if ([partialData isKindOfClass:[NSData class]] && partialData.length > 0) {
+            NSData *extendedData = [YYDiskCache getExtendedDataFromObject:partialData];
+            NSDictionary *info = nil;
+            @try {
+                info = extendedData ? [NSKeyedUnarchiver unarchiveObjectWithData:extendedData] : nil;
+            } @catch (NSException *exception) {}
+            if (![info isKindOfClass:[NSDictionary class]]) info = nil;
+            NSString *validator = info[@"validator"];
+            NSNumber *length = info[@"length"];
+            if (![validator isKindOfClass:[NSString class]]) validator = nil;
+            long long completeLength = [length isKindOfClass:[NSNumber class]] ? length.longLongValue : 0;
+            if (validator.length && (completeLength <= 0 || partialData.length < completeLength)) {
+                _resumeRequest = request;
+                NSMutableURLRequest *rangeRequest = request.mutableCopy;
+                [rangeRequest setValue:[NSString stringWithFormat:@"bytes=%llu-", (unsigned long long)partialData.length] forHTTPHeaderField:@"Range"];
+                [rangeRequest setValue:validator forHTTPHeaderField:@"If-Range"];
+                request = rangeRequest;
+                _resumeData = partialData;
+                _resumeValidator = validator;
+            }
+        }
+        
         // request image from web
         [_lock lock];
         if (![self isCancelled]) {
-            _connection = [[NSURLConnection alloc] initWithRequest:_request delegate:[YYWeakProxy proxyWithTarget:self]];
+            _task = [[self.class _session] dataTaskWithRequest:request];
+            _task.priority = YYURLSessionTaskPriority(self.queuePriority);
+            [[self.class _sessionRouter] setOperation:self forTask:_task];
+            [_task resume];
             if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
                 [[UIApplication sharedExtensionApplication] incrementNetworkActivityCount];
             }
@@ -334,23 +931,26 @@ static void URLInBlackListAdd(NSURL *url) {
     }
 }
 
-// runs on network thread, called from outer "cancel"
+// runs on task queue, called from outer "cancel"
 - (void)_cancelOperation {
     @autoreleasepool {
-        if (_connection) {
+        if (_task) {
             if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
                 [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
             }
         }
-        [_connection cancel];
-        _connection = nil;
+        [[self.class _sessionRouter] setOperation:nil forTask:_task];
+        [_task cancel];
+        _task = nil;
+        [self _savePartialData];
+        [self _removeDataFile];
         if (_completion) _completion(nil, _request.URL, YYWebImageFromNone, YYWebImageStageCancelled, nil);
         [self _endBackgroundTask];
     }
 }
 
 
-// runs on network thread
+// runs on task queue
 - (void)_didReceiveImageFromDiskCache:(UIImage *)image {
     @autoreleasepool {
         [_lock lock];
@@ -366,21 +966,69 @@ static void URLInBlackListAdd(NSURL *url) {
     }
 }
 
+// runs on task queue, the cached image is still valid (304 Not Modified)
+- (void)_didReceiveNotModifiedResponse {
+    @autoreleasepool {
+        if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
+            [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
+        }
+        [[self.class _sessionRouter] setOperation:nil forTask:_task];
+        _task = nil;
+        _revalidated = YES;
+        // 只更新访问时间，不重写缓存的数据
+        [_cache touchImageForKey:_cacheKey];
+        __weak typeof(self) _self = self;
+        [self _decodeAsync:^{
+            __strong typeof(_self) self = _self;
+            if (!self || [self isCancelled]) return;
+            UIImage *image = nil;
+            // 和新下载的图片一样经过transform和变换器处理（有验证字段的缓存保存的是服务器的原始数据）
+            if (self.transformedCacheKey) {
+                image = [self.cache getImageForKey:self.transformedCacheKey withType:YYImageCacheTypeAll maxPixelSize:0];
+                if (!image) {
+                    image = [self.cache getImageForKey:self.cacheKey withType:YYImageCacheTypeDisk maxPixelSize:self.maxPixelSize];
+                    if (image && self.transform) image = self.transform(image, self.request.URL);
+                    if (image) image = [self _transformImage:image];
+                }
+            } else {
+                image = [self.cache getImageForKey:self.cacheKey withType:YYImageCacheTypeAll maxPixelSize:self.maxPixelSize];
+                if (image && self.transform) image = self.transform(image, self.request.URL);
+            }
+            dispatch_async(self.taskQueue, ^{
+                [self _didReceiveImageFromDiskCache:image];
+            });
+        }];
+    }
+}
+
 - (void)_didReceiveImageFromWeb:(UIImage *)image {
     @autoreleasepool {
         [_lock lock];
         if (![self isCancelled]) {
             if (_cache) {
                 if (image || (_options & YYWebImageOptionRefreshImageCache)) {
+                    // 有变换器时变换后的图片已经用派生的key缓存，这里只在磁盘中保存原始数据
+                    UIImage *originalImage = _transformer ? nil : image;
                     NSData *data = _data;
-                    dispatch_async([YYWebImageOperation _imageQueue], ^{
+                    NSDictionary *validators = _imageTransformed ? nil : YYWebImageResponseValidators(_response);
+                    NSString *dataFilePath = _fileData ? _dataFilePath : nil;
+                    if (dataFilePath) _dataFilePath = nil; // moved to disk cache
+                    [YYWebImageOperation _imageAsync:^{
+                        if (dataFilePath) {
+                            [_cache setImage:originalImage imageDataFileAtPath:dataFilePath validators:validators forKey:_cacheKey maxPixelSize:_maxPixelSize];
+                            return;
+                        }
                         YYImageCacheType cacheType = (_options & YYWebImageOptionIgnoreDiskCache) ? YYImageCacheTypeMemory : YYImageCacheTypeAll;
-                        [_cache setImage:image imageData:data forKey:_cacheKey withType:cacheType];
+                        if (_transformer) cacheType &= ~YYImageCacheTypeMemory;
+                        if (cacheType == YYImageCacheTypeNone) return;
+                        [_cache setImage:originalImage imageData:data validators:validators forKey:_cacheKey withType:cacheType maxPixelSize:_maxPixelSize];
 
-                    });
+                    }];
                 }
             }
             _data = nil;
+            _dataBuffer = nil;
+            [self _removeDataFile];
             NSError *error = nil;
             if (!image) {
                 error = [NSError errorWithDomain:@"com.ibireme.yykit.image" code:-1 userInfo:@{ NSLocalizedDescriptionKey : @"Web image decode fail." }];
@@ -399,48 +1047,87 @@ static void URLInBlackListAdd(NSURL *url) {
     }
 }
 
-#pragma mark - NSURLConnectionDelegate runs in operation thread
+#pragma mark - NSURLSessionDataDelegate runs in task queue
 
-- (BOOL)connectionShouldUseCredentialStorage:(NSURLConnection *)connection {
-    return _shouldUseCredentialStorage;
-}
-
-- (void)connection:(NSURLConnection *)connection willSendRequestForAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge {
+- (void)_task:(NSURLSessionTask *)task didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential *))completionHandler {
     @autoreleasepool {
         if ([challenge.protectionSpace.authenticationMethod isEqualToString:NSURLAuthenticationMethodServerTrust]) {
-            if (!(_options & YYWebImageOptionAllowInvalidSSLCertificates) &&
-                [challenge.sender respondsToSelector:@selector(performDefaultHandlingForAuthenticationChallenge:)]) {
-                [challenge.sender performDefaultHandlingForAuthenticationChallenge:challenge];
+            if (!(_options & YYWebImageOptionAllowInvalidSSLCertificates)) {
+                completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
             } else {
                 NSURLCredential *credential = [NSURLCredential credentialForTrust:challenge.protectionSpace.serverTrust];
-                [[challenge sender] useCredential:credential forAuthenticationChallenge:challenge];
+                completionHandler(NSURLSessionAuthChallengeUseCredential, credential);
             }
         } else {
-            if ([challenge previousFailureCount] == 0) {
-                if (_credential) {
-                    [[challenge sender] useCredential:_credential forAuthenticationChallenge:challenge];
-                } else {
-                    [[challenge sender] continueWithoutCredentialForAuthenticationChallenge:challenge];
-                }
+            if ([challenge previousFailureCount] == 0 && _credential) {
+                completionHandler(NSURLSessionAuthChallengeUseCredential, _credential);
+            } else if ([challenge previousFailureCount] == 0 && _shouldUseCredentialStorage) {
+                // 由会话查询凭证存储
+                completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
             } else {
-                [[challenge sender] continueWithoutCredentialForAuthenticationChallenge:challenge];
+                // continue without credential
+                completionHandler(NSURLSessionAuthChallengeUseCredential, nil);
             }
         }
     }
 }
 
-- (NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse {
-    if (!cachedResponse) return cachedResponse;
+- (void)_task:(NSURLSessionTask *)task willCacheResponse:(NSCachedURLResponse *)cachedResponse completionHandler:(void (^)(NSCachedURLResponse *))completionHandler {
     if (_options & YYWebImageOptionUseNSURLCache) {
-        return cachedResponse;
+        completionHandler(cachedResponse);
     } else {
         // ignore NSURLCache
-        return nil;
+        completionHandler(nil);
     }
 }
 
-- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
+- (void)_task:(NSURLSessionTask *)task didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
     @autoreleasepool {
+        if (task != _task) {
+            completionHandler(NSURLSessionResponseCancel);
+            return;
+        }
+        BOOL revalidating = _revalidating;
+        _revalidating = NO;
+        if (revalidating && [response isKindOfClass:[NSHTTPURLResponse class]] &&
+            ((NSHTTPURLResponse *)response).statusCode == 304) {
+            completionHandler(NSURLSessionResponseCancel);
+            [self _didReceiveNotModifiedResponse];
+            return;
+        }
+        // 断点续传：206并且从保存的位置开始时继续使用保存的数据，服务器忽略Range（200）时重新下载
+        NSData *resumeData = _resumeData;
+        _resumeData = nil;
+        NSURLRequest *resumeRequest = _resumeRequest;
+        _resumeRequest = nil;
+        if (resumeData) {
+            // 不在网络回调中同步访问磁盘
+            YYDiskCache *diskCache = _cache.diskCache;
+            NSString *partialKey = YYWebImagePartialKey(_cacheKey);
+            [YYWebImageOperation _partialDataAsync:^{
+                [diskCache removeObjectForKey:partialKey];
+            }];
+        }
+        long long completeLength = -1;
+        if (resumeData && [response isKindOfClass:[NSHTTPURLResponse class]]) {
+            NSHTTPURLResponse *httpResponse = (id) response;
+            BOOL staleResumeData = NO;
+            if (httpResponse.statusCode == 416) {
+                staleResumeData = YES;
+            } else if (httpResponse.statusCode == 206) {
+                long long firstByte = 0;
+                NSString *contentRange = YYHTTPHeaderValue(httpResponse, @"Content-Range");
+                staleResumeData = !YYParseContentRange(contentRange, &firstByte, &completeLength) || firstByte != resumeData.length;
+            } else {
+                resumeData = nil;
+            }
+            // 保存的部分数据和服务器上的不一致：丢弃部分数据，不带Range重新请求一次，这个响应不算作失败
+            if (staleResumeData) {
+                completionHandler(NSURLSessionResponseCancel);
+                [self _restartTaskWithRequest:resumeRequest];
+                return;
+            }
+        }
         NSError *error = nil;
         if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
             NSHTTPURLResponse *httpResponse = (id) response;
@@ -450,85 +1137,189 @@ static void URLInBlackListAdd(NSURL *url) {
             }
         }
         if (error) {
-            [_connection cancel];
-            [self connection:_connection didFailWithError:error];
+            completionHandler(NSURLSessionResponseCancel);
+            [self _task:task didCompleteWithError:error];
         } else {
+            _response = response;
             if (response.expectedContentLength) {
                 _expectedSize = (NSInteger)response.expectedContentLength;
                 if (_expectedSize < 0) _expectedSize = -1;
             }
-            _data = [NSMutableData dataWithCapacity:_expectedSize > 0 ? _expectedSize : 0];
+            if (resumeData) {
+                _expectedSize = completeLength > 0 ? (NSInteger)completeLength : -1;
+            }
+            _partialValidator = nil;
+            if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+                // 只有支持Range的响应才保存部分数据
+                NSHTTPURLResponse *httpResponse = (id)response;
+                NSString *validator = YYHTTPHeaderValue(httpResponse, @"ETag");
+                if (!validator.length) validator = YYHTTPHeaderValue(httpResponse, @"Last-Modified");
+                NSString *acceptRangesValue = YYHTTPHeaderValue(httpResponse, @"Accept-Ranges");
+                BOOL acceptRanges = resumeData || (acceptRangesValue && [acceptRangesValue caseInsensitiveCompare:@"bytes"] == NSOrderedSame);
+                if (acceptRanges && validator.length) _partialValidator = resumeData ? _resumeValidator : validator;
+            }
+            _receivedSize = 0;
+            [self _removeDataFile];
+            // 较大的图片直接写入磁盘缓存目录中的临时文件，完成后移动到磁盘缓存，解码时映射这个文件，不在内存中保留整个响应
+            if (_cache && !(_options & YYWebImageOptionIgnoreDiskCache) &&
+                (_expectedSize <= 0 || _expectedSize >= MIN_DATA_FILE_SIZE)) {
+                NSString *path = [_cache temporaryImageDataPath];
+                int file = path ? open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+                if (file >= 0) {
+                    _dataFile = file;
+                    _dataFilePath = path;
+                }
+            }
+            _data = nil;
+            _dataBuffer = _dataFile >= 0 ? nil : [[_YYWebImageDataBuffer alloc] initWithCapacity:_expectedSize > 0 ? _expectedSize : 0];
             if (_progress) {
                 [_lock lock];
                 if (![self isCancelled]) _progress(0, _expectedSize);
                 [_lock unlock];
             }
+            completionHandler(NSURLSessionResponseAllow);
+            if (resumeData) [self _task:task didReceiveData:resumeData];
         }
     }
 }
 
-- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
+// 放弃当前的任务，使用新的请求重新开始（部分数据已经删除，新请求不带Range）
+- (void)_restartTaskWithRequest:(NSURLRequest *)request {
+    [_lock lock];
+    BOOL cancelled = [self isCancelled];
+    [[self.class _sessionRouter] setOperation:nil forTask:_task];
+    _task = nil; // the cancelled task's callbacks are ignored
+    if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
+        [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
+    }
+    [_lock unlock];
+    if (cancelled) return;
+    [self _startTaskWithRequest:request ? request : _request partialData:nil];
+}
+
+- (void)_task:(NSURLSessionTask *)task didReceiveData:(NSData *)data {
     @autoreleasepool {
+        if (task != _task) return;
         [_lock lock];
         BOOL canceled = [self isCancelled];
         [_lock unlock];
         if (canceled) return;
         
-        if (data) [_data appendData:data];
+        if (data) {
+            if (_dataFile >= 0) {
+                [self _appendDataToFile:data];
+            } else {
+                [_dataBuffer appendData:data];
+            }
+            _receivedSize += data.length;
+        }
+        BOOL progressive = (_options & YYWebImageOptionProgressive) > 0;
+        BOOL progressiveBlur = (_options & YYWebImageOptionProgressiveBlur) > 0;
+        if (data && progressiveBlur && !_progressiveIgnored) {
+            YYJPEGScannerFeed(&_progressiveScanner, data.bytes, data.length);
+        }
         if (_progress) {
             [_lock lock];
             if (![self isCancelled]) {
-                _progress(_data.length, _expectedSize);
+                _progress(_receivedSize, _expectedSize);
             }
             [_lock unlock];
         }
         
         /*--------------------------- progressive ----------------------------*/
-        BOOL progressive = (_options & YYWebImageOptionProgressive) > 0;
-        BOOL progressiveBlur = (_options & YYWebImageOptionProgressiveBlur) > 0;
         if (!_completion || !(progressive || progressiveBlur)) return;
         if (data.length <= 16) return;
         if (_expectedSize > 0 && data.length >= _expectedSize * 0.99) return;
+        if (_progressiveDecoding) return; // the previous decode is still running
         if (_progressiveIgnored) return;
+        if (progressiveBlur && !_progressiveScanner.notJPEG) {
+            // 渐进式JPEG只在出现新的扫描（SOS）时才解码，基线JPEG直接忽略
+            if (_progressiveScanner.frameMarker && !YYJPEGFrameMarkerIsProgressive(_progressiveScanner.frameMarker)) {
+                _progressiveIgnored = YES;
+                return;
+            }
+            if (_progressiveScanner.scanCount <= _progressiveScanCount) return;
+        }
         
         NSTimeInterval min = progressiveBlur ? MIN_PROGRESSIVE_BLUR_TIME_INTERVAL : MIN_PROGRESSIVE_TIME_INTERVAL;
         NSTimeInterval now = CACurrentMediaTime();
         if (now - _lastProgressiveDecodeTimestamp < min) return;
         
+        // 渐进解码在解码队列中进行，不阻塞网络回调；快照直接引用下载缓存，不复制数据
+        // 同一时间只有一个渐进解码，解码器只在解码任务中使用，解码结果回到任务队列更新状态
+        _progressiveDecoding = YES;
+        _progressiveScanCount = _progressiveScanner.scanCount;
+        NSData *snapshot = nil;
+        if (_dataFile >= 0) {
+            snapshot = [NSData dataWithContentsOfFile:_dataFilePath options:NSDataReadingMappedAlways error:NULL];
+        } else {
+            snapshot = [_dataBuffer snapshot];
+        }
+        if (!snapshot) {
+            _progressiveDecoding = NO;
+            return;
+        }
+        NSInteger expectedSize = _expectedSize;
+        __weak typeof(self) _self = self;
+        [self _decodeAsync:^{
+            __strong typeof(_self) self = _self;
+            if (!self) return;
+            BOOL ignored = NO;
+            UIImage *image = [self _progressiveDecodeData:snapshot progressiveBlur:progressiveBlur expectedSize:expectedSize ignored:&ignored];
+            dispatch_async(self.taskQueue, ^{
+                self.progressiveDecoding = NO;
+                if (ignored) self.progressiveIgnored = YES;
+                if (!image) return;
+                [self.lock lock];
+                if (![self isCancelled] && self.task == task) {
+                    self.completion(image, self.request.URL, YYWebImageFromRemote, YYWebImageStageProgress, nil);
+                    self.lastProgressiveDecodeTimestamp = now;
+                }
+                [self.lock unlock];
+            });
+        }];
+    }
+}
+
+/**
+ Runs in image queue, only one progressive decode runs at the same time (see 
+ `progressiveDecoding`), the decoder and its state are only used here.
+ @param ignored Set to YES if the progressive decoding should be ignored for this image.
+ @return The image to display, or nil if there's nothing new to display.
+ */
+- (UIImage *)_progressiveDecodeData:(NSData *)data progressiveBlur:(BOOL)progressiveBlur expectedSize:(NSInteger)expectedSize ignored:(BOOL *)ignored {
+    @autoreleasepool {
         if (!_progressiveDecoder) {
-            _progressiveDecoder = [[YYImageDecoder alloc] initWithScale:[UIScreen mainScreen].scale];
+            _progressiveDecoder = [[YYImageDecoder alloc] initWithScale:[UIScreen mainScreen].scale maxPixelSize:_maxPixelSize];
         }
-        [_progressiveDecoder updateData:_data final:NO];
-        if ([self isCancelled]) return;
+        [_progressiveDecoder updateData:data final:NO];
+        if ([self isCancelled]) return nil;
         
         if (_progressiveDecoder.type == YYImageTypeUnknown ||
-            _progressiveDecoder.type == YYImageTypeWebP ||
             _progressiveDecoder.type == YYImageTypeOther) {
             _progressiveDecoder = nil;
-            _progressiveIgnored = YES;
-            return;
+            *ignored = YES;
+            return nil;
         }
-        if (progressiveBlur) { // only support progressive JPEG and interlaced PNG
+        if (progressiveBlur) { // only support progressive JPEG and interlaced PNG (WebP is decoded row by row)
             if (_progressiveDecoder.type != YYImageTypeJPEG &&
                 _progressiveDecoder.type != YYImageTypePNG) {
                 _progressiveDecoder = nil;
-                _progressiveIgnored = YES;
-                return;
+                *ignored = YES;
+                return nil;
             }
         }
-        if (_progressiveDecoder.frameCount == 0) return;
+        if (_progressiveDecoder.frameCount == 0) return nil;
         
         if (!progressiveBlur) {
-            YYImageFrame *frame = [_progressiveDecoder frameAtIndex:0 decodeForDisplay:YES];
-            if (frame.image) {
-                [_lock lock];
-                if (![self isCancelled]) {
-                    _completion(frame.image, _request.URL, YYWebImageFromRemote, YYWebImageStageProgress, nil);
-                    _lastProgressiveDecodeTimestamp = now;
-                }
-                [_lock unlock];
+            // 流式解码(WebP/PNG)没有新的行时不需要重新显示
+            NSUInteger decodedRowCount = _progressiveDecoder.decodedRowCount;
+            if (decodedRowCount > 0) {
+                if (decodedRowCount == _progressiveDecodedRowCount) return nil;
+                _progressiveDecodedRowCount = decodedRowCount;
             }
-            return;
+            YYImageFrame *frame = [_progressiveDecoder frameAtIndex:0 decodeForDisplay:YES];
+            return frame.image;
         } else {
             if (_progressiveDecoder.type == YYImageTypeJPEG) {
                 if (!_progressiveDetected) {
@@ -536,20 +1327,13 @@ static void URLInBlackListAdd(NSURL *url) {
                     NSDictionary *jpeg = dic[(id)kCGImagePropertyJFIFDictionary];
                     NSNumber *isProg = jpeg[(id)kCGImagePropertyJFIFIsProgressive];
                     if (!isProg.boolValue) {
-                        _progressiveIgnored = YES;
                         _progressiveDecoder = nil;
-                        return;
+                        *ignored = YES;
+                        return nil;
                     }
                     _progressiveDetected = YES;
                 }
-                
-                NSInteger scanLength = (NSInteger)_data.length - (NSInteger)_progressiveScanedLength - 4;
-                if (scanLength <= 2) return;
-                NSRange scanRange = NSMakeRange(_progressiveScanedLength, scanLength);
-                NSRange markerRange = [_data rangeOfData:JPEGSOSMarker() options:kNilOptions range:scanRange];
-                _progressiveScanedLength = _data.length;
-                if (markerRange.location == NSNotFound) return;
-                if ([self isCancelled]) return;
+                // the data contains a new scan, see `YYJPEGScannerFeed()`
                 
             } else if (_progressiveDecoder.type == YYImageTypePNG) {
                 if (!_progressiveDetected) {
@@ -557,9 +1341,9 @@ static void URLInBlackListAdd(NSURL *url) {
                     NSDictionary *png = dic[(id)kCGImagePropertyPNGDictionary];
                     NSNumber *isProg = png[(id)kCGImagePropertyPNGInterlaceType];
                     if (!isProg.boolValue) {
-                        _progressiveIgnored = YES;
                         _progressiveDecoder = nil;
-                        return;
+                        *ignored = YES;
+                        return nil;
                     }
                     _progressiveDetected = YES;
                 }
@@ -567,54 +1351,56 @@ static void URLInBlackListAdd(NSURL *url) {
             
             YYImageFrame *frame = [_progressiveDecoder frameAtIndex:0 decodeForDisplay:YES];
             UIImage *image = frame.image;
-            if (!image) return;
-            if ([self isCancelled]) return;
+            if (!image) return nil;
+            if ([self isCancelled]) return nil;
             
-            if (!YYCGImageLastPixelFilled(image.CGImage)) return;
+            if (!YYCGImageLastPixelFilled(image.CGImage)) return nil;
             _progressiveDisplayCount++;
             
             CGFloat radius = 32;
-            if (_expectedSize > 0) {
-                radius *= 1.0 / (3 * _data.length / (CGFloat)_expectedSize + 0.6) - 0.25;
+            if (expectedSize > 0) {
+                radius *= 1.0 / (3 * data.length / (CGFloat)expectedSize + 0.6) - 0.25;
             } else {
                 radius /= (_progressiveDisplayCount);
             }
-            image = [image imageByBlurRadius:radius tintColor:nil tintMode:0 saturation:1 maskImage:nil];
-            
-            if (image) {
-                [_lock lock];
-                if (![self isCancelled]) {
-                    _completion(image, _request.URL, YYWebImageFromRemote, YYWebImageStageProgress, nil);
-                    _lastProgressiveDecodeTimestamp = now;
-                }
-                [_lock unlock];
-            }
+            return [image imageByBlurRadius:radius tintColor:nil tintMode:0 saturation:1 maskImage:nil];
         }
     }
 }
 
-- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
+- (void)_taskDidFinishLoading {
     @autoreleasepool {
         [_lock lock];
-        _connection = nil;
+        _task = nil;
+        if (_dataBuffer) {
+            _data = [_dataBuffer snapshot];
+            _dataBuffer = nil;
+        }
+        if (_dataFile >= 0) {
+            close(_dataFile);
+            _dataFile = -1;
+            _fileData = [NSData dataWithContentsOfFile:_dataFilePath options:NSDataReadingMappedAlways error:NULL];
+            if (!_fileData) [self _removeDataFile];
+        }
         if (![self isCancelled]) {
             __weak typeof(self) _self = self;
-            dispatch_async([self.class _imageQueue], ^{
+            [self _decodeAsync:^{
                 __strong typeof(_self) self = _self;
                 if (!self) return;
                 
+                NSData *imageData = self.fileData ? self.fileData : self.data; // mapped file or data in memory
                 BOOL shouldDecode = (self.options & YYWebImageOptionIgnoreImageDecoding) == 0;
                 BOOL allowAnimation = (self.options & YYWebImageOptionIgnoreAnimatedImage) == 0;
                 UIImage *image;
                 BOOL hasAnimation = NO;
                 if (allowAnimation) {
-                    image = [[YYImage alloc] initWithData:self.data scale:[UIScreen mainScreen].scale];
+                    image = [[YYImage alloc] initWithData:imageData scale:[UIScreen mainScreen].scale maxPixelSize:self.maxPixelSize];
                     if (shouldDecode) image = [image imageByDecoded];
                     if ([((YYImage *)image) animatedImageFrameCount] > 1) {
                         hasAnimation = YES;
                     }
                 } else {
-                    YYImageDecoder *decoder = [YYImageDecoder decoderWithData:self.data scale:[UIScreen mainScreen].scale];
+                    YYImageDecoder *decoder = [YYImageDecoder decoderWithData:imageData scale:[UIScreen mainScreen].scale maxPixelSize:self.maxPixelSize];
                     image = [decoder frameAtIndex:0 decodeForDisplay:shouldDecode].image;
                 }
                 
@@ -622,23 +1408,29 @@ static void URLInBlackListAdd(NSURL *url) {
                  If the image has animation, save the original image data to disk cache.
                  If the image is not PNG or JPEG, re-encode the image to PNG or JPEG for
                  better decoding performance.
+                 If the image is downsampled, always save the original image data, the
+                 downsampled image should not be re-encoded as the original image.
                  */
-                YYImageType imageType = YYImageDetectType((__bridge CFDataRef)self.data);
-                switch (imageType) {
-                    case YYImageTypeJPEG:
-                    case YYImageTypeGIF:
-                    case YYImageTypePNG:
-                    case YYImageTypeWebP: { // save to disk cache
-                        if (!hasAnimation) {
-                            if (imageType == YYImageTypeGIF ||
-                                imageType == YYImageTypeWebP) {
-                                self.data = nil; // clear the data, re-encode for disk cache
+                YYImageType imageType = YYImageDetectType((__bridge CFDataRef)imageData);
+                if (self.maxPixelSize == 0) {
+                    switch (imageType) {
+                        case YYImageTypeJPEG:
+                        case YYImageTypeGIF:
+                        case YYImageTypePNG:
+                        case YYImageTypeWebP: { // save to disk cache
+                            if (!hasAnimation) {
+                                if (imageType == YYImageTypeGIF ||
+                                    imageType == YYImageTypeWebP) {
+                                    self.data = nil; // clear the data, re-encode for disk cache
+                                    self.fileData = nil;
+                                }
                             }
-                        }
-                    } break;
-                    default: {
-                        self.data = nil; // clear the data, re-encode for disk cache
-                    } break;
+                        } break;
+                        default: {
+                            self.data = nil; // clear the data, re-encode for disk cache
+                            self.fileData = nil;
+                        } break;
+                    }
                 }
                 if ([self isCancelled]) return;
                 
@@ -646,13 +1438,21 @@ static void URLInBlackListAdd(NSURL *url) {
                     UIImage *newImage = self.transform(image, self.request.URL);
                     if (newImage != image) {
                         self.data = nil;
+                        self.fileData = nil;
+                        self.imageTransformed = YES;
                     }
                     image = newImage;
                     if ([self isCancelled]) return;
                 }
+                if (self.transformer && image) {
+                    image = [self _transformImage:image];
+                    if ([self isCancelled]) return;
+                }
                 
-                [self performSelector:@selector(_didReceiveImageFromWeb:) onThread:[self.class _networkThread] withObject:image waitUntilDone:NO];
-            });
+                dispatch_async(self.taskQueue, ^{
+                    [self _didReceiveImageFromWeb:image];
+                });
+            }];
             if (![self.request.URL isFileURL] && (self.options & YYWebImageOptionShowNetworkActivity)) {
                 [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
             }
@@ -661,15 +1461,23 @@ static void URLInBlackListAdd(NSURL *url) {
     }
 }
 
-- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
+- (void)_task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    if (task != _task) return; // cancelled or already failed
+    if (!error) {
+        [self _taskDidFinishLoading];
+        return;
+    }
     @autoreleasepool {
         [_lock lock];
         if (![self isCancelled]) {
             if (_completion) {
                 _completion(nil, _request.URL, YYWebImageFromNone, YYWebImageStageFinished, error);
             }
-            _connection = nil;
+            _task = nil;
+            [self _savePartialData];
             _data = nil;
+            _dataBuffer = nil;
+            [self _removeDataFile];
             if (![_request.URL isFileURL] && (_options & YYWebImageOptionShowNetworkActivity)) {
                 [[UIApplication sharedExtensionApplication] decrementNetworkActivityCount];
             }
@@ -696,7 +1504,9 @@ static void URLInBlackListAdd(NSURL *url) {
         [_lock lock];
         self.started = YES;
         if ([self isCancelled]) {
-            [self performSelector:@selector(_cancelOperation) onThread:[[self class] _networkThread] withObject:nil waitUntilDone:NO modes:@[NSDefaultRunLoopMode]];
+            dispatch_async(_taskQueue, ^{
+                [self _cancelOperation];
+            });
             self.finished = YES;
         } else if ([self isReady] && ![self isFinished] && ![self isExecuting]) {
             if (!_request) {
@@ -707,7 +1517,9 @@ static void URLInBlackListAdd(NSURL *url) {
                 }
             } else {
                 self.executing = YES;
-                [self performSelector:@selector(_startOperation) onThread:[[self class] _networkThread] withObject:nil waitUntilDone:NO modes:@[NSDefaultRunLoopMode]];
+                dispatch_async(_taskQueue, ^{
+                    [self _startOperation];
+                });
                 if ((_options & YYWebImageOptionAllowBackgroundTask) && ![UIApplication isAppExtension]) {
                     __weak __typeof__ (self) _self = self;
                     if (_taskID == UIBackgroundTaskInvalid) {
@@ -731,9 +1543,14 @@ static void URLInBlackListAdd(NSURL *url) {
     if (![self isCancelled]) {
         [super cancel];
         self.cancelled = YES;
+#ifdef YYDispatchQueuePool_h
+        [_decodeToken cancel];
+#endif
         if ([self isExecuting]) {
             self.executing = NO;
-            [self performSelector:@selector(_cancelOperation) onThread:[[self class] _networkThread] withObject:nil waitUntilDone:NO modes:@[NSDefaultRunLoopMode]];
+            dispatch_async(_taskQueue, ^{
+                [self _cancelOperation];
+            });
         }
         if (self.started) {
             self.finished = YES;
@@ -742,6 +1559,14 @@ static void URLInBlackListAdd(NSURL *url) {
     [_lock unlock];
 }
 
+- (void)setQueuePriority:(NSOperationQueuePriority)queuePriority {
+    [super setQueuePriority:queuePriority];
+    // 已经开始的请求，通过任务优先级调整（HTTP/2 流优先级）
+    [_lock lock];
+    _task.priority = YYURLSessionTaskPriority(queuePriority);
+    [_lock unlock];
+}
+
 - (void)setExecuting:(BOOL)executing {
     [_lock lock];
     if (_executing != executing) {
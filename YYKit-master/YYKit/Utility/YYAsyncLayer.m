@@ -18,11 +18,9 @@
 #import <libkern/OSAtomic.h>
 #endif
 
+#ifndef YYDispatchQueuePool_h
 /// Global display queue, used for content rendering.
 static dispatch_queue_t YYAsyncLayerGetDisplayQueue() {
-#ifdef YYDispatchQueuePool_h
-    return YYDispatchQueueGetForQOS(NSQualityOfServiceUserInitiated);
-#else
 #define MAX_QUEUE_COUNT 16
     static int queueCount;
     static dispatch_queue_t queues[MAX_QUEUE_COUNT];
@@ -47,6 +45,15 @@ static dispatch_queue_t YYAsyncLayerGetDisplayQueue() {
     if (cur < 0) cur = -cur;
     return queues[(cur) % queueCount];
 #undef MAX_QUEUE_COUNT
+}
+#endif
+
+/// Runs a block for content rendering, shares the executor with image decoding.
+static void YYAsyncLayerDisplayAsync(dispatch_block_t block) {
+#ifdef YYDispatchQueuePool_h
+    YYDispatchExecutorAsync(NSQualityOfServiceUserInitiated, block);
+#else
+    dispatch_async(YYAsyncLayerGetDisplayQueue(), block);
 #endif
 }
 
@@ -140,7 +147,7 @@ static dispatch_queue_t YYAsyncLayerGetReleaseQueue() {
             return;
         }
         
-        dispatch_async(YYAsyncLayerGetDisplayQueue(), ^{
+        YYAsyncLayerDisplayAsync(^{
             if (isCancelled()) {
                 CGColorRelease(backgroundColor);
                 return;
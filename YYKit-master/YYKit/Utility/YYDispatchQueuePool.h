@@ -46,6 +46,84 @@ NS_ASSUME_NONNULL_BEGIN
 /// Get a serial queue from global queue pool with a specified qos.
 extern dispatch_queue_t YYDispatchQueueGetForQOS(NSQualityOfService qos);
 
+
+
+/**
+ A token to cancel the tasks submitted to a `YYDispatchExecutor`.
+ A cancelled task which is not started will not be executed; a long running task
+ may check `isCancelled` to stop early.
+ 
+ @note 取消令牌，取消后还未开始的任务不会执行，正在执行的任务可以检查isCancelled提前结束
+ */
+@interface YYDispatchCancellationToken : NSObject
+/// Whether the token is cancelled. This method is thread-safe.
+@property (readonly, getter=isCancelled) BOOL cancelled;
+/// Cancel the token. This method is thread-safe.
+- (void)cancel;
+@end
+
+
+/**
+ A work-stealing executor for decode and render tasks.
+ 
+ @discussion The executor has a fixed number of worker threads (active processor
+ count by default). Each worker has its own task deque with one lane per quality
+ of service. A task is pushed to the deque of the current worker (when submitted
+ from a worker) or of a worker chosen round-robin; a worker takes a task of the highest
+ lane, the newest one from its own deque first and then the oldest one by stealing from
+ the other workers. So a long task never blocks the tasks queued behind it while other
+ workers are idle, which happens with a pool of serial queues. The thread runs each
+ task with the QoS of its lane, and an idle worker blocks until a task is submitted.
+ 
+ The workers are sized for CPU bound work, don't submit blocking IO to an executor.
+ 
+ The worker threads are never exited, an executor is never deallocated once created.
+ 
+ @note 工作窃取的任务执行器：每个工作线程有自己的任务队列（按QoS分道），线程从自己队列的尾部取任务，
+ 空闲时从其他线程队列的头部窃取任务，耗时长的任务不会阻塞排在后面的任务。线程数按CPU数设置，不要提交阻塞的IO任务
+ */
+@interface YYDispatchExecutor : NSObject
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+/**
+ Creates and returns an executor.
+ @param name        The name of the executor (used as the name of worker threads).
+ @param workerCount The worker count, should in range (1, 32).
+ @return A new executor, or nil if an error occurs.
+ */
+- (nullable instancetype)initWithName:(nullable NSString *)name workerCount:(NSUInteger)workerCount;
+
+/// The shared executor used by image decoding and async rendering.
++ (instancetype)sharedExecutor;
+
+/// Executor's name.
+@property (nullable, nonatomic, readonly) NSString *name;
+
+/// The worker count.
+@property (nonatomic, readonly) NSUInteger workerCount;
+
+/**
+ Submits a block for asynchronous execution.
+ @param qos   The quality of service of the task, tasks in higher QoS lanes run first.
+ @param block The block to execute.
+ */
+- (void)async:(NSQualityOfService)qos block:(dispatch_block_t)block;
+
+/**
+ Submits a block for asynchronous execution, the block is not executed if the token 
+ is cancelled before it starts.
+ @param qos   The quality of service of the task, tasks in higher QoS lanes run first.
+ @param token The cancellation token, pass nil to avoid it.
+ @param block The block to execute.
+ */
+- (void)async:(NSQualityOfService)qos token:(nullable YYDispatchCancellationToken *)token block:(dispatch_block_t)block;
+
+@end
+
+/// Submits a block to the shared executor with a specified qos.
+extern void YYDispatchExecutorAsync(NSQualityOfService qos, dispatch_block_t block);
+
 NS_ASSUME_NONNULL_END
 
 #endif
\ No newline at end of file
@@ -12,6 +12,7 @@
 #import "YYDispatchQueuePool.h"
 #import <UIKit/UIKit.h>
 #import <libkern/OSAtomic.h>
+#import <pthread.h>
 
 #define MAX_QUEUE_COUNT 32
 
@@ -236,3 +237,274 @@ static YYDispatchContext *YYDispatchContextGetForQOS(NSQualityOfService qos) {
 dispatch_queue_t YYDispatchQueueGetForQOS(NSQualityOfService qos) {
     return YYDispatchContextGetQueue(YYDispatchContextGetForQOS(qos));
 }
+
+
+#pragma mark - Executor
+
+#define YY_EXECUTOR_LANE_COUNT 5
+
+/// Lane index for a QoS, higher QoS has lower index.
+static inline int YYExecutorLaneForQOS(NSQualityOfService qos) {
+    switch (qos) {
+        case NSQualityOfServiceUserInteractive: return 0;
+        case NSQualityOfServiceUserInitiated: return 1;
+        case NSQualityOfServiceUtility: return 3;
+        case NSQualityOfServiceBackground: return 4;
+        case NSQualityOfServiceDefault:
+        default: return 2;
+    }
+}
+
+static const qos_class_t YYExecutorLaneQOSClass[YY_EXECUTOR_LANE_COUNT] = {
+    QOS_CLASS_USER_INTERACTIVE, QOS_CLASS_USER_INITIATED, QOS_CLASS_DEFAULT, QOS_CLASS_UTILITY, QOS_CLASS_BACKGROUND
+};
+
+/// Thread specific key of the current worker.
+static pthread_key_t YYExecutorWorkerKey;
+
+
+@implementation YYDispatchCancellationToken {
+    int32_t _cancelled;
+}
+
+- (BOOL)isCancelled {
+    return OSAtomicAdd32Barrier(0, &_cancelled) != 0;
+}
+
+- (void)cancel {
+    OSAtomicCompareAndSwap32Barrier(0, 1, &_cancelled);
+}
+
+@end
+
+
+/// A task in the executor.
+@interface _YYExecutorTask : NSObject {
+    @package
+    dispatch_block_t _block;
+    YYDispatchCancellationToken *_token;
+}
+@end
+
+@implementation _YYExecutorTask
+@end
+
+
+/// A worker thread and its task deque (one lane per QoS).
+@interface _YYExecutorWorker : NSObject {
+    @package
+    pthread_mutex_t _lock;
+    NSMutableArray *_lanes[YY_EXECUTOR_LANE_COUNT]; ///< Array<_YYExecutorTask>
+    __unsafe_unretained YYDispatchExecutor *_executor;
+    NSString *_name;
+}
+@end
+
+@implementation _YYExecutorWorker
+
+- (instancetype)init {
+    self = [super init];
+    pthread_mutex_init(&_lock, NULL);
+    for (int i = 0; i < YY_EXECUTOR_LANE_COUNT; i++) {
+        _lanes[i] = [NSMutableArray new];
+    }
+    return self;
+}
+
+/// Removes and returns a task in a lane: the newest one for the owner (LIFO, the data it
+/// touches is likely still in cache), or the oldest one for a thief (FIFO, from the other end).
+- (_YYExecutorTask *)takeTaskInLane:(int)lane steal:(BOOL)steal {
+    _YYExecutorTask *task = nil;
+    pthread_mutex_lock(&_lock);
+    NSMutableArray *tasks = _lanes[lane];
+    if (tasks.count) {
+        if (steal) {
+            task = tasks.firstObject;
+            [tasks removeObjectAtIndex:0];
+        } else {
+            task = tasks.lastObject;
+            [tasks removeLastObject];
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+    return task;
+}
+
+- (void)addTask:(_YYExecutorTask *)task inLane:(int)lane {
+    pthread_mutex_lock(&_lock);
+    [_lanes[lane] addObject:task];
+    pthread_mutex_unlock(&_lock);
+}
+
+@end
+
+
+@implementation YYDispatchExecutor {
+    NSArray *_workers; ///< Array<_YYExecutorWorker>
+    pthread_mutex_t _lock; ///< guards the fields below
+    pthread_cond_t _taskCond; ///< signaled when a task is added
+    pthread_cond_t _missCond; ///< broadcasted when a task is added, for the workers which missed a task
+    NSUInteger _pendingCount; ///< the count of tasks not claimed by a worker
+    NSUInteger _missWaiters;
+    uint64_t _addCount; ///< the count of tasks added, increased only
+    int32_t _counter;
+}
+
+static void *YYExecutorWorkerMain(void *context);
+
+- (instancetype)initWithName:(NSString *)name workerCount:(NSUInteger)workerCount {
+    if (workerCount == 0 || workerCount > MAX_QUEUE_COUNT) return nil;
+    self = [super init];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&YYExecutorWorkerKey, NULL);
+    });
+    _name = name.copy;
+    _workerCount = workerCount;
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_taskCond, NULL);
+    pthread_cond_init(&_missCond, NULL);
+    NSMutableArray *workers = [NSMutableArray new];
+    for (NSUInteger i = 0; i < workerCount; i++) {
+        _YYExecutorWorker *worker = [_YYExecutorWorker new];
+        worker->_executor = self;
+        worker->_name = name ? [NSString stringWithFormat:@"%@.%lu", name, (unsigned long)i] : nil;
+        [workers addObject:worker];
+    }
+    _workers = workers.copy;
+    
+    // 工作线程持有worker和executor，executor不会被释放
+    for (_YYExecutorWorker *worker in _workers) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_attr_set_qos_class_np(&attr, QOS_CLASS_UTILITY, 0);
+        pthread_t thread;
+        CFTypeRef context = CFBridgingRetain(@[worker, self]);
+        if (pthread_create(&thread, &attr, YYExecutorWorkerMain, (void *)context) != 0) {
+            CFRelease(context);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return self;
+}
+
++ (instancetype)sharedExecutor {
+    static YYDispatchExecutor *executor;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        int count = (int)[NSProcessInfo processInfo].activeProcessorCount;
+        count = count < 1 ? 1 : count > MAX_QUEUE_COUNT ? MAX_QUEUE_COUNT : count;
+        executor = [[YYDispatchExecutor alloc] initWithName:@"com.ibireme.yykit.executor" workerCount:count];
+    });
+    return executor;
+}
+
+- (void)async:(NSQualityOfService)qos block:(dispatch_block_t)block {
+    [self async:qos token:nil block:block];
+}
+
+- (void)async:(NSQualityOfService)qos token:(YYDispatchCancellationToken *)token block:(dispatch_block_t)block {
+    if (!block) return;
+    _YYExecutorTask *task = [_YYExecutorTask new];
+    task->_block = [block copy];
+    task->_token = token;
+    
+    // 在工作线程中提交的任务放入当前线程的队列，否则轮流放入各个线程的队列
+    _YYExecutorWorker *worker = (__bridge _YYExecutorWorker *)pthread_getspecific(YYExecutorWorkerKey);
+    if (!worker || worker->_executor != self) {
+        uint32_t counter = (uint32_t)OSAtomicIncrement32(&_counter);
+        worker = _workers[counter % _workerCount];
+    }
+    [worker addTask:task inLane:YYExecutorLaneForQOS(qos)];
+    
+    pthread_mutex_lock(&_lock);
+    _pendingCount++;
+    _addCount++;
+    pthread_cond_signal(&_taskCond);
+    if (_missWaiters) pthread_cond_broadcast(&_missCond);
+    pthread_mutex_unlock(&_lock);
+}
+
+/// Blocks until there's a task not claimed by other workers, and claims it.
+- (void)_claimTask {
+    pthread_mutex_lock(&_lock);
+    while (_pendingCount == 0) pthread_cond_wait(&_taskCond, &_lock);
+    _pendingCount--;
+    pthread_mutex_unlock(&_lock);
+}
+
+/// The count of tasks added so far.
+- (uint64_t)_addCount {
+    pthread_mutex_lock(&_lock);
+    uint64_t count = _addCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+/// Blocks until a task is added after `addCount`.
+- (void)_waitForTaskAddedAfter:(uint64_t)addCount {
+    pthread_mutex_lock(&_lock);
+    _missWaiters++;
+    while (_addCount == addCount) pthread_cond_wait(&_missCond, &_lock);
+    _missWaiters--;
+    pthread_mutex_unlock(&_lock);
+}
+
+/// Takes a task of the highest lane, from the worker's own deque first (newest), then steals from others (oldest).
+- (_YYExecutorTask *)_takeTaskForWorker:(_YYExecutorWorker *)worker index:(NSUInteger)index lane:(int *)lane {
+    for (int i = 0; i < YY_EXECUTOR_LANE_COUNT; i++) {
+        _YYExecutorTask *task = [worker takeTaskInLane:i steal:NO];
+        for (NSUInteger n = 1; !task && n < _workerCount; n++) {
+            _YYExecutorWorker *victim = _workers[(index + n) % _workerCount];
+            task = [victim takeTaskInLane:i steal:YES];
+        }
+        if (task) {
+            *lane = i;
+            return task;
+        }
+    }
+    return nil;
+}
+
+static void *YYExecutorWorkerMain(void *context) {
+    NSArray *objects = CFBridgingRelease(context);
+    _YYExecutorWorker *worker = objects[0];
+    YYDispatchExecutor *executor = objects[1];
+    objects = nil;
+    pthread_setspecific(YYExecutorWorkerKey, (__bridge void *)worker);
+    if (worker->_name) pthread_setname_np(worker->_name.UTF8String);
+    NSUInteger index = [executor->_workers indexOfObjectIdenticalTo:worker];
+    qos_class_t currentQOS = QOS_CLASS_UTILITY;
+    
+    while (YES) {
+        @autoreleasepool {
+            // 空闲时阻塞在条件变量上。认领一个任务后，队列中的任务数一定不少于认领了但还未取走任务的线程数，
+            // 所以扫描期间没有新任务加入时一定能取到任务；错过时（其他线程取走了已扫描过的队列之后加入的任务），
+            // 等待新任务加入后重新扫描，不会空转
+            [executor _claimTask];
+            int lane = 0;
+            _YYExecutorTask *task = nil;
+            while (YES) {
+                uint64_t addCount = [executor _addCount];
+                task = [executor _takeTaskForWorker:worker index:index lane:&lane];
+                if (task) break;
+                [executor _waitForTaskAddedAfter:addCount];
+            }
+            if (task->_token.isCancelled) continue;
+            qos_class_t qos = YYExecutorLaneQOSClass[lane];
+            if (qos != currentQOS) {
+                pthread_set_qos_class_self_np(qos, 0);
+                currentQOS = qos;
+            }
+            task->_block();
+        }
+    }
+    return NULL;
+}
+
+@end
+
+void YYDispatchExecutorAsync(NSQualityOfService qos, dispatch_block_t block) {
+    [[YYDispatchExecutor sharedExecutor] async:qos block:block];
+}